@@ -0,0 +1,159 @@
+/* Benchmark for the text and pattern drawing (ft2_glyphs.c, ft2_pattern_draw.c).
+**
+** Draws into a frame buffer in memory, no window is opened. Each test is run
+** for a number of frames (the argument, 2000 by default), and the time per
+** frame is printed:
+**   text          - a screen full of textOut() (transparent glyphs)
+**   text bg       - the same with charOutBg() (opaque glyphs)
+**   hex bg        - hexOutBg(), like the numbers in the GUI
+**   pattern       - writePattern() while a song plays (the rows scroll)
+**   pattern edit  - writePattern() when every row on the screen has changed
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../src/ft2_header.h"
+#include "../src/ft2_bmp.h"
+#include "../src/ft2_config.h"
+#include "../src/ft2_gui.h"
+#include "../src/ft2_palette.h"
+#include "../src/ft2_pattern_draw.h"
+#include "../src/ft2_replayer.h"
+#include "../src/ft2_structs.h"
+#include "../src/ft2_tables.h"
+#include "../src/ft2_video.h"
+
+#define TEXT_COLUMNS 78
+#define TEXT_ROWS 40
+
+static const char benchText[] = "The quick brown fox jumps over the lazy dog. 0123456789 ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static void drawText(int32_t frame)
+{
+	char line[TEXT_COLUMNS+1];
+	for (int32_t y = 0; y < TEXT_ROWS; y++)
+	{
+		const int32_t offset = (frame + y) % (sizeof (benchText) - TEXT_COLUMNS);
+		memcpy(line, &benchText[offset], TEXT_COLUMNS);
+		line[TEXT_COLUMNS] = '\0';
+
+		textOut(4, (uint16_t)(y * 10), PAL_FORGRND, line);
+	}
+}
+
+static void drawTextBg(int32_t frame)
+{
+	for (int32_t y = 0; y < TEXT_ROWS; y++)
+	{
+		const int32_t offset = (frame + y) % (sizeof (benchText) - TEXT_COLUMNS);
+		for (int32_t x = 0; x < TEXT_COLUMNS; x++)
+			charOutBg((uint16_t)(4 + (x * 8)), (uint16_t)(y * 10), PAL_FORGRND, PAL_DESKTOP, benchText[offset + x]);
+	}
+}
+
+static void drawHexBg(int32_t frame)
+{
+	for (int32_t y = 0; y < TEXT_ROWS; y++)
+	{
+		for (int32_t x = 0; x < 8; x++)
+			hexOutBg((uint16_t)(4 + (x * 76)), (uint16_t)(y * 10), PAL_FORGRND, PAL_DESKTOP, (uint32_t)(frame * 7919) + (y * 8) + x, 8);
+	}
+}
+
+static void drawPattern(int32_t frame)
+{
+	writePattern(frame % patternNumRows[0], 0);
+}
+
+static void drawEditedPattern(int32_t frame)
+{
+	// change every row, so that nothing drawn before can be reused
+	note_t *p = pattern[0];
+	for (int32_t row = 0; row < patternNumRows[0]; row++)
+		p[row * MAX_CHANNELS].efxData = (uint8_t)(frame + row);
+
+	writePattern(32, 0);
+}
+
+static void fillPattern(note_t *p, int32_t numRows)
+{
+	srand(1234);
+	for (int32_t row = 0; row < numRows; row++)
+	{
+		for (int32_t ch = 0; ch < MAX_CHANNELS; ch++, p++)
+		{
+			if (rand() & 1)
+				continue; // leave some cells empty, like in a real song
+
+			p->note = (uint8_t)(1 + (rand() % 96));
+			p->instr = (uint8_t)(1 + (rand() % 32));
+			p->vol = (uint8_t)(0x10 + (rand() % 0x40));
+			p->efx = (uint8_t)(rand() % 16);
+			p->efxData = (uint8_t)rand();
+		}
+	}
+}
+
+static void runBench(const char *name, void (*func)(int32_t), int32_t numFrames)
+{
+	for (int32_t i = 0; i < 10; i++) // warm up (caches)
+		func(i);
+
+	const uint64_t start = SDL_GetPerformanceCounter();
+	for (int32_t i = 0; i < numFrames; i++)
+		func(i);
+	const uint64_t end = SDL_GetPerformanceCounter();
+
+	const double dUsPerFrame = ((double)(end - start) * 1000000.0) / ((double)SDL_GetPerformanceFrequency() * numFrames);
+	printf("%-14s %10.2f us/frame\n", name, dUsPerFrame);
+}
+
+int main(int argc, char *argv[])
+{
+	const int32_t numFrames = (argc > 1) ? atoi(argv[1]) : 2000;
+	if (numFrames <= 0)
+		return 1;
+
+	video.frameBuffer = (uint32_t *)calloc(SCREEN_W * SCREEN_H, sizeof (int32_t));
+	pattern[0] = (note_t *)calloc(MAX_PATT_LEN * TRACK_WIDTH, 1);
+
+	if (video.frameBuffer == NULL || pattern[0] == NULL || !loadBMPs())
+	{
+		fprintf(stderr, "Not enough memory!\n");
+		return 1;
+	}
+
+	setPalette(palTable[0], false);
+
+	// the default pattern editor settings, with 8 channels shown
+	config.ptnFont = 0;
+	config.ptnHex = 1;
+	config.ptnShowVolColumn = 1;
+	config.ptnChnNumbers = 1;
+	config.ptnFrmWrk = 1;
+	config.ptnLineLight = 1;
+	config.ptnLineLightStep = 4;
+	updatePattFontPtrs();
+
+	song.numChannels = 8;
+	ui.numChannelsShown = 8;
+	ui.maxVisibleChannels = 8;
+	ui.patternEditorShown = true;
+
+	patternNumRows[0] = 64;
+	fillPattern(pattern[0], patternNumRows[0]);
+
+	runBench("text", drawText, numFrames);
+	runBench("text bg", drawTextBg, numFrames);
+	runBench("hex bg", drawHexBg, numFrames);
+	runBench("pattern", drawPattern, numFrames);
+	runBench("pattern edit", drawEditedPattern, numFrames);
+
+	free(pattern[0]);
+	free(video.frameBuffer);
+	freeBMPs();
+
+	return 0;
+}
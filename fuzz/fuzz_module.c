@@ -0,0 +1,20 @@
+/* Fuzz target for the module loaders (libFuzzer, or AFL with fuzz_standalone.c).
+**
+** The data goes through testLoadModule(), which detects the format like for a
+** loaded file, and runs the XM/IT/S3M/STM/MOD/STK/DIGI/BEM loader on it. No GUI
+** is needed, the loader messages are silenced. The job workers aren't started,
+** so the samples are decoded on this thread.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../src/ft2_module_loader.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	if (size > UINT32_MAX)
+		return 0;
+
+	testLoadModule(data, (uint32_t)size);
+	return 0;
+}
@@ -0,0 +1,18 @@
+/* Fuzz target for the sample loaders (libFuzzer, or AFL with fuzz_standalone.c).
+**
+** The data goes through testLoadSample(), which detects the format like for a
+** loaded file, and runs the WAV/AIFF/IFF/BRR/FLAC/MP3/OGG/RAW loader on it.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../src/ft2_sample_loader.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	if (size > UINT32_MAX)
+		return 0;
+
+	testLoadSample(data, (uint32_t)size);
+	return 0;
+}
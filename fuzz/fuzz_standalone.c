@@ -0,0 +1,87 @@
+/* A main() for the fuzz targets when they're not linked with libFuzzer.
+**
+** Every file on the command line is passed to LLVMFuzzerTestOneInput() once
+** (this is how the regression corpus is run by CTest). Without arguments, one
+** input is read from stdin, for AFL (afl-fuzz -i corpus/module -o out -- ./fuzz_module).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static uint8_t *readInput(FILE *f, size_t *size)
+{
+	size_t bufSize = 65536, length = 0;
+	uint8_t *buf = (uint8_t *)malloc(bufSize);
+	if (buf == NULL)
+		return NULL;
+
+	while (true)
+	{
+		if (length == bufSize)
+		{
+			bufSize *= 2;
+			uint8_t *newBuf = (uint8_t *)realloc(buf, bufSize);
+			if (newBuf == NULL)
+			{
+				free(buf);
+				return NULL;
+			}
+
+			buf = newBuf;
+		}
+
+		const size_t bytesRead = fread(&buf[length], 1, bufSize - length, f);
+		if (bytesRead == 0)
+			break;
+
+		length += bytesRead;
+	}
+
+	*size = length;
+	return buf;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t size;
+
+	if (argc < 2)
+	{
+		uint8_t *data = readInput(stdin, &size);
+		if (data == NULL)
+			return 1;
+
+		LLVMFuzzerTestOneInput(data, size);
+		free(data);
+		return 0;
+	}
+
+	for (int i = 1; i < argc; i++)
+	{
+		FILE *f = fopen(argv[i], "rb");
+		if (f == NULL)
+		{
+			fprintf(stderr, "Couldn't open %s\n", argv[i]);
+			return 1;
+		}
+
+		uint8_t *data = readInput(f, &size);
+		fclose(f);
+
+		if (data == NULL)
+			return 1;
+
+		printf("%s\n", argv[i]);
+		fflush(stdout); // (so that a crash shows which file it was)
+
+		LLVMFuzzerTestOneInput(data, size);
+		free(data);
+	}
+
+	return 0;
+}
@@ -27,7 +27,7 @@
 
 static int32_t smpShiftValue;
 static uint32_t oldAudioFreq, tickTimeLenInt, randSeed = INITIAL_DITHER_SEED;
-static uint64_t tickTimeLenFrac;
+static uint64_t tickTimeLenFrac, callbackStartTime;
 static float fSqrtPanningTable[256+1], fAudioNormalizeMul, fPrngStateL, fPrngStateR;
 static voice_t voice[MAX_CHANNELS * 2];
 
@@ -757,7 +757,13 @@ void resumeAudio(void) // unlock audio
 	audioPaused = false;
 }
 
-static void fillVisualsSyncBuffer(void)
+// when the sample at bufferPosition in the current callback's buffer will be heard
+static uint64_t getSampleOutputTime(int32_t bufferPosition)
+{
+	return callbackStartTime + audio.audLatencyPerfValInt + (((uint64_t)bufferPosition * hpcFreq.freq64) / audio.freq);
+}
+
+static void fillVisualsSyncBuffer(int32_t bufferPosition)
 {
 	pattSyncData_t pattSyncData;
 	chSyncData_t chSyncData;
@@ -766,7 +772,7 @@ static void fillVisualsSyncBuffer(void)
 	{
 		audio.resetSyncTickTimeFlag = false;
 
-		audio.tickTime64 = SDL_GetPerformanceCounter() + audio.audLatencyPerfValInt;
+		audio.tickTime64 = getSampleOutputTime(bufferPosition);
 		audio.tickTime64Frac = audio.audLatencyPerfValFrac;
 	}
 
@@ -821,6 +827,41 @@ static void fillVisualsSyncBuffer(void)
 	}
 }
 
+/* The tick timestamps are advanced by the nominal tick length, but the audio
+** device clock never runs at exactly the same rate as the HPC timer. Compare
+** the timestamp of the next tick against when it should be heard (measured
+** the same way as on sync reset), and steer it slowly towards that. The
+** callback timing is jittery, so only a small part of the error is applied
+** per callback. Big errors (buffer underruns etc.) reset the sync instead.
+** This replaces the old "reset the sync every half an hour" approach.
+*/
+#define SYNC_DRIFT_SMOOTHING 256
+#define SYNC_MAX_ERROR_MS 50
+
+static void correctSyncDrift(void)
+{
+	if (audio.resetSyncTickTimeFlag || audio.tickTime64 == 0)
+		return;
+
+	// next tick starts this many samples into the buffer
+	const int32_t nextTickPos = (audio.tickSampleCounter > 0) ? audio.tickSampleCounter : 0;
+
+	const int64_t error = (int64_t)(getSampleOutputTime(nextTickPos) - audio.tickTime64);
+
+	// allow for bursty callbacks (some audio backends call us several times in a row)
+	const int64_t maxError = (int64_t)(((hpcFreq.freq64 * SYNC_MAX_ERROR_MS) / 1000) + (audio.audLatencyPerfValInt * 2));
+	if (error > maxError || error < -maxError)
+	{
+		audio.resetSyncTickTimeFlag = true;
+		audio.syncCorrection = 0;
+		return;
+	}
+
+	const int64_t correction = error / SYNC_DRIFT_SMOOTHING;
+	audio.tickTime64 += correction;
+	audio.syncCorrection = correction;
+}
+
 static void audioCallback(void *userdata, Uint8 *stream, int len)
 {
 	if (editor.wavIsRendering)
@@ -835,6 +876,10 @@ static void audioCallback(void *userdata, Uint8 *stream, int len)
 
 	audio.callbackOngoing = true;
 
+	callbackStartTime = SDL_GetPerformanceCounter();
+	if (!musicPaused && audio.freq > 0)
+		correctSyncDrift();
+
 	int32_t bufferPosition = 0;
 
 	uint32_t samplesLeft = len;
@@ -852,7 +897,7 @@ static void audioCallback(void *userdata, Uint8 *stream, int len)
 				updateVoices();
 
 				if (audio.samplesPerTickInt != 0)
-					fillVisualsSyncBuffer();
+					fillVisualsSyncBuffer(bufferPosition);
 			}
 			replayerBusy = false;
 
@@ -49,6 +49,7 @@ typedef struct audio_t
 	uint64_t audLatencyPerfValFrac, tickTimeFracTab[(MAX_BPM-MIN_BPM)+1];
 
 	uint64_t tickTime64, tickTime64Frac;
+	volatile int64_t syncCorrection; // last audio/video sync drift correction (HPC ticks), for the FPS counter
 
 	float *fMixBufferL, *fMixBufferR, fQuickVolRampSamplesMul, fSamplesPerTickIntMul;
 
@@ -0,0 +1,758 @@
+/* Autosave of the current song, for recovery after a crash.
+**
+** setSongModifiedFlag() marks the song as dirty. At most every
+** AUTOSAVE_INTERVAL_SECS seconds, the GUI thread then takes a snapshot of the
+** patterns and instruments that have changed since the last autosave (found by
+** comparing checksums) by copying them. The sample data is neither hashed nor
+** copied here, its dataVersion tells if it has changed, and the snapshot holds
+** the sample data (see holdSmpData()) so that it stays allocated. A background
+** job encodes the snapshot in the XM format and appends it to a journal file
+** next to FT2.CFG, so the GUI and the audio never wait for the encoding or the
+** disk. If held sample data is edited meanwhile, the job may have read some of
+** it half-edited, so the snapshot is left without its "END " record (the
+** previous one is recovered then), and the next autosave has the edit.
+**
+** The journal is deleted when the song is saved or loaded, and when the
+** program is closed normally. If it's still there on the next start, the last
+** complete snapshot in it is rebuilt into an XM module and loaded.
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+#include "ft2_header.h"
+#include "ft2_sysreqs.h"
+#include "ft2_memfile.h"
+#include "ft2_module_loader.h"
+#include "ft2_module_saver.h"
+#include "ft2_sample_ed.h"
+#include "ft2_structs.h"
+#include "ft2_jobs.h"
+#include "ft2_autosave.h"
+
+#define JOURNAL_FILE_ID "FT2ASAV1"
+#define JOURNAL_COMPACT_BYTES (1024*1024) /* the journal is rewritten when it's this much bigger than twice its compacted size */
+#define HASH_SEED 0xCBF29CE484222325ULL
+#define HASH_PRIME 0x100000001B3ULL
+#define EMPTY_INSTR_HEADER_LEN (22+11)
+
+/* Journal file format (native endian, like the XM data in it):
+** char[8] ID, then records of char[4] type, uint32_t index, uint64_t length and the data.
+** "SONG" has the xmHdr_t, "PATT" an xmPatHdr_t and the packed pattern, "INST" an XM instrument
+** (headers and delta encoded sample data). A snapshot ends with an "END " record that has the
+** number of records and a checksum of them, so that a snapshot that was cut off is ignored.
+*/
+
+typedef struct recordHdr_t
+{
+	char type[4];
+	uint32_t index;
+	uint64_t length;
+} recordHdr_t;
+
+typedef struct recordEnd_t
+{
+	uint32_t numRecords, reserved;
+	uint64_t checksum;
+} recordEnd_t;
+
+typedef struct autosaveSnapshot_t // copies of the changed song data (not of the sample data), owned by the job until it's done
+{
+	bool newJournal, pattChanged[MAX_PATTERNS], instrChanged[1+MAX_INST];
+	char instrName[1+MAX_INST][22+1];
+	int16_t pattNumRows[MAX_PATTERNS], instrNumSamples[1+MAX_INST];
+	int32_t numChannels;
+	uint64_t pattHash[MAX_PATTERNS], instrHash[1+MAX_INST], journalBytes;
+	note_t *patt[MAX_PATTERNS]; // NULL for empty patterns
+	instr_t *instr[1+MAX_INST]; // NULL for empty instruments, their samples point to the held sample data
+	xmHdr_t header;
+	UNICHAR *journalPathU, *tmpPathU;
+} autosaveSnapshot_t;
+
+typedef struct journalState_t // the latest records, pointing into the journal file
+{
+	const uint8_t *header, *patt[MAX_PATTERNS], *instr[1+MAX_INST];
+	uint64_t pattLength[MAX_PATTERNS], instrLength[1+MAX_INST];
+} journalState_t;
+
+static volatile bool jobBusy; // set while the job function runs
+static bool jobRunning, journalWritten, canAppend;
+static int32_t journalNumChannels;
+static uint32_t lastSnapshotTime;
+static uint64_t journalBytes, compactedBytes, pattHash[MAX_PATTERNS], instrHash[1+MAX_INST];
+static journalState_t state, pendingState;
+
+static uint64_t hashData(uint64_t h, const void *data, size_t length) // for finding changes, 8 bytes at a time
+{
+	const uint8_t *p = (const uint8_t *)data;
+	for (; length >= 8; length -= 8, p += 8)
+	{
+		uint64_t x;
+		memcpy(&x, p, 8);
+
+		h = (h ^ x) * HASH_PRIME;
+		h ^= h >> 32;
+	}
+
+	for (; length > 0; length--)
+		h = (h ^ *p++) * HASH_PRIME;
+
+	return h;
+}
+
+static uint64_t checksum(uint64_t h, const void *data, size_t length) // FNV-1a, the data can be split up
+{
+	const uint8_t *p = (const uint8_t *)data;
+	for (; length > 0; length--)
+		h = (h ^ *p++) * HASH_PRIME;
+
+	return h;
+}
+
+static uint64_t hashPatt(const note_t *p, int16_t numRows)
+{
+	uint64_t h = hashData(HASH_SEED, &numRows, sizeof (numRows));
+	if (p != NULL)
+		h = hashData(h, p, numRows * TRACK_WIDTH);
+
+	return h;
+}
+
+static uint64_t hashInstr(const instr_t *ins, const char *name)
+{
+	uint64_t h = hashData(HASH_SEED, name, strlen(name));
+	if (ins == NULL)
+		return h;
+
+	h = hashData(h, ins, offsetof(instr_t, smp)); // the instrument header
+	for (int32_t i = 0; i < MAX_SMP_PER_INST; i++)
+	{
+		const sample_t *s = &ins->smp[i];
+		const int32_t smpHeader[9] =
+		{
+			s->finetune, s->relativeNote, s->volume, s->flags, s->panning,
+			s->length, s->loopStart, s->loopLength, s->dataPtr != NULL
+		};
+
+		h = hashData(h, s->name, strlen(s->name));
+		h = hashData(h, smpHeader, sizeof (smpHeader));
+		if (s->dataPtr != NULL)
+			h = hashData(h, &s->dataVersion, sizeof (s->dataVersion)); // (instead of the data, which can be big)
+	}
+
+	return h;
+}
+
+static UNICHAR *getJournalPathU(bool tmpFile) // kinda hackish
+{
+	int32_t autosaveStrLen, ft2DotCfgStrLen;
+
+	if (editor.configFileLocationU == NULL)
+		return NULL;
+
+	const int32_t ft2ConfPathLen = (int32_t)UNICHAR_STRLEN(editor.configFileLocationU);
+
+#ifdef _WIN32
+	autosaveStrLen = (int32_t)UNICHAR_STRLEN(L"autosave.dat");
+	ft2DotCfgStrLen = (int32_t)UNICHAR_STRLEN(L"FT2.CFG");
+#else
+	autosaveStrLen = (int32_t)UNICHAR_STRLEN("autosave.dat");
+	ft2DotCfgStrLen = (int32_t)UNICHAR_STRLEN("FT2.CFG");
+#endif
+
+	UNICHAR *filePathU = (UNICHAR *)malloc((ft2ConfPathLen + autosaveStrLen + 1) * sizeof (UNICHAR));
+	if (filePathU == NULL)
+		return NULL;
+
+	UNICHAR_STRCPY(filePathU, editor.configFileLocationU);
+	filePathU[ft2ConfPathLen-ft2DotCfgStrLen] = 0;
+
+#ifdef _WIN32
+	UNICHAR_STRCAT(filePathU, tmpFile ? L"autosave.tmp" : L"autosave.dat");
+#else
+	UNICHAR_STRCAT(filePathU, tmpFile ? "autosave.tmp" : "autosave.dat");
+#endif
+
+	return filePathU;
+}
+
+static void deleteJournal(void)
+{
+	UNICHAR *journalPathU = getJournalPathU(false);
+	if (journalPathU != NULL)
+	{
+		UNICHAR_REMOVE(journalPathU);
+		free(journalPathU);
+	}
+}
+
+static instr_t *snapshotInstr(const instr_t *src) // the sample data is held, the job reads it like the saver (unfixed)
+{
+	instr_t *ins = (instr_t *)malloc(sizeof (instr_t));
+	if (ins == NULL)
+		return NULL;
+
+	memcpy(ins, src, sizeof (instr_t));
+
+	for (int32_t i = 0; i < MAX_SMP_PER_INST; i++)
+	{
+		if (!holdSmpData(&ins->smp[i]))
+		{
+			free(ins);
+			return NULL;
+		}
+	}
+
+	return ins;
+}
+
+static void freeSnapshot(autosaveSnapshot_t *snap)
+{
+	for (int32_t i = 0; i < MAX_PATTERNS; i++)
+	{
+		if (snap->patt[i] != NULL)
+			free(snap->patt[i]);
+	}
+
+	for (int32_t i = 1; i <= MAX_INST; i++)
+	{
+		if (snap->instr[i] != NULL)
+			free(snap->instr[i]);
+	}
+
+	releaseHeldSmpData(); // (the job is done with it)
+
+	if (snap->journalPathU != NULL) free(snap->journalPathU);
+	if (snap->tmpPathU != NULL) free(snap->tmpPathU);
+
+	free(snap);
+}
+
+static bool writeRecordHeader(FILE *f, const char *type, uint32_t index, uint64_t length, uint64_t *sum)
+{
+	recordHdr_t hdr;
+
+	memcpy(hdr.type, type, 4);
+	hdr.index = index;
+	hdr.length = length;
+
+	*sum = checksum(*sum, &hdr, sizeof (hdr));
+	return fwrite(&hdr, sizeof (hdr), 1, f) == 1;
+}
+
+static bool writeRecordData(FILE *f, const void *data, size_t length, uint64_t *sum)
+{
+	*sum = checksum(*sum, data, length);
+	return fwrite(data, 1, length, f) == length;
+}
+
+static bool writeSnapshot(job_t *job, autosaveSnapshot_t *snap, FILE *f, uint8_t *pattBuf, int8_t *scratch)
+{
+	xmPatHdr_t ph;
+	xmInsHdr_t ih;
+	recordEnd_t end;
+
+	uint64_t sum = HASH_SEED;
+	uint32_t numRecords = 0;
+
+	if (!writeRecordHeader(f, "SONG", 0, sizeof (xmHdr_t), &sum) || !writeRecordData(f, &snap->header, sizeof (xmHdr_t), &sum))
+		return false;
+
+	numRecords++;
+	snap->journalBytes += sizeof (recordHdr_t) + sizeof (xmHdr_t);
+
+	for (int32_t i = 0; i < MAX_PATTERNS; i++)
+	{
+		if (!snap->pattChanged[i])
+			continue;
+
+		ph.headerSize = sizeof (xmPatHdr_t);
+		ph.type = 0;
+		ph.numRows = snap->pattNumRows[i];
+		ph.dataSize = 0;
+
+		if (snap->patt[i] != NULL)
+			ph.dataSize = packPatt(pattBuf + sizeof (xmPatHdr_t), (const uint8_t *)snap->patt[i], ph.numRows, snap->numChannels);
+
+		memcpy(pattBuf, &ph, sizeof (xmPatHdr_t));
+
+		const uint32_t length = sizeof (xmPatHdr_t) + ph.dataSize;
+		if (!writeRecordHeader(f, "PATT", i, length, &sum) || !writeRecordData(f, pattBuf, length, &sum))
+			return false;
+
+		numRecords++;
+		snap->journalBytes += sizeof (recordHdr_t) + length;
+	}
+
+	for (int32_t i = 1; i <= MAX_INST; i++)
+	{
+		if (!snap->instrChanged[i])
+			continue;
+
+		if (jobCancelled(job))
+			return false;
+
+		instr_t *ins = snap->instr[i];
+		const int16_t numSamples = snap->instrNumSamples[i]; // (zero if the instrument is empty)
+
+		const int32_t headerBytes = setupXMInstrHeader(&ih, ins, snap->instrName[i], numSamples);
+
+		uint64_t length = headerBytes;
+		for (int32_t j = 0; j < numSamples; j++)
+		{
+			const sample_t *s = &ins->smp[j];
+			if (s->dataPtr != NULL)
+				length += SAMPLE_LENGTH_BYTES(s);
+		}
+
+		if (!writeRecordHeader(f, "INST", i, length, &sum) || !writeRecordData(f, &ih, headerBytes, &sum))
+			return false;
+
+		for (int32_t j = 0; j < numSamples; j++)
+		{
+			const sample_t *s = &ins->smp[j];
+			if (s->dataPtr == NULL)
+				continue;
+
+			int16_t oldSmp = 0;
+			for (int32_t pos = 0; pos < s->length; pos += XM_ENCODE_CHUNK_LEN)
+			{
+				const int32_t bytes = encodeXMSampleChunk(s, pos, scratch, &oldSmp);
+				if (!writeRecordData(f, scratch, bytes, &sum))
+					return false;
+			}
+
+			if (heldSmpDataChanged(s)) // edited while it was encoded, don't close this snapshot
+				return false;
+		}
+
+		numRecords++;
+		snap->journalBytes += sizeof (recordHdr_t) + length;
+	}
+
+	end.numRecords = numRecords;
+	end.reserved = 0;
+	end.checksum = sum;
+
+	if (!writeRecordHeader(f, "END ", 0, sizeof (end), &sum) || !writeRecordData(f, &end, sizeof (end), &sum))
+		return false;
+
+	snap->journalBytes += sizeof (recordHdr_t) + sizeof (end);
+	return true;
+}
+
+static bool flushToDisk(FILE *f)
+{
+	if (fflush(f) != 0)
+		return false;
+
+#ifdef _WIN32
+	return _commit(_fileno(f)) == 0;
+#else
+	return fsync(fileno(f)) == 0;
+#endif
+}
+
+static bool autosaveJob(job_t *job, void *data)
+{
+	autosaveSnapshot_t *snap = (autosaveSnapshot_t *)data;
+
+	jobBusy = true;
+	if (jobCancelled(job)) // the program is closing
+	{
+		jobBusy = false;
+		return false;
+	}
+
+	uint8_t *pattBuf = (uint8_t *)malloc(sizeof (xmPatHdr_t) + (MAX_PATT_LEN * TRACK_WIDTH));
+	int8_t *scratch = (int8_t *)malloc(XM_ENCODE_SCRATCH_LEN);
+
+	// a new journal is written under a temporary name, so the old one is intact until it's complete
+	FILE *f = NULL;
+	if (pattBuf != NULL && scratch != NULL)
+		f = UNICHAR_FOPEN(snap->newJournal ? snap->tmpPathU : snap->journalPathU, snap->newJournal ? "wb" : "ab");
+
+	bool writeOK = (f != NULL);
+	if (writeOK && snap->newJournal)
+	{
+		writeOK = fwrite(JOURNAL_FILE_ID, 1, 8, f) == 8;
+		snap->journalBytes = 8;
+	}
+
+	if (writeOK) writeOK = writeSnapshot(job, snap, f, pattBuf, scratch);
+	if (writeOK) writeOK = flushToDisk(f);
+
+	if (f != NULL && fclose(f) != 0)
+		writeOK = false;
+
+	if (snap->newJournal && f != NULL)
+	{
+		if (writeOK)
+		{
+#ifdef _WIN32
+			writeOK = MoveFileExW(snap->tmpPathU, snap->journalPathU, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+			writeOK = UNICHAR_RENAME(snap->tmpPathU, snap->journalPathU) == 0;
+#endif
+		}
+
+		if (!writeOK)
+			UNICHAR_REMOVE(snap->tmpPathU);
+	}
+
+	if (pattBuf != NULL) free(pattBuf);
+	if (scratch != NULL) free(scratch);
+
+	jobBusy = false;
+	return writeOK;
+}
+
+static void autosaveJobDone(void *data, int32_t result)
+{
+	autosaveSnapshot_t *snap = (autosaveSnapshot_t *)data;
+
+	if (result == JOB_DONE)
+	{
+		// the journal now has the song data that the checksums are of
+		memcpy(pattHash, snap->pattHash, sizeof (pattHash));
+		memcpy(instrHash, snap->instrHash, sizeof (instrHash));
+
+		journalNumChannels = snap->numChannels;
+		journalBytes = snap->journalBytes;
+		if (snap->newJournal)
+			compactedBytes = journalBytes;
+
+		canAppend = true;
+	}
+	else
+	{
+		canAppend = false; // the journal may end with a broken snapshot now, so write a new one
+		editor.autosaveDirty = true; // try again later
+	}
+
+	freeSnapshot(snap);
+	jobRunning = false;
+}
+
+static void takeSnapshot(void)
+{
+	autosaveSnapshot_t *snap = (autosaveSnapshot_t *)calloc(1, sizeof (autosaveSnapshot_t));
+	if (snap == NULL)
+		return;
+
+	snap->journalPathU = getJournalPathU(false);
+	snap->tmpPathU = getJournalPathU(true);
+	if (snap->journalPathU == NULL || snap->tmpPathU == NULL)
+	{
+		freeSnapshot(snap);
+		return;
+	}
+
+	snap->numChannels = song.numChannels;
+	snap->newJournal = !canAppend || snap->numChannels != journalNumChannels || journalBytes > (compactedBytes * 2) + JOURNAL_COMPACT_BYTES;
+
+	setupXMHeader(&snap->header);
+
+	// compare with the checksums of what's in the journal (everything is empty in a new journal)
+	const uint64_t emptyPattHash = hashPatt(NULL, 64);
+	const uint64_t emptyInstrHash = hashInstr(NULL, "");
+
+	bool copyOK = true;
+	for (int32_t i = 0; i < MAX_PATTERNS && copyOK; i++)
+	{
+		snap->pattHash[i] = hashPatt(pattern[i], patternNumRows[i]);
+		if (snap->pattHash[i] == (snap->newJournal ? emptyPattHash : pattHash[i]))
+			continue;
+
+		snap->pattChanged[i] = true;
+		snap->pattNumRows[i] = patternNumRows[i];
+
+		if (pattern[i] != NULL)
+		{
+			const size_t pattBytes = patternNumRows[i] * TRACK_WIDTH;
+
+			snap->patt[i] = (note_t *)malloc(pattBytes);
+			if (snap->patt[i] != NULL)
+				memcpy(snap->patt[i], pattern[i], pattBytes);
+			else
+				copyOK = false;
+		}
+	}
+
+	for (int32_t i = 1; i <= MAX_INST && copyOK; i++)
+	{
+		snap->instrHash[i] = hashInstr(instr[i], song.instrName[i]);
+		if (snap->instrHash[i] == (snap->newJournal ? emptyInstrHash : instrHash[i]))
+			continue;
+
+		snap->instrChanged[i] = true;
+		snap->instrNumSamples[i] = getUsedSamples((int16_t)i);
+		strcpy(snap->instrName[i], song.instrName[i]);
+
+		if (instr[i] != NULL)
+		{
+			snap->instr[i] = snapshotInstr(instr[i]);
+			if (snap->instr[i] == NULL)
+				copyOK = false;
+		}
+	}
+
+	if (!copyOK)
+	{
+		freeSnapshot(snap);
+		editor.autosaveDirty = true; // try again later
+		return;
+	}
+
+	journalWritten = true;
+	jobRunning = true;
+
+	if (!startJob(autosaveJob, autosaveJobDone, snap, JOB_BACKGROUND))
+	{
+		jobRunning = false;
+		freeSnapshot(snap);
+		editor.autosaveDirty = true;
+	}
+}
+
+void handleAutosave(void)
+{
+	if (jobRunning)
+		return;
+
+	if (!song.isModified)
+	{
+		// the song was saved, loaded or cleared, so the journal is not needed anymore
+		if (journalWritten)
+		{
+			deleteJournal();
+			journalWritten = false;
+			canAppend = false;
+		}
+
+		editor.autosaveDirty = false;
+		return;
+	}
+
+	// don't take snapshots while the song is being loaded/saved, or while samples are being processed
+	if (!editor.autosaveDirty || editor.busy || foregroundJobsRunning())
+		return;
+
+	const uint32_t time = SDL_GetTicks();
+	if (time-lastSnapshotTime < AUTOSAVE_INTERVAL_SECS*1000)
+		return;
+
+	lastSnapshotTime = time;
+	editor.autosaveDirty = false;
+
+	takeSnapshot();
+}
+
+static uint8_t *rebuildModule(MEMFILE *f, uint32_t *outLength) // returns the last complete snapshot as an XM module
+{
+	char ID[8];
+	recordHdr_t hdr;
+	recordEnd_t end;
+	xmHdr_t h;
+	xmPatHdr_t ph;
+	xmInsHdr_t ih;
+
+	if (mread(ID, 1, 8, f) != 8 || memcmp(ID, JOURNAL_FILE_ID, 8) != 0)
+		return NULL;
+
+	memset(&state, 0, sizeof (state));
+	memset(&pendingState, 0, sizeof (pendingState));
+
+	uint64_t sum = HASH_SEED;
+	uint32_t numRecords = 0;
+
+	// the records of a snapshot are pending until its end record has been checked
+	while (mread(&hdr, sizeof (hdr), 1, f) == 1)
+	{
+		if (hdr.length > msize(f)-mtell(f))
+			break; // cut off
+
+		const uint8_t *data = mptr(f, (size_t)hdr.length);
+		if (data == NULL)
+			break;
+
+		if (!memcmp(hdr.type, "END ", 4))
+		{
+			if (hdr.length != sizeof (end))
+				break;
+
+			memcpy(&end, data, sizeof (end));
+			if (end.numRecords != numRecords || end.checksum != sum)
+				break;
+
+			memcpy(&state, &pendingState, sizeof (state));
+
+			sum = HASH_SEED;
+			numRecords = 0;
+			continue;
+		}
+
+		sum = checksum(sum, &hdr, sizeof (hdr));
+		sum = checksum(sum, data, (size_t)hdr.length);
+		numRecords++;
+
+		if (!memcmp(hdr.type, "SONG", 4))
+		{
+			if (hdr.length != sizeof (xmHdr_t))
+				break;
+
+			pendingState.header = data;
+		}
+		else if (!memcmp(hdr.type, "PATT", 4))
+		{
+			if (hdr.index >= MAX_PATTERNS || hdr.length < sizeof (xmPatHdr_t))
+				break;
+
+			pendingState.patt[hdr.index] = data;
+			pendingState.pattLength[hdr.index] = hdr.length;
+		}
+		else if (!memcmp(hdr.type, "INST", 4))
+		{
+			if (hdr.index < 1 || hdr.index > MAX_INST || hdr.length < EMPTY_INSTR_HEADER_LEN)
+				break;
+
+			pendingState.instr[hdr.index] = data;
+			pendingState.instrLength[hdr.index] = hdr.length;
+		}
+		else
+		{
+			break; // unknown record
+		}
+	}
+
+	if (state.header == NULL)
+		return NULL;
+
+	memcpy(&h, state.header, sizeof (h));
+	if (h.numPatterns > MAX_PATTERNS) h.numPatterns = MAX_PATTERNS;
+	if (h.numInstr > MAX_INST) h.numInstr = MAX_INST;
+
+	// the patterns and instruments that are not in the journal are empty
+	ph.headerSize = sizeof (xmPatHdr_t);
+	ph.type = 0;
+	ph.numRows = 64;
+	ph.dataSize = 0;
+
+	setupXMInstrHeader(&ih, NULL, "", 0);
+
+	uint64_t length = sizeof (h);
+	for (int32_t i = 0; i < h.numPatterns; i++)
+		length += (state.patt[i] != NULL) ? state.pattLength[i] : sizeof (xmPatHdr_t);
+
+	for (int32_t i = 1; i <= h.numInstr; i++)
+		length += (state.instr[i] != NULL) ? state.instrLength[i] : EMPTY_INSTR_HEADER_LEN;
+
+	if (length > INT32_MAX)
+		return NULL;
+
+	uint8_t *moduleData = (uint8_t *)malloc((size_t)length);
+	if (moduleData == NULL)
+		return NULL;
+
+	uint8_t *writePtr = moduleData;
+
+	memcpy(writePtr, &h, sizeof (h));
+	writePtr += sizeof (h);
+
+	for (int32_t i = 0; i < h.numPatterns; i++)
+	{
+		if (state.patt[i] != NULL)
+		{
+			memcpy(writePtr, state.patt[i], (size_t)state.pattLength[i]);
+			writePtr += state.pattLength[i];
+		}
+		else
+		{
+			memcpy(writePtr, &ph, sizeof (xmPatHdr_t));
+			writePtr += sizeof (xmPatHdr_t);
+		}
+	}
+
+	for (int32_t i = 1; i <= h.numInstr; i++)
+	{
+		if (state.instr[i] != NULL)
+		{
+			memcpy(writePtr, state.instr[i], (size_t)state.instrLength[i]);
+			writePtr += state.instrLength[i];
+		}
+		else
+		{
+			memcpy(writePtr, &ih, EMPTY_INSTR_HEADER_LEN);
+			writePtr += EMPTY_INSTR_HEADER_LEN;
+		}
+	}
+
+	*outLength = (uint32_t)length;
+	return moduleData;
+}
+
+bool checkAutosaveRecovery(void)
+{
+	UNICHAR *journalPathU = getJournalPathU(false);
+	if (journalPathU == NULL)
+		return false;
+
+	MEMFILE *f = mopenFile(journalPathU);
+	if (f == NULL)
+	{
+		free(journalPathU);
+		return false; // no journal, the last session ended normally
+	}
+
+	uint32_t moduleLength = 0;
+	uint8_t *moduleData = rebuildModule(f, &moduleLength);
+	mclose(&f);
+
+	if (moduleData != NULL)
+	{
+		if (okBox(2, "System request", "The song from the last session was not saved. Do you want to recover it?", NULL) == 1 &&
+			loadMusicFromMemory(moduleData, moduleLength))
+		{
+			setSongModifiedFlag(); // it's still not saved
+
+			// keep the journal until the first autosave of the recovered song has replaced it
+			journalWritten = true;
+			canAppend = false;
+
+			free(moduleData);
+			free(journalPathU);
+			return true;
+		}
+
+		free(moduleData);
+	}
+
+	UNICHAR_REMOVE(journalPathU);
+	free(journalPathU);
+	return false;
+}
+
+void freeAutosave(void) // call this after freeJobs(), which cancels the job
+{
+	while (jobBusy)
+		SDL_Delay(1); // the job stops at the next instrument
+
+	if (journalWritten)
+	{
+		deleteJournal();
+		journalWritten = false;
+	}
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdbool.h>
+
+#define AUTOSAVE_INTERVAL_SECS 30
+
+void handleAutosave(void); // called every frame, takes a snapshot of the changed song data when it's time
+bool checkAutosaveRecovery(void); // called once on startup, asks to recover the song if the journal is still there (true if it was)
+void freeAutosave(void); // normal exit, deletes the journal
@@ -11,6 +11,7 @@
 #include "ft2_gfxdata.h"
 #include "ft2_bmp.h"
 #include "ft2_video.h"
+#include "ft2_glyphs.h"
 
 enum
 {
@@ -120,11 +121,19 @@ bool loadBMPs(void)
 		return false;
 	}
 
+	if (!setupGlyphs())
+	{
+		showErrorMsgBox("Not enough memory!");
+		return false;
+	}
+
 	return true;
 }
 
 void freeBMPs(void)
 {
+	freeGlyphs();
+
 	if (bmp.ft2AboutLogo != NULL) { free(bmp.ft2AboutLogo); bmp.ft2AboutLogo = NULL; }
 	if (bmp.buttonGfx != NULL) { free(bmp.buttonGfx); bmp.buttonGfx = NULL; }
 	if (bmp.font1 != NULL) { free(bmp.font1); bmp.font1 = NULL; }
@@ -21,8 +21,8 @@
 
 checkBox_t checkBoxes[NUM_CHECKBOXES] =
 {
-	// ------ RESERVED CHECKBOX ------
-	{ 0 },
+	// ------ RESERVED CHECKBOXES ------
+	{ 0 }, { 0 }, { 0 }, { 0 },
 
 	/*
 	** -- STRUCT INFO: --
@@ -88,6 +88,7 @@ checkBox_t checkBoxes[NUM_CHECKBOXES] =
 	// ------ CONFIG CHECKBOXES ------
 	//x,   y,   w,   h,  funcOnUp
 	{   3,  91,  77, 12, cbToggleAutoSaveConfig },
+	{   3,  78,  96, 12, cbTogglePackXMSamples },
 	{ 389, 158,  89, 12, cbPreciseBPM },
 	{ 512, 158, 107, 12, cbConfigVolRamp },
 	{ 113,  14, 108, 12, cbConfigPattStretch },
@@ -198,13 +199,13 @@ bool testCheckBoxMouseDown(void)
 
 	if (ui.sysReqShown)
 	{
-		// if a system request is open, only test the first checkbox (reserved)
+		// if a system request is open, only test the first four checkboxes (reserved)
 		start = 0;
-		end = 1;
+		end = 4;
 	}
 	else
 	{
-		start = 1;
+		start = 4;
 		end = NUM_CHECKBOXES;
 	}
 
@@ -6,6 +6,9 @@
 enum // CHECKBOXES
 {
 	CB_RES_1, // reserved
+	CB_RES_2, // reserved
+	CB_RES_3, // reserved
+	CB_RES_4, // reserved
 
 	// NIBBLES
 	CB_NIBBLES_SURROUND,
@@ -55,6 +58,7 @@ enum // CHECKBOXES
 
 	// CONFIG
 	CB_CONF_AUTOSAVE,
+	CB_CONF_PACK_XM_SAMPLES,
 
 	// CONFIG AUDIO
 	CB_CONF_PRECISE_BPM,
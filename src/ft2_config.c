@@ -160,6 +160,9 @@ static void loadConfigFromBuffer(bool defaults)
 	if (config.audioInputFreq <= 1) // default value from FT2 (this was cdr_Sync) - set defaults
 		config.audioInputFreq = INPUT_FREQ_48KHZ;
 
+	if (config.smpUndoMemLimit < 16) // FT2 default is 8 (this was cfg_DPMIMemLimit) - set defaults
+		config.smpUndoMemLimit = DEFAULT_SMP_UNDO_MEM_LIMIT;
+
 	if (config.specialFlags == 64) // default value from FT2 (this was ptnDefaultLen byte #1) - set defaults
 		config.specialFlags = BUFFSIZE_1024 | BITDEPTH_16;
 
@@ -1107,6 +1110,9 @@ void showConfigScreen(void)
 	checkBoxes[CB_CONF_AUTOSAVE].checked = config.cfg_AutoSave;
 	showCheckBox(CB_CONF_AUTOSAVE);
 
+	checkBoxes[CB_CONF_PACK_XM_SAMPLES].checked = (config.specialFlags2 & PACK_XM_SAMPLES) ? true : false;
+	showCheckBox(CB_CONF_PACK_XM_SAMPLES);
+
 	showPushButton(PB_CONFIG_RESET);
 	showPushButton(PB_CONFIG_LOAD);
 	showPushButton(PB_CONFIG_SAVE);
@@ -1119,6 +1125,7 @@ void showConfigScreen(void)
 #ifdef HAS_MIDI
 	textOutShadow(21, 67, PAL_FORGRND, PAL_DSKTOP2, "MIDI input");
 #endif
+	textOutShadow(20, 80, PAL_FORGRND, PAL_DSKTOP2, "Compress XMs");
 	textOutShadow(20, 93, PAL_FORGRND, PAL_DSKTOP2, "Auto save");
 
 	switch (editor.currConfigScreen)
@@ -1415,6 +1422,7 @@ void hideConfigScreen(void)
 	// CONFIG LEFT SIDE
 	hideRadioButtonGroup(RB_GROUP_CONFIG_SELECT);
 	hideCheckBox(CB_CONF_AUTOSAVE);
+	hideCheckBox(CB_CONF_PACK_XM_SAMPLES);
 	hidePushButton(PB_CONFIG_RESET);
 	hidePushButton(PB_CONFIG_LOAD);
 	hidePushButton(PB_CONFIG_SAVE);
@@ -1707,6 +1715,11 @@ void cbToggleAutoSaveConfig(void)
 	config.cfg_AutoSave ^= 1;
 }
 
+void cbTogglePackXMSamples(void)
+{
+	config.specialFlags2 ^= PACK_XM_SAMPLES;
+}
+
 void cbPreciseBPM(void)
 {
 	config.specialFlags2 ^= PRECISE_BPM;
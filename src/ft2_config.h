@@ -8,6 +8,8 @@
 #define CFG_ID_STR "FastTracker 2.0 configuration file\x1A"
 #define CONFIG_FILE_SIZE 1736
 
+#define DEFAULT_SMP_UNDO_MEM_LIMIT 512 /* MB */
+
 enum
 {
 	CONFIG_SCREEN_AUDIO,
@@ -74,6 +76,7 @@ enum
 	STRETCH_IMAGE = 4,
 	USE_OS_MOUSE_POINTER = 8,
 	PRECISE_BPM = 16,
+	PACK_XM_SAMPLES = 32,
 
 	// windowFlags
 	WINSIZE_AUTO = 1,
@@ -154,7 +157,8 @@ typedef struct config_t // exact FT2.CFG layout (with some modifications)
 	int16_t antStars, ptnMaxChannels;
 	uint16_t sampleRates[16];
 	uint8_t cfg_OverwriteWarning;
-	int16_t cfg_SortPriority, cfg_DPMIMemLimit;
+	int16_t cfg_SortPriority;
+	int16_t smpUndoMemLimit; // in MB, was "cfg_DPMIMemLimit" (never used in the clone)
 	uint8_t cfg_DPMIMemLimitEnabled;
 	uint8_t audioInputFreq; // was "cdr_Sync"
 }
@@ -241,6 +245,7 @@ void rbWinSize2x(void);
 void rbWinSize3x(void);
 void rbWinSize4x(void);
 void cbToggleAutoSaveConfig(void);
+void cbTogglePackXMSamples(void);
 void cbPreciseBPM(void);
 void cbConfigVolRamp(void);
 void cbConfigPattStretch(void);
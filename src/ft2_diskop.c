@@ -7,6 +7,8 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #ifdef _WIN32
 #define WIN32_MEAN_AND_LEAN
@@ -36,6 +38,8 @@
 #include "ft2_wav_renderer.h"
 #include "ft2_module_loader.h"
 #include "ft2_module_saver.h"
+#include "ft2_module_index.h"
+#include "ft2_textboxes.h"
 #include "ft2_events.h"
 #include "ft2_video.h"
 #include "ft2_inst_ed.h"
@@ -49,6 +53,11 @@
 #define FILENAME_TEXT_X 170
 #define FILESIZE_TEXT_X 295
 #define DISKOP_MAX_DRIVE_BUTTONS 8
+#define DIRREC_MIN_ENTRIES 256
+#define DIRREC_POOL_BLOCK_SIZE (64*1024)
+#define FILESIZE_NOT_READ (-2) /* filesize is read when the entry is shown */
+#define DIR_READ_PROGRESS_MIN 1000 /* show progress when reading directories with more entries than this */
+#define MAX_SEARCH_WORDS 8
 
 #ifdef _WIN32
 #define PARENT_DIR_STR L".."
@@ -66,21 +75,47 @@ enum
 	LFF_OK = 2
 };
 
+// directory read states
+enum
+{
+	DIR_READ_IDLE = 0,
+	DIR_READ_LISTING = 1,
+	DIR_READ_SORTING = 2
+};
+
 typedef struct DirRec
 {
 	UNICHAR *nameU;
 	bool isDir;
 	int32_t filesize;
+	const char *infoText; // from the module index (lowercase), NULL if not indexed (yet)
+	const char *searchKey; // lowercase name + info text, made when searching
 } DirRec;
 
-static char FReq_SysReqText[256], *FReq_FileName, *FReq_NameTemp;
+typedef struct dirRecPool_t // string storage for directory entries, the data follows the header
+{
+	struct dirRecPool_t *next;
+	uint32_t size, used;
+} dirRecPool_t;
+
+typedef struct dirSortEntry_t
+{
+	const char *key;
+	DirRec rec;
+} dirSortEntry_t;
+
+static char FReq_SysReqText[256], *FReq_FileName, *FReq_NameTemp, FReq_SearchText[DISKOP_SEARCH_LEN+1];
 static char *modTmpFName, *insTmpFName, *smpTmpFName, *patTmpFName, *trkTmpFName;
 static char *modTmpFNameUTF8; // for window title
 static uint8_t FReq_Item;
-static bool FReq_ShowAllFiles, insPathSet, smpPathSet, patPathSet, trkPathSet, firstTimeOpeningDiskOp = true;
-static int32_t FReq_EntrySelected = -1, FReq_FileCount, FReq_DirPos, lastMouseY;
+static bool FReq_ShowAllFiles, FReq_SearchShown, insPathSet, smpPathSet, patPathSet, trkPathSet, firstTimeOpeningDiskOp = true;
+static volatile uint8_t FReq_ReadState;
+static int32_t FReq_EntrySelected = -1, FReq_FileCount, FReq_BufferSize, FReq_DirPos, lastMouseY, lastReadProgress;
+static int32_t *FReq_View, FReq_ViewCount; // the entries matching the search text (FReq_View is NULL if not searching)
+static bool FReq_ListReady; // false while the directory is being read
 static UNICHAR *FReq_CurPathU, *FReq_ModCurPathU, *FReq_InsCurPathU, *FReq_SmpCurPathU, *FReq_PatCurPathU, *FReq_TrkCurPathU;
 static DirRec *FReq_Buffer;
+static dirRecPool_t *FReq_NamePool;
 static SDL_Thread *thread;
 
 static void setDiskOpItem(uint8_t item);
@@ -258,21 +293,109 @@ static void setupInitialPaths(void)
 #endif
 }
 
+static void *poolAlloc(dirRecPool_t **pool, uint32_t numBytes)
+{
+	numBytes = (numBytes + 7) & ~7; // keep the strings aligned
+
+	dirRecPool_t *block = *pool;
+	if (block == NULL || block->used+numBytes > block->size)
+	{
+		const uint32_t blockSize = MAX(numBytes, DIRREC_POOL_BLOCK_SIZE);
+
+		block = (dirRecPool_t *)malloc(sizeof (dirRecPool_t) + blockSize);
+		if (block == NULL)
+			return NULL;
+
+		block->next = *pool;
+		block->size = blockSize;
+		block->used = 0;
+		*pool = block;
+	}
+
+	void *ptr = (uint8_t *)&block[1] + block->used;
+	block->used += numBytes;
+
+	return ptr;
+}
+
+static void freePool(dirRecPool_t **pool)
+{
+	dirRecPool_t *block = *pool;
+	while (block != NULL)
+	{
+		dirRecPool_t *next = block->next;
+		free(block);
+		block = next;
+	}
+
+	*pool = NULL;
+}
+
+static UNICHAR *poolStrDupU(const UNICHAR *strU)
+{
+	const uint32_t numBytes = (uint32_t)(UNICHAR_STRLEN(strU) + 1) * sizeof (UNICHAR);
+
+	UNICHAR *dstU = (UNICHAR *)poolAlloc(&FReq_NamePool, numBytes);
+	if (dstU != NULL)
+		memcpy(dstU, strU, numBytes);
+
+	return dstU;
+}
+
+static bool addDirRec(const DirRec *dirEntry) // the buffer grows geometrically, big directories would realloc a lot otherwise
+{
+	if (FReq_FileCount >= FReq_BufferSize)
+	{
+		const int32_t newSize = (FReq_BufferSize < DIRREC_MIN_ENTRIES) ? DIRREC_MIN_ENTRIES : FReq_BufferSize * 2;
+
+		DirRec *newPtr = (DirRec *)realloc(FReq_Buffer, sizeof (DirRec) * newSize);
+		if (newPtr == NULL)
+			return false;
+
+		FReq_Buffer = newPtr;
+		FReq_BufferSize = newSize;
+	}
+
+	DirRec *newEntry = &FReq_Buffer[FReq_FileCount++];
+	*newEntry = *dirEntry;
+	newEntry->infoText = newEntry->searchKey = NULL;
+
+	return true;
+}
+
+static void freeSearchView(void)
+{
+	if (FReq_View != NULL)
+	{
+		free(FReq_View);
+		FReq_View = NULL;
+	}
+
+	FReq_ViewCount = 0;
+}
+
+static int32_t getNumListEntries(void) // the shown entries
+{
+	return (FReq_View != NULL) ? FReq_ViewCount : FReq_FileCount;
+}
+
+static DirRec *getListEntry(int32_t index)
+{
+	return &FReq_Buffer[(FReq_View != NULL) ? FReq_View[index] : index];
+}
+
 static void freeDirRecBuffer(void)
 {
 	if (FReq_Buffer != NULL)
 	{
-		for (int32_t i = 0; i < FReq_FileCount; i++)
-		{
-			if (FReq_Buffer[i].nameU != NULL)
-				free(FReq_Buffer[i].nameU);
-		}
-
 		free(FReq_Buffer);
 		FReq_Buffer = NULL;
 	}
 
+	freePool(&FReq_NamePool);
+
 	FReq_FileCount = 0;
+	FReq_BufferSize = 0;
 }
 
 void freeDiskOp(void)
@@ -302,6 +425,8 @@ void freeDiskOp(void)
 	if (FReq_TrkCurPathU != NULL) { free(FReq_TrkCurPathU); FReq_TrkCurPathU = NULL; }
 	if (modTmpFNameUTF8 != NULL) { free(modTmpFNameUTF8); modTmpFNameUTF8 = NULL; }
 
+	cancelModuleIndexing();
+	freeSearchView();
 	freeDirRecBuffer();
 }
 
@@ -1043,7 +1168,7 @@ static void fileListPressed(int32_t index)
 	int32_t result;
 
 	const int32_t entryIndex = FReq_DirPos + index;
-	if (entryIndex >= FReq_FileCount || FReq_FileCount == 0)
+	if (entryIndex >= getNumListEntries())
 		return; // illegal entry
 
 	const int8_t mode = mouse.mode;
@@ -1056,7 +1181,7 @@ static void fileListPressed(int32_t index)
 	FReq_EntrySelected = -1;
 	diskOp_DrawFilelist();
 
-	DirRec *dirEntry = &FReq_Buffer[entryIndex];
+	DirRec *dirEntry = getListEntry(entryIndex);
 	switch (mode)
 	{
 		// open file/folder
@@ -1157,10 +1282,10 @@ bool testDiskOpMouseDown(bool mouseHeldDlown)
 {
 	int32_t tmpEntry;
 
-	if (!ui.diskOpShown || FReq_FileCount == 0)
+	if (!ui.diskOpShown || getNumListEntries() == 0)
 		return false;
 
-	int32_t max = FReq_FileCount - FReq_DirPos;
+	int32_t max = getNumListEntries() - FReq_DirPos;
 	if (max > DISKOP_ENTRY_NUM) // needed kludge when mouse-scrolling
 		max = DISKOP_ENTRY_NUM;
 
@@ -1369,47 +1494,35 @@ skipEntry:
 	return true;
 }
 
-static int8_t findFirst(DirRec *searchRec)
-{
+// fills in the entry, the filesize of a normal file is read later (stat() for every file is slow in big directories)
 #ifdef _WIN32
-	WIN32_FIND_DATAW fData;
-#else
-	struct dirent *fData;
-	struct stat st;
-	int64_t fSize;
-#endif
-
-#if defined(__sun) || defined(sun)
-	struct stat s;
-#endif
+static int8_t fillSearchRec(DirRec *searchRec, WIN32_FIND_DATAW *fData)
+{
+	searchRec->filesize = (fData->nFileSizeHigh > 0) ? -1 : fData->nFileSizeLow;
+	searchRec->isDir = (fData->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? true : false;
 
-	searchRec->nameU = NULL; // this one must be initialized
+	if (searchRec->filesize < -1)
+		searchRec->filesize = -1;
 
-#ifdef _WIN32
-	hFind = FindFirstFileW(L"*", &fData);
-	if (hFind == NULL || hFind == INVALID_HANDLE_VALUE)
-		return LFF_DONE;
+	if (handleEntrySkip(fData->cFileName, searchRec->isDir))
+		return LFF_SKIP;
 
-	searchRec->nameU = UNICHAR_STRDUP(fData.cFileName);
+	searchRec->nameU = poolStrDupU(fData->cFileName);
 	if (searchRec->nameU == NULL)
 		return LFF_SKIP;
 
-	searchRec->filesize = (fData.nFileSizeHigh > 0) ? -1 : fData.nFileSizeLow;
-	searchRec->isDir = (fData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? true : false;
+	return LFF_OK;
+}
 #else
-	hFind = opendir(".");
-	if (hFind == NULL)
-		return LFF_DONE;
-
-	fData = readdir(hFind);
-	if (fData == NULL)
-		return LFF_DONE;
+static int8_t fillSearchRec(DirRec *searchRec, struct dirent *fData)
+{
+	struct stat st;
 
-	searchRec->nameU = UNICHAR_STRDUP(fData->d_name);
-	if (searchRec->nameU == NULL)
-		return LFF_SKIP;
+#if defined(__sun) || defined(sun)
+	struct stat s;
+#endif
 
-	searchRec->filesize = 0;
+	searchRec->filesize = FILESIZE_NOT_READ;
 
 #if defined(__sun) || defined(sun)
 	stat(fData->d_name, &s);
@@ -1424,121 +1537,78 @@ static int8_t findFirst(DirRec *searchRec)
 	if (fData->d_type == DT_UNKNOWN || fData->d_type == DT_LNK)
 #endif
 	{
+		// we need to know if it's a directory, so stat it now
 		if (stat(fData->d_name, &st) == 0)
 		{
-			fSize = (int64_t)st.st_size;
+			const int64_t fSize = (int64_t)st.st_size;
 			searchRec->filesize = (fSize > INT32_MAX) ? -1 : (fSize & 0xFFFFFFFF);
 
 			if ((st.st_mode & S_IFMT) == S_IFDIR)
 				searchRec->isDir = true;
 		}
 	}
-	else if (!searchRec->isDir)
-	{
-		if (stat(fData->d_name, &st) == 0)
-		{
-			fSize = (int64_t)st.st_size;
-			searchRec->filesize = (fSize > INT32_MAX) ? -1 : (fSize & 0xFFFFFFFF);
-		}
-	}
-#endif
-
-	if (searchRec->filesize < -1)
-		searchRec->filesize = -1;
 
-	if (handleEntrySkip(searchRec->nameU, searchRec->isDir))
-	{
-		// skip file
-		free(searchRec->nameU);
-		searchRec->nameU = NULL;
+	if (handleEntrySkip(fData->d_name, searchRec->isDir))
+		return LFF_SKIP;
 
+	searchRec->nameU = poolStrDupU(fData->d_name);
+	if (searchRec->nameU == NULL)
 		return LFF_SKIP;
-	}
 
 	return LFF_OK;
 }
+#endif
 
-static int8_t findNext(DirRec *searchRec)
+static int8_t findFirst(DirRec *searchRec)
 {
 #ifdef _WIN32
 	WIN32_FIND_DATAW fData;
 #else
 	struct dirent *fData;
-	struct stat st;
-	int64_t fSize;
-#endif
-
-#if defined(__sun) || defined(sun)
-	struct stat s;
 #endif
 
-	searchRec->nameU = NULL; // important
+	searchRec->nameU = NULL; // this one must be initialized
 
 #ifdef _WIN32
-	if (hFind == NULL || FindNextFileW(hFind, &fData) == 0)
+	hFind = FindFirstFileW(L"*", &fData);
+	if (hFind == NULL || hFind == INVALID_HANDLE_VALUE)
 		return LFF_DONE;
 
-	searchRec->nameU = UNICHAR_STRDUP(fData.cFileName);
-	if (searchRec->nameU == NULL)
-		return LFF_SKIP;
-
-	searchRec->filesize = (fData.nFileSizeHigh > 0) ? -1 : fData.nFileSizeLow;
-	searchRec->isDir = (fData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? true : false;
+	return fillSearchRec(searchRec, &fData);
 #else
-	if (hFind == NULL || (fData = readdir(hFind)) == NULL)
+	hFind = opendir(".");
+	if (hFind == NULL)
 		return LFF_DONE;
 
-	searchRec->nameU = UNICHAR_STRDUP(fData->d_name);
-	if (searchRec->nameU == NULL)
-		return LFF_SKIP;
-
-	searchRec->filesize = 0;
+	fData = readdir(hFind);
+	if (fData == NULL)
+		return LFF_DONE;
 
-#if defined(__sun) || defined(sun)
-	stat(fData->d_name, &s);
-	searchRec->isDir = (s.st_mode != S_IFDIR) ? true : false;
-#else
-	searchRec->isDir = (fData->d_type == DT_DIR) ? true : false;
+	return fillSearchRec(searchRec, fData);
 #endif
+}
 
-#if defined(__sun) || defined(sun)
-	if (s.st_mode == S_IFLNK)
+static int8_t findNext(DirRec *searchRec)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAW fData;
 #else
-	if (fData->d_type == DT_UNKNOWN || fData->d_type == DT_LNK)
-#endif
-	{
-		if (stat(fData->d_name, &st) == 0)
-		{
-			fSize = (int64_t)st.st_size;
-			searchRec->filesize = (fSize > INT32_MAX) ? -1 : (fSize & 0xFFFFFFFF);
-
-			if ((st.st_mode & S_IFMT) == S_IFDIR)
-				searchRec->isDir = true;
-		}
-	}
-	else if (!searchRec->isDir)
-	{
-		if (stat(fData->d_name, &st) == 0)
-		{
-			fSize = (int64_t)st.st_size;
-			searchRec->filesize = (fSize > INT32_MAX) ? -1 : (fSize & 0xFFFFFFFF);
-		}
-	}
+	struct dirent *fData;
 #endif
 
-	if (searchRec->filesize < -1)
-		searchRec->filesize = -1;
+	searchRec->nameU = NULL; // important
 
-	if (handleEntrySkip(searchRec->nameU, searchRec->isDir))
-	{
-		// skip file
-		free(searchRec->nameU);
-		searchRec->nameU = NULL;
+#ifdef _WIN32
+	if (hFind == NULL || FindNextFileW(hFind, &fData) == 0)
+		return LFF_DONE;
 
-		return LFF_SKIP;
-	}
+	return fillSearchRec(searchRec, &fData);
+#else
+	if (hFind == NULL || (fData = readdir(hFind)) == NULL)
+		return LFF_DONE;
 
-	return LFF_OK;
+	return fillSearchRec(searchRec, fData);
+#endif
 }
 
 static void findClose(void)
@@ -1554,34 +1624,16 @@ static void findClose(void)
 	}
 }
 
-static bool swapBufferEntry(int32_t a, int32_t b) // used for sorting
+// makes the sort key of an entry (once per entry, the keys are lowercased so that strcmp() can be used)
+static const char *getSortKey(dirRecPool_t **pool, const DirRec *dirEntry)
 {
-	if (a >= FReq_FileCount || b >= FReq_FileCount)
-		return false;
-
-	DirRec tmp = FReq_Buffer[a];
-	FReq_Buffer[a] = FReq_Buffer[b];
-	FReq_Buffer[b] = tmp;
-
-	return true;
-}
-
-static char *ach(int32_t rad) // used for sortDirectory()
-{
-	DirRec *dirEntry = &FReq_Buffer[rad];
-
 	char *name = unicharToCp850(dirEntry->nameU, true);
 	if (name == NULL)
-		return NULL;
+		return "";
 
 	const int32_t nameLen = (int32_t)strlen(name);
-	if (nameLen == 0)
-	{
-		free(name);
-		return NULL;
-	}
 
-	char *p = (char *)malloc(nameLen+1+1);
+	char *p = (char *)poolAlloc(pool, nameLen+1+1);
 	if (p == NULL)
 	{
 		free(name);
@@ -1598,91 +1650,80 @@ static char *ach(int32_t rad) // used for sortDirectory()
 			p[0] = 0x02; // make second priority
 
 		strcpy(&p[1], name);
-
-		free(name);
-		return p;
 	}
 	else
 	{
 		// file
 
 		const int32_t i = getExtOffset(name, nameLen);
-		if (config.cfg_SortPriority == 1 || i == -1)
+		const int32_t extLen = nameLen - i;
+
+		if (config.cfg_SortPriority == 1 || i == -1 || extLen <= 1)
 		{
 			// sort by filename
 			strcpy(p, name);
-			free(name);
-			return p;
 		}
 		else
 		{
 			// sort by filename extension
-			const int32_t extLen = nameLen - i;
-			if (extLen <= 1)
-			{
-				strcpy(p, name);
-				free(name);
-				return p;
-			}
 
 			// FILENAME.EXT -> EXT.FILENAME (for sorting)
 			memcpy(p, &name[i+1], extLen - 1);
 			memcpy(&p[extLen-1], name, i);
 			p[nameLen-1] = '\0';
-
-			free(name);
-			return p;
 		}
 	}
+
+	free(name);
+
+	for (char *c = p; *c != '\0'; c++)
+	{
+		if (*c >= 'A' && *c <= 'Z')
+			*c += 'a' - 'A';
+	}
+
+	return p;
+}
+
+static int32_t dirSortCompare(const void *a, const void *b)
+{
+	return strcmp(((const dirSortEntry_t *)a)->key, ((const dirSortEntry_t *)b)->key);
 }
 
 static void sortDirectory(void)
 {
-	bool didSwap;
+	dirRecPool_t *keyPool = NULL;
 
 	if (FReq_FileCount < 2)
 		return; // no need to sort
 
-	uint32_t offset = FReq_FileCount >> 1;
-	while (offset > 0)
+	dirSortEntry_t *sortBuf = (dirSortEntry_t *)malloc(FReq_FileCount * sizeof (dirSortEntry_t));
+	if (sortBuf == NULL)
+		goto oom;
+
+	for (int32_t i = 0; i < FReq_FileCount; i++)
 	{
-		const uint32_t limit = FReq_FileCount - offset;
-		do
-		{
-			didSwap = false;
-			for (uint32_t i = 0; i < limit; i++)
-			{
-				char *p1 = ach(i);
-				char *p2 = ach(offset+i);
+		sortBuf[i].rec = FReq_Buffer[i];
+		sortBuf[i].key = getSortKey(&keyPool, &FReq_Buffer[i]);
+		if (sortBuf[i].key == NULL)
+			goto oom;
+	}
 
-				if (p1 == NULL || p2 == NULL)
-				{
-					if (p1 != NULL) free(p1);
-					if (p2 != NULL) free(p2);
-					okBox(0, "System message", "Not enough memory!", NULL);
-					return;
-				}
+	qsort(sortBuf, FReq_FileCount, sizeof (dirSortEntry_t), dirSortCompare);
 
-				if (_stricmp(p1, p2) > 0)
-				{
-					if (!swapBufferEntry(i, offset + i))
-					{
-						free(p1);
-						free(p2);
-						return;
-					}
+	for (int32_t i = 0; i < FReq_FileCount; i++)
+		FReq_Buffer[i] = sortBuf[i].rec;
 
-					didSwap = true;
-				}
+	free(sortBuf);
+	freePool(&keyPool);
+	return;
 
-				free(p1);
-				free(p2);
-			}
-		}
-		while (didSwap);
+oom:
+	if (sortBuf != NULL)
+		free(sortBuf);
 
-		offset >>= 1;
-	}
+	freePool(&keyPool);
+	okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
 }
 
 static uint8_t numDigits32(uint32_t x)
@@ -1700,12 +1741,15 @@ static uint8_t numDigits32(uint32_t x)
 	return 1;
 }
 
-static void printFormattedFilesize(uint16_t x, uint16_t y, uint32_t bufEntry)
+static void printFormattedFilesize(uint16_t x, uint16_t y, DirRec *dirEntry)
 {
 	char sizeStrBuffer[16];
 	int32_t printFilesize;
 
-	const int32_t filesize = FReq_Buffer[bufEntry].filesize;
+	if (dirEntry->filesize == FILESIZE_NOT_READ)
+		dirEntry->filesize = getFileSize(dirEntry->nameU);
+
+	const int32_t filesize = dirEntry->filesize;
 	if (filesize == -1)
 	{
 		x += 6;
@@ -1814,7 +1858,8 @@ void diskOp_DrawFilelist(void)
 {
 	clearRect(FILENAME_TEXT_X-1, 4, 162, 164);
 
-	if (FReq_FileCount == 0)
+	const int32_t numEntries = getNumListEntries();
+	if (numEntries == 0)
 		return;
 
 	// draw "selected file" rectangle
@@ -1826,24 +1871,25 @@ void diskOp_DrawFilelist(void)
 
 	for (uint16_t i = 0; i < DISKOP_ENTRY_NUM; i++)
 	{
-		const int32_t bufEntry = FReq_DirPos + i;
-		if (bufEntry >= FReq_FileCount)
+		const int32_t listEntry = FReq_DirPos + i;
+		if (listEntry >= numEntries)
 			break;
 
-		if (FReq_Buffer[bufEntry].nameU == NULL)
+		DirRec *dirEntry = getListEntry(listEntry);
+		if (dirEntry->nameU == NULL)
 			continue;
 
 		// convert unichar name to codepage 437
-		char *readName = unicharToCp850(FReq_Buffer[bufEntry].nameU, true);
+		char *readName = unicharToCp850(dirEntry->nameU, true);
 		if (readName == NULL)
 			continue;
 
 		const uint16_t y = 4 + (i * (FONT1_CHAR_H + 1));
 
 		// shrink entry name and add ".." if it doesn't fit on screen
-		trimEntryName(readName, FReq_Buffer[bufEntry].isDir);
+		trimEntryName(readName, dirEntry->isDir);
 
-		if (FReq_Buffer[bufEntry].isDir)
+		if (dirEntry->isDir)
 		{
 			// directory
 			charOut(FILENAME_TEXT_X, y, PAL_BLCKTXT, DIR_DELIMITER);
@@ -1857,8 +1903,8 @@ void diskOp_DrawFilelist(void)
 
 		free(readName);
 
-		if (!FReq_Buffer[bufEntry].isDir)
-			printFormattedFilesize(FILESIZE_TEXT_X, y, bufEntry);
+		if (!dirEntry->isDir)
+			printFormattedFilesize(FILESIZE_TEXT_X, y, dirEntry);
 	}
 }
 
@@ -1866,109 +1912,341 @@ void diskOp_DrawDirectory(void)
 {
 	drawTextBox(TB_DISKOP_FILENAME);
 
-	displayCurrPath();
+	if (FReq_SearchShown)
+		drawTextBox(TB_DISKOP_SEARCH);
+	else
+		displayCurrPath();
 #ifdef _WIN32
 	setupDiskOpDrives();
 #endif
 
-	setScrollBarEnd(SB_DISKOP_LIST, FReq_FileCount);
+	setScrollBarEnd(SB_DISKOP_LIST, getNumListEntries());
 	setScrollBarPos(SB_DISKOP_LIST, FReq_DirPos, DONT_TRIGGER_CALLBACK);
 
 	diskOp_DrawFilelist();
 }
 
-static DirRec *bufferCreateEmptyDir(void) // special case: creates a dir entry with a ".." directory
+void diskOp_DrawReadProgress(void) // the number of entries read so far, for big directories
 {
-	DirRec *dirEntry = (DirRec *)malloc(sizeof (DirRec));
-	if (dirEntry == NULL)
-		return NULL;
+	if (FReq_ReadState == DIR_READ_IDLE || !ui.diskOpShown)
+		return;
+
+	const int32_t numEntries = FReq_FileCount;
+	if (numEntries < DIR_READ_PROGRESS_MIN || numEntries == lastReadProgress)
+		return;
+
+	lastReadProgress = numEntries;
+
+	char text[64];
+	if (FReq_ReadState == DIR_READ_SORTING)
+		sprintf(text, "Sorting %d entries...", numEntries);
+	else
+		sprintf(text, "Reading... %d entries", numEntries);
 
-	dirEntry->nameU = UNICHAR_STRDUP(PARENT_DIR_STR);
-	if (dirEntry->nameU == NULL)
+	clearRect(FILENAME_TEXT_X-1, 4, 162, 164);
+	textOut(FILENAME_TEXT_X, 4, PAL_BLCKTXT, text);
+}
+
+// the search key is the lowercase name and module info of an entry, made the first time it's searched
+static const char *getSearchKey(DirRec *dirEntry)
+{
+	if (dirEntry->searchKey != NULL)
+		return dirEntry->searchKey;
+
+	char *name = unicharToCp850(dirEntry->nameU, true);
+	if (name == NULL)
+		return "";
+
+	const int32_t nameLen = (int32_t)strlen(name);
+	const int32_t infoLen = (dirEntry->infoText != NULL) ? (int32_t)strlen(dirEntry->infoText) : 0;
+
+	char *p = (char *)poolAlloc(&FReq_NamePool, nameLen+1+infoLen+1);
+	if (p == NULL)
 	{
-		free(dirEntry);
-		return NULL;
+		free(name);
+		return "";
+	}
+
+	for (int32_t i = 0; i < nameLen; i++)
+	{
+		char c = name[i];
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+
+		p[i] = c;
 	}
 
-	dirEntry->isDir = true;
-	dirEntry->filesize = 0;
+	free(name);
+
+	p[nameLen] = '\n';
+	if (infoLen > 0)
+		memcpy(&p[nameLen+1], dirEntry->infoText, infoLen);
+	p[nameLen+1+infoLen] = '\0';
 
-	return dirEntry;
+	dirEntry->searchKey = p;
+	return p;
 }
 
-static int32_t diskOp_ReadDirectoryThread(void *ptr)
+static void updateSearchView(void) // an entry is shown if all words in the search text are found in its search key
 {
-	DirRec tmp;
+	char words[DISKOP_SEARCH_LEN+1];
+	const char *wordPtrs[MAX_SEARCH_WORDS];
+	int32_t numWords = 0;
 
-	FReq_DirPos = 0;
+	freeSearchView();
 
-	// free old buffer
-	freeDirRecBuffer();
+	if (!FReq_ListReady || FReq_FileCount == 0)
+		return;
 
-	UNICHAR_GETCWD(FReq_CurPathU, PATH_MAX);
+	// split the search text into lowercase words
+	strcpy(words, FReq_SearchText);
 
-	// read first file
-	int8_t lastFindFileFlag = findFirst(&tmp);
-	if (lastFindFileFlag != LFF_DONE && lastFindFileFlag != LFF_SKIP)
+	char *p = words;
+	while (numWords < MAX_SEARCH_WORDS)
 	{
-		FReq_Buffer = (DirRec *)malloc(sizeof (DirRec));
-		if (FReq_Buffer == NULL)
+		while (*p == ' ')
+			p++;
+
+		if (*p == '\0')
+			break;
+
+		wordPtrs[numWords++] = p;
+		for (; *p != ' ' && *p != '\0'; p++)
 		{
-			findClose();
+			if (*p >= 'A' && *p <= 'Z')
+				*p += 'a' - 'A';
+		}
 
-			okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
+		if (*p == ' ')
+			*p++ = '\0';
+	}
 
-			FReq_Buffer = bufferCreateEmptyDir();
-			if (FReq_Buffer != NULL)
-				FReq_FileCount = 1;
-			else
-				okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
+	if (numWords == 0)
+		return; // show all entries
 
-			setMouseBusy(false);
-			return false;
+	FReq_View = (int32_t *)malloc(FReq_FileCount * sizeof (int32_t));
+	if (FReq_View == NULL)
+		return;
+
+	for (int32_t i = 0; i < FReq_FileCount; i++)
+	{
+		DirRec *dirEntry = &FReq_Buffer[i];
+
+		bool match = true;
+		if (dirEntry->isDir && !UNICHAR_STRCMP(dirEntry->nameU, PARENT_DIR_STR))
+		{
+			// always show the ".." directory
+		}
+		else
+		{
+			const char *key = getSearchKey(dirEntry);
+			for (int32_t j = 0; j < numWords; j++)
+			{
+				if (strstr(key, wordPtrs[j]) == NULL)
+				{
+					match = false;
+					break;
+				}
+			}
 		}
 
-		memcpy(FReq_Buffer, &tmp, sizeof (DirRec));
-		FReq_FileCount++;
+		if (match)
+			FReq_View[FReq_ViewCount++] = i;
 	}
+}
 
-	// read remaining files
-	while (lastFindFileFlag != LFF_DONE)
+static void redrawSearchResults(bool resetListPos)
+{
+	updateSearchView();
+
+	const int32_t numEntries = getNumListEntries();
+	if (resetListPos || FReq_DirPos > numEntries-DISKOP_ENTRY_NUM)
+		FReq_DirPos = MAX(0, resetListPos ? 0 : numEntries-DISKOP_ENTRY_NUM);
+
+	FReq_EntrySelected = -1;
+
+	if (ui.diskOpShown)
 	{
-		lastFindFileFlag = findNext(&tmp);
-		if (lastFindFileFlag != LFF_DONE && lastFindFileFlag != LFF_SKIP)
+		setScrollBarEnd(SB_DISKOP_LIST, numEntries);
+		setScrollBarPos(SB_DISKOP_LIST, FReq_DirPos, DONT_TRIGGER_CALLBACK);
+		diskOp_DrawFilelist();
+	}
+}
+
+static void drawSearchBox(void) // the search box replaces the current path
+{
+	fillRect(2, 143, 164, 14, PAL_DESKTOP);
+	drawFramework(30, 143, 136, 14, FRAMEWORK_TYPE2);
+	textOutShadow(4, 145, PAL_FORGRND, PAL_DSKTOP2, "Find:");
+
+	showTextBox(TB_DISKOP_SEARCH);
+	drawTextBox(TB_DISKOP_SEARCH);
+}
+
+static void hideSearchBox(void)
+{
+	hideTextBox(TB_DISKOP_SEARCH);
+
+	fillRect(2, 143, 164, 14, PAL_DESKTOP);
+	displayCurrPath();
+}
+
+void diskOpFind(void) // shows the search box, and starts editing it
+{
+	if (!ui.diskOpShown)
+		return;
+
+	if (editor.editTextFlag)
+		exitTextEditing();
+
+	if (!FReq_SearchShown)
+	{
+		FReq_SearchShown = true;
+		drawSearchBox();
+	}
+
+	mouse.lastEditBox = TB_DISKOP_SEARCH;
+	setTextCursorToEnd(&textBoxes[TB_DISKOP_SEARCH]);
+
+	editor.editTextFlag = true;
+	SDL_StartTextInput();
+}
+
+void diskOp_SearchTextChanged(void)
+{
+	redrawSearchResults(true);
+}
+
+void diskOp_SearchEditDone(void)
+{
+	if (FReq_SearchText[0] != '\0' || !FReq_SearchShown)
+		return;
+
+	// the search text was cleared, show the current path again
+	FReq_SearchShown = false;
+	if (ui.diskOpShown)
+		hideSearchBox();
+}
+
+// called by the module index in the GUI thread, the files are in list order (see startModuleIndexing())
+static void moduleIndexDone(int32_t firstFile, int32_t numFiles, char **infoTexts)
+{
+	int32_t file = 0;
+	for (int32_t i = 0; i < FReq_FileCount && file < firstFile+numFiles; i++)
+	{
+		DirRec *dirEntry = &FReq_Buffer[i];
+		if (dirEntry->isDir)
+			continue;
+
+		const char *infoText = (file >= firstFile) ? infoTexts[file-firstFile] : NULL;
+		if (infoText != NULL)
 		{
-			DirRec *newPtr = (DirRec *)realloc(FReq_Buffer, sizeof (DirRec) * (FReq_FileCount + 1));
-			if (newPtr == NULL)
+			const uint32_t numBytes = (uint32_t)strlen(infoText) + 1;
+
+			char *p = (char *)poolAlloc(&FReq_NamePool, numBytes);
+			if (p != NULL)
 			{
-				freeDirRecBuffer();
-				okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
-				break;
+				memcpy(p, infoText, numBytes);
+				dirEntry->infoText = p;
+				dirEntry->searchKey = NULL; // make it again with the info
 			}
+		}
+
+		file++;
+	}
+
+	if (FReq_View != NULL)
+		redrawSearchResults(false);
+}
+
+static void startModuleIndexing(void) // reads the module headers of the listed files in the background
+{
+	if (FReq_Item != DISKOP_ITEM_MODULE || FReq_FileCount == 0)
+		return;
+
+	UNICHAR **filenamesU = (UNICHAR **)malloc(FReq_FileCount * sizeof (UNICHAR *));
+	if (filenamesU == NULL)
+		return;
+
+	int32_t numFiles = 0;
+	for (int32_t i = 0; i < FReq_FileCount; i++)
+	{
+		if (!FReq_Buffer[i].isDir)
+			filenamesU[numFiles++] = FReq_Buffer[i].nameU;
+	}
+
+	indexModules(FReq_CurPathU, filenamesU, numFiles, moduleIndexDone); // (copies the names)
+	free(filenamesU);
+}
+
+void diskOp_ReadDone(void) // called from the GUI thread when the directory read thread is done
+{
+	FReq_ListReady = true;
+
+	updateSearchView();
+	startModuleIndexing();
+
+	if (ui.diskOpShown)
+		diskOp_DrawDirectory();
+}
 
-			FReq_Buffer = newPtr;
+static bool addParentDirEntry(void) // special case: creates a dir entry with a ".." directory
+{
+	DirRec dirEntry;
+
+	dirEntry.nameU = poolStrDupU(PARENT_DIR_STR);
+	if (dirEntry.nameU == NULL)
+		return false;
+
+	dirEntry.isDir = true;
+	dirEntry.filesize = 0;
+
+	return addDirRec(&dirEntry);
+}
 
-			memcpy(&FReq_Buffer[FReq_FileCount], &tmp, sizeof (DirRec));
-			FReq_FileCount++;
+static int32_t diskOp_ReadDirectoryThread(void *ptr)
+{
+	DirRec tmp;
+
+	FReq_DirPos = 0;
+
+	// free old buffer
+	freeDirRecBuffer();
+
+	UNICHAR_GETCWD(FReq_CurPathU, PATH_MAX);
+
+	lastReadProgress = 0;
+	FReq_ReadState = DIR_READ_LISTING;
+
+	// read files
+	int8_t lastFindFileFlag = findFirst(&tmp);
+	while (lastFindFileFlag != LFF_DONE)
+	{
+		if (lastFindFileFlag != LFF_SKIP && !addDirRec(&tmp))
+		{
+			freeDirRecBuffer();
+			okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
+			break;
 		}
+
+		lastFindFileFlag = findNext(&tmp);
 	}
 
 	findClose();
 
 	if (FReq_FileCount > 0)
 	{
+		FReq_ReadState = DIR_READ_SORTING;
 		sortDirectory();
 	}
 	else
 	{
 		// access denied or out of memory - create parent directory link
-		FReq_Buffer = bufferCreateEmptyDir();
-		if (FReq_Buffer != NULL)
-			FReq_FileCount = 1;
-		else
+		if (!addParentDirEntry())
 			okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
 	}
 
+	FReq_ReadState = DIR_READ_IDLE;
 	editor.diskOpReadDone = true;
 	setMouseBusy(false);
 
@@ -1979,6 +2257,11 @@ static int32_t diskOp_ReadDirectoryThread(void *ptr)
 
 void diskOp_StartDirReadThread(void)
 {
+	// the list is about to be freed
+	cancelModuleIndexing();
+	freeSearchView();
+	FReq_ListReady = false;
+
 	editor.diskOpReadDone = false;
 
 	mouseAnimOn();
@@ -2167,6 +2450,7 @@ static void setDiskOpItem(uint8_t item)
 	}
 
 	textBoxes[TB_DISKOP_FILENAME].textPtr = FReq_FileName;
+	textBoxes[TB_DISKOP_SEARCH].textPtr = FReq_SearchText;
 	FReq_ShowAllFiles = false;
 
 	if (ui.diskOpShown)
@@ -2243,6 +2527,9 @@ static void drawDiskOpScreen(void)
 	// filename
 	textOutShadow(4, 159, PAL_FORGRND, PAL_DSKTOP2, "File:");
 
+	if (FReq_SearchShown)
+		drawSearchBox();
+
 	diskOp_DrawDirectory();
 }
 
@@ -2317,6 +2604,7 @@ void hideDiskOpScreen(void)
 
 	hideScrollBar(SB_DISKOP_LIST);
 	hideTextBox(TB_DISKOP_FILENAME);
+	hideTextBox(TB_DISKOP_SEARCH);
 	hideRadioButtonGroup(RB_GROUP_DISKOP_ITEM);
 	hideRadioButtonGroup(RB_GROUP_DISKOP_MOD_SAVEAS);
 	hideRadioButtonGroup(RB_GROUP_DISKOP_INS_SAVEAS);
@@ -2344,7 +2632,7 @@ void toggleDiskOpScreen(void)
 
 void sbDiskOpSetPos(uint32_t pos)
 {
-	if ((int32_t)pos != FReq_DirPos && FReq_FileCount > DISKOP_ENTRY_NUM)
+	if ((int32_t)pos != FReq_DirPos && getNumListEntries() > DISKOP_ENTRY_NUM)
 	{
 		FReq_DirPos = (int32_t)pos;
 		diskOp_DrawFilelist();
@@ -2353,13 +2641,14 @@ void sbDiskOpSetPos(uint32_t pos)
 
 void pbDiskOpListUp(void)
 {
-	if (FReq_DirPos > 0 && FReq_FileCount > DISKOP_ENTRY_NUM)
+	if (FReq_DirPos > 0 && getNumListEntries() > DISKOP_ENTRY_NUM)
 		scrollBarScrollUp(SB_DISKOP_LIST, 1);
 }
 
 void pbDiskOpListDown(void)
 {
-	if (FReq_DirPos < FReq_FileCount-DISKOP_ENTRY_NUM && FReq_FileCount > DISKOP_ENTRY_NUM)
+	const int32_t numEntries = getNumListEntries();
+	if (FReq_DirPos < numEntries-DISKOP_ENTRY_NUM && numEntries > DISKOP_ENTRY_NUM)
 		scrollBarScrollDown(SB_DISKOP_LIST, 1);
 }
 
@@ -4,6 +4,7 @@
 #include "ft2_unicode.h"
 
 #define DISKOP_ENTRY_NUM 15
+#define DISKOP_SEARCH_LEN 48
 
 enum
 {
@@ -44,6 +45,11 @@ void testDiskOpMouseRelease(void);
 void diskOp_StartDirReadThread(void);
 void diskOp_DrawFilelist(void);
 void diskOp_DrawDirectory(void);
+void diskOp_DrawReadProgress(void);
+void diskOp_ReadDone(void);
+void diskOp_SearchTextChanged(void);
+void diskOp_SearchEditDone(void);
+void diskOpFind(void);
 void showDiskOpScreen(void);
 void hideDiskOpScreen(void);
 void exitDiskOpScreen(void);
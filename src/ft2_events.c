@@ -30,7 +30,8 @@
 #include "ft2_sysreqs.h"
 #include "ft2_keyboard.h"
 #include "ft2_sample_ed.h"
-#include "ft2_sample_ed_features.h"
+#include "ft2_jobs.h"
+#include "ft2_autosave.h"
 #include "ft2_structs.h"
 
 #define CRASH_TEXT "Oh no! The Fasttracker II clone has crashed...\nA backup of the song was hopefully " \
@@ -89,6 +90,9 @@ void handleEvents(void)
 		trimThreadDone();
 	}
 
+	handleJobs();
+	handleAutosave();
+
 	if (editor.updateCurSmp)
 	{
 		editor.updateCurSmp = false;
@@ -102,6 +106,8 @@ void handleEvents(void)
 		setMouseBusy(false);
 	}
 
+	handleSampleLoadProgress();
+
 	if (editor.updateCurInstr)
 	{
 		editor.updateCurInstr = false;
@@ -124,8 +130,11 @@ void handleEvents(void)
 	if (editor.diskOpReadDone)
 	{
 		editor.diskOpReadDone = false;
-		if (ui.diskOpShown)
-			diskOp_DrawDirectory();
+		diskOp_ReadDone();
+	}
+	else
+	{
+		diskOp_DrawReadProgress();
 	}
 
 	handleLoadMusicEvents();
@@ -375,6 +384,17 @@ void handleWaitVblQuirk(SDL_Event *event)
 		// reset vblank end time if we minimize window
 		if (event->window.event == SDL_WINDOWEVENT_MINIMIZED || event->window.event == SDL_WINDOWEVENT_FOCUS_LOST)
 			hpc_ResetCounters(&video.vblankHpc);
+
+		// frames are only presented when something changed, so force one if the window contents got lost
+		if (event->window.event == SDL_WINDOWEVENT_EXPOSED || event->window.event == SDL_WINDOWEVENT_SHOWN ||
+			event->window.event == SDL_WINDOWEVENT_RESTORED || event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+		{
+			markScreenDirty();
+		}
+	}
+	else if (event->type == SDL_RENDER_TARGETS_RESET || event->type == SDL_RENDER_DEVICE_RESET)
+	{
+		markScreenDirty();
 	}
 }
 
@@ -394,13 +414,14 @@ static void handleSDLEvents(void)
 			const uint32_t eventType = event.type;
 			const SDL_Scancode key = event.key.keysym.scancode;
 
-			/* The Echo tool in Smp. Ed. can take forever if abused, let
-			** mouse buttons/ESC/SIGTERM force-stop it.
+			/* Long sample editor operations (jobs) and sample loads can take forever
+			** if abused, let mouse buttons/ESC/SIGTERM cancel them.
 			*/
 			if (eventType == SDL_MOUSEBUTTONDOWN || eventType == SDL_QUIT ||
 				(eventType == SDL_KEYUP && key == SDL_SCANCODE_ESCAPE))
 			{
-				handleEchoToolPanic();
+				cancelForegroundJobs();
+				cancelSampleLoading();
 			}
 
 			// let certain mouse buttons or keyboard keys stop certain events
@@ -0,0 +1,120 @@
+/* Radix-2 complex FFT, used by the sample editor's convolution reverb and
+** spectrogram. The twiddle factors and the bit-reversal permutation are
+** calculated once in fftInit(), so an fft_t can be used for many transforms.
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ft2_header.h"
+#include "ft2_fft.h"
+
+bool fftInit(fft_t *f, int32_t log2Size)
+{
+	memset(f, 0, sizeof (fft_t));
+
+	f->log2Size = log2Size;
+	f->size = 1 << log2Size;
+
+	const int32_t halfSize = f->size >> 1;
+
+	f->bitRev = (int32_t *)malloc(f->size * sizeof (int32_t));
+	f->cosTab = (double *)malloc(halfSize * sizeof (double));
+	f->sinTab = (double *)malloc(halfSize * sizeof (double));
+
+	if (f->bitRev == NULL || f->cosTab == NULL || f->sinTab == NULL)
+	{
+		fftFree(f);
+		return false;
+	}
+
+	for (int32_t i = 0; i < f->size; i++)
+	{
+		int32_t rev = 0;
+		for (int32_t j = 0; j < log2Size; j++)
+			rev |= ((i >> j) & 1) << (log2Size - 1 - j);
+
+		f->bitRev[i] = rev;
+	}
+
+	for (int32_t i = 0; i < halfSize; i++)
+	{
+		const double phase = (2.0 * PI * i) / f->size;
+
+		f->cosTab[i] = cos(phase);
+		f->sinTab[i] = sin(phase);
+	}
+
+	return true;
+}
+
+void fftFree(fft_t *f)
+{
+	if (f->bitRev != NULL)
+	{
+		free(f->bitRev);
+		f->bitRev = NULL;
+	}
+
+	if (f->cosTab != NULL)
+	{
+		free(f->cosTab);
+		f->cosTab = NULL;
+	}
+
+	if (f->sinTab != NULL)
+	{
+		free(f->sinTab);
+		f->sinTab = NULL;
+	}
+}
+
+void fftTransform(const fft_t *f, double *re, double *im, bool inverse)
+{
+	const int32_t n = f->size;
+	const double sinSign = inverse ? 1.0 : -1.0;
+
+	for (int32_t i = 0; i < n; i++)
+	{
+		const int32_t j = f->bitRev[i];
+		if (j > i)
+		{
+			double tmp;
+			tmp = re[i]; re[i] = re[j]; re[j] = tmp;
+			tmp = im[i]; im[i] = im[j]; im[j] = tmp;
+		}
+	}
+
+	for (int32_t len = 2; len <= n; len <<= 1)
+	{
+		const int32_t halfLen = len >> 1;
+		const int32_t tabStep = n / len;
+
+		for (int32_t i = 0; i < n; i += len)
+		{
+			for (int32_t j = 0; j < halfLen; j++)
+			{
+				const double wRe = f->cosTab[j * tabStep];
+				const double wIm = f->sinTab[j * tabStep] * sinSign;
+
+				const int32_t a = i + j;
+				const int32_t b = a + halfLen;
+
+				const double tRe = (re[b] * wRe) - (im[b] * wIm);
+				const double tIm = (re[b] * wIm) + (im[b] * wRe);
+
+				re[b] = re[a] - tRe;
+				im[b] = im[a] - tIm;
+				re[a] += tRe;
+				im[a] += tIm;
+			}
+		}
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct fft_t
+{
+	int32_t size, log2Size;
+	int32_t *bitRev;
+	double *cosTab, *sinTab; // size/2 entries
+} fft_t;
+
+bool fftInit(fft_t *f, int32_t log2Size);
+void fftFree(fft_t *f);
+
+// in-place complex FFT, the inverse transform is not scaled (divide by f->size)
+void fftTransform(const fft_t *f, double *re, double *im, bool inverse);
@@ -0,0 +1,202 @@
+/* Font glyph caches.
+**
+** The fonts are stored as 1-bit bitmaps (one byte per pixel), and drawing
+** them directly means testing every pixel of every glyph on each redraw.
+** Instead, every glyph is converted once to a list of horizontal pixel runs
+** for transparent text. Opaque text (charOutBg(), hexOutBg()) still tests
+** the pixels, with the glyph size known at compile time that is faster than
+** copying pre-colored glyphs (see bench/bench_draw.c).
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ft2_header.h"
+#include "ft2_gui.h"
+#include "ft2_bmp.h"
+#include "ft2_glyphs.h"
+
+typedef struct glyphRun_t
+{
+	uint16_t offset; // (y * SCREEN_W) + x
+	uint8_t x, w;
+} glyphRun_t;
+
+typedef struct glyphFont_t
+{
+	const uint8_t *bitmap;
+	int32_t bitmapW, charW, charH, numChars;
+	uint32_t *runIndex; // numChars+1 entries
+	glyphRun_t *runs;
+} glyphFont_t;
+
+static glyphFont_t glyphFonts[NUM_GLYPH_FONTS];
+
+static void setGlyphFont(uint8_t fontNum, const uint8_t *bitmap, int32_t bitmapW, int32_t charW, int32_t charH)
+{
+	glyphFont_t *f = &glyphFonts[fontNum];
+
+	f->bitmap = bitmap;
+	f->bitmapW = bitmapW;
+	f->charW = charW;
+	f->charH = charH;
+	f->numChars = bitmapW / charW;
+}
+
+static int32_t getGlyphRuns(const glyphFont_t *f, int32_t chr, glyphRun_t *runs) // runs can be NULL (count only)
+{
+	int32_t numRuns = 0;
+
+	const uint8_t *srcPtr = &f->bitmap[chr * f->charW];
+	for (int32_t y = 0; y < f->charH; y++, srcPtr += f->bitmapW)
+	{
+		int32_t x = 0;
+		while (x < f->charW)
+		{
+			if (srcPtr[x] == 0)
+			{
+				x++;
+				continue;
+			}
+
+			const int32_t runStart = x;
+			while (x < f->charW && srcPtr[x] != 0)
+				x++;
+
+			if (runs != NULL)
+			{
+				glyphRun_t *r = &runs[numRuns];
+				r->offset = (uint16_t)((y * SCREEN_W) + runStart);
+				r->x = (uint8_t)runStart;
+				r->w = (uint8_t)(x - runStart);
+			}
+
+			numRuns++;
+		}
+	}
+
+	return numRuns;
+}
+
+static bool buildGlyphRuns(glyphFont_t *f)
+{
+	f->runIndex = (uint32_t *)malloc((f->numChars + 1) * sizeof (uint32_t));
+	if (f->runIndex == NULL)
+		return false;
+
+	int32_t totalRuns = 0;
+	for (int32_t i = 0; i < f->numChars; i++)
+	{
+		f->runIndex[i] = totalRuns;
+		totalRuns += getGlyphRuns(f, i, NULL);
+	}
+	f->runIndex[f->numChars] = totalRuns;
+
+	f->runs = (glyphRun_t *)malloc((totalRuns + 1) * sizeof (glyphRun_t));
+	if (f->runs == NULL)
+		return false;
+
+	for (int32_t i = 0; i < f->numChars; i++)
+		getGlyphRuns(f, i, &f->runs[f->runIndex[i]]);
+
+	return true;
+}
+
+bool setupGlyphs(void)
+{
+	memset(glyphFonts, 0, sizeof (glyphFonts));
+
+	setGlyphFont(GLYPH_FONT1, bmp.font1, FONT1_WIDTH, FONT1_CHAR_W, FONT1_CHAR_H);
+	setGlyphFont(GLYPH_FONT2, bmp.font2, FONT2_WIDTH, FONT2_CHAR_W, FONT2_CHAR_H);
+	setGlyphFont(GLYPH_FONT3, bmp.font3, FONT3_WIDTH, FONT3_CHAR_W, FONT3_CHAR_H);
+	setGlyphFont(GLYPH_FONT6, bmp.font6, FONT6_WIDTH, FONT6_CHAR_W, FONT6_CHAR_H);
+	setGlyphFont(GLYPH_FONT7, bmp.font7, FONT7_WIDTH, FONT7_CHAR_W, FONT7_CHAR_H);
+	setGlyphFont(GLYPH_FONT8, bmp.font8, FONT8_WIDTH, FONT8_CHAR_W, FONT8_CHAR_H);
+
+	// font4 BMP: four font4 sets followed by four font5 sets
+	for (int32_t i = 0; i < 4; i++)
+	{
+		setGlyphFont(GLYPH_FONT4+i, &bmp.font4[i * (FONT4_WIDTH * FONT4_CHAR_H)], FONT4_WIDTH, FONT4_CHAR_W, FONT4_CHAR_H);
+		setGlyphFont(GLYPH_FONT5+i, &bmp.font4[(4 + i) * (FONT4_WIDTH * FONT4_CHAR_H)], FONT5_WIDTH, FONT5_CHAR_W, FONT5_CHAR_H);
+	}
+
+	for (int32_t i = 0; i < NUM_GLYPH_FONTS; i++)
+	{
+		if (!buildGlyphRuns(&glyphFonts[i]))
+		{
+			freeGlyphs();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void freeGlyphs(void)
+{
+	glyphFont_t *f = glyphFonts;
+	for (int32_t i = 0; i < NUM_GLYPH_FONTS; i++, f++)
+	{
+		if (f->runIndex != NULL)
+		{
+			free(f->runIndex);
+			f->runIndex = NULL;
+		}
+
+		if (f->runs != NULL)
+		{
+			free(f->runs);
+			f->runs = NULL;
+		}
+	}
+}
+
+void glyphOut(uint8_t fontNum, uint32_t chr, uint32_t *dstPtr, uint32_t color)
+{
+	const glyphFont_t *f = &glyphFonts[fontNum];
+	ASSERT(chr < (uint32_t)f->numChars);
+
+	const glyphRun_t *r = &f->runs[f->runIndex[chr]];
+	const glyphRun_t *rEnd = &f->runs[f->runIndex[chr+1]];
+
+	for (; r < rEnd; r++)
+	{
+		uint32_t *dst = dstPtr + r->offset;
+		for (int32_t x = 0; x < r->w; x++)
+			dst[x] = color;
+	}
+}
+
+void glyphsOut(uint8_t fontNum, uint32_t firstChr, uint32_t numChars, uint32_t *dstPtr, uint32_t color)
+{
+	const int32_t charW = glyphFonts[fontNum].charW;
+	for (uint32_t i = 0; i < numChars; i++, dstPtr += charW)
+		glyphOut(fontNum, firstChr + i, dstPtr, color);
+}
+
+void glyphOutClipW(uint8_t fontNum, uint32_t chr, uint32_t *dstPtr, int32_t maxW, uint32_t color)
+{
+	const glyphFont_t *f = &glyphFonts[fontNum];
+	ASSERT(chr < (uint32_t)f->numChars);
+
+	const glyphRun_t *r = &f->runs[f->runIndex[chr]];
+	const glyphRun_t *rEnd = &f->runs[f->runIndex[chr+1]];
+
+	for (; r < rEnd; r++)
+	{
+		if (r->x >= maxW)
+			continue;
+
+		const int32_t w = MIN(r->w, maxW - r->x);
+
+		uint32_t *dst = dstPtr + r->offset;
+		for (int32_t x = 0; x < w; x++)
+			dst[x] = color;
+	}
+}
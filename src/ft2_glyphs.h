@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// pattern fonts (4/5) have four sets each, selected by config.ptnFont
+enum
+{
+	GLYPH_FONT1 = 0,
+	GLYPH_FONT2 = 1,
+	GLYPH_FONT3 = 2,
+	GLYPH_FONT4 = 3, // +0..3
+	GLYPH_FONT5 = 7, // +0..3
+	GLYPH_FONT6 = 11,
+	GLYPH_FONT7 = 12,
+	GLYPH_FONT8 = 13,
+
+	NUM_GLYPH_FONTS
+};
+
+bool setupGlyphs(void); // call after the font BMPs have been loaded
+void freeGlyphs(void);
+
+// transparent glyph(s), only the set pixels are written
+void glyphOut(uint8_t fontNum, uint32_t chr, uint32_t *dstPtr, uint32_t color);
+void glyphsOut(uint8_t fontNum, uint32_t firstChr, uint32_t numChars, uint32_t *dstPtr, uint32_t color);
+void glyphOutClipW(uint8_t fontNum, uint32_t chr, uint32_t *dstPtr, int32_t maxW, uint32_t color);
@@ -21,6 +21,7 @@
 #include "ft2_video.h"
 #include "ft2_tables.h"
 #include "ft2_bmp.h"
+#include "ft2_glyphs.h"
 #include "ft2_structs.h"
 
 static void releaseMouseStates(void)
@@ -311,23 +312,15 @@ void textOutTiny(int32_t xPos, int32_t yPos, char *str, uint32_t color) // A..Z/
 		else
 		{
 			dstPtr += FONT3_CHAR_W;
+			xPos += FONT3_CHAR_W;
 			continue;
 		}
 
-		const uint8_t *srcPtr = &bmp.font3[chr * FONT3_CHAR_W];
-		for (int32_t y = 0; y < FONT3_CHAR_H; y++)
-		{
-			for (int32_t x = 0; x < FONT3_CHAR_W; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = color;
-			}
-
-			srcPtr += FONT3_WIDTH;
-			dstPtr += SCREEN_W;
-		}
+		markRectDirty(xPos, yPos, FONT3_CHAR_W, FONT3_CHAR_H);
+		glyphOut(GLYPH_FONT3, chr, dstPtr, color);
 
-		dstPtr -= (SCREEN_W * FONT3_CHAR_H) - FONT3_CHAR_W;
+		dstPtr += FONT3_CHAR_W;
+		xPos += FONT3_CHAR_W;
 	}
 }
 
@@ -355,21 +348,8 @@ void charOut(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, char chr)
 	if (chr == ' ')
 		return;
 
-	const uint32_t pixVal = video.palette[paletteIndex];
-	const uint8_t *srcPtr = &bmp.font1[chr * FONT1_CHAR_W];
-	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-
-	for (uint32_t y = 0; y < FONT1_CHAR_H; y++)
-	{
-		for (uint32_t x = 0; x < FONT1_CHAR_W; x++)
-		{
-			if (srcPtr[x] != 0)
-				dstPtr[x] = pixVal;
-		}
-
-		srcPtr += FONT1_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	markRectDirty(xPos, yPos, FONT1_CHAR_W, FONT1_CHAR_H);
+	glyphOut(GLYPH_FONT1, chr, &video.frameBuffer[(yPos * SCREEN_W) + xPos], video.palette[paletteIndex]);
 }
 
 void charOutBg(uint16_t xPos, uint16_t yPos, uint8_t fgPalette, uint8_t bgPalette, char chr)
@@ -383,6 +363,8 @@ void charOutBg(uint16_t xPos, uint16_t yPos, uint8_t fgPalette, uint8_t bgPalett
 	if (chr == ' ')
 		return;
 
+	markRectDirty(xPos, yPos, FONT1_CHAR_W-1, FONT1_CHAR_H);
+
 	const uint32_t fg = video.palette[fgPalette];
 	const uint32_t bg = video.palette[bgPalette];
 
@@ -420,27 +402,11 @@ void charOutShadow(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, uint8_t s
 	if (chr == ' ')
 		return;
 
-	const uint32_t pixVal1 = video.palette[paletteIndex];
-	const uint32_t pixVal2 = video.palette[shadowPaletteIndex];
-	const uint8_t *srcPtr = &bmp.font1[chr * FONT1_CHAR_W];
-	uint32_t *dstPtr1 = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-	uint32_t *dstPtr2 = dstPtr1 + (SCREEN_W+1);
+	markRectDirty(xPos, yPos, FONT1_CHAR_W+1, FONT1_CHAR_H+1);
 
-	for (int32_t y = 0; y < FONT1_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT1_CHAR_W; x++)
-		{
-			if (srcPtr[x] != 0)
-			{
-				dstPtr2[x] = pixVal2;
-				dstPtr1[x] = pixVal1;
-			}
-		}
-
-		srcPtr += FONT1_WIDTH;
-		dstPtr1 += SCREEN_W;
-		dstPtr2 += SCREEN_W;
-	}
+	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
+	glyphOut(GLYPH_FONT1, chr, dstPtr + (SCREEN_W+1), video.palette[shadowPaletteIndex]);
+	glyphOut(GLYPH_FONT1, chr, dstPtr, video.palette[paletteIndex]);
 }
 
 void charOutClipX(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, char chr, uint16_t clipX)
@@ -457,25 +423,12 @@ void charOutClipX(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, char chr,
 	if (chr == ' ')
 		return;
 
-	const uint32_t pixVal = video.palette[paletteIndex];
-	const uint8_t *srcPtr = &bmp.font1[chr * FONT1_CHAR_W];
-	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-
 	int32_t width = FONT1_CHAR_W;
 	if (xPos+width > clipX)
 		width = FONT1_CHAR_W - ((xPos + width) - clipX);
 
-	for (int32_t y = 0; y < FONT1_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < width; x++)
-		{
-			if (srcPtr[x] != 0)
-				dstPtr[x] = pixVal;
-		}
-
-		srcPtr += FONT1_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	markRectDirty(xPos, yPos, width, FONT1_CHAR_H);
+	glyphOutClipW(GLYPH_FONT1, chr, &video.frameBuffer[(yPos * SCREEN_W) + xPos], width, video.palette[paletteIndex]);
 }
 
 void bigCharOut(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, char chr)
@@ -489,21 +442,8 @@ void bigCharOut(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, char chr)
 	if (chr == ' ')
 		return;
 
-	const uint8_t *srcPtr = &bmp.font2[chr * FONT2_CHAR_W];
-	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-	const uint32_t pixVal = video.palette[paletteIndex];
-
-	for (int32_t y = 0; y < FONT2_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT2_CHAR_W; x++)
-		{
-			if (srcPtr[x] != 0)
-				dstPtr[x] = pixVal;
-		}
-
-		srcPtr += FONT2_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	markRectDirty(xPos, yPos, FONT2_CHAR_W, FONT2_CHAR_H);
+	glyphOut(GLYPH_FONT2, chr, &video.frameBuffer[(yPos * SCREEN_W) + xPos], video.palette[paletteIndex]);
 }
 
 static void bigCharOutShadow(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, uint8_t shadowPaletteIndex, char chr)
@@ -517,27 +457,11 @@ static void bigCharOutShadow(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex,
 	if (chr == ' ')
 		return;
 
-	const uint32_t pixVal1 = video.palette[paletteIndex];
-	const uint32_t pixVal2 = video.palette[shadowPaletteIndex];
-	const uint8_t *srcPtr = &bmp.font2[chr * FONT2_CHAR_W];
-	uint32_t *dstPtr1 = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-	uint32_t *dstPtr2 = dstPtr1 + (SCREEN_W+1);
-
-	for (int32_t y = 0; y < FONT2_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT2_CHAR_W; x++)
-		{
-			if (srcPtr[x] != 0)
-			{
-				dstPtr2[x] = pixVal2;
-				dstPtr1[x] = pixVal1;
-			}
-		}
+	markRectDirty(xPos, yPos, FONT2_CHAR_W+1, FONT2_CHAR_H+1);
 
-		srcPtr += FONT2_WIDTH;
-		dstPtr1 += SCREEN_W;
-		dstPtr2 += SCREEN_W;
-	}
+	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
+	glyphOut(GLYPH_FONT2, chr, dstPtr + (SCREEN_W+1), video.palette[shadowPaletteIndex]);
+	glyphOut(GLYPH_FONT2, chr, dstPtr, video.palette[paletteIndex]);
 }
 
 void textOut(uint16_t x, uint16_t y, uint8_t paletteIndex, const char *textPtr)
@@ -654,34 +578,21 @@ void hexOut(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, uint32_t val, ui
 {
 	ASSERT(xPos < SCREEN_W && yPos < SCREEN_H);
 
+	markRectDirty(xPos, yPos, numDigits * FONT6_CHAR_W, FONT6_CHAR_H);
+
 	const uint32_t pixVal = video.palette[paletteIndex];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
 
-	for (int32_t i = numDigits-1; i >= 0; i--)
-	{
-		const uint8_t *srcPtr = &bmp.font6[((val >> (i * 4)) & 15) * FONT6_CHAR_W];
-
-		// render glyph
-		for (int32_t y = 0; y < FONT6_CHAR_H; y++)
-		{
-			for (int32_t x = 0; x < FONT6_CHAR_W; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = pixVal;
-			}
-
-			srcPtr += FONT6_WIDTH;
-			dstPtr += SCREEN_W;
-		}
-
-		dstPtr -= (SCREEN_W * FONT6_CHAR_H) - FONT6_CHAR_W; // xpos += FONT6_CHAR_W
-	}
+	for (int32_t i = numDigits-1; i >= 0; i--, dstPtr += FONT6_CHAR_W)
+		glyphOut(GLYPH_FONT6, (val >> (i * 4)) & 15, dstPtr, pixVal);
 }
 
 void hexOutBg(uint16_t xPos, uint16_t yPos, uint8_t fgPalette, uint8_t bgPalette, uint32_t val, uint8_t numDigits)
 {
 	ASSERT(xPos < SCREEN_W && yPos < SCREEN_H);
 
+	markRectDirty(xPos, yPos, numDigits * FONT6_CHAR_W, FONT6_CHAR_H);
+
 	const uint32_t fg = video.palette[fgPalette];
 	const uint32_t bg = video.palette[bgPalette];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
@@ -717,6 +628,8 @@ void clearRect(uint16_t xPos, uint16_t yPos, uint16_t w, uint16_t h)
 {
 	ASSERT(xPos < SCREEN_W && yPos < SCREEN_H && (xPos + w) <= SCREEN_W && (yPos + h) <= SCREEN_H);
 
+	markRectDirty(xPos, yPos, w, h);
+
 	const uint32_t pitch = w * sizeof (int32_t);
 
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
@@ -728,6 +641,8 @@ void fillRect(uint16_t xPos, uint16_t yPos, uint16_t w, uint16_t h, uint8_t pale
 {
 	ASSERT(xPos < SCREEN_W && yPos < SCREEN_H && (xPos + w) <= SCREEN_W && (yPos + h) <= SCREEN_H);
 
+	markRectDirty(xPos, yPos, w, h);
+
 	const uint32_t pixVal = video.palette[paletteIndex];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
 
@@ -744,6 +659,8 @@ void blit32(uint16_t xPos, uint16_t yPos, const uint32_t *srcPtr, uint16_t w, ui
 {
 	ASSERT(srcPtr != NULL && xPos < SCREEN_W && yPos < SCREEN_H && (xPos + w) <= SCREEN_W && (yPos + h) <= SCREEN_H);
 
+	markRectDirty(xPos, yPos, w, h);
+
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
 	for (int32_t y = 0; y < h; y++)
 	{
@@ -762,6 +679,8 @@ void blit(uint16_t xPos, uint16_t yPos, const uint8_t *srcPtr, uint16_t w, uint1
 {
 	ASSERT(srcPtr != NULL && xPos < SCREEN_W && yPos < SCREEN_H && (xPos + w) <= SCREEN_W && (yPos + h) <= SCREEN_H);
 
+	markRectDirty(xPos, yPos, w, h);
+
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
 	for (int32_t y = 0; y < h; y++)
 	{
@@ -784,6 +703,8 @@ void blitClipX(uint16_t xPos, uint16_t yPos, const uint8_t *srcPtr, uint16_t w,
 
 	ASSERT(srcPtr != NULL && xPos < SCREEN_W && yPos < SCREEN_H && (xPos + clipX) <= SCREEN_W && (yPos + h) <= SCREEN_H);
 
+	markRectDirty(xPos, yPos, clipX, h);
+
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
 	for (int32_t y = 0; y < h; y++)
 	{
@@ -803,6 +724,8 @@ void blitFast(uint16_t xPos, uint16_t yPos, const uint8_t *srcPtr, uint16_t w, u
 {
 	ASSERT(srcPtr != NULL && xPos < SCREEN_W && yPos < SCREEN_H && (xPos + w) <= SCREEN_W && (yPos + h) <= SCREEN_H);
 
+	markRectDirty(xPos, yPos, w, h);
+
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
 	for (int32_t y = 0; y < h; y++)
 	{
@@ -821,6 +744,8 @@ void blitFastClipX(uint16_t xPos, uint16_t yPos, const uint8_t *srcPtr, uint16_t
 
 	ASSERT(srcPtr != NULL && xPos < SCREEN_W && yPos < SCREEN_H && (xPos + clipX) <= SCREEN_W && (yPos + h) <= SCREEN_H);
 
+	markRectDirty(xPos, yPos, clipX, h);
+
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
 	for (int32_t y = 0; y < h; y++)
 	{
@@ -838,6 +763,8 @@ void hLine(uint16_t x, uint16_t y, uint16_t w, uint8_t paletteIndex)
 {
 	ASSERT(x < SCREEN_W && y < SCREEN_H && (x + w) <= SCREEN_W);
 
+	markRectDirty(x, y, w, 1);
+
 	const uint32_t pixVal = video.palette[paletteIndex];
 
 	uint32_t *dstPtr = &video.frameBuffer[(y * SCREEN_W) + x];
@@ -849,6 +776,8 @@ void vLine(uint16_t x, uint16_t y, uint16_t h, uint8_t paletteIndex)
 {
 	ASSERT(x < SCREEN_W && y < SCREEN_H && (y + h) <= SCREEN_W);
 
+	markRectDirty(x, y, 1, h);
+
 	const uint32_t pixVal = video.palette[paletteIndex];
 
 	uint32_t *dstPtr = &video.frameBuffer[(y * SCREEN_W) + x];
@@ -882,6 +811,8 @@ void line(int16_t x1, int16_t x2, int16_t y1, int16_t y2, uint8_t paletteIndex)
 	int16_t x = x1;
 	int16_t y  = y1;
 
+	markRectDirty(MIN(x1, x2), MIN(y1, y2), ABS(dx) + 1, ABS(dy) + 1);
+
 	uint32_t pixVal = video.palette[paletteIndex];
 	const int32_t pitch  = sy * SCREEN_W;
 	uint32_t *dst32  = &video.frameBuffer[(y * SCREEN_W) + x];
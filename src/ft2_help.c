@@ -279,6 +279,8 @@ static void bigTextOutHalf(uint16_t xPos, uint16_t yPos, uint8_t paletteIndex, b
 			if (!lowerHalf)
 				srcPtr += (FONT2_CHAR_H / 2) * FONT2_WIDTH;
 
+			markRectDirty(currX, yPos, FONT2_CHAR_W, FONT2_CHAR_H/2);
+
 			uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + currX];
 			const uint32_t pixVal = video.palette[paletteIndex];
 
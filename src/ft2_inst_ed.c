@@ -1569,6 +1569,8 @@ static void pianoNumberOut(uint16_t xPos, uint16_t yPos, uint8_t fgPalette, uint
 {
 	ASSERT(val <= 0xF);
 
+	markRectDirty(xPos, yPos, FONT8_CHAR_W, FONT8_CHAR_H);
+
 	const uint32_t fg = video.palette[fgPalette];
 	const uint32_t bg = video.palette[bgPalette];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
@@ -2042,6 +2044,7 @@ static void drawPanEnvCoords(int16_t tick, int16_t val)
 		hLine(326, 289, 3, PAL_BCKGRND);
 		video.frameBuffer[(288 * SCREEN_W) + 325] = video.palette[PAL_BCKGRND];
 		video.frameBuffer[(288 * SCREEN_W) + 329] = video.palette[PAL_BCKGRND];
+		markRectDirty(325, 288, 5, 1);
 
 		hLine(326, 288, 3, PAL_FORGRND);
 	}
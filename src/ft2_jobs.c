@@ -0,0 +1,336 @@
+/* Background jobs for long sample operations.
+**
+** Jobs are queued to a small pool of worker threads, and run in the order
+** they were started. A job can report its progress and should poll
+** jobCancelled() in its long loops. When a job is done, its done callback is
+** called from the GUI thread (in handleJobs()), so it can safely update the
+** GUI.
+**
+** The workers are created once on startup (initJobs()). Background jobs
+** can be started from any thread (the module loader and saver threads use
+** them), foreground jobs only from the GUI thread.
+**
+** Foreground jobs block the input (busy mouse) until all of them are done,
+** and their combined progress is drawn as a bar at the bottom of the sample
+** data area. ESC or a mouse click cancels them (see handleSDLEvents()).
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ft2_header.h"
+#include "ft2_gui.h"
+#include "ft2_mouse.h"
+#include "ft2_sample_ed.h"
+#include "ft2_structs.h"
+#include "ft2_jobs.h"
+
+#define MAX_JOBS 32
+#define MAX_JOB_WORKERS 4
+
+enum
+{
+	JOB_STATE_FREE = 0,
+	JOB_STATE_QUEUED = 1,
+	JOB_STATE_RUNNING = 2,
+	JOB_STATE_FINISHED = 3
+};
+
+struct job_t
+{
+	jobFunc_t func;
+	jobDoneFunc_t doneFunc;
+	void *data;
+	uint8_t mode;
+	uint32_t order;
+	bool ok;
+	volatile bool cancel;
+	volatile int32_t state, progress;
+};
+
+static volatile bool stopWorkers;
+static int32_t numWorkers, fgJobsStarted, fgJobsFinished, lastDrawnProgressW;
+static uint32_t jobCounter;
+static job_t jobs[MAX_JOBS];
+static SDL_Thread *workers[MAX_JOB_WORKERS];
+static SDL_mutex *jobMutex;
+static SDL_cond *jobCond;
+
+static job_t *getNextQueuedJob(void) // call with jobMutex locked
+{
+	job_t *nextJob = NULL;
+	for (int32_t i = 0; i < MAX_JOBS; i++)
+	{
+		job_t *job = &jobs[i];
+		if (job->state == JOB_STATE_QUEUED && (nextJob == NULL || (int32_t)(job->order - nextJob->order) < 0))
+			nextJob = job;
+	}
+
+	return nextJob;
+}
+
+static int32_t SDLCALL jobWorkerThread(void *ptr)
+{
+	SDL_LockMutex(jobMutex);
+	while (!stopWorkers)
+	{
+		job_t *job = getNextQueuedJob();
+		if (job == NULL)
+		{
+			SDL_CondWait(jobCond, jobMutex);
+			continue;
+		}
+
+		job->state = JOB_STATE_RUNNING;
+		SDL_UnlockMutex(jobMutex);
+
+		// (a job that was cancelled while queued is not started at all)
+		const bool ok = !job->cancel && job->func(job, job->data);
+
+		SDL_LockMutex(jobMutex);
+		job->ok = ok;
+		job->state = JOB_STATE_FINISHED;
+	}
+	SDL_UnlockMutex(jobMutex);
+
+	return true;
+
+	(void)ptr;
+}
+
+bool initJobs(void)
+{
+	jobMutex = SDL_CreateMutex();
+	jobCond = SDL_CreateCond();
+
+	if (jobMutex == NULL || jobCond == NULL)
+	{
+		if (jobCond != NULL) SDL_DestroyCond(jobCond);
+		if (jobMutex != NULL) SDL_DestroyMutex(jobMutex);
+		jobCond = NULL;
+		jobMutex = NULL;
+
+		return false;
+	}
+
+	int32_t maxWorkers = SDL_GetCPUCount();
+	maxWorkers = CLAMP(maxWorkers, 2, MAX_JOB_WORKERS);
+
+	stopWorkers = false;
+	for (int32_t i = 0; i < maxWorkers; i++)
+	{
+		workers[numWorkers] = SDL_CreateThread(jobWorkerThread, "job worker thread", NULL);
+		if (workers[numWorkers] != NULL)
+			numWorkers++;
+	}
+
+	return numWorkers > 0;
+}
+
+bool startJob(jobFunc_t func, jobDoneFunc_t doneFunc, void *data, uint8_t mode)
+{
+	if (numWorkers == 0) // initJobs() failed, or we're closing down
+		return false;
+
+	job_t *job = NULL;
+
+	SDL_LockMutex(jobMutex);
+	if (stopWorkers)
+	{
+		SDL_UnlockMutex(jobMutex);
+		return false;
+	}
+
+	for (int32_t i = 0; i < MAX_JOBS; i++)
+	{
+		if (jobs[i].state == JOB_STATE_FREE)
+		{
+			job = &jobs[i];
+			break;
+		}
+	}
+
+	if (job == NULL) // too many jobs
+	{
+		SDL_UnlockMutex(jobMutex);
+		return false;
+	}
+
+	job->func = func;
+	job->doneFunc = doneFunc;
+	job->data = data;
+	job->mode = mode;
+	job->order = jobCounter++;
+	job->ok = false;
+	job->cancel = false;
+	job->progress = 0;
+	job->state = JOB_STATE_QUEUED;
+
+	SDL_CondSignal(jobCond);
+	SDL_UnlockMutex(jobMutex);
+
+	if (mode == JOB_FOREGROUND)
+	{
+		if (fgJobsStarted == 0)
+			lastDrawnProgressW = 0;
+
+		fgJobsStarted++;
+		mouseAnimOn();
+	}
+
+	return true;
+}
+
+void setJobProgress(job_t *job, uint64_t pos, uint64_t total)
+{
+	if (total == 0)
+		return;
+
+	if (pos > total)
+		pos = total;
+
+	const int32_t progress = (int32_t)((pos * JOB_PROGRESS_MAX) / total);
+	if (progress > job->progress)
+		job->progress = progress;
+}
+
+bool jobCancelled(const job_t *job)
+{
+	return job->cancel || stopWorkers;
+}
+
+void cancelForegroundJobs(void)
+{
+	for (int32_t i = 0; i < MAX_JOBS; i++)
+	{
+		job_t *job = &jobs[i];
+		if (job->mode == JOB_FOREGROUND && (job->state == JOB_STATE_QUEUED || job->state == JOB_STATE_RUNNING))
+			job->cancel = true;
+	}
+}
+
+bool foregroundJobsRunning(void)
+{
+	return fgJobsStarted > 0;
+}
+
+int32_t getNumJobs(void)
+{
+	int32_t numJobs = 0;
+	for (int32_t i = 0; i < MAX_JOBS; i++)
+	{
+		if (jobs[i].state != JOB_STATE_FREE)
+			numJobs++;
+	}
+
+	return numJobs;
+}
+
+static void drawJobProgress(void)
+{
+	if (!ui.sampleEditorShown)
+		return;
+
+	// finished jobs count as done, so the bar never shrinks
+	int64_t progressSum = (int64_t)fgJobsFinished * JOB_PROGRESS_MAX;
+	for (int32_t i = 0; i < MAX_JOBS; i++)
+	{
+		const job_t *job = &jobs[i];
+		if (job->mode == JOB_FOREGROUND && (job->state == JOB_STATE_QUEUED || job->state == JOB_STATE_RUNNING))
+			progressSum += job->progress;
+	}
+
+	const int32_t w = (int32_t)((progressSum * SAMPLE_AREA_WIDTH) / ((int64_t)fgJobsStarted * JOB_PROGRESS_MAX));
+	if (w <= lastDrawnProgressW)
+		return;
+
+	fillRect(0, 324, (uint16_t)w, 3, PAL_FORGRND);
+	lastDrawnProgressW = w;
+}
+
+void handleJobs(void)
+{
+	if (jobMutex == NULL)
+		return;
+
+	for (int32_t i = 0; i < MAX_JOBS; i++)
+	{
+		job_t *job = &jobs[i];
+		if (job->state != JOB_STATE_FINISHED)
+			continue;
+
+		SDL_LockMutex(jobMutex);
+		const jobDoneFunc_t doneFunc = job->doneFunc;
+		void *data = job->data;
+		const uint8_t mode = job->mode;
+		const int32_t result = job->ok ? JOB_DONE : (job->cancel ? JOB_CANCELLED : JOB_FAILED);
+		job->state = JOB_STATE_FREE;
+		SDL_UnlockMutex(jobMutex);
+
+		if (mode == JOB_FOREGROUND)
+			fgJobsFinished++;
+
+		if (doneFunc != NULL)
+			doneFunc(data, result); // can start new jobs
+	}
+
+	if (fgJobsStarted == 0)
+		return;
+
+	if (fgJobsFinished < fgJobsStarted)
+	{
+		drawJobProgress();
+		return;
+	}
+
+	// all foreground jobs are done
+	fgJobsStarted = fgJobsFinished = 0;
+
+	if (lastDrawnProgressW > 0 && ui.sampleEditorShown)
+		writeSample(FORCE_SAMPLE_REDRAW); // erase the progress bar
+
+	mouseAnimOff();
+}
+
+void freeJobs(void)
+{
+	if (jobMutex == NULL)
+		return;
+
+	bool jobRunning = false;
+
+	SDL_LockMutex(jobMutex);
+	stopWorkers = true;
+	for (int32_t i = 0; i < MAX_JOBS; i++)
+	{
+		if (jobs[i].state == JOB_STATE_RUNNING)
+			jobRunning = true;
+	}
+	SDL_CondBroadcast(jobCond);
+	SDL_UnlockMutex(jobMutex);
+
+	if (jobRunning)
+	{
+		/* A job may wait for the GUI thread (okBoxThreadSafe()), and we're
+		** closing down. Let the workers run off on their own instead.
+		*/
+		for (int32_t i = 0; i < numWorkers; i++)
+			SDL_DetachThread(workers[i]);
+
+		numWorkers = 0;
+		return;
+	}
+
+	for (int32_t i = 0; i < numWorkers; i++)
+		SDL_WaitThread(workers[i], NULL);
+	numWorkers = 0;
+
+	SDL_DestroyCond(jobCond);
+	SDL_DestroyMutex(jobMutex);
+	jobCond = NULL;
+	jobMutex = NULL;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JOB_PROGRESS_MAX 1000
+
+enum
+{
+	JOB_BACKGROUND = 0,
+	JOB_FOREGROUND = 1 // input is blocked (busy mouse) until the job is done, the progress is shown in the sample editor
+};
+
+enum // results, passed to the done callback
+{
+	JOB_DONE = 0,
+	JOB_FAILED = 1,
+	JOB_CANCELLED = 2
+};
+
+typedef struct job_t job_t;
+
+typedef bool (*jobFunc_t)(job_t *job, void *data); // runs in a worker thread, returns false on failure/cancel
+typedef void (*jobDoneFunc_t)(void *data, int32_t result); // runs in the GUI thread (from handleJobs())
+
+bool initJobs(void); // called once on startup, creates the worker threads
+bool startJob(jobFunc_t func, jobDoneFunc_t doneFunc, void *data, uint8_t mode); // JOB_BACKGROUND: any thread, JOB_FOREGROUND: GUI thread only
+void setJobProgress(job_t *job, uint64_t pos, uint64_t total); // from the job function
+bool jobCancelled(const job_t *job); // poll this in long loops, and bail out if true
+void cancelForegroundJobs(void); // can be called from any thread
+bool foregroundJobsRunning(void);
+int32_t getNumJobs(void); // queued and running jobs, and finished jobs not yet handled
+void handleJobs(void); // called every frame, and in sample editor tool windows
+void freeJobs(void);
@@ -816,6 +816,11 @@ static bool checkModifiedKeys(SDL_Keycode keycode)
 
 				return true;
 			}
+			else if (keyb.leftAltPressed && ui.sampleEditorShown)
+			{
+				pbSampleBatch();
+				return true;
+			}
 		}
 		break;
 
@@ -915,6 +920,11 @@ static bool checkModifiedKeys(SDL_Keycode keycode)
 					showTopScreen(DONT_RESTORE_SCREENS);
 				}
 			}
+			else if (keyb.leftCtrlPressed && ui.diskOpShown)
+			{
+				diskOpFind();
+				return true;
+			}
 			else if (keyb.leftAltPressed)
 			{
 				jumpToChannel(11);
@@ -927,7 +937,11 @@ static bool checkModifiedKeys(SDL_Keycode keycode)
 		{
 			if (keyb.leftAltPressed)
 			{
-				jumpToChannel(12);
+				if (ui.sampleEditorShown)
+					toggleSampleSpectrogram();
+				else
+					jumpToChannel(12);
+
 				return true;
 			}
 		}
@@ -28,6 +28,7 @@
 #include "scopes/ft2_scopedraw.h"
 #include "ft2_about.h"
 #include "ft2_pattern_ed.h"
+#include "ft2_pattern_draw.h"
 #include "ft2_module_loader.h"
 #include "ft2_sampling.h"
 #include "ft2_audioselector.h"
@@ -38,6 +39,11 @@
 #include "ft2_structs.h"
 #include "ft2_hpc.h"
 #include "ft2_smpfx.h"
+#include "ft2_sample_undo.h"
+#include "ft2_spectrogram.h"
+#include "ft2_jobs.h"
+#include "ft2_module_index.h"
+#include "ft2_autosave.h"
 
 static void initializeVars(void);
 static void cleanUpAndExit(void); // never call this inside the main loop
@@ -51,10 +57,11 @@ static void disableWasapi(void);
 
 int main(int argc, char *argv[])
 {
-#ifdef _WIN32 // test for SSE/SSE2 presence very first, to make sure no SSE/SSE2 code is attempted to be ran
+	// the SIMD sample scanning code checks these on all platforms
 	cpu.hasSSE = SDL_HasSSE();
 	cpu.hasSSE2 = SDL_HasSSE2();
 
+#ifdef _WIN32 // test for SSE/SSE2 presence very first, to make sure no SSE/SSE2 code is attempted to be ran
 	if (!cpu.hasSSE)
 	{
 		MessageBoxA(NULL, "Your computer's processor doesn't have the SSE instruction set " \
@@ -216,6 +223,9 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	initJobs(); // (if the workers can't be created, startJob() fails, and the callers handle that)
+	initSampleUndo(); // the undo steps are taken in the sample editor jobs too, this creates their lock
+
 	pauseAudio();
 	resumeAudio();
 	rescanAudioDevices();
@@ -242,7 +252,8 @@ int main(int argc, char *argv[])
 #endif
 
 	hpc_ResetCounters(&video.vblankHpc); // quirk: this is needed for potential okBox() calls in handleModuleLoadFromArg()
-	handleModuleLoadFromArg(argc, argv);
+	if (!checkAutosaveRecovery()) // a recovered song takes priority over the module given on the command line
+		handleModuleLoadFromArg(argc, argv);
 
 	editor.mainLoopOngoing = true;
 	hpc_ResetCounters(&video.vblankHpc); // this must be the last thing we do before entering the main loop
@@ -362,12 +373,18 @@ static void cleanUpAndExit(void) // never call this inside the main loop!
 #endif
 
 	closeAudio();
+	freeJobs(); // cancels the running jobs, and stops the job workers
+	freeAutosave(); // deletes the autosave journal, this was a normal exit
+	freeModuleIndex(); // saves the module index cache
+	freeSpectrogram(); // stops its thread, which reads sample data
 	closeReplayer();
 	closeVideo();
 	freeSprites();
+	freePattRowCache();
 	freeDiskOp();
 	clearCopyBuffer();
-	clearSampleUndo();
+	freeSamplePeaks();
+	freeSampleUndo();
 	freeAudioDeviceSelectorBuffers();
 	windUpFTHelp();
 	freeTextBoxes();
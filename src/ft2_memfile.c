@@ -0,0 +1,307 @@
+/* Memory files for the module loaders.
+**
+** The whole module is mapped into memory (or read in one go if mapping isn't
+** possible), so loading it is one sequential read instead of lots of small
+** fread()/fseek() calls. The loaders read from it through a bounds-checked
+** cursor that mimics stdio, which also lets them load from memory buffers.
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+#include "ft2_unicode.h"
+#include "ft2_memfile.h"
+
+#define MAX_MEMFILE_SIZE 0x7FFFFFFF /* the loaders use 32-bit positions */
+
+enum
+{
+	MEMFILE_BUFFER = 0, // not owned by us
+	MEMFILE_ALLOCATED = 1,
+	MEMFILE_MAPPED = 2
+};
+
+static MEMFILE *allocMemFile(const uint8_t *data, size_t size, uint8_t type)
+{
+	MEMFILE *f = (MEMFILE *)malloc(sizeof (MEMFILE));
+	if (f == NULL)
+		return NULL;
+
+	f->data = data;
+	f->size = size;
+	f->pos = 0;
+	f->type = type;
+	f->eof = false;
+
+	return f;
+}
+
+static MEMFILE *mapFile(UNICHAR *filenameU)
+{
+	static const uint8_t emptyData[1];
+
+#ifdef _WIN32
+	HANDLE hFile = CreateFileW(filenameU, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart > MAX_MEMFILE_SIZE)
+	{
+		CloseHandle(hFile);
+		return NULL;
+	}
+
+	if (fileSize.QuadPart == 0) // can't map empty files
+	{
+		CloseHandle(hFile);
+		return allocMemFile(emptyData, 0, MEMFILE_BUFFER);
+	}
+
+	HANDLE hMap = CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(hFile); // the mapping keeps its own reference
+	if (hMap == NULL)
+		return NULL;
+
+	const uint8_t *data = (const uint8_t *)MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(hMap); // the view keeps its own reference
+	if (data == NULL)
+		return NULL;
+
+	MEMFILE *f = allocMemFile(data, (size_t)fileSize.QuadPart, MEMFILE_MAPPED);
+	if (f == NULL)
+		UnmapViewOfFile(data);
+#else
+	const int fd = open(filenameU, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size > MAX_MEMFILE_SIZE)
+	{
+		close(fd);
+		return NULL;
+	}
+
+	if (st.st_size == 0) // can't map empty files
+	{
+		close(fd);
+		return allocMemFile(emptyData, 0, MEMFILE_BUFFER);
+	}
+
+	void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // the mapping keeps its own reference
+	if (data == MAP_FAILED)
+		return NULL;
+
+#ifdef MADV_SEQUENTIAL
+	madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+
+	MEMFILE *f = allocMemFile((const uint8_t *)data, (size_t)st.st_size, MEMFILE_MAPPED);
+	if (f == NULL)
+		munmap(data, (size_t)st.st_size);
+#endif
+
+	return f;
+}
+
+static MEMFILE *readFile(UNICHAR *filenameU)
+{
+	FILE *in = UNICHAR_FOPEN(filenameU, "rb");
+	if (in == NULL)
+		return NULL;
+
+	fseek(in, 0, SEEK_END);
+	const long fileSize = ftell(in);
+	rewind(in);
+
+	if (fileSize < 0 || fileSize > MAX_MEMFILE_SIZE)
+	{
+		fclose(in);
+		return NULL;
+	}
+
+	uint8_t *data = (uint8_t *)malloc(fileSize + 1); // +1 so that empty files work
+	if (data == NULL)
+	{
+		fclose(in);
+		return NULL;
+	}
+
+	if (fread(data, 1, fileSize, in) != (size_t)fileSize)
+	{
+		free(data);
+		fclose(in);
+		return NULL;
+	}
+
+	fclose(in);
+
+	MEMFILE *f = allocMemFile(data, (size_t)fileSize, MEMFILE_ALLOCATED);
+	if (f == NULL)
+		free(data);
+
+	return f;
+}
+
+MEMFILE *mopenFile(UNICHAR *filenameU)
+{
+	if (filenameU == NULL)
+		return NULL;
+
+	MEMFILE *f = mapFile(filenameU);
+	if (f == NULL)
+		f = readFile(filenameU); // not mappable (network drive, pipe etc.)
+
+	return f;
+}
+
+MEMFILE *mopen(const uint8_t *src, size_t length)
+{
+	if (src == NULL || length > MAX_MEMFILE_SIZE)
+		return NULL;
+
+	return allocMemFile(src, length, MEMFILE_BUFFER);
+}
+
+void mclose(MEMFILE **f)
+{
+	if (*f == NULL)
+		return;
+
+	MEMFILE *m = *f;
+	if (m->type == MEMFILE_ALLOCATED)
+	{
+		free((void *)m->data);
+	}
+	else if (m->type == MEMFILE_MAPPED)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m->data);
+#else
+		munmap((void *)m->data, m->size);
+#endif
+	}
+
+	free(m);
+	*f = NULL;
+}
+
+size_t mread(void *buffer, size_t size, size_t count, MEMFILE *f)
+{
+	if (f == NULL || buffer == NULL || size == 0 || count == 0)
+		return 0;
+
+	if (f->pos >= f->size)
+	{
+		f->eof = true;
+		return 0;
+	}
+
+	// like fread(), only whole elements are counted
+	size_t bytesLeft = f->size - f->pos;
+	size_t numElements = bytesLeft / size;
+	if (numElements > count)
+		numElements = count;
+
+	size_t numBytes = numElements * size;
+	if (numElements < count)
+	{
+		numBytes = bytesLeft; // the partial element is read too, just like fread()
+		f->eof = true;
+	}
+
+	memcpy(buffer, &f->data[f->pos], numBytes);
+	f->pos += numBytes;
+
+	return numElements;
+}
+
+int32_t mgetc(MEMFILE *f)
+{
+	if (f == NULL)
+		return EOF;
+
+	if (f->pos >= f->size)
+	{
+		f->eof = true;
+		return EOF;
+	}
+
+	return f->data[f->pos++];
+}
+
+int32_t mseek(MEMFILE *f, int64_t offset, int32_t whence)
+{
+	if (f == NULL)
+		return -1;
+
+	int64_t newPos;
+	switch (whence)
+	{
+		case SEEK_SET: newPos = offset; break;
+		case SEEK_CUR: newPos = (int64_t)f->pos + offset; break;
+		case SEEK_END: newPos = (int64_t)f->size + offset; break;
+		default: return -1;
+	}
+
+	if (newPos < 0)
+		return -1;
+
+	f->pos = (size_t)newPos;
+	f->eof = false;
+	return 0;
+}
+
+size_t mtell(MEMFILE *f)
+{
+	return (f == NULL) ? 0 : f->pos;
+}
+
+size_t msize(MEMFILE *f)
+{
+	return (f == NULL) ? 0 : f->size;
+}
+
+bool meof(MEMFILE *f)
+{
+	return (f == NULL) || f->eof;
+}
+
+void mrewind(MEMFILE *f)
+{
+	if (f != NULL)
+	{
+		f->pos = 0;
+		f->eof = false;
+	}
+}
+
+const uint8_t *mptr(MEMFILE *f, size_t numBytes)
+{
+	if (f == NULL || f->pos > f->size || numBytes > f->size-f->pos)
+		return NULL;
+
+	const uint8_t *p = &f->data[f->pos];
+	f->pos += numBytes;
+
+	return p;
+}
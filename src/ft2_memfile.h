@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "ft2_unicode.h"
+
+/* Read-only file in memory, with stdio-like functions for the module loaders.
+** The reads are bounds-checked, and behave like their stdio counterparts at the
+** end of the data (short reads, mgetc() returns EOF, meof() is set).
+*/
+
+typedef struct memFile_t
+{
+	const uint8_t *data;
+	size_t size, pos;
+	uint8_t type;
+	bool eof;
+} MEMFILE;
+
+MEMFILE *mopenFile(UNICHAR *filenameU); // maps the file if possible, or else reads it in one go
+MEMFILE *mopen(const uint8_t *src, size_t length); // src is not copied, and must stay valid until mclose()
+void mclose(MEMFILE **f);
+size_t mread(void *buffer, size_t size, size_t count, MEMFILE *f);
+int32_t mgetc(MEMFILE *f);
+int32_t mseek(MEMFILE *f, int64_t offset, int32_t whence); // seeking past the end is allowed (like fseek())
+size_t mtell(MEMFILE *f);
+size_t msize(MEMFILE *f);
+bool meof(MEMFILE *f); // like feof(), set by reading past the end and cleared by seeking
+void mrewind(MEMFILE *f);
+const uint8_t *mptr(MEMFILE *f, size_t numBytes); // the next numBytes without copying (and skips them), or NULL
@@ -17,6 +17,7 @@
 #include "ft2_audio.h"
 #include "ft2_mouse.h"
 #include "ft2_pattern_ed.h"
+#include "ft2_video.h"
 #include "ft2_structs.h"
 #include "rtmidi/rtmidi_c.h"
 
@@ -124,6 +125,8 @@ static void midiInCallback(double timeStamp, const unsigned char *message, size_
 
 	midi.callbackBusy = false;
 
+	wakeUpFromIdle(); // MIDI input doesn't generate SDL events
+
 	(void)timeStamp;
 	(void)userData;
 }
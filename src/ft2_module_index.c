@@ -0,0 +1,511 @@
+/* Module metadata index for the Disk Op. search.
+**
+** When a directory is listed in module mode, its files are indexed by
+** background jobs that only read the module headers (readModuleInfo()). The
+** results are cached in memory, keyed by path, modification time and size,
+** and the cache is saved next to FT2.CFG on exit. Revisited directories are
+** then indexed without opening the module files again.
+**
+** The info text of a module is a lowercase "format\nNch\ntitle\nnames" string
+** that Disk Op. searches in while typing.
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "ft2_header.h"
+#include "ft2_module_loader.h"
+#include "ft2_structs.h"
+#include "ft2_jobs.h"
+#include "ft2_module_index.h"
+
+#define INDEX_FILE_ID "FT2MIDX1"
+#define INDEX_HASH_SIZE 4096 /* must be a power of two */
+#define INDEX_MAX_ENTRIES 100000 /* the cache is cleared when this is reached */
+#define INDEX_MAX_TEXT_LEN (MODINFO_TITLE_LEN + MODINFO_NAMES_LEN + 16)
+#define INDEX_MAX_JOBS 2 /* leave job workers for the sample editor */
+#define INDEX_MIN_FILES_PER_JOB 256
+
+typedef struct indexEntry_t // the path and the info text follow the struct in the same allocation
+{
+	struct indexEntry_t *next;
+	int64_t mtime, size;
+	uint16_t pathLen, textLen; // textLen is 0 if the file is not a module
+	UNICHAR *pathU;
+	char *infoText;
+} indexEntry_t;
+
+typedef struct indexJob_t
+{
+	uint32_t generation;
+	int32_t firstFile, numFiles;
+	moduleIndexDoneFunc_t doneFunc;
+	UNICHAR *dirPathU, **filenamesU;
+	char **infoTexts;
+} indexJob_t;
+
+static bool cacheLoaded, cacheDirty; // protected by indexMutex
+static volatile uint32_t indexGeneration;
+static int32_t numEntries;
+static indexEntry_t *hashTable[INDEX_HASH_SIZE];
+static SDL_mutex *indexMutex;
+
+static uint32_t hashPath(const UNICHAR *pathU, uint32_t pathLen) // FNV-1a
+{
+	uint32_t hash = 2166136261UL;
+	for (uint32_t i = 0; i < pathLen; i++)
+	{
+		hash ^= (uint32_t)pathU[i];
+		hash *= 16777619UL;
+	}
+
+	return hash;
+}
+
+static indexEntry_t *findEntry(const UNICHAR *pathU, uint16_t pathLen) // call with indexMutex locked
+{
+	indexEntry_t *entry = hashTable[hashPath(pathU, pathLen) & (INDEX_HASH_SIZE-1)];
+	for (; entry != NULL; entry = entry->next)
+	{
+		if (entry->pathLen == pathLen && !memcmp(entry->pathU, pathU, pathLen * sizeof (UNICHAR)))
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void clearCache(void) // call with indexMutex locked
+{
+	for (int32_t i = 0; i < INDEX_HASH_SIZE; i++)
+	{
+		indexEntry_t *entry = hashTable[i];
+		while (entry != NULL)
+		{
+			indexEntry_t *next = entry->next;
+			free(entry);
+			entry = next;
+		}
+
+		hashTable[i] = NULL;
+	}
+
+	numEntries = 0;
+}
+
+static void removeEntry(const UNICHAR *pathU, uint16_t pathLen) // call with indexMutex locked
+{
+	indexEntry_t **link = &hashTable[hashPath(pathU, pathLen) & (INDEX_HASH_SIZE-1)];
+	for (; *link != NULL; link = &(*link)->next)
+	{
+		indexEntry_t *entry = *link;
+		if (entry->pathLen == pathLen && !memcmp(entry->pathU, pathU, pathLen * sizeof (UNICHAR)))
+		{
+			*link = entry->next;
+			free(entry);
+			numEntries--;
+			return;
+		}
+	}
+}
+
+// call with indexMutex locked, infoText can be NULL
+static bool addEntry(const UNICHAR *pathU, uint16_t pathLen, int64_t mtime, int64_t size, const char *infoText, uint16_t textLen)
+{
+	removeEntry(pathU, pathLen);
+	if (numEntries >= INDEX_MAX_ENTRIES)
+		clearCache(); // simpler than tracking the oldest entries
+
+	const size_t pathBytes = pathLen * sizeof (UNICHAR);
+
+	indexEntry_t *entry = (indexEntry_t *)malloc(sizeof (indexEntry_t) + pathBytes + textLen + 1);
+	if (entry == NULL)
+		return false;
+
+	entry->mtime = mtime;
+	entry->size = size;
+	entry->pathLen = pathLen;
+	entry->textLen = textLen;
+	entry->pathU = (UNICHAR *)&entry[1];
+	entry->infoText = (char *)entry->pathU + pathBytes;
+
+	memcpy(entry->pathU, pathU, pathBytes);
+	if (textLen > 0)
+		memcpy(entry->infoText, infoText, textLen);
+	entry->infoText[textLen] = '\0';
+
+	const uint32_t bucket = hashPath(pathU, pathLen) & (INDEX_HASH_SIZE-1);
+	entry->next = hashTable[bucket];
+	hashTable[bucket] = entry;
+	numEntries++;
+
+	return true;
+}
+
+static UNICHAR *getCachePathU(void) // kinda hackish
+{
+	int32_t indexDotDatStrLen, ft2DotCfgStrLen;
+
+	if (editor.configFileLocationU == NULL)
+		return NULL;
+
+	const int32_t ft2ConfPathLen = (int32_t)UNICHAR_STRLEN(editor.configFileLocationU);
+
+#ifdef _WIN32
+	indexDotDatStrLen = (int32_t)UNICHAR_STRLEN(L"modindex.dat");
+	ft2DotCfgStrLen = (int32_t)UNICHAR_STRLEN(L"FT2.CFG");
+#else
+	indexDotDatStrLen = (int32_t)UNICHAR_STRLEN("modindex.dat");
+	ft2DotCfgStrLen = (int32_t)UNICHAR_STRLEN("FT2.CFG");
+#endif
+
+	UNICHAR *filePathU = (UNICHAR *)malloc((ft2ConfPathLen + indexDotDatStrLen + 1) * sizeof (UNICHAR));
+	if (filePathU == NULL)
+		return NULL;
+
+	UNICHAR_STRCPY(filePathU, editor.configFileLocationU);
+	filePathU[ft2ConfPathLen-ft2DotCfgStrLen] = 0;
+
+#ifdef _WIN32
+	UNICHAR_STRCAT(filePathU, L"modindex.dat");
+#else
+	UNICHAR_STRCAT(filePathU, "modindex.dat");
+#endif
+
+	return filePathU;
+}
+
+/* Cache file format (native endian, it's not meant to be moved between computers):
+** char[8] ID, uint32_t sizeof (UNICHAR), int32_t numEntries, then for each entry:
+** uint16_t pathLen, uint16_t textLen, int64_t mtime, int64_t size, path (UNICHARs), info text
+*/
+
+static void loadCache(void) // call with indexMutex locked
+{
+	char ID[8];
+	uint16_t lengths[2];
+	int64_t stamp[2];
+	uint32_t charSize;
+	int32_t numFileEntries;
+	UNICHAR pathU[PATH_MAX+1];
+	char infoText[INDEX_MAX_TEXT_LEN+1];
+
+	cacheLoaded = true;
+
+	UNICHAR *cachePathU = getCachePathU();
+	if (cachePathU == NULL)
+		return;
+
+	FILE *f = UNICHAR_FOPEN(cachePathU, "rb");
+	free(cachePathU);
+
+	if (f == NULL)
+		return;
+
+	if (fread(ID, 1, 8, f) != 8 || memcmp(ID, INDEX_FILE_ID, 8) != 0 ||
+		fread(&charSize, 4, 1, f) != 1 || charSize != sizeof (UNICHAR) ||
+		fread(&numFileEntries, 4, 1, f) != 1 || numFileEntries < 0 || numFileEntries > INDEX_MAX_ENTRIES)
+	{
+		fclose(f);
+		return;
+	}
+
+	// on errors, keep what was read so far
+	for (int32_t i = 0; i < numFileEntries; i++)
+	{
+		if (fread(lengths, 2, 2, f) != 2 || fread(stamp, 8, 2, f) != 2)
+			break;
+
+		const uint16_t pathLen = lengths[0];
+		const uint16_t textLen = lengths[1];
+
+		if (pathLen == 0 || pathLen > PATH_MAX || textLen > INDEX_MAX_TEXT_LEN)
+			break;
+
+		if (fread(pathU, sizeof (UNICHAR), pathLen, f) != pathLen || fread(infoText, 1, textLen, f) != textLen)
+			break;
+
+		if (!addEntry(pathU, pathLen, stamp[0], stamp[1], infoText, textLen))
+			break;
+	}
+
+	fclose(f);
+}
+
+static void saveCache(void) // call with indexMutex locked
+{
+	UNICHAR *cachePathU = getCachePathU();
+	if (cachePathU == NULL)
+		return;
+
+	FILE *f = UNICHAR_FOPEN(cachePathU, "wb");
+	free(cachePathU);
+
+	if (f == NULL)
+		return;
+
+	const uint32_t charSize = sizeof (UNICHAR);
+
+	fwrite(INDEX_FILE_ID, 1, 8, f);
+	fwrite(&charSize, 4, 1, f);
+	fwrite(&numEntries, 4, 1, f);
+
+	for (int32_t i = 0; i < INDEX_HASH_SIZE; i++)
+	{
+		for (indexEntry_t *entry = hashTable[i]; entry != NULL; entry = entry->next)
+		{
+			const uint16_t lengths[2] = { entry->pathLen, entry->textLen };
+			const int64_t stamp[2] = { entry->mtime, entry->size };
+
+			fwrite(lengths, 2, 2, f);
+			fwrite(stamp, 8, 2, f);
+			fwrite(entry->pathU, sizeof (UNICHAR), entry->pathLen, f);
+			fwrite(entry->infoText, 1, entry->textLen, f);
+		}
+	}
+
+	fclose(f);
+	cacheDirty = false;
+}
+
+static bool getFileStamp(const UNICHAR *pathU, int64_t *mtime, int64_t *size)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_wstat64(pathU, &st) != 0 || !(st.st_mode & _S_IFREG))
+		return false;
+#else
+	struct stat st;
+	if (stat(pathU, &st) != 0 || !S_ISREG(st.st_mode))
+		return false;
+#endif
+
+	*mtime = (int64_t)st.st_mtime;
+	*size = (int64_t)st.st_size;
+	return true;
+}
+
+static char *makeInfoText(const moduleInfo_t *info)
+{
+	char *text = (char *)malloc(INDEX_MAX_TEXT_LEN+1);
+	if (text == NULL)
+		return NULL;
+
+	sprintf(text, "%s\n%dch\n%s\n%s", info->format, info->numChannels, info->title, info->instrNames);
+
+	for (char *p = text; *p != '\0'; p++)
+	{
+		if (*p >= 'A' && *p <= 'Z')
+			*p += 'a' - 'A';
+	}
+
+	return text;
+}
+
+static char *getInfoText(UNICHAR *pathU) // returns a malloc'd copy, NULL if the file is not a module
+{
+	int64_t mtime, size;
+
+	const size_t pathLen = UNICHAR_STRLEN(pathU);
+	if (pathLen == 0 || pathLen > PATH_MAX || !getFileStamp(pathU, &mtime, &size))
+		return NULL;
+
+	SDL_LockMutex(indexMutex);
+
+	if (!cacheLoaded)
+		loadCache();
+
+	const indexEntry_t *entry = findEntry(pathU, (uint16_t)pathLen);
+	if (entry != NULL && entry->mtime == mtime && entry->size == size)
+	{
+		char *text = (entry->textLen > 0) ? strdup(entry->infoText) : NULL;
+		SDL_UnlockMutex(indexMutex);
+		return text;
+	}
+
+	SDL_UnlockMutex(indexMutex);
+
+	// not in the cache (or the file was changed), read the module header
+
+	moduleInfo_t *info = (moduleInfo_t *)malloc(sizeof (moduleInfo_t));
+	if (info == NULL)
+		return NULL;
+
+	char *text = NULL;
+	if (readModuleInfo(pathU, info))
+	{
+		text = makeInfoText(info);
+		if (text == NULL)
+		{
+			free(info);
+			return NULL; // out of memory, don't cache this file as a non-module
+		}
+	}
+
+	free(info);
+
+	SDL_LockMutex(indexMutex);
+	if (addEntry(pathU, (uint16_t)pathLen, mtime, size, text, (text != NULL) ? (uint16_t)strlen(text) : 0))
+		cacheDirty = true;
+	SDL_UnlockMutex(indexMutex);
+
+	return text;
+}
+
+static void freeIndexJob(indexJob_t *data)
+{
+	for (int32_t i = 0; i < data->numFiles; i++)
+	{
+		if (data->filenamesU[i] != NULL) free(data->filenamesU[i]);
+		if (data->infoTexts[i] != NULL) free(data->infoTexts[i]);
+	}
+
+	free(data->filenamesU);
+	free(data->infoTexts);
+	free(data->dirPathU);
+	free(data);
+}
+
+static bool indexJob(job_t *job, void *ptr)
+{
+	UNICHAR pathU[PATH_MAX+1];
+	indexJob_t *data = (indexJob_t *)ptr;
+
+	const size_t dirPathLen = UNICHAR_STRLEN(data->dirPathU);
+	if (dirPathLen == 0 || dirPathLen >= PATH_MAX-1)
+		return false;
+
+	UNICHAR_STRCPY(pathU, data->dirPathU);
+
+	// the root dir already ends with a delimiter
+	size_t nameOffset = dirPathLen;
+	if (pathU[nameOffset-1] != DIR_DELIMITER)
+		pathU[nameOffset++] = DIR_DELIMITER;
+
+	for (int32_t i = 0; i < data->numFiles; i++)
+	{
+		if (jobCancelled(job) || data->generation != indexGeneration)
+			return false;
+
+		if (nameOffset+UNICHAR_STRLEN(data->filenamesU[i]) > PATH_MAX)
+			continue;
+
+		UNICHAR_STRCPY(&pathU[nameOffset], data->filenamesU[i]);
+		data->infoTexts[i] = getInfoText(pathU);
+	}
+
+	return true;
+}
+
+static void indexJobDone(void *ptr, int32_t result)
+{
+	indexJob_t *data = (indexJob_t *)ptr;
+
+	if (result == JOB_DONE && data->generation == indexGeneration)
+		data->doneFunc(data->firstFile, data->numFiles, data->infoTexts);
+
+	freeIndexJob(data);
+}
+
+static indexJob_t *createIndexJob(const UNICHAR *dirPathU, UNICHAR **filenamesU, int32_t firstFile, int32_t numFiles)
+{
+	indexJob_t *data = (indexJob_t *)calloc(1, sizeof (indexJob_t));
+	if (data == NULL)
+		return NULL;
+
+	data->generation = indexGeneration;
+	data->firstFile = firstFile;
+	data->numFiles = numFiles;
+	data->dirPathU = UNICHAR_STRDUP(dirPathU);
+	data->filenamesU = (UNICHAR **)calloc(numFiles, sizeof (UNICHAR *));
+	data->infoTexts = (char **)calloc(numFiles, sizeof (char *));
+
+	if (data->dirPathU == NULL || data->filenamesU == NULL || data->infoTexts == NULL)
+		goto error;
+
+	for (int32_t i = 0; i < numFiles; i++)
+	{
+		data->filenamesU[i] = UNICHAR_STRDUP(filenamesU[firstFile+i]);
+		if (data->filenamesU[i] == NULL)
+			goto error;
+	}
+
+	return data;
+
+error:
+	if (data->filenamesU == NULL || data->infoTexts == NULL)
+		data->numFiles = 0; // nothing to free in the arrays
+
+	freeIndexJob(data);
+	return NULL;
+}
+
+bool indexModules(const UNICHAR *dirPathU, UNICHAR **filenamesU, int32_t numFiles, moduleIndexDoneFunc_t doneFunc)
+{
+	cancelModuleIndexing();
+
+	if (dirPathU == NULL || numFiles <= 0)
+		return true;
+
+	if (indexMutex == NULL)
+	{
+		indexMutex = SDL_CreateMutex();
+		if (indexMutex == NULL)
+			return false;
+	}
+
+	int32_t filesPerJob = (numFiles + (INDEX_MAX_JOBS-1)) / INDEX_MAX_JOBS;
+	if (filesPerJob < INDEX_MIN_FILES_PER_JOB)
+		filesPerJob = INDEX_MIN_FILES_PER_JOB;
+
+	for (int32_t firstFile = 0; firstFile < numFiles; firstFile += filesPerJob)
+	{
+		indexJob_t *data = createIndexJob(dirPathU, filenamesU, firstFile, MIN(filesPerJob, numFiles-firstFile));
+		if (data == NULL)
+			return false;
+
+		data->doneFunc = doneFunc;
+		if (!startJob(indexJob, indexJobDone, data, JOB_BACKGROUND))
+		{
+			freeIndexJob(data);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void cancelModuleIndexing(void)
+{
+	indexGeneration++; // the running jobs stop, and their results are thrown away
+}
+
+void freeModuleIndex(void)
+{
+	cancelModuleIndexing();
+
+	if (indexMutex == NULL)
+		return;
+
+	SDL_LockMutex(indexMutex);
+
+	if (cacheDirty)
+		saveCache();
+
+	clearCache();
+
+	SDL_UnlockMutex(indexMutex);
+
+	// detached job workers can still be indexing (see freeJobs())
+	if (getNumJobs() == 0)
+	{
+		SDL_DestroyMutex(indexMutex);
+		indexMutex = NULL;
+	}
+}
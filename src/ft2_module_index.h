@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ft2_unicode.h"
+
+// called from the GUI thread for each indexed range of files, infoTexts[i] is NULL for non-modules
+typedef void (*moduleIndexDoneFunc_t)(int32_t firstFile, int32_t numFiles, char **infoTexts);
+
+/* Indexes the files (names only) in dirPathU in the background, cancels the previous indexing.
+** The strings are copied. The info texts are lowercase, and only valid during the callback.
+*/
+bool indexModules(const UNICHAR *dirPathU, UNICHAR **filenamesU, int32_t numFiles, moduleIndexDoneFunc_t doneFunc);
+void cancelModuleIndexing(void);
+void freeModuleIndex(void); // saves the cache
@@ -20,23 +20,36 @@
 #include "ft2_diskop.h"
 #include "ft2_sample_loader.h"
 #include "ft2_smpfx.h"
+#include "ft2_sample_undo.h"
 #include "ft2_mouse.h"
 #include "ft2_midi.h"
 #include "ft2_events.h"
 #include "ft2_video.h"
 #include "ft2_structs.h"
 #include "ft2_sysreqs.h"
-
-bool detectBEM(FILE *f);
-bool loadBEM(FILE *f, uint32_t filesize);
-
-bool loadIT(FILE *f, uint32_t filesize);
-bool loadDIGI(FILE *f, uint32_t filesize);
-bool loadMOD(FILE *f, uint32_t filesize);
-bool loadS3M(FILE *f, uint32_t filesize);
-bool loadSTK(FILE *f, uint32_t filesize);
-bool loadSTM(FILE *f, uint32_t filesize);
-bool loadXM(FILE *f, uint32_t filesize);
+#include "ft2_memfile.h"
+#include "ft2_jobs.h"
+#include "ft2_module_loader.h"
+
+bool detectBEM(MEMFILE *f);
+bool loadBEM(MEMFILE *f, uint32_t filesize);
+
+bool loadIT(MEMFILE *f, uint32_t filesize);
+bool loadDIGI(MEMFILE *f, uint32_t filesize);
+bool loadMOD(MEMFILE *f, uint32_t filesize);
+bool loadS3M(MEMFILE *f, uint32_t filesize);
+bool loadSTK(MEMFILE *f, uint32_t filesize);
+bool loadSTM(MEMFILE *f, uint32_t filesize);
+bool loadXM(MEMFILE *f, uint32_t filesize);
+
+bool getBEMInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info);
+bool getITInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info);
+bool getDIGIInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info);
+bool getMODInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info);
+bool getS3MInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info);
+bool getSTKInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info);
+bool getSTMInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info);
+bool getXMInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info);
 
 enum
 {
@@ -70,27 +83,32 @@ instr_t *instrTmp[1+256];
 song_t songTmp;
 // --------------------------
 
+#define SAMPLE_DECODE_MAX_JOBS 4
+#define SAMPLE_DECODE_CLOSED (1 << 30) /* no items can be taken while the loader is queueing */
+
 static volatile bool musicIsLoading, moduleLoaded, moduleFailedToLoad;
 static SDL_Thread *thread;
 static uint8_t oldPlayMode;
+static int32_t decodeNumItems, decodeQueueSize;
+static sampleDecode_t *decodeQueue;
+static SDL_atomic_t decodeNextItem = { SAMPLE_DECODE_CLOSED }, decodeItemsDone;
 static void setupLoadedModule(void);
+static void clearTmpModule(void);
 static void freeTmpModule(void);
 
 // Crude module detection routine. These aren't always accurate detections!
-static int8_t detectModule(FILE *f)
+static int8_t detectModule(MEMFILE *f)
 {
 	uint8_t D[256], I[4];
 
-	fseek(f, 0, SEEK_END);
-	uint32_t fileLength = (uint32_t)ftell(f);
-	rewind(f);
+	uint32_t fileLength = (uint32_t)msize(f);
 
 	memset(D, 0, sizeof (D));
-	fread(D, 1, sizeof (D), f);
-	fseek(f, 1080, SEEK_SET); // MOD ID
+	mread(D, 1, sizeof (D), f);
+	mseek(f, 1080, SEEK_SET); // MOD ID
 	I[0] = I[1] = I[2] = I[3] = 0;
-	fread(I, 1, 4, f);
-	rewind(f);
+	mread(I, 1, 4, f);
+	mrewind(f);
 
 	// BEM ("UN05", from XM only, MikMod)
 	if (detectBEM(f))
@@ -159,10 +177,10 @@ static int8_t detectModule(FILE *f)
 		return FORMAT_UNKNOWN;
 
 	// test STK numOrders+BPM for illegal values
-	fseek(f, 470, SEEK_SET);
+	mseek(f, 470, SEEK_SET);
 	D[0] = D[1] = 0;
-	fread(D, 1, 2, f);
-	rewind(f);
+	mread(D, 1, 2, f);
+	mrewind(f);
 
 	if (D[0] <= 128 && D[1] <= 220)
 		return FORMAT_POSSIBLY_STK;
@@ -170,30 +188,116 @@ static int8_t detectModule(FILE *f)
 	return FORMAT_UNKNOWN;
 }
 
-static bool doLoadMusic(bool externalThreadFlag)
+void queueSampleDecode(MEMFILE *f, sampleDecodeFunc_t func, sample_t *s, uint32_t srcLength, uint32_t param)
 {
-	// setup message box functions
-	loaderMsgBox = externalThreadFlag ? myLoaderMsgBoxThreadSafe : myLoaderMsgBox;
-	loaderSysReq = externalThreadFlag ? okBoxThreadSafe : okBox;
+	const size_t pos = mtell(f), size = msize(f);
+	const size_t bytesLeft = (pos < size) ? (size - pos) : 0;
 
-	if (editor.tmpFilenameU == NULL)
+	sampleDecode_t d;
+	d.func = func;
+	d.s = s;
+	d.srcLength = (srcLength > bytesLeft) ? (uint32_t)bytesLeft : srcLength;
+	d.src = mptr(f, d.srcLength);
+	d.param = param;
+
+	mseek(f, srcLength - d.srcLength, SEEK_CUR);
+
+	if (decodeNumItems >= decodeQueueSize)
 	{
-		loaderMsgBox("Generic memory fault during loading!");
-		goto loadError;
+		const int32_t newSize = (decodeQueueSize == 0) ? 256 : (decodeQueueSize * 2);
+
+		sampleDecode_t *newQueue = (sampleDecode_t *)realloc(decodeQueue, newSize * sizeof (sampleDecode_t));
+		if (newQueue == NULL)
+		{
+			func(&d, tmpBuffer); // decode it right away instead
+			return;
+		}
+
+		decodeQueue = newQueue;
+		decodeQueueSize = newSize;
 	}
 
-	FILE *f = UNICHAR_FOPEN(editor.tmpFilenameU, "rb");
-	if (f == NULL)
+	decodeQueue[decodeNumItems++] = d;
+}
+
+static void decodeSamples(uint8_t *scratch)
+{
+	// the queued samples are shared by the loader thread and the jobs, each takes the next one until they're all done
+	while (true)
 	{
-		loaderMsgBox("General I/O error during loading! Is the file in use? Does it exist?");
-		goto loadError;
+		const int32_t i = SDL_AtomicAdd(&decodeNextItem, 1);
+		if (i >= decodeNumItems)
+			break;
+
+		sampleDecode_t *d = &decodeQueue[i];
+		d->func(d, scratch);
+
+		SDL_AtomicAdd(&decodeItemsDone, 1);
 	}
+}
+
+static bool sampleDecodeJob(job_t *job, void *data)
+{
+	uint8_t *scratch = (uint8_t *)malloc(SAMPLE_DECODE_SCRATCH_LEN);
+	if (scratch == NULL)
+		return false; // the loader thread does the work instead
+
+	decodeSamples(scratch);
+
+	free(scratch);
+	return true;
+
+	(void)job;
+	(void)data;
+}
+
+static int32_t sampleDecodeCompare(const void *a, const void *b) // longest sample first
+{
+	const uint32_t len1 = ((const sampleDecode_t *)a)->srcLength;
+	const uint32_t len2 = ((const sampleDecode_t *)b)->srcLength;
+
+	return (len1 < len2) - (len1 > len2);
+}
 
+static void runQueuedSampleDecodes(void) // the file must still be open
+{
+	if (decodeNumItems == 0)
+		return;
+
+	// the longest samples are started first, so that the jobs end at about the same time
+	qsort(decodeQueue, decodeNumItems, sizeof (sampleDecode_t), sampleDecodeCompare);
+
+	SDL_AtomicSet(&decodeItemsDone, 0);
+	SDL_AtomicSet(&decodeNextItem, 0);
+
+	int32_t numJobs = SDL_GetCPUCount() - 1; // the loader thread is decoding too
+	numJobs = CLAMP(numJobs, 0, SAMPLE_DECODE_MAX_JOBS);
+	if (numJobs > decodeNumItems-1)
+		numJobs = decodeNumItems-1;
+
+	/* If a job can't be started (or starts late), the loader thread just decodes more samples.
+	** A job that starts after we're done finds no items left.
+	*/
+	for (int32_t i = 0; i < numJobs; i++)
+		startJob(sampleDecodeJob, NULL, NULL, JOB_BACKGROUND);
+
+	decodeSamples(tmpBuffer);
+
+	while (SDL_AtomicGet(&decodeItemsDone) < decodeNumItems)
+		SDL_Delay(1); // wait for the samples that the jobs are still decoding
+
+	SDL_AtomicSet(&decodeNextItem, SAMPLE_DECODE_CLOSED);
+	decodeNumItems = 0;
+}
+
+static bool loadModuleFromMemFile(MEMFILE *f) // loads into the temp module
+{
 	int8_t format = detectModule(f);
-	fseek(f, 0, SEEK_END);
-	uint32_t filesize = ftell(f);
+	uint32_t filesize = (uint32_t)msize(f);
 
-	rewind(f);
+	mrewind(f);
+
+	decodeNumItems = 0;
 
 	bool wasLoaded = false;
 	switch (format)
@@ -211,7 +315,55 @@ static bool doLoadMusic(bool externalThreadFlag)
 			loaderMsgBox("This file is not a supported module!");
 		break;
 	}
-	fclose(f);
+
+	if (wasLoaded)
+		runQueuedSampleDecodes(); // before the file is closed, the decoders read from it
+	decodeNumItems = 0;
+
+	return wasLoaded;
+}
+
+bool testLoadModule(const uint8_t *data, uint32_t dataLength)
+{
+	if (musicIsLoading)
+		return false; // the temp module is in use
+
+	MEMFILE *f = mopen(data, dataLength);
+	if (f == NULL)
+		return false;
+
+	loaderMsgBox = silentLoaderMsgBox;
+	loaderSysReq = silentLoaderSysReq;
+
+	clearTmpModule();
+	const bool wasLoaded = loadModuleFromMemFile(f);
+	mclose(&f);
+
+	freeTmpModule();
+	return wasLoaded;
+}
+
+static bool doLoadMusic(bool externalThreadFlag)
+{
+	// setup message box functions
+	loaderMsgBox = externalThreadFlag ? myLoaderMsgBoxThreadSafe : myLoaderMsgBox;
+	loaderSysReq = externalThreadFlag ? okBoxThreadSafe : okBox;
+
+	if (editor.tmpFilenameU == NULL)
+	{
+		loaderMsgBox("Generic memory fault during loading!");
+		goto loadError;
+	}
+
+	MEMFILE *f = mopenFile(editor.tmpFilenameU); // maps the whole file, so loading is one sequential read
+	if (f == NULL)
+	{
+		loaderMsgBox("General I/O error during loading! Is the file in use? Does it exist?");
+		goto loadError;
+	}
+
+	const bool wasLoaded = loadModuleFromMemFile(f);
+	mclose(&f);
 
 	if (!wasLoaded)
 		goto loadError;
@@ -225,6 +377,103 @@ loadError:
 	return false;
 }
 
+static void copyInfoString(char *dst, const char *src, int32_t maxLen) // dst must have room for maxLen+1 chars
+{
+	int32_t len = 0;
+	for (; len < maxLen; len++)
+	{
+		const char ch = src[len];
+		if (ch == '\0')
+			break;
+
+		dst[len] = ((uint8_t)ch < 32) ? ' ' : ch;
+	}
+
+	// trim trailing spaces
+	while (len > 0 && dst[len-1] == ' ')
+		len--;
+
+	dst[len] = '\0';
+}
+
+void setModuleInfoTitle(moduleInfo_t *info, const char *src, int32_t maxLen)
+{
+	copyInfoString(info->title, src, MIN(maxLen, MODINFO_TITLE_LEN));
+}
+
+void addModuleInfoName(moduleInfo_t *info, const char *src, int32_t maxLen)
+{
+	char name[32+1];
+
+	copyInfoString(name, src, MIN(maxLen, 32));
+	if (name[0] == '\0')
+		return;
+
+	const int32_t nameLen = (int32_t)strlen(name);
+	const int32_t oldLen = (int32_t)strlen(info->instrNames);
+
+	if (oldLen+1+nameLen+1 > MODINFO_NAMES_LEN)
+		return; // no room left
+
+	char *dst = &info->instrNames[oldLen];
+	if (oldLen > 0)
+		*dst++ = '\n';
+
+	strcpy(dst, name);
+}
+
+static bool getModuleInfo(MEMFILE *f, moduleInfo_t *info)
+{
+	memset(info, 0, sizeof (moduleInfo_t));
+
+	const int8_t format = detectModule(f);
+	const uint32_t filesize = (uint32_t)msize(f);
+
+	mrewind(f);
+	switch (format)
+	{
+		case FORMAT_XM: return getXMInfo(f, filesize, info);
+		case FORMAT_S3M: return getS3MInfo(f, filesize, info);
+		case FORMAT_STM: return getSTMInfo(f, filesize, info);
+		case FORMAT_MOD: return getMODInfo(f, filesize, info);
+		case FORMAT_POSSIBLY_STK: return getSTKInfo(f, filesize, info);
+		case FORMAT_DIGI: return getDIGIInfo(f, filesize, info);
+		case FORMAT_BEM: return getBEMInfo(f, filesize, info);
+		case FORMAT_IT: return getITInfo(f, filesize, info);
+		default: return false;
+	}
+}
+
+bool readModuleInfo(UNICHAR *filenameU, moduleInfo_t *info)
+{
+	MEMFILE *f = mopenFile(filenameU);
+	if (f == NULL)
+	{
+		memset(info, 0, sizeof (moduleInfo_t));
+		return false;
+	}
+
+	const bool isModule = getModuleInfo(f, info);
+	mclose(&f);
+
+	return isModule;
+}
+
+bool validateModule(const uint8_t *data, uint32_t dataLength, moduleInfo_t *info)
+{
+	MEMFILE *f = mopen(data, dataLength);
+	if (f == NULL)
+	{
+		memset(info, 0, sizeof (moduleInfo_t));
+		return false;
+	}
+
+	const bool isModule = getModuleInfo(f, info);
+	mclose(&f);
+
+	return isModule && !(info->warnings & MODINFO_WARN_CORRUPT);
+}
+
 static void clearTmpModule(void)
 {
 	memset(patternTmp, 0, sizeof (patternTmp));
@@ -289,6 +538,34 @@ static bool loadMusicUnthreaded(UNICHAR *filenameU)
 	return false;
 }
 
+bool loadMusicFromMemory(const uint8_t *data, uint32_t dataLength)
+{
+	if (musicIsLoading)
+		return false;
+
+	MEMFILE *f = mopen(data, dataLength);
+	if (f == NULL)
+		return false;
+
+	loaderMsgBox = myLoaderMsgBox;
+	loaderSysReq = okBox;
+
+	clearTmpModule(); // clear stuff from last loading session (very important)
+	editor.loadMusicEvent = EVENT_NONE;
+
+	const bool wasLoaded = loadModuleFromMemFile(f);
+	mclose(&f);
+
+	if (!wasLoaded)
+	{
+		freeTmpModule();
+		return false;
+	}
+
+	setupLoadedModule();
+	return true;
+}
+
 bool allocateTmpPatt(int32_t pattNum, uint16_t numRows)
 {
 	patternTmp[pattNum] = (note_t *)calloc((MAX_PATT_LEN * TRACK_WIDTH) + 16, 1);
@@ -599,12 +876,12 @@ bool handleModuleLoadFromArg(int argc, char **argv)
 
 static bool fileIsModule(UNICHAR *pathU)
 {
-	FILE *f = UNICHAR_FOPEN(pathU, "rb");
+	MEMFILE *f = mopenFile(pathU);
 	if (f == NULL)
 		return false;
 
 	int8_t modFormat = detectModule(f);
-	fclose(f);
+	mclose(&f);
 
 	/* If the module was not identified (possibly STK type),
 	** check the file extension and handle it as a module only
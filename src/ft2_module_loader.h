@@ -4,16 +4,78 @@
 #include <stdbool.h>
 #include "ft2_header.h"
 #include "ft2_unicode.h"
+#include "ft2_memfile.h"
+
+#define MODINFO_TITLE_LEN 28 /* longest song name (S3M) */
+#define MODINFO_NAMES_LEN 2048
+
+// moduleInfo_t warning flags
+enum
+{
+	MODINFO_WARN_CORRUPT = 1, // broken header values, the loader will reject the module
+	MODINFO_WARN_TRUNCATED = 2, // pattern or sample data is missing at the end of the file
+	MODINFO_WARN_CHANNELS = 4, // more than 32 channels (the extra channels are discarded)
+	MODINFO_WARN_INSTRS = 8, // more than 128 instruments (the extra instruments are discarded)
+	MODINFO_WARN_SAMPLES = 16 // instrument(s) with more than 16 samples (the extra samples are discarded)
+};
+
+typedef struct moduleInfo_t // module header data, for the Disk Op. module index and validateModule()
+{
+	char format[4+1], title[MODINFO_TITLE_LEN+1];
+	uint8_t numChannels;
+	uint16_t numInstrs, songLength, numPatterns;
+	uint32_t sampleDataBytes; // the size of the sample data after loading (0 if not known)
+	uint32_t warnings; // MODINFO_WARN_* flags
+	char instrNames[MODINFO_NAMES_LEN]; // the non-empty instrument/sample names, separated by '\n'
+} moduleInfo_t;
+
+#define SAMPLE_DECODE_SCRATCH_LEN 65536
+
+typedef struct sampleDecode_t sampleDecode_t;
+typedef void (*sampleDecodeFunc_t)(sampleDecode_t *d, uint8_t *scratch); // scratch is SAMPLE_DECODE_SCRATCH_LEN bytes
+
+struct sampleDecode_t
+{
+	sampleDecodeFunc_t func;
+	sample_t *s; // the sample data is already allocated
+	const uint8_t *src; // points into the module file
+	uint32_t srcLength, param;
+};
 
 bool tmpPatternEmpty(int32_t pattNum);
 void clearUnusedChannels(note_t *p, int16_t numRows, int32_t numChannels);
 bool allocateTmpInstr(int32_t insNum);
 bool allocateTmpPatt(int32_t pattNum, uint16_t numRows);
 void loadMusic(UNICHAR *filenameU);
+bool loadMusicFromMemory(const uint8_t *data, uint32_t dataLength); // GUI thread only, not threaded
 bool handleModuleLoadFromArg(int argc, char **argv);
 void loadDroppedFile(char *fullPathUTF8);
 void handleLoadMusicEvents(void);
 
+/* Runs the module loaders on a memory buffer without any GUI (the messages are dropped),
+** and frees the loaded module again. For testing the loaders with malformed files.
+*/
+bool testLoadModule(const uint8_t *data, uint32_t dataLength);
+
+// reads only the headers, false if the file is not a supported module (thread-safe)
+bool readModuleInfo(UNICHAR *filenameU, moduleInfo_t *info);
+
+/* Checks if a module in memory looks loadable, by reading only the headers (no message boxes, no
+** allocations, and thread-safe). Returns false if it's not a supported module or if the headers
+** are broken. The warnings in info tell what the loader would have to fix or discard.
+*/
+bool validateModule(const uint8_t *data, uint32_t dataLength, moduleInfo_t *info);
+
+/* For the module loaders. The sample data at the current file position (srcLength bytes,
+** clamped to the end of the file) is decoded by func after the loader is done, in parallel
+** with the other queued samples. The file position is moved past the data.
+*/
+void queueSampleDecode(MEMFILE *f, sampleDecodeFunc_t func, sample_t *s, uint32_t srcLength, uint32_t param);
+
+// for the module loaders' header info functions
+void setModuleInfoTitle(moduleInfo_t *info, const char *src, int32_t maxLen);
+void addModuleInfoName(moduleInfo_t *info, const char *src, int32_t maxLen);
+
 // file extensions accepted by Disk Op. in module mode
 extern char *supportedModExtensions[];
 
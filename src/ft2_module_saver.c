@@ -4,7 +4,13 @@
 #endif
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdbool.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 #include "ft2_header.h"
 #include "ft2_audio.h"
 #include "ft2_gui.h"
@@ -13,9 +19,31 @@
 #include "ft2_module_loader.h"
 #include "ft2_tables.h"
 #include "ft2_structs.h"
+#include "ft2_jobs.h"
+#include "ft2_config.h"
+#include "ft2_sample_pack.h"
+#include "ft2_module_saver.h"
+
+#define XM_SAVE_MAX_JOBS 4
+#define XM_SAVE_CLOSED (1 << 30) /* no items can be taken while the saver is queueing */
+#define XM_SAVE_SCRATCH_LEN MAX(XM_ENCODE_SCRATCH_LEN, IT_PACK_SCRATCH_LEN)
 
-static int8_t smpChunkBuf[1024];
-static uint8_t packedPattData[65536], modPattData[64*32*4];
+typedef struct xmSaveItem_t // a pattern to pack or a sample to encode, done in parallel
+{
+	int16_t pattNum; // -1 for samples
+	const sample_t *smp;
+	xmSmpHdr_t *smpHdr; // for marking packed samples
+	uint8_t *dst;
+	uint32_t maxLength, length;
+} xmSaveItem_t;
+
+static bool xmSavePackSamples;
+static int8_t smpChunkBuf[1024], xmSaveScratch[XM_SAVE_SCRATCH_LEN];
+static int16_t smpChunkBuf16[1024];
+static uint8_t modPattData[64*32*4], xmPattData[MAX_PATT_LEN * TRACK_WIDTH];
+static int32_t xmSaveNumItems;
+static xmSaveItem_t xmSaveItems[MAX_PATTERNS + (MAX_INST * MAX_SMP_PER_INST)];
+static SDL_atomic_t xmSaveNextItem = { XM_SAVE_CLOSED }, xmSaveItemsDone;
 static SDL_Thread *thread;
 
 static const char modIDs[32][5] =
@@ -26,55 +54,264 @@ static const char modIDs[32][5] =
 	"25CH", "26CH", "27CH", "28CH", "29CH", "30CH", "31CH", "32CH"
 };
 
-static uint16_t packPatt(uint8_t *writePtr, uint8_t *pattPtr, uint16_t numRows);
+// delta encodes the next XM_ENCODE_CHUNK_LEN samples (at most) into scratch, returns the number of bytes
+int32_t encodeXMSampleChunk(const sample_t *s, int32_t pos, int8_t *scratch, int16_t *oldSmp)
+{
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	const int32_t length = MIN(s->length - pos, (int32_t)XM_ENCODE_CHUNK_LEN);
 
-bool saveXM(UNICHAR *filenameU)
+	// the mixer may be playing the sample, so we delta encode an unfixed copy of it
+	copyUnfixedSmpData(s, scratch, pos, length);
+
+	if (sample16Bit)
+	{
+		int16_t *ptr16 = (int16_t *)scratch;
+		for (int32_t i = 0; i < length; i++)
+		{
+			const int16_t smp16 = ptr16[i];
+			ptr16[i] -= *oldSmp;
+			*oldSmp = smp16;
+		}
+	}
+	else // 8-bit
+	{
+		for (int32_t i = 0; i < length; i++)
+		{
+			const int8_t smp8 = scratch[i];
+			scratch[i] -= (int8_t)*oldSmp;
+			*oldSmp = smp8;
+		}
+	}
+
+	return length << sample16Bit;
+}
+
+void encodeXMSampleData(const sample_t *s, uint8_t *dst, int8_t *scratch)
 {
-	int16_t i, j, k, a;
-	size_t result;
-	xmHdr_t h;
-	xmPatHdr_t ph;
-	instr_t *ins;
-	xmInsHdr_t ih;
-	sample_t *s;
-	xmSmpHdr_t *dst;
+	int16_t oldSmp = 0;
+	for (int32_t pos = 0; pos < s->length; pos += XM_ENCODE_CHUNK_LEN)
+	{
+		const int32_t bytes = encodeXMSampleChunk(s, pos, scratch, &oldSmp);
+		memcpy(dst, scratch, bytes);
+		dst += bytes;
+	}
+}
 
-	FILE *f = UNICHAR_FOPEN(filenameU, "wb");
+static void encodeXMSaveSample(xmSaveItem_t *item, int8_t *scratch)
+{
+	const sample_t *s = item->smp;
+	const uint32_t sampleBytes = SAMPLE_LENGTH_BYTES(s);
+
+	if (xmSavePackSamples)
+	{
+		// the unpacked length comes first, then the packed blocks (see ft2_sample_pack.h)
+		bool deltaEncoded;
+		const uint32_t packedLength = 4 + packITSampleData(s, item->dst + 4, (uint8_t *)scratch, &deltaEncoded);
+		if (packedLength < sampleBytes)
+		{
+			memcpy(item->dst, &sampleBytes, 4);
+
+			item->smpHdr->nameLength = deltaEncoded ? XM_SMP_IT215_PACKED : XM_SMP_IT214_PACKED;
+			item->smpHdr->length = packedLength;
+			item->length = packedLength;
+			return;
+		}
+
+		// (noise doesn't pack, it's stored as usual then)
+	}
+
+	encodeXMSampleData(s, item->dst, scratch);
+	item->length = sampleBytes;
+}
+
+static uint32_t getXMSaveSampleRoom(const sample_t *s) // packed samples can be a bit bigger than unpacked ones
+{
+	return xmSavePackSamples ? 4 + IT_PACK_MAX_LEN(SAMPLE_LENGTH_BYTES(s)) : SAMPLE_LENGTH_BYTES(s);
+}
+
+static void doXMSaveItems(int8_t *scratch)
+{
+	// the items are shared by the saving thread and the jobs, each takes the next one until they're all done
+	while (true)
+	{
+		const int32_t i = SDL_AtomicAdd(&xmSaveNextItem, 1);
+		if (i >= xmSaveNumItems)
+			break;
+
+		xmSaveItem_t *item = &xmSaveItems[i];
+		if (item->pattNum >= 0)
+			item->length = packPatt(item->dst, (const uint8_t *)pattern[item->pattNum], patternNumRows[item->pattNum], song.numChannels);
+		else
+			encodeXMSaveSample(item, scratch);
+
+		SDL_AtomicAdd(&xmSaveItemsDone, 1);
+	}
+}
+
+static bool xmSaveJob(job_t *job, void *data)
+{
+	int8_t *scratch = (int8_t *)malloc(xmSavePackSamples ? XM_SAVE_SCRATCH_LEN : XM_ENCODE_SCRATCH_LEN);
+	if (scratch == NULL)
+		return false; // the saving thread does the work instead
+
+	doXMSaveItems(scratch);
+
+	free(scratch);
+	return true;
+
+	(void)job;
+	(void)data;
+}
+
+static void runXMSaveItems(void)
+{
+	if (xmSaveNumItems == 0)
+		return;
+
+	SDL_AtomicSet(&xmSaveItemsDone, 0);
+	SDL_AtomicSet(&xmSaveNextItem, 0);
+
+	int32_t numJobs = SDL_GetCPUCount() - 1; // the saving thread is working too
+	numJobs = CLAMP(numJobs, 0, XM_SAVE_MAX_JOBS);
+	if (numJobs > xmSaveNumItems-1)
+		numJobs = xmSaveNumItems-1;
+
+	// if a job can't be started (or starts late), the saving thread just does more of the work
+	for (int32_t i = 0; i < numJobs; i++)
+		startJob(xmSaveJob, NULL, NULL, JOB_BACKGROUND);
+
+	doXMSaveItems(xmSaveScratch);
+
+	while (SDL_AtomicGet(&xmSaveItemsDone) < xmSaveNumItems)
+		SDL_Delay(1); // wait for the items that the jobs are still working on
+
+	SDL_AtomicSet(&xmSaveNextItem, XM_SAVE_CLOSED);
+	xmSaveNumItems = 0;
+}
+
+static void freeEmptyPatterns(int32_t numPatterns) // FT2 does this when saving
+{
+	bool audioWasntLocked = false;
+	for (int32_t i = 0; i < numPatterns; i++)
+	{
+		if (!patternEmpty((uint16_t)i) || (pattern[i] == NULL && patternNumRows[i] == 64))
+			continue;
+
+		// the replayer may be reading the pattern, so lock the audio while changing it
+		if (!audio.locked)
+		{
+			lockAudio();
+			audioWasntLocked = true;
+		}
+
+		if (pattern[i] != NULL)
+		{
+			free(pattern[i]);
+			pattern[i] = NULL;
+		}
+
+		patternNumRows[i] = 64;
+	}
+
+	if (audioWasntLocked)
+		unlockAudio();
+}
+
+/* Writes the file under a temporary name first, and then replaces the old file with it.
+** The old file is still intact if we crash or run out of disk space while saving.
+*/
+static bool writeFileSafely(UNICHAR *filenameU, const uint8_t *data1, size_t length1, const uint8_t *data2, size_t length2)
+{
+	UNICHAR *tmpFilenameU = (UNICHAR *)malloc((UNICHAR_STRLEN(filenameU) + 4 + 1) * sizeof (UNICHAR));
+	if (tmpFilenameU == NULL)
+	{
+		okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
+		return false;
+	}
+
+	UNICHAR_STRCPY(tmpFilenameU, filenameU);
+#ifdef _WIN32
+	UNICHAR_STRCAT(tmpFilenameU, L".tmp");
+#else
+	UNICHAR_STRCAT(tmpFilenameU, ".tmp");
+#endif
+
+	FILE *f = UNICHAR_FOPEN(tmpFilenameU, "wb");
 	if (f == NULL)
 	{
+		free(tmpFilenameU);
 		okBoxThreadSafe(0, "System message", "Error opening file for saving, is it in use?", NULL);
 		return false;
 	}
 
-	memcpy(h.ID, "Extended Module: ", 17);
+	bool writeOK = fwrite(data1, 1, length1, f) == length1 && fwrite(data2, 1, length2, f) == length2;
+
+	// make sure that the data is on the disk before the old file is replaced
+	if (writeOK && fflush(f) != 0)
+		writeOK = false;
+#ifdef _WIN32
+	if (writeOK && _commit(_fileno(f)) != 0)
+		writeOK = false;
+#else
+	if (writeOK && fsync(fileno(f)) != 0)
+		writeOK = false;
+#endif
+
+	if (fclose(f) != 0)
+		writeOK = false;
+
+	if (writeOK)
+	{
+#ifdef _WIN32
+		writeOK = MoveFileExW(tmpFilenameU, filenameU, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		writeOK = UNICHAR_RENAME(tmpFilenameU, filenameU) == 0; // atomic
+#endif
+	}
+
+	if (!writeOK)
+	{
+		UNICHAR_REMOVE(tmpFilenameU);
+		okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
+	}
+
+	free(tmpFilenameU);
+	return writeOK;
+}
+
+void setupXMHeader(xmHdr_t *h)
+{
+	int16_t i;
+
+	memcpy(h->ID, "Extended Module: ", 17);
 
 	// song name
 	int32_t nameLength = (int32_t)strlen(song.name);
 	if (nameLength > 20)
 		nameLength = 20;
 
-	memset(h.name, ' ', 20); // yes, FT2 pads the name with spaces
+	memset(h->name, ' ', 20); // yes, FT2 pads the name with spaces
 	if (nameLength > 0)
-		memcpy(h.name, song.name, nameLength);
+		memcpy(h->name, song.name, nameLength);
 
-	h.x1A = 0x1A;
+	h->x1A = 0x1A;
 
 	// program/tracker name
 	nameLength = (int32_t)strlen(PROG_NAME_STR);
 	if (nameLength > 20)
 		nameLength = 20;
 
-	memset(h.progName, ' ', 20); // yes, FT2 pads the name with spaces
+	memset(h->progName, ' ', 20); // yes, FT2 pads the name with spaces
 	if (nameLength > 0)
-		memcpy(h.progName, PROG_NAME_STR, nameLength);
+		memcpy(h->progName, PROG_NAME_STR, nameLength);
 
-	h.version = 0x0104;
-	h.headerSize = 20 + 256;
-	h.numOrders = song.songLength;
-	h.songLoopStart = song.songLoopStart;
-	h.numChannels = (uint16_t)song.numChannels;
-	h.speed = song.speed;
-	h.BPM = song.BPM;
+	h->version = 0x0104;
+	h->headerSize = 20 + 256;
+	h->numOrders = song.songLength;
+	h->songLoopStart = song.songLoopStart;
+	h->numChannels = (uint16_t)song.numChannels;
+	h->speed = song.speed;
+	h->BPM = song.BPM;
 
 	// count number of patterns
 	i = MAX_PATTERNS;
@@ -86,195 +323,364 @@ bool saveXM(UNICHAR *filenameU)
 			break;
 	}
 	while (i > 0);
-	h.numPatterns = i;
+	h->numPatterns = i;
 
 	// count number of instruments
 	i = 128;
 	while (i > 0 && getUsedSamples(i) == 0 && song.instrName[i][0] == '\0')
 		i--;
-	h.numInstr = i;
+	h->numInstr = i;
+
+	h->flags = audio.linearPeriodsFlag;
+	memcpy(h->orders, song.orders, 256);
+}
+
+int32_t setupXMInstrHeader(xmInsHdr_t *ih, const instr_t *ins, const char *name, int16_t numSamples)
+{
+	memset(ih, 0, sizeof (xmInsHdr_t)); // important, clears reserved stuff
 
-	h.flags = audio.linearPeriodsFlag;
-	memcpy(h.orders, song.orders, 256);
+	int32_t nameLength = (int32_t)strlen(name);
+	if (nameLength > 22)
+		nameLength = 22;
 
-	if (fwrite(&h, sizeof (h), 1, f) != 1)
+	memset(ih->name, 0, 22); // pad with zero
+	if (nameLength > 0)
+		memcpy(ih->name, name, nameLength);
+
+	ih->type = 0;
+	ih->numSamples = numSamples;
+	ih->sampleSize = sizeof (xmSmpHdr_t);
+
+	if (numSamples > 0)
 	{
-		fclose(f);
-		okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
+		memcpy(ih->note2SampleLUT, ins->note2SampleLUT, 96);
+		memcpy(ih->volEnvPoints, ins->volEnvPoints, 12*2*sizeof(int16_t));
+		memcpy(ih->panEnvPoints, ins->panEnvPoints, 12*2*sizeof(int16_t));
+		ih->volEnvLength = ins->volEnvLength;
+		ih->panEnvLength = ins->panEnvLength;
+		ih->volEnvSustain = ins->volEnvSustain;
+		ih->volEnvLoopStart = ins->volEnvLoopStart;
+		ih->volEnvLoopEnd = ins->volEnvLoopEnd;
+		ih->panEnvSustain = ins->panEnvSustain;
+		ih->panEnvLoopStart = ins->panEnvLoopStart;
+		ih->panEnvLoopEnd = ins->panEnvLoopEnd;
+		ih->volEnvFlags = ins->volEnvFlags;
+		ih->panEnvFlags = ins->panEnvFlags;
+		ih->vibType = ins->autoVibType;
+		ih->vibSweep = ins->autoVibSweep;
+		ih->vibDepth = ins->autoVibDepth;
+		ih->vibRate = ins->autoVibRate;
+		ih->fadeout = ins->fadeout;
+		ih->midiOn = ins->midiOn ? 1 : 0;
+		ih->midiChannel = ins->midiChannel;
+		ih->midiProgram = ins->midiProgram;
+		ih->midiBend = ins->midiBend;
+		ih->mute = ins->mute ? 1 : 0;
+		ih->instrSize = INSTR_HEADER_SIZE;
+		
+		for (int32_t i = 0; i < numSamples; i++)
+		{
+			const sample_t *s = &ins->smp[i];
+			xmSmpHdr_t *dst = &ih->smp[i];
+
+			bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+			dst->length = s->length;
+			dst->loopStart = s->loopStart;
+			dst->loopLength = s->loopLength;
+
+			if (sample16Bit)
+			{
+				dst->length <<= 1;
+				dst->loopStart <<= 1;
+				dst->loopLength <<= 1;
+			}
+
+			dst->volume = s->volume;
+			dst->finetune = s->finetune;
+			dst->flags = s->flags;
+			dst->panning = s->panning;
+			dst->relativeNote = s->relativeNote;
+
+			nameLength = (int32_t)strlen(s->name);
+			if (nameLength > 22)
+				nameLength = 22;
+
+			dst->nameLength = (uint8_t)nameLength;
+
+			memset(dst->name, ' ', 22); // yes, FT2 pads the name with spaces
+			if (nameLength > 0)
+				memcpy(dst->name, s->name, nameLength);
+
+			if (s->dataPtr == NULL)
+				dst->length = 0;
+		}
+	}
+	else
+	{
+		ih->instrSize = 22 + 11;
+	}
+
+	return ih->instrSize + (numSamples * sizeof (xmSmpHdr_t));
+}
+
+/* The song is only read (except for the empty patterns that are freed), so the audio doesn't
+** have to be paused. The file is built in two buffers, and the patterns are packed and the
+** samples delta encoded (or packed) in parallel.
+*/
+static bool doSaveXM(UNICHAR *filenameU)
+{
+	int16_t i, k, a;
+	xmHdr_t h;
+	xmPatHdr_t ph;
+	xmInsHdr_t ih;
+	sample_t *s;
+
+	setupXMHeader(&h);
+
+	freeEmptyPatterns(h.numPatterns);
+
+	xmSavePackSamples = !!(config.specialFlags2 & PACK_XM_SAMPLES);
+
+	// the header and patterns go into one buffer, with room for the unpacked size of each pattern
+	const int32_t maxPackedRowBytes = song.numChannels * sizeof (note_t);
+
+	size_t pattBufLength = sizeof (h);
+	for (i = 0; i < h.numPatterns; i++)
+		pattBufLength += sizeof (xmPatHdr_t) + (patternNumRows[i] * maxPackedRowBytes);
+
+	// the instruments and their sample data go into another one
+	uint64_t instrBufLength = 0;
+	for (i = 1; i <= h.numInstr; i++)
+	{
+		a = getUsedSamples(i);
+		if (a == 0)
+		{
+			instrBufLength += 22 + 11;
+			continue;
+		}
+
+		instrBufLength += INSTR_HEADER_SIZE + (a * sizeof (xmSmpHdr_t));
+		for (k = 0; k < a; k++)
+		{
+			s = &instr[i]->smp[k];
+			if (s->dataPtr != NULL)
+				instrBufLength += getXMSaveSampleRoom(s);
+		}
+	}
+
+	uint8_t *pattBuf = (uint8_t *)malloc(pattBufLength);
+	uint8_t *instrBuf = (instrBufLength < SIZE_MAX) ? (uint8_t *)malloc((size_t)instrBufLength + 1) : NULL; // +1 in case it's empty
+	if (pattBuf == NULL || instrBuf == NULL)
+	{
+		if (pattBuf != NULL) free(pattBuf);
+		if (instrBuf != NULL) free(instrBuf);
+
+		okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
 		return false;
 	}
 
+	xmSaveNumItems = 0;
+
+	// queue the patterns for packing, each gets its own room in the buffer
+	uint8_t *writePtr = pattBuf + sizeof (h) + sizeof (xmPatHdr_t);
 	for (i = 0; i < h.numPatterns; i++)
 	{
-		if (patternEmpty(i))
+		if (pattern[i] != NULL)
 		{
-			if (pattern[i] != NULL)
-			{
-				free(pattern[i]);
-				pattern[i] = NULL;
-			}
+			xmSaveItem_t *item = &xmSaveItems[xmSaveNumItems++];
 
-			patternNumRows[i] = 64;
+			item->pattNum = i;
+			item->dst = writePtr;
 		}
 
-		ph.headerSize = sizeof (xmPatHdr_t);
-		ph.numRows = patternNumRows[i];
-		ph.type = 0;
+		writePtr += sizeof (xmPatHdr_t) + (patternNumRows[i] * maxPackedRowBytes);
+	}
 
-		if (pattern[i] == NULL)
+	const int32_t numPattItems = xmSaveNumItems;
+
+	// write the instrument headers, and queue the sample data for encoding
+	writePtr = instrBuf;
+	for (i = 1; i <= h.numInstr; i++)
+	{
+		a = getUsedSamples(i); // (zero if the instrument is not allocated)
+
+		const int32_t instrHeaderBytes = setupXMInstrHeader(&ih, instr[i], song.instrName[i], a);
+		memcpy(writePtr, &ih, instrHeaderBytes);
+
+		xmSmpHdr_t *smpHdr = (xmSmpHdr_t *)(writePtr + offsetof(xmInsHdr_t, smp));
+		writePtr += instrHeaderBytes;
+
+		for (k = 0; k < a; k++)
 		{
-			ph.dataSize = 0;
-			if (fwrite(&ph, ph.headerSize, 1, f) != 1)
+			s = &instr[i]->smp[k];
+			if (s->dataPtr != NULL)
 			{
-				fclose(f);
-				okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
-				return false;
+				xmSaveItem_t *item = &xmSaveItems[xmSaveNumItems++];
+
+				item->pattNum = -1;
+				item->smp = s;
+				item->smpHdr = &smpHdr[k];
+				item->dst = writePtr;
+				item->maxLength = getXMSaveSampleRoom(s);
+
+				writePtr += item->maxLength;
 			}
 		}
-		else
+	}
+
+	const int32_t numItems = xmSaveNumItems;
+	runXMSaveItems();
+
+	if (xmSavePackSamples) // move the packed sample data down, so that there are no gaps
+	{
+		uint8_t *readPtr = instrBuf;
+		uint8_t *instrBufEnd = writePtr;
+		bool samplesPacked = false;
+
+		writePtr = instrBuf;
+		for (int32_t j = numPattItems; j < numItems; j++)
 		{
-			ph.dataSize = packPatt(packedPattData, (uint8_t *)pattern[i], patternNumRows[i]);
+			const xmSaveItem_t *item = &xmSaveItems[j];
+			if (item->smpHdr->nameLength == XM_SMP_IT214_PACKED || item->smpHdr->nameLength == XM_SMP_IT215_PACKED)
+				samplesPacked = true;
 
-			result = fwrite(&ph, ph.headerSize, 1, f);
-			result += fwrite(packedPattData, ph.dataSize, 1, f);
+			const size_t headerBytes = item->dst - readPtr; // the instrument/sample headers before the data
+			memmove(writePtr, readPtr, headerBytes);
+			writePtr += headerBytes;
 
-			if (result != 2) // write was not OK
-			{
-				fclose(f);
-				okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
-				return false;
-			}
+			memmove(writePtr, item->dst, item->length);
+			writePtr += item->length;
+
+			readPtr = item->dst + item->maxLength;
+		}
+
+		memmove(writePtr, readPtr, instrBufEnd - readPtr);
+		writePtr += instrBufEnd - readPtr;
+
+		instrBufLength = writePtr - instrBuf;
+
+		if (samplesPacked) // our loader only looks for packed samples in files with this tracker name
+		{
+			memset(h.progName, ' ', sizeof (h.progName));
+			memcpy(h.progName, XM_PACKED_PROG_NAME, sizeof (XM_PACKED_PROG_NAME) - 1);
 		}
 	}
 
-	memset(&ih, 0, sizeof (ih)); // important, clears reserved stuff
+	// move the packed patterns down after their headers, so that there are no gaps
+	memcpy(pattBuf, &h, sizeof (h));
+	writePtr = pattBuf + sizeof (h);
 
-	for (i = 1; i <= h.numInstr; i++)
+	int32_t itemNum = 0;
+	for (i = 0; i < h.numPatterns; i++)
 	{
-		if (instr[i] == NULL)
-			j = 0;
-		else
-			j = i;
+		ph.headerSize = sizeof (xmPatHdr_t);
+		ph.numRows = patternNumRows[i];
+		ph.type = 0;
+		ph.dataSize = 0;
 
-		a = getUsedSamples(i);
+		if (itemNum < numPattItems && xmSaveItems[itemNum].pattNum == i)
+		{
+			ph.dataSize = (uint16_t)xmSaveItems[itemNum].length;
+			memmove(writePtr + sizeof (xmPatHdr_t), xmSaveItems[itemNum].dst, ph.dataSize);
+			itemNum++;
+		}
 
-		nameLength = (int32_t)strlen(song.instrName[i]);
-		if (nameLength > 22)
-			nameLength = 22;
+		memcpy(writePtr, &ph, sizeof (xmPatHdr_t));
+		writePtr += sizeof (xmPatHdr_t) + ph.dataSize;
+	}
 
-		memset(ih.name, 0, 22); // pad with zero
-		if (nameLength > 0)
-			memcpy(ih.name, song.instrName[i], nameLength);
+	const bool fileWritten = writeFileSafely(filenameU, pattBuf, writePtr - pattBuf, instrBuf, (size_t)instrBufLength);
 
-		ih.type = 0;
-		ih.numSamples = a;
-		ih.sampleSize = sizeof (xmSmpHdr_t);
+	free(pattBuf);
+	free(instrBuf);
 
-		if (a > 0)
-		{
-			ins = instr[j];
-
-			memcpy(ih.note2SampleLUT, ins->note2SampleLUT, 96);
-			memcpy(ih.volEnvPoints, ins->volEnvPoints, 12*2*sizeof(int16_t));
-			memcpy(ih.panEnvPoints, ins->panEnvPoints, 12*2*sizeof(int16_t));
-			ih.volEnvLength = ins->volEnvLength;
-			ih.panEnvLength = ins->panEnvLength;
-			ih.volEnvSustain = ins->volEnvSustain;
-			ih.volEnvLoopStart = ins->volEnvLoopStart;
-			ih.volEnvLoopEnd = ins->volEnvLoopEnd;
-			ih.panEnvSustain = ins->panEnvSustain;
-			ih.panEnvLoopStart = ins->panEnvLoopStart;
-			ih.panEnvLoopEnd = ins->panEnvLoopEnd;
-			ih.volEnvFlags = ins->volEnvFlags;
-			ih.panEnvFlags = ins->panEnvFlags;
-			ih.vibType = ins->autoVibType;
-			ih.vibSweep = ins->autoVibSweep;
-			ih.vibDepth = ins->autoVibDepth;
-			ih.vibRate = ins->autoVibRate;
-			ih.fadeout = ins->fadeout;
-			ih.midiOn = ins->midiOn ? 1 : 0;
-			ih.midiChannel = ins->midiChannel;
-			ih.midiProgram = ins->midiProgram;
-			ih.midiBend = ins->midiBend;
-			ih.mute = ins->mute ? 1 : 0;
-			ih.instrSize = INSTR_HEADER_SIZE;
-			
-			for (k = 0; k < a; k++)
-			{
-				s = &instr[j]->smp[k];
-				dst = &ih.smp[k];
+	if (!fileWritten)
+		return false;
 
-				bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	removeSongModifiedFlag();
 
-				dst->length = s->length;
-				dst->loopStart = s->loopStart;
-				dst->loopLength = s->loopLength;
+	editor.diskOpReadDir = true; // force diskop re-read
 
-				if (sample16Bit)
-				{
-					dst->length <<= 1;
-					dst->loopStart <<= 1;
-					dst->loopLength <<= 1;
-				}
+	setMouseBusy(false);
+	return true;
+}
+
+/* For the crash handler. The file is written directly with the static buffers (one pattern or
+** sample chunk at a time), so that the backup can be saved even if we're out of memory. No jobs
+** are started, the song isn't changed, and the samples are always stored unpacked.
+*/
+bool saveXM(UNICHAR *filenameU)
+{
+	int16_t i, k, a;
+	xmHdr_t h;
+	xmPatHdr_t ph;
+	xmInsHdr_t ih;
 
-				dst->volume = s->volume;
-				dst->finetune = s->finetune;
-				dst->flags = s->flags;
-				dst->panning = s->panning;
-				dst->relativeNote = s->relativeNote;
+	setupXMHeader(&h);
 
-				nameLength = (int32_t)strlen(s->name);
-				if (nameLength > 22)
-					nameLength = 22;
+	FILE *f = UNICHAR_FOPEN(filenameU, "wb");
+	if (f == NULL)
+	{
+		okBoxThreadSafe(0, "System message", "Error opening file for saving, is it in use?", NULL);
+		return false;
+	}
 
-				dst->nameLength = (uint8_t)nameLength;
+	bool writeOK = fwrite(&h, sizeof (h), 1, f) == 1;
 
-				memset(dst->name, ' ', 22); // yes, FT2 pads the name with spaces
-				if (nameLength > 0)
-					memcpy(dst->name, s->name, nameLength);
+	for (i = 0; writeOK && i < h.numPatterns; i++)
+	{
+		ph.headerSize = sizeof (xmPatHdr_t);
+		ph.type = 0;
 
-				if (s->dataPtr == NULL)
-					dst->length = 0;
-			}
+		if (patternEmpty(i))
+		{
+			ph.numRows = 64; // (like freeEmptyPatterns())
+			ph.dataSize = 0;
 		}
 		else
 		{
-			ih.instrSize = 22 + 11;
+			ph.numRows = patternNumRows[i];
+			ph.dataSize = packPatt(xmPattData, (const uint8_t *)pattern[i], patternNumRows[i], song.numChannels);
 		}
 
-		if (fwrite(&ih, ih.instrSize + (a * sizeof (xmSmpHdr_t)), 1, f) != 1)
-		{
-			fclose(f);
-			okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
-			return false;
-		}
+		writeOK = fwrite(&ph, sizeof (xmPatHdr_t), 1, f) == 1;
+		if (writeOK && ph.dataSize > 0)
+			writeOK = fwrite(xmPattData, ph.dataSize, 1, f) == 1;
+	}
 
-		for (k = 1; k <= a; k++)
-		{
-			s = &instr[j]->smp[k-1];
-			if (s->dataPtr != NULL)
-			{
-				unfixSample(s);
-				samp2Delta(s->dataPtr, s->length, s->flags);
+	for (i = 1; writeOK && i <= h.numInstr; i++)
+	{
+		a = getUsedSamples(i); // (zero if the instrument is not allocated)
 
-				result = fwrite(s->dataPtr, 1, SAMPLE_LENGTH_BYTES(s), f);
+		const int32_t instrHeaderBytes = setupXMInstrHeader(&ih, instr[i], song.instrName[i], a);
+		writeOK = fwrite(&ih, instrHeaderBytes, 1, f) == 1;
 
-				delta2Samp(s->dataPtr, s->length, s->flags);
-				fixSample(s);
+		for (k = 0; writeOK && k < a; k++)
+		{
+			const sample_t *s = &instr[i]->smp[k];
+			if (s->dataPtr == NULL)
+				continue;
 
-				if (result != (size_t)SAMPLE_LENGTH_BYTES(s)) // write not OK
-				{
-					fclose(f);
-					okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
-					return false;
-				}
+			int16_t oldSmp = 0;
+			for (int32_t pos = 0; writeOK && pos < s->length; pos += XM_ENCODE_CHUNK_LEN)
+			{
+				const int32_t bytes = encodeXMSampleChunk(s, pos, xmSaveScratch, &oldSmp);
+				writeOK = fwrite(xmSaveScratch, bytes, 1, f) == 1;
 			}
 		}
 	}
 
-	removeSongModifiedFlag();
+	if (fclose(f) != 0)
+		writeOK = false;
 
-	fclose(f);
+	if (!writeOK)
+	{
+		okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
+		return false;
+	}
+
+	removeSongModifiedFlag();
 
 	editor.diskOpReadDir = true; // force diskop re-read
 
@@ -589,47 +995,34 @@ static bool saveMOD(UNICHAR *filenameU)
 
 		modSmpHdr_t *modSmp = &hdr.smp[i-1];
 
-		unfixSample(smp);
-
 		int32_t sampleBytes = SWAP16(modSmp->length) * 2;
+		int32_t samplesWritten = 0;
 
-		if (smp->flags & SAMPLE_16BIT) // 16-bit sample (convert to 8-bit)
+		while (samplesWritten < sampleBytes) // write in chunks, from unfixed copies (the sample may be playing)
 		{
-			int8_t *dstPtr = (int8_t *)smpChunkBuf;
-			int32_t writeLen = sampleBytes;
-			int32_t samplesWritten = 0;
+			int32_t samplesToWrite = sizeof (smpChunkBuf);
+			if (samplesWritten+samplesToWrite > sampleBytes)
+				samplesToWrite = sampleBytes - samplesWritten;
 
-			while (samplesWritten < writeLen) // write in chunks
+			if (smp->flags & SAMPLE_16BIT) // 16-bit sample (convert to 8-bit)
 			{
-	 			int32_t samplesToWrite = sizeof (smpChunkBuf);
-				if (samplesWritten+samplesToWrite > writeLen)
-					samplesToWrite = writeLen - samplesWritten;
-
-				int16_t *srcPtr16 = (int16_t *)smp->dataPtr + samplesWritten;
+				copyUnfixedSmpData(smp, (int8_t *)smpChunkBuf16, samplesWritten, samplesToWrite);
 				for (j = 0; j < samplesToWrite; j++)
-					dstPtr[j] = srcPtr16[j] >> 8; // convert 16-bit to 8-bit
-
-				if (fwrite(dstPtr, 1, samplesToWrite, f) != (size_t)samplesToWrite)
-				{
-					fixSample(smp);
-					okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
-					goto modSaveError;
-				}
-
-				samplesWritten += samplesToWrite;
+					smpChunkBuf[j] = smpChunkBuf16[j] >> 8; // convert 16-bit to 8-bit
 			}
-		}
-		else // 8-bit sample
-		{
-			if (fwrite(smp->dataPtr, 1, sampleBytes, f) != (size_t)sampleBytes)
+			else // 8-bit sample
+			{
+				copyUnfixedSmpData(smp, smpChunkBuf, samplesWritten, samplesToWrite);
+			}
+
+			if (fwrite(smpChunkBuf, 1, samplesToWrite, f) != (size_t)samplesToWrite)
 			{
-				fixSample(smp);
 				okBoxThreadSafe(0, "System message", "Error saving module: general I/O error!", NULL);
 				goto modSaveError;
 			}
-		}
 
-		fixSample(smp);
+			samplesWritten += samplesToWrite;
+		}
 	}
 
 	fclose(f);
@@ -651,14 +1044,12 @@ static int32_t saveMusicThread(void *ptr)
 	if (editor.tmpFilenameU == NULL)
 		return false;
 
-	pauseAudio();
-
+	// the savers only read the song, so the audio keeps running
 	if (editor.moduleSaveMode == 1)
-		saveXM(editor.tmpFilenameU);
+		doSaveXM(editor.tmpFilenameU);
 	else
 		saveMOD(editor.tmpFilenameU);
 
-	resumeAudio();
 	return true;
 
 	(void)ptr;
@@ -679,7 +1070,7 @@ void saveMusic(UNICHAR *filenameU)
 	SDL_DetachThread(thread);
 }
 
-static uint16_t packPatt(uint8_t *writePtr, uint8_t *pattPtr, uint16_t numRows)
+uint16_t packPatt(uint8_t *writePtr, const uint8_t *pattPtr, uint16_t numRows, int32_t numChannels)
 {
 	uint8_t bytes[5];
 
@@ -688,10 +1079,10 @@ static uint16_t packPatt(uint8_t *writePtr, uint8_t *pattPtr, uint16_t numRows)
 
 	uint16_t totalPackLen = 0;
 
-	const int32_t pitch = sizeof (note_t) * (MAX_CHANNELS - song.numChannels);
+	const int32_t pitch = sizeof (note_t) * (MAX_CHANNELS - numChannels);
 	for (int32_t row = 0; row < numRows; row++)
 	{
-		for (int32_t chn = 0; chn < song.numChannels; chn++)
+		for (int32_t chn = 0; chn < numChannels; chn++)
 		{
 			bytes[0] = *pattPtr++;
 			bytes[1] = *pattPtr++;
@@ -2,7 +2,18 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "ft2_replayer.h"
 #include "ft2_unicode.h"
 
+#define XM_ENCODE_SCRATCH_LEN 65536
+#define XM_ENCODE_CHUNK_LEN (XM_ENCODE_SCRATCH_LEN / sizeof (int16_t)) /* samples per encodeXMSampleChunk() */
+
 void saveMusic(UNICHAR *filenameU);
-bool saveXM(UNICHAR *filenameU);
+bool saveXM(UNICHAR *filenameU); // for the crash handler, writes the file directly without allocating memory
+
+// XM encoding, also used by the autosave (these only read the song data)
+void setupXMHeader(xmHdr_t *h); // for the current song
+int32_t setupXMInstrHeader(xmInsHdr_t *ih, const instr_t *ins, const char *name, int16_t numSamples); // returns the size with the sample headers
+uint16_t packPatt(uint8_t *writePtr, const uint8_t *pattPtr, uint16_t numRows, int32_t numChannels); // writePtr needs numRows*numChannels*5 bytes
+void encodeXMSampleData(const sample_t *s, uint8_t *dst, int8_t *scratch); // delta encodes an unfixed copy, scratch is XM_ENCODE_SCRATCH_LEN bytes
+int32_t encodeXMSampleChunk(const sample_t *s, int32_t pos, int8_t *scratch, int16_t *oldSmp); // the same in steps (oldSmp starts at 0), returns the bytes in scratch
@@ -626,7 +626,7 @@ void mouseButtonUpHandler(uint8_t mouseButton)
 		{
 			// right mouse button released after hand-editing sample data
 			if (instr[editor.curInstr] != NULL)
-				fixSample(&instr[editor.curInstr]->smp[editor.curSmp]);
+				fixDrawnSample(&instr[editor.curInstr]->smp[editor.curSmp]);
 
 			resumeAudio();
 
@@ -105,6 +105,8 @@ static void drawNibblesFoodNumber(int32_t xOut, int32_t yOut, int32_t number)
 	if (number > 9)
 		return;
 
+	markRectDirty(xOut, yOut, FONT8_CHAR_W, FONT8_CHAR_H);
+
 	uint32_t *dstPtr = &video.frameBuffer[(yOut * SCREEN_W) + xOut];
 	uint8_t *srcPtr = &bmp.font8[number * FONT8_CHAR_W];
 
@@ -275,6 +277,8 @@ static void nibbleWriteLevelSprite(int16_t xOut, int16_t yOut, int16_t levelNum)
 	const int32_t readX = (51 + 2) * (levelNum % 10);
 	const int32_t readY = (23 + 2) * (levelNum / 10);
 
+	markRectDirty(xOut, yOut, 51+2, 23+2);
+
 	const uint8_t *src = (const uint8_t *)&bmp.nibblesStages[(readY * 530) + readX];
 	uint32_t *dst = &video.frameBuffer[(yOut * SCREEN_W) + xOut];
 
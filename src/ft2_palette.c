@@ -21,6 +21,50 @@ static uint8_t palContrast[12][2] = // palette desktop/button contrasts
 	{66, 62}, {68, 57}, {58, 42}, {57, 55}, {62, 57}, {52, 57}
 };
 
+static void setSpectrumPalette(void) // black -> blue -> purple -> orange -> yellow -> white
+{
+	static const uint8_t gradient[6][4] = // position (0..255), r, g, b
+	{
+		{   0,   0,   0,   0 },
+		{  64,   0,   0, 140 },
+		{ 128, 150,   0, 150 },
+		{ 192, 255, 100,   0 },
+		{ 230, 255, 220,   0 },
+		{ 255, 255, 255, 255 }
+	};
+
+	const uint32_t markColor = video.palette[PAL_BLCKMRK];
+
+	for (int32_t i = 0; i < PAL_SPECTRUM_LEVELS; i++)
+	{
+		const int32_t pos = (i * 255) / (PAL_SPECTRUM_LEVELS-1);
+
+		int32_t j = 0;
+		while (j < 4 && pos > gradient[j+1][0])
+			j++;
+
+		const int32_t x1 = gradient[j][0];
+		const int32_t x2 = gradient[j+1][0];
+		const int32_t f = ((pos - x1) * 256) / (x2 - x1);
+
+		int32_t r = gradient[j][1] + (((gradient[j+1][1] - gradient[j][1]) * f) >> 8);
+		int32_t g = gradient[j][2] + (((gradient[j+1][2] - gradient[j][2]) * f) >> 8);
+		int32_t b = gradient[j][3] + (((gradient[j+1][3] - gradient[j][3]) * f) >> 8);
+
+		const int32_t palNum = PAL_SPECTRUM + (i * 4);
+		video.palette[palNum+0] = (palNum << 24) | RGB32(r, g, b);
+		video.palette[palNum+1] = ((palNum+1) << 24) | RGB32(255-r, 255-g, 255-b);
+
+		// marked: mix with the block mark color
+		r = (r + RGB32_R(markColor)) >> 1;
+		g = (g + RGB32_G(markColor)) >> 1;
+		b = (b + RGB32_B(markColor)) >> 1;
+
+		video.palette[palNum+2] = ((palNum+2) << 24) | RGB32(r, g, b);
+		video.palette[palNum+3] = ((palNum+3) << 24) | RGB32(255-r, 255-g, 255-b);
+	}
+}
+
 void setPalette(pal16 *p, bool redrawScreen)
 {
 #define LOOP_PIN_COL_SUB 96
@@ -55,11 +99,21 @@ void setPalette(pal16 *p, bool redrawScreen)
 
 	video.palette[PAL_LOOPPIN] = (PAL_LOOPPIN << 24) | RGB32(r8, g8, b8);
 
+	setSpectrumPalette();
+
 	// update framebuffer pixels with new palette
 	if (redrawScreen && video.frameBuffer != NULL)
 	{
 		for (int32_t i = 0; i < SCREEN_W*SCREEN_H; i++)
-			video.frameBuffer[i] = video.palette[(video.frameBuffer[i] >> 24) & 15]; // ARGB alpha channel = palette index
+		{
+			const uint32_t pal = video.frameBuffer[i] >> 24; // ARGB alpha channel = palette index
+			if (pal >= PAL_SPECTRUM && pal < PAL_NUM)
+				video.frameBuffer[i] = video.palette[pal];
+			else
+				video.frameBuffer[i] = video.palette[pal & 15];
+		}
+
+		markScreenDirty();
 	}
 }
 
@@ -19,6 +19,8 @@ enum
 // palette entry for transparency
 #define PAL_TRANSPR 127
 
+#define PAL_SPECTRUM_LEVELS 31
+
 enum
 {
 	// FT2 palette (exact order as original FT2)
@@ -44,7 +46,12 @@ enum
 	PAL_TEXTMRK   = 17,
 	PAL_BOXSLCT   = 18,
 
-	PAL_NUM
+	/* Sample editor spectrogram colors, four entries per level. Bit 0 is the
+	** inverted color (sample position line), bit 1 the marked color (range).
+	*/
+	PAL_SPECTRUM  = 128,
+
+	PAL_NUM = PAL_SPECTRUM + (PAL_SPECTRUM_LEVELS * 4)
 };
 
 #ifdef _MSC_VER
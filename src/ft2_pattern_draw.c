@@ -5,33 +5,72 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include "ft2_header.h"
 #include "ft2_pattern_ed.h"
 #include "ft2_config.h"
 #include "ft2_gui.h"
 #include "ft2_video.h"
 #include "ft2_tables.h"
-#include "ft2_bmp.h"
+#include "ft2_glyphs.h"
 #include "ft2_structs.h"
 
+/* Pattern row render cache.
+**
+** The note text of a pattern row is cached as a list of horizontal pixel runs,
+** relative to the row's text origin. The runs don't store a color, so the
+** same entry is used for the selected (middle) row and the other rows, and
+** palette changes don't need to invalidate anything.
+** Each entry also holds a copy of the row's note data, so edits to the
+** pattern (from anywhere) make the entry mismatch and get re-rasterized.
+*/
+#define PATT_ROW_CACHE_SLOTS 512 /* must be 2^n */
+#define PATT_ROW_TEXT_X 29
+#define PATT_ROW_TEXT_H 8
+#define PATT_ROW_INK 0xFFFFFFFF /* not a valid palette pixel (the top byte is the palette index) */
+#define MAX_CHANNELS_SHOWN 12
+
+typedef struct pattRowRun_t
+{
+	uint16_t offset, w;
+} pattRowRun_t;
+
+typedef struct pattRowCache_t
+{
+	bool valid;
+	int32_t pattNum, row, numRuns, runsAllocated;
+	note_t notes[MAX_CHANNELS_SHOWN];
+	pattRowRun_t *runs;
+} pattRowCache_t;
+
+typedef struct pattRowLayout_t // everything (besides the notes) that changes how a row is rendered
+{
+	int32_t numChannels, chanWidth;
+	uint8_t numChannelsShown, showVolColumn, alternativeLayout, instrZero, acc, font4, font5;
+} pattRowLayout_t;
+
+static pattRowCache_t pattRowCache[PATT_ROW_CACHE_SLOTS];
+static pattRowLayout_t pattRowLayout;
+
 static note_t emptyPattern[MAX_CHANNELS * MAX_PATT_LEN];
 
-static const uint8_t *font4Ptr, *font5Ptr;
+static uint8_t font4Glyphs, font5Glyphs;
 static const uint8_t vol2charTab1[16] = { 39, 0, 1, 2, 3, 4, 36, 52, 53, 54, 28, 31, 25, 58, 59, 22 };
 static const uint8_t vol2charTab2[16] = { 42, 0, 1, 2, 3, 4, 36, 37, 38, 39, 28, 31, 25, 40, 41, 22 };
 static const uint8_t columnModeTab[12] = { 0, 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 3 };
-static const uint8_t sharpNote1Char_small[12] = {  8*6,  8*6,  9*6,  9*6, 10*6, 11*6, 11*6, 12*6, 12*6, 13*6, 13*6, 14*6 };
-static const uint8_t sharpNote2Char_small[12] = { 16*6, 15*6, 16*6, 15*6, 16*6, 16*6, 15*6, 16*6, 15*6, 16*6, 15*6, 16*6 };
-static const uint8_t flatNote1Char_small[12] = {  8*6,  9*6,  9*6, 10*6, 10*6, 11*6, 12*6, 12*6, 13*6, 13*6, 14*6, 14*6 };
-static const uint8_t flatNote2Char_small[12] = { 16*6, 17*6, 16*6, 17*6, 16*6, 16*6, 17*6, 16*6, 17*6, 16*6, 17*6, 16*6 };
-static const uint8_t sharpNote1Char_med[12] = { 12*8, 12*8, 13*8, 13*8, 14*8, 15*8, 15*8, 16*8, 16*8, 10*8, 10*8, 11*8 };
-static const uint16_t sharpNote2Char_med[12] = { 36*8, 37*8, 36*8, 37*8, 36*8, 36*8, 37*8, 36*8, 37*8, 36*8, 37*8, 36*8 };
-static const uint8_t flatNote1Char_med[12] = { 12*8, 13*8, 13*8, 14*8, 14*8, 15*8, 16*8, 16*8, 10*8, 10*8, 11*8, 11*8 };
-static const uint16_t flatNote2Char_med[12] = { 36*8, 38*8, 36*8, 38*8, 36*8, 36*8, 38*8, 36*8, 38*8, 36*8, 38*8, 36*8 };
-static const uint16_t sharpNote1Char_big[12] = { 12*16, 12*16, 13*16, 13*16, 14*16, 15*16, 15*16, 16*16, 16*16, 10*16, 10*16, 11*16 };
-static const uint16_t sharpNote2Char_big[12] = { 36*16, 37*16, 36*16, 37*16, 36*16, 36*16, 37*16, 36*16, 37*16, 36*16, 37*16, 36*16 };
-static const uint16_t flatNote1Char_big[12] = { 12*16, 13*16, 13*16, 14*16, 14*16, 15*16, 16*16, 16*16, 10*16, 10*16, 11*16, 11*16 };
-static const uint16_t flatNote2Char_big[12] = { 36*16, 38*16, 36*16, 38*16, 36*16, 36*16, 38*16, 36*16, 38*16, 36*16, 38*16, 36*16 };
+static const uint8_t sharpNote1Char_small[12] = {  8,  8,  9,  9, 10, 11, 11, 12, 12, 13, 13, 14 };
+static const uint8_t sharpNote2Char_small[12] = { 16, 15, 16, 15, 16, 16, 15, 16, 15, 16, 15, 16 };
+static const uint8_t flatNote1Char_small[12] = {  8,  9,  9, 10, 10, 11, 12, 12, 13, 13, 14, 14 };
+static const uint8_t flatNote2Char_small[12] = { 16, 17, 16, 17, 16, 16, 17, 16, 17, 16, 17, 16 };
+static const uint8_t sharpNote1Char_med[12] = { 12, 12, 13, 13, 14, 15, 15, 16, 16, 10, 10, 11 };
+static const uint8_t sharpNote2Char_med[12] = { 36, 37, 36, 37, 36, 36, 37, 36, 37, 36, 37, 36 };
+static const uint8_t flatNote1Char_med[12] = { 12, 13, 13, 14, 14, 15, 16, 16, 10, 10, 11, 11 };
+static const uint8_t flatNote2Char_med[12] = { 36, 38, 36, 38, 36, 36, 38, 36, 38, 36, 38, 36 };
+static const uint8_t sharpNote1Char_big[12] = { 12, 12, 13, 13, 14, 15, 15, 16, 16, 10, 10, 11 };
+static const uint8_t sharpNote2Char_big[12] = { 36, 37, 36, 37, 36, 36, 37, 36, 37, 36, 37, 36 };
+static const uint8_t flatNote1Char_big[12] = { 12, 13, 13, 14, 14, 15, 16, 16, 10, 10, 11, 11 };
+static const uint8_t flatNote2Char_big[12] = { 36, 38, 36, 38, 36, 36, 38, 36, 38, 36, 38, 36 };
 
 static void pattCharOut(uint32_t xPos, uint32_t yPos, uint8_t chr, uint8_t fontType, uint32_t color);
 static void drawEmptyNoteSmall(uint32_t xPos, uint32_t yPos, uint32_t color);
@@ -47,8 +86,8 @@ static void drawNoteBig(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32_t
 void updatePattFontPtrs(void)
 {
 	//config.ptnFont is pre-clamped and safe to use
-	font4Ptr = &bmp.font4[config.ptnFont * (FONT4_WIDTH * FONT4_CHAR_H)];
-	font5Ptr = &bmp.font4[(4 + config.ptnFont) * (FONT4_WIDTH * FONT4_CHAR_H)];
+	font4Glyphs = GLYPH_FONT4 + config.ptnFont;
+	font5Glyphs = GLYPH_FONT5 + config.ptnFont;
 }
 
 void drawPatternBorders(void)
@@ -59,6 +98,10 @@ void drawPatternBorders(void)
 	// set pattern cursor Y position
 	editor.ptnCursorY = pattCoord->lowerRowsY - 9;
 
+	// the whole pattern area is redrawn (borders, pattern data, cursor and block mark)
+	const int32_t pattAreaY = ui.extendedPatternEditor ? 68 : 173;
+	markRectDirty(0, pattAreaY, SCREEN_W, SCREEN_H - pattAreaY);
+
 	int32_t chans = ui.numChannelsShown;
 	if (chans > ui.maxVisibleChannels)
 		chans = ui.maxVisibleChannels;
@@ -338,33 +381,16 @@ static void drawRowNums(int32_t yPos, uint8_t row, bool selectedRowFlag)
 	if (!config.ptnHex)
 		row = hex2Dec[row];
 
-	const uint8_t *src1Ptr = &font4Ptr[(row   >> 4) * FONT4_CHAR_W];
-	const uint8_t *src2Ptr = &font4Ptr[(row & 0x0F) * FONT4_CHAR_W];
 	uint32_t *dst1Ptr = &video.frameBuffer[(yPos * SCREEN_W) + LEFT_ROW_XPOS];
 	uint32_t *dst2Ptr = dst1Ptr + (RIGHT_ROW_XPOS - LEFT_ROW_XPOS);
 
-	for (int32_t y = 0; y < FONT4_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT4_CHAR_W; x++)
-		{
-			if (src1Ptr[x])
-			{
-				dst1Ptr[x] = pixVal; // left side
-				dst2Ptr[x] = pixVal; // right side
-			}
-
-			if (src2Ptr[x])
-			{
-				dst1Ptr[FONT4_CHAR_W+x] = pixVal; // left side
-				dst2Ptr[FONT4_CHAR_W+x] = pixVal; // right side
-			}
-		}
+	// left side
+	glyphOut(font4Glyphs, row >> 4, dst1Ptr, pixVal);
+	glyphOut(font4Glyphs, row & 0x0F, dst1Ptr + FONT4_CHAR_W, pixVal);
 
-		src1Ptr += FONT4_WIDTH;
-		src2Ptr += FONT4_WIDTH;
-		dst1Ptr += SCREEN_W;
-		dst2Ptr += SCREEN_W;
-	}
+	// right side
+	glyphOut(font4Glyphs, row >> 4, dst2Ptr, pixVal);
+	glyphOut(font4Glyphs, row & 0x0F, dst2Ptr + FONT4_CHAR_W, pixVal);
 }
 
 // DRAWING ROUTINES (WITH VOLUME COLUMN)
@@ -749,6 +775,129 @@ static void showEfxNoVolColumn(uint32_t xPos, uint32_t yPos, uint8_t efx, uint8_
 	}
 }
 
+static void invalidatePattRowCache(void)
+{
+	for (int32_t i = 0; i < PATT_ROW_CACHE_SLOTS; i++)
+		pattRowCache[i].valid = false;
+}
+
+void freePattRowCache(void)
+{
+	pattRowCache_t *c = pattRowCache;
+	for (int32_t i = 0; i < PATT_ROW_CACHE_SLOTS; i++, c++)
+	{
+		if (c->runs != NULL)
+		{
+			free(c->runs);
+			c->runs = NULL;
+		}
+
+		c->runsAllocated = 0;
+		c->valid = false;
+	}
+}
+
+static void updatePattRowLayout(int32_t numChannels, int32_t chanWidth)
+{
+	pattRowLayout_t layout;
+	memset(&layout, 0, sizeof (layout)); // clear padding, we memcmp() this
+
+	layout.numChannels = numChannels;
+	layout.chanWidth = chanWidth;
+	layout.numChannelsShown = ui.numChannelsShown;
+	layout.showVolColumn = config.ptnShowVolColumn;
+	layout.alternativeLayout = config.ptnAlternativeLayout;
+	layout.instrZero = config.ptnInstrZero;
+	layout.acc = config.ptnAcc;
+	layout.font4 = font4Glyphs;
+	layout.font5 = font5Glyphs;
+
+	if (memcmp(&layout, &pattRowLayout, sizeof (layout)) != 0)
+	{
+		pattRowLayout = layout;
+		invalidatePattRowCache();
+	}
+}
+
+// returns the slot for this row, check ->valid to see if it needs to be rasterized
+static pattRowCache_t *getPattRowCache(int32_t pattNum, int32_t row, const note_t *notes, int32_t numChannels)
+{
+	pattRowCache_t *c = &pattRowCache[((pattNum * MAX_PATT_LEN) + row) & (PATT_ROW_CACHE_SLOTS-1)];
+	const size_t notesSize = numChannels * sizeof (note_t);
+
+	if (c->valid && c->pattNum == pattNum && c->row == row && memcmp(c->notes, notes, notesSize) == 0)
+		return c;
+
+	c->valid = false;
+	c->pattNum = pattNum;
+	c->row = row;
+	memcpy(c->notes, notes, notesSize);
+
+	return c;
+}
+
+/* Scans the freshly drawn (PATT_ROW_INK colored) row text into runs, and
+** gives the pixels their real color while doing so. If we run out of memory,
+** the slot stays invalid but the row is still colored properly.
+*/
+static void rasterizePattRow(pattRowCache_t *c, uint32_t *dstPtr, int32_t rowW, uint32_t color)
+{
+	bool outOfMemory = false;
+
+	c->numRuns = 0;
+	for (int32_t y = 0; y < PATT_ROW_TEXT_H; y++, dstPtr += SCREEN_W)
+	{
+		int32_t x = 0;
+		while (x < rowW)
+		{
+			if (dstPtr[x] != PATT_ROW_INK)
+			{
+				x++;
+				continue;
+			}
+
+			const int32_t runStart = x;
+			for (; x < rowW && dstPtr[x] == PATT_ROW_INK; x++)
+				dstPtr[x] = color;
+
+			if (outOfMemory)
+				continue;
+
+			if (c->numRuns >= c->runsAllocated)
+			{
+				const int32_t newSize = (c->runsAllocated == 0) ? 256 : (c->runsAllocated * 2);
+
+				pattRowRun_t *newRuns = (pattRowRun_t *)realloc(c->runs, newSize * sizeof (pattRowRun_t));
+				if (newRuns == NULL)
+				{
+					outOfMemory = true;
+					continue;
+				}
+
+				c->runs = newRuns;
+				c->runsAllocated = newSize;
+			}
+
+			pattRowRun_t *r = &c->runs[c->numRuns++];
+			r->offset = (uint16_t)((y * SCREEN_W) + runStart);
+			r->w = (uint16_t)(x - runStart);
+		}
+	}
+
+	c->valid = !outOfMemory;
+}
+
+static void drawPattRowRuns(const pattRowCache_t *c, uint32_t *dstPtr, uint32_t color)
+{
+	const pattRowRun_t *r = c->runs;
+	for (int32_t i = 0; i < c->numRuns; i++, r++)
+	{
+		uint32_t *dst = dstPtr + r->offset;
+		for (int32_t x = 0; x < r->w; x++)
+			dst[x] = color;
+	}
+}
+
 void writePattern(int32_t currRow, int32_t currPattern)
 {
 	uint32_t noteTextColors[2];
@@ -814,6 +963,11 @@ void writePattern(int32_t currRow, int32_t currPattern)
 	noteTextColors[0] = video.palette[PAL_PATTEXT]; // not selected
 	noteTextColors[1] = video.palette[PAL_FORGRND]; // selected
 
+	ASSERT(numChannels <= MAX_CHANNELS_SHOWN);
+	updatePattRowLayout(numChannels, ui.patternChannelWidth);
+
+	const int32_t rowW = MIN(numChannels * ui.patternChannelWidth, SCREEN_W - PATT_ROW_TEXT_X);
+
 	// draw pattern data
 	for (int32_t i = 0; i < rowsOnScreen; i++)
 	{
@@ -826,14 +980,25 @@ void writePattern(int32_t currRow, int32_t currPattern)
 			const note_t *p = (pattPtr == NULL) ? emptyPattern : &pattPtr[(uint32_t)row * MAX_CHANNELS];
 			const int32_t xWidth = ui.patternChannelWidth;
 			const uint32_t color = noteTextColors[selectedRowFlag];
+			uint32_t *dstPtr = &video.frameBuffer[(textY * SCREEN_W) + PATT_ROW_TEXT_X];
 
-			int32_t xPos = 29;
-			for (int32_t j = 0; j < numChannels; j++, p++, xPos += xWidth)
+			pattRowCache_t *c = getPattRowCache(currPattern, row, p, numChannels);
+			if (c->valid)
 			{
-				drawNote(xPos, textY, p->note, color);
-				drawInst(xPos, textY, p->instr, color);
-				drawVolEfx(xPos, textY, p->vol, color);
-				drawEfx(xPos, textY, p->efx, p->efxData, color);
+				drawPattRowRuns(c, dstPtr, color);
+			}
+			else
+			{
+				int32_t xPos = PATT_ROW_TEXT_X;
+				for (int32_t j = 0; j < numChannels; j++, p++, xPos += xWidth)
+				{
+					drawNote(xPos, textY, p->note, PATT_ROW_INK);
+					drawInst(xPos, textY, p->instr, PATT_ROW_INK);
+					drawVolEfx(xPos, textY, p->vol, PATT_ROW_INK);
+					drawEfx(xPos, textY, p->efx, p->efxData, PATT_ROW_INK);
+				}
+
+				rasterizePattRow(c, dstPtr, rowW, color);
 			}
 		}
 
@@ -865,91 +1030,26 @@ void writePattern(int32_t currRow, int32_t currPattern)
 
 void pattTwoHexOut(uint32_t xPos, uint32_t yPos, uint8_t val, uint32_t color)
 {
-	const uint8_t *ch1Ptr = &font4Ptr[(val   >> 4) * FONT4_CHAR_W];
-	const uint8_t *ch2Ptr = &font4Ptr[(val & 0x0F) * FONT4_CHAR_W];
-	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
+	markRectDirty(xPos, yPos, FONT4_CHAR_W*2, FONT4_CHAR_H);
 
-	for (int32_t y = 0; y < FONT4_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT4_CHAR_W; x++)
-		{
-			if (ch1Ptr[x] != 0) dstPtr[x] = color;
-			if (ch2Ptr[x] != 0) dstPtr[FONT4_CHAR_W+x] = color;
-		}
-
-		ch1Ptr += FONT4_WIDTH;
-		ch2Ptr += FONT4_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
+	glyphOut(font4Glyphs, val >> 4, dstPtr, color);
+	glyphOut(font4Glyphs, val & 0x0F, dstPtr + FONT4_CHAR_W, color);
 }
 
 static void pattCharOut(uint32_t xPos, uint32_t yPos, uint8_t chr, uint8_t fontType, uint32_t color)
 {
-	const uint8_t *srcPtr;
-	int32_t x, y;
-
-	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-
+	uint8_t fontNum;
 	if (fontType == FONT_TYPE3)
-	{
-		srcPtr = &bmp.font3[chr * FONT3_CHAR_W];
-		for (y = 0; y < FONT3_CHAR_H; y++)
-		{
-			for (x = 0; x < FONT3_CHAR_W; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = color;
-			}
-
-			srcPtr += FONT3_WIDTH;
-			dstPtr += SCREEN_W;
-		}
-	}
+		fontNum = GLYPH_FONT3;
 	else if (fontType == FONT_TYPE4)
-	{
-		srcPtr = &font4Ptr[chr * FONT4_CHAR_W];
-		for (y = 0; y < FONT4_CHAR_H; y++)
-		{
-			for (x = 0; x < FONT4_CHAR_W; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = color;
-			}
-
-			srcPtr += FONT4_WIDTH;
-			dstPtr += SCREEN_W;
-		}
-	}
+		fontNum = font4Glyphs;
 	else if (fontType == FONT_TYPE5)
-	{
-		srcPtr = &font5Ptr[chr * FONT5_CHAR_W];
-		for (y = 0; y < FONT5_CHAR_H; y++)
-		{
-			for (x = 0; x < FONT5_CHAR_W; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = color;
-			}
-
-			srcPtr += FONT5_WIDTH;
-			dstPtr += SCREEN_W;
-		}
-	}
+		fontNum = font5Glyphs;
 	else
-	{
-		srcPtr = &bmp.font7[chr * FONT7_CHAR_W];
-		for (y = 0; y < FONT7_CHAR_H; y++)
-		{
-			for (x = 0; x < FONT7_CHAR_W; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = color;
-			}
+		fontNum = GLYPH_FONT7;
 
-			srcPtr += FONT7_WIDTH;
-			dstPtr += SCREEN_W;
-		}
-	}
+	glyphOut(fontNum, chr, &video.frameBuffer[(yPos * SCREEN_W) + xPos], color);
 }
 
 static void drawEmptyNoteSmall(uint32_t xPos, uint32_t yPos, uint32_t color)
@@ -967,38 +1067,14 @@ static void drawEmptyNoteSmall(uint32_t xPos, uint32_t yPos, uint32_t color)
 	}
 	else
 	{
-		const uint8_t *srcPtr = &bmp.font7[18 * FONT7_CHAR_W];
-
-		for (int32_t y = 0; y < FONT7_CHAR_H; y++)
-		{
-			for (int32_t x = 0; x < FONT7_CHAR_W*3; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = color;
-			}
-
-			srcPtr += FONT7_WIDTH;
-			dstPtr += SCREEN_W;
-		}
+		glyphsOut(GLYPH_FONT7, 18, 3, dstPtr, color);
 	}
 }
 
 static void drawKeyOffSmall(uint32_t xPos, uint32_t yPos, uint32_t color)
 {
-	const uint8_t *srcPtr = &bmp.font7[21 * FONT7_CHAR_W];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + (xPos + 2)];
-
-	for (int32_t y = 0; y < FONT7_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT7_CHAR_W*2; x++)
-		{
-			if (srcPtr[x] != 0)
-				dstPtr[x] = color;
-		}
-
-		srcPtr += FONT7_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	glyphsOut(GLYPH_FONT7, 21, 2, dstPtr, color);
 }
 
 static void drawNoteSmall(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32_t color)
@@ -1008,7 +1084,7 @@ static void drawNoteSmall(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32_
 	noteNum--;
 
 	const uint8_t note = noteTab1[noteNum];
-	const uint32_t char3 = noteTab2[noteNum] * FONT7_CHAR_W;
+	const uint32_t char3 = noteTab2[noteNum];
 
 	if (config.ptnAcc == 0)
 	{
@@ -1021,25 +1097,10 @@ static void drawNoteSmall(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32_
 		char2 = flatNote2Char_small[note];
 	}
 
-	const uint8_t *ch1Ptr = &bmp.font7[char1];
-	const uint8_t *ch2Ptr = &bmp.font7[char2];
-	const uint8_t *ch3Ptr = &bmp.font7[char3];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-
-	for (int32_t y = 0; y < FONT7_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT7_CHAR_W; x++)
-		{
-			if (ch1Ptr[x] != 0) dstPtr[x] = color;
-			if (ch2Ptr[x] != 0) dstPtr[FONT7_CHAR_W+x] = color;
-			if (ch3Ptr[x] != 0) dstPtr[((FONT7_CHAR_W*2)-2)+x] = color;
-		}
-
-		ch1Ptr += FONT7_WIDTH;
-		ch2Ptr += FONT7_WIDTH;
-		ch3Ptr += FONT7_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	glyphOut(GLYPH_FONT7, char1, dstPtr, color);
+	glyphOut(GLYPH_FONT7, char2, dstPtr + FONT7_CHAR_W, color);
+	glyphOut(GLYPH_FONT7, char3, dstPtr + ((FONT7_CHAR_W*2)-2), color);
 }
 
 static void drawEmptyNoteMedium(uint32_t xPos, uint32_t yPos, uint32_t color)
@@ -1057,38 +1118,14 @@ static void drawEmptyNoteMedium(uint32_t xPos, uint32_t yPos, uint32_t color)
 	}
 	else
 	{
-		const uint8_t *srcPtr = &font4Ptr[43 * FONT4_CHAR_W];
-
-		for (int32_t y = 0; y < FONT4_CHAR_H; y++)
-		{
-			for (int32_t x = 0; x < FONT4_CHAR_W*3; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = color;
-			}
-
-			srcPtr += FONT4_WIDTH;
-			dstPtr += SCREEN_W;
-		}
+		glyphsOut(font4Glyphs, 43, 3, dstPtr, color);
 	}
 }
 
 static void drawKeyOffMedium(uint32_t xPos, uint32_t yPos, uint32_t color)
 {
-	const uint8_t *srcPtr = &font4Ptr[40 * FONT4_CHAR_W];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-
-	for (int32_t y = 0; y < FONT4_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT4_CHAR_W*3; x++)
-		{
-			if (srcPtr[x] != 0)
-				dstPtr[x] = color;
-		}
-
-		srcPtr += FONT4_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	glyphsOut(font4Glyphs, 40, 3, dstPtr, color);
 }
 
 static void drawNoteMedium(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32_t color)
@@ -1098,7 +1135,7 @@ static void drawNoteMedium(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32
 	noteNum--;
 
 	const uint8_t note = noteTab1[noteNum];
-	const uint32_t char3 = noteTab2[noteNum] * FONT4_CHAR_W;
+	const uint32_t char3 = noteTab2[noteNum];
 
 	if (config.ptnAcc == 0)
 	{
@@ -1111,25 +1148,10 @@ static void drawNoteMedium(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32
 		char2 = flatNote2Char_med[note];
 	}
 
-	const uint8_t *ch1Ptr = &font4Ptr[char1];
-	const uint8_t *ch2Ptr = &font4Ptr[char2];
-	const uint8_t *ch3Ptr = &font4Ptr[char3];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-
-	for (int32_t y = 0; y < FONT4_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT4_CHAR_W; x++)
-		{
-			if (ch1Ptr[x] != 0) dstPtr[x] = color;
-			if (ch2Ptr[x] != 0) dstPtr[FONT4_CHAR_W+x] = color;
-			if (ch3Ptr[x] != 0) dstPtr[(FONT4_CHAR_W*2)+x] = color;
-		}
-
-		ch1Ptr += FONT4_WIDTH;
-		ch2Ptr += FONT4_WIDTH;
-		ch3Ptr += FONT4_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	glyphOut(font4Glyphs, char1, dstPtr, color);
+	glyphOut(font4Glyphs, char2, dstPtr + FONT4_CHAR_W, color);
+	glyphOut(font4Glyphs, char3, dstPtr + (FONT4_CHAR_W*2), color);
 }
 
 static void drawEmptyNoteBig(uint32_t xPos, uint32_t yPos, uint32_t color)
@@ -1147,38 +1169,14 @@ static void drawEmptyNoteBig(uint32_t xPos, uint32_t yPos, uint32_t color)
 	}
 	else
 	{
-		const uint8_t *srcPtr = &font4Ptr[67 * FONT4_CHAR_W];
-
-		for (int32_t y = 0; y < FONT4_CHAR_H; y++)
-		{
-			for (int32_t x = 0; x < FONT4_CHAR_W*6; x++)
-			{
-				if (srcPtr[x] != 0)
-					dstPtr[x] = color;
-			}
-
-			srcPtr += FONT4_WIDTH;
-			dstPtr += SCREEN_W;
-		}
+		glyphsOut(font4Glyphs, 67, 6, dstPtr, color);
 	}
 }
 
 static void drawKeyOffBig(uint32_t xPos, uint32_t yPos, uint32_t color)
 {
-	const uint8_t *srcPtr = &bmp.font4[61 * FONT4_CHAR_W];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-
-	for (int32_t y = 0; y < FONT4_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT4_CHAR_W*6; x++)
-		{
-			if (srcPtr[x] != 0)
-				dstPtr[x] = color;
-		}
-
-		srcPtr += FONT4_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	glyphsOut(GLYPH_FONT4, 61, 6, dstPtr, color);
 }
 
 static void drawNoteBig(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32_t color)
@@ -1188,7 +1186,7 @@ static void drawNoteBig(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32_t
 	noteNum--;
 
 	const uint8_t note = noteTab1[noteNum];
-	const uint32_t char3 = noteTab2[noteNum] * FONT5_CHAR_W;
+	const uint32_t char3 = noteTab2[noteNum];
 
 	if (config.ptnAcc == 0)
 	{
@@ -1201,23 +1199,8 @@ static void drawNoteBig(uint32_t xPos, uint32_t yPos, int32_t noteNum, uint32_t
 		char2 = flatNote2Char_big[note];
 	}
 
-	const uint8_t *ch1Ptr = &font5Ptr[char1];
-	const uint8_t *ch2Ptr = &font5Ptr[char2];
-	const uint8_t *ch3Ptr = &font5Ptr[char3];
 	uint32_t *dstPtr = &video.frameBuffer[(yPos * SCREEN_W) + xPos];
-
-	for (int32_t y = 0; y < FONT5_CHAR_H; y++)
-	{
-		for (int32_t x = 0; x < FONT5_CHAR_W; x++)
-		{
-			if (ch1Ptr[x] != 0) dstPtr[x] = color;
-			if (ch2Ptr[x] != 0) dstPtr[FONT5_CHAR_W+x] = color;
-			if (ch3Ptr[x] != 0) dstPtr[(FONT5_CHAR_W*2)+x] = color;
-		}
-
-		ch1Ptr += FONT5_WIDTH;
-		ch2Ptr += FONT5_WIDTH;
-		ch3Ptr += FONT5_WIDTH;
-		dstPtr += SCREEN_W;
-	}
+	glyphOut(font5Glyphs, char1, dstPtr, color);
+	glyphOut(font5Glyphs, char2, dstPtr + FONT5_CHAR_W, color);
+	glyphOut(font5Glyphs, char3, dstPtr + (FONT5_CHAR_W*2), color);
 }
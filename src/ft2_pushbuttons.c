@@ -501,6 +501,8 @@ void drawPushButton(uint16_t pushButtonID)
 
 			// blit graphics
 
+			markRectDirty(textX, textY, textW, 8);
+
 			uint32_t *dst32 = &video.frameBuffer[(textY * SCREEN_W) + textX];
 			for (y = 0; y < 8; y++, src8 += BUTTON_GFX_BMP_WIDTH, dst32 += SCREEN_W)
 			{
@@ -132,6 +132,7 @@ void setSongModifiedFlag(void)
 {
 	song.isModified = true;
 	editor.updateWindowTitle = true;
+	editor.autosaveDirty = true; // the changed parts are found when the autosave snapshot is taken
 }
 
 void removeSongModifiedFlag(void)
@@ -3391,7 +3392,7 @@ void setSyncedReplayerVars(void)
 
 	memset(scopeUpdateStatus, 0, sizeof (scopeUpdateStatus));
 
-	uint64_t frameTime64 = SDL_GetPerformanceCounter();
+	const uint64_t frameTime64 = getVisualsSyncTime();
 
 	// handle channel sync queue
 
@@ -71,6 +71,8 @@ enum // sample flags
 	SAMPLE_16BIT = 16,
 	SAMPLE_STEREO = 32,
 	SAMPLE_ADPCM = 64, // not an existing flag, but used by loader
+	SAMPLE_IT214_PACKED = 128, // not an existing flag, but used by loader
+	SAMPLE_IT215_PACKED = 8 // not an existing flag, but used by loader
 };
 
 enum // envelope flags
@@ -223,6 +225,9 @@ typedef struct sample_t
 	int16_t leftEdgeTapSamples16[MAX_TAPS*2];
 	int16_t fixedSmp[MAX_TAPS*2];
 	int32_t fixedPos;
+
+	uint32_t dataVersion; // a new value after every (re)allocation or edit of the sample data (for the autosave)
+	uint32_t dataGeneration; // a new value for every new sample (loaded, cloned, recorded), edits keep it (for the sample undo)
 } sample_t;
 
 typedef struct instr_t
@@ -10,9 +10,6 @@
 #ifndef _WIN32
 #include <unistd.h> // chdir() in UNICHAR_CHDIR()
 #endif
-#if defined _WIN32 || defined __amd64__ || (defined __i386__ && defined __SSE2__)
-#include <emmintrin.h>
-#endif
 #include "ft2_header.h"
 #include "ft2_config.h"
 #include "ft2_audio.h"
@@ -30,6 +27,10 @@
 #include "ft2_random.h"
 #include "ft2_replayer.h"
 #include "ft2_smpfx.h"
+#include "ft2_sample_undo.h"
+#include "ft2_spectrogram.h"
+#include "ft2_sample_scan.h"
+#include "ft2_jobs.h"
 #include "mixer/ft2_mix_interpolation.h" // SINC_TAPS, SINC_NEGATIVE_TAPS
 
 static const char sharpNote1Char[12] = { 'C', 'C', 'D', 'D', 'E', 'F', 'F', 'G', 'G', 'A', 'A', 'B' };
@@ -39,18 +40,150 @@ static const char flatNote2Char[12]  = { '-', 'b', '-', 'b', '-', '-', 'b', '-',
 
 static char smpEd_SysReqText[64];
 static int8_t *smpCopyBuff;
-static bool updateLoopsOnMouseUp, writeSampleFlag, smpCopyDidCopyWholeSample;
-static int32_t smpEd_OldSmpPosLine = -1;
+static bool updateLoopsOnMouseUp, writeSampleFlag, smpCopyDidCopyWholeSample, showSpectrogram, spectroRequestPending;
+static int32_t smpEd_OldSmpPosLine = -1, spectroColumnsDrawn;
 static int32_t smpEd_ViewSize, smpEd_ScrPos, smpCopySize, smpCopyBits;
 static int32_t old_Rx1, old_Rx2, old_ViewSize, old_SmpScrPos;
 static int32_t lastMouseX, lastMouseY, lastDrawX, lastDrawY, mouseXOffs, curSmpLoopStart, curSmpLoopLength;
 static double dScrPosScaled, dPos2ScrMul, dScr2SmpPosMul;
 static sample_t smpCopySample;
-static SDL_Thread *thread;
+
+static void forgetSamplePeaks(const int8_t *dataPtr);
+static void invalidateSamplePeakRange(sample_t *s, int32_t pos, int32_t length);
+static void keepSamplePeaks(const sample_t *s, uint32_t oldDataVersion);
 
 // globals
 int32_t smpEd_Rx1 = 0, smpEd_Rx2 = 0;
 
+/* Held sample data (see holdSmpData()) is read by the autosave job while the
+** song can still be edited. Freeing or reallocating it only marks it as freed
+** then (a reallocation moves the data to a new buffer), and it's really freed
+** when the job is done and releases it. Edits of the held data are not
+** deferred, a new dataVersion is recorded for it instead, so that the autosave
+** can tell that it may have read half-edited data (heldSmpDataChanged()).
+*/
+#define MAX_HELD_SMP_DATA (MAX_INST * MAX_SMP_PER_INST)
+
+typedef struct heldSmpData_t
+{
+	int8_t *origPtr;
+	size_t size; // the allocated size (at least)
+	uint32_t dataVersion; // the latest, edits of held data change it
+	bool freed;
+} heldSmpData_t;
+
+static SDL_SpinLock heldSmpDataLock;
+static int32_t numHeldSmpData;
+static heldSmpData_t heldSmpData[MAX_HELD_SMP_DATA];
+static SDL_atomic_t lastSmpDataVersion, lastSmpDataGeneration;
+
+static heldSmpData_t *getHeldSmpData(const int8_t *origPtr) // call with heldSmpDataLock locked
+{
+	for (int32_t i = 0; i < numHeldSmpData; i++)
+	{
+		heldSmpData_t *h = &heldSmpData[i];
+		if (h->origPtr == origPtr && !h->freed)
+			return h;
+	}
+
+	return NULL;
+}
+
+static void setNewSmpDataVersion(sample_t *s) // can be called from any thread
+{
+	s->dataVersion = (uint32_t)SDL_AtomicAdd(&lastSmpDataVersion, 1) + 1;
+
+	if (s->origDataPtr != NULL)
+	{
+		SDL_AtomicLock(&heldSmpDataLock);
+		heldSmpData_t *h = getHeldSmpData(s->origDataPtr);
+		if (h != NULL)
+			h->dataVersion = s->dataVersion;
+		SDL_AtomicUnlock(&heldSmpDataLock);
+	}
+}
+
+static void freeSmpDataMem(int8_t *origPtr)
+{
+	SDL_AtomicLock(&heldSmpDataLock);
+	heldSmpData_t *h = getHeldSmpData(origPtr);
+	if (h != NULL)
+		h->freed = true;
+	SDL_AtomicUnlock(&heldSmpDataLock);
+
+	if (h == NULL)
+		free(origPtr);
+}
+
+static int8_t *reallocSmpDataMem(int8_t *origPtr, size_t size)
+{
+	SDL_AtomicLock(&heldSmpDataLock);
+	heldSmpData_t *h = getHeldSmpData(origPtr);
+	if (h == NULL)
+	{
+		SDL_AtomicUnlock(&heldSmpDataLock);
+		return (int8_t *)realloc(origPtr, size);
+	}
+
+	int8_t *newPtr = (int8_t *)malloc(size);
+	if (newPtr != NULL)
+	{
+		memcpy(newPtr, origPtr, MIN(size, h->size));
+		h->freed = true;
+	}
+	SDL_AtomicUnlock(&heldSmpDataLock);
+
+	return newPtr;
+}
+
+bool holdSmpData(const sample_t *s)
+{
+	if (s->origDataPtr == NULL)
+		return true;
+
+	SDL_AtomicLock(&heldSmpDataLock);
+	if (numHeldSmpData >= MAX_HELD_SMP_DATA)
+	{
+		SDL_AtomicUnlock(&heldSmpDataLock);
+		return false;
+	}
+
+	heldSmpData_t *h = &heldSmpData[numHeldSmpData++];
+	h->origPtr = s->origDataPtr;
+	h->size = SAMPLE_LENGTH_BYTES(s) + SAMPLE_PAD_LENGTH;
+	h->dataVersion = s->dataVersion;
+	h->freed = false;
+	SDL_AtomicUnlock(&heldSmpDataLock);
+
+	return true;
+}
+
+bool heldSmpDataChanged(const sample_t *s) // s is the sample as it was when it was held
+{
+	if (s->origDataPtr == NULL)
+		return false;
+
+	SDL_AtomicLock(&heldSmpDataLock);
+	const heldSmpData_t *h = getHeldSmpData(s->origDataPtr);
+	const bool changed = (h != NULL && h->dataVersion != s->dataVersion);
+	SDL_AtomicUnlock(&heldSmpDataLock);
+
+	return changed; // (freed data is never changed, a reallocation edits the new buffer)
+}
+
+void releaseHeldSmpData(void)
+{
+	SDL_AtomicLock(&heldSmpDataLock);
+	for (int32_t i = 0; i < numHeldSmpData; i++)
+	{
+		if (heldSmpData[i].freed)
+			free(heldSmpData[i].origPtr);
+	}
+
+	numHeldSmpData = 0;
+	SDL_AtomicUnlock(&heldSmpDataLock);
+}
+
 // allocs sample with proper alignment and padding for branchless resampling interpolation
 bool allocateSmpData(sample_t *s, int32_t length, bool sample16Bit)
 {
@@ -58,6 +191,9 @@ bool allocateSmpData(sample_t *s, int32_t length, bool sample16Bit)
 		length <<= 1;
 
 	s->origDataPtr = (int8_t *)malloc(length + SAMPLE_PAD_LENGTH);
+	s->dataGeneration = (uint32_t)SDL_AtomicAdd(&lastSmpDataGeneration, 1) + 1; // (a new sample in this slot)
+	setNewSmpDataVersion(s);
+
 	if (s->origDataPtr == NULL)
 	{
 		s->dataPtr = NULL;
@@ -92,14 +228,18 @@ bool reallocateSmpData(sample_t *s, int32_t length, bool sample16Bit)
 	if (sample16Bit)
 		length <<= 1;
 
-	int8_t *newPtr = (int8_t *)realloc(s->origDataPtr, length + SAMPLE_PAD_LENGTH);
-	if (newPtr == NULL)
-		return false;
+	forgetSamplePeaks(s->dataPtr);
 
-	s->origDataPtr = newPtr;
-	s->dataPtr = s->origDataPtr + SMP_DAT_OFFSET;
+	// held sample data is copied to a new buffer, so the new dataVersion below is for that buffer
+	int8_t *newPtr = reallocSmpDataMem(s->origDataPtr, length + SAMPLE_PAD_LENGTH);
+	if (newPtr != NULL)
+	{
+		s->origDataPtr = newPtr;
+		s->dataPtr = s->origDataPtr + SMP_DAT_OFFSET;
+	}
+	setNewSmpDataVersion(s);
 
-	return true;
+	return newPtr != NULL;
 }
 
 // reallocs sample with proper alignment and padding for branchless resampling interpolation
@@ -111,7 +251,9 @@ bool reallocateSmpDataPtr(smpPtr_t *sp, int32_t length, bool sample16Bit)
 	if (sample16Bit)
 		length <<= 1;
 
-	int8_t *newPtr = (int8_t *)realloc(sp->origPtr, length + SAMPLE_PAD_LENGTH);
+	forgetSamplePeaks(sp->ptr);
+
+	int8_t *newPtr = reallocSmpDataMem(sp->origPtr, length + SAMPLE_PAD_LENGTH);
 	if (newPtr == NULL)
 		return false;
 
@@ -123,15 +265,20 @@ bool reallocateSmpDataPtr(smpPtr_t *sp, int32_t length, bool sample16Bit)
 
 void setSmpDataPtr(sample_t *s, smpPtr_t *sp)
 {
+	forgetSamplePeaks(s->dataPtr);
+
 	s->origDataPtr = sp->origPtr;
 	s->dataPtr = sp->ptr;
+	setNewSmpDataVersion(s);
 }
 
 void freeSmpDataPtr(smpPtr_t *sp)
 {
+	forgetSamplePeaks(sp->ptr);
+
 	if (sp->origPtr != NULL)
 	{
-		free(sp->origPtr);
+		freeSmpDataMem(sp->origPtr);
 		sp->origPtr = NULL;
 	}
 
@@ -140,14 +287,17 @@ void freeSmpDataPtr(smpPtr_t *sp)
 
 void freeSmpData(sample_t *s)
 {
+	forgetSamplePeaks(s->dataPtr);
+
 	if (s->origDataPtr != NULL)
 	{
-		free(s->origDataPtr);
+		freeSmpDataMem(s->origDataPtr);
 		s->origDataPtr = NULL;
 	}
 
 	s->dataPtr = NULL;
 	s->isFixed = false;
+	setNewSmpDataVersion(s);
 }
 
 bool cloneSample(sample_t *src, sample_t *dst)
@@ -168,6 +318,7 @@ bool cloneSample(sample_t *src, sample_t *dst)
 		dst->origDataPtr = dst->dataPtr = NULL;
 		dst->isFixed = false;
 		dst->fixedPos = 0;
+		dst->dataGeneration = (uint32_t)SDL_AtomicAdd(&lastSmpDataGeneration, 1) + 1;
 
 		// if source sample isn't empty, allocate room and copy it over (and fix it)
 		if (src->length > 0 && src->dataPtr != NULL)
@@ -232,6 +383,8 @@ void fixSample(sample_t *s)
 	bool backwards;
 
 	ASSERT(s != NULL);
+	setNewSmpDataVersion(s); // (this ends every sample data edit)
+
 	if (s->dataPtr == NULL || s->length <= 0)
 	{
 		s->isFixed = false;
@@ -462,10 +615,22 @@ void fixSample(sample_t *s)
 	}
 }
 
+// fixSample() after hand-drawing, the peak pyramid was kept up to date while drawing
+void fixDrawnSample(sample_t *s)
+{
+	const uint32_t oldDataVersion = s->dataVersion;
+	fixSample(s);
+	keepSamplePeaks(s, oldDataVersion);
+}
+
 // restores interpolation tap samples after loop/end
 void unfixSample(sample_t *s)
 {
 	ASSERT(s != NULL);
+
+	invalidateSpectrogram(s->dataPtr); // the sample data is about to be modified
+	setNewSmpDataVersion(s); // (the new version also makes the peak pyramid stale)
+
 	if (s->dataPtr == NULL || !s->isFixed)
 		return; // empty sample or not fixed (f.ex. no loop)
 
@@ -485,6 +650,38 @@ void unfixSample(sample_t *s)
 	s->isFixed = false;
 }
 
+/* Copies sample data as if the sample was unfixed. The sample is only read, so this
+** can be used on a sample that is being played (f.ex. to prepare new sample data before
+** pausing the audio for a short moment to swap it in).
+*/
+void copyUnfixedSmpData(const sample_t *s, int8_t *dst, int32_t pos, int32_t length)
+{
+	if (s->dataPtr == NULL || length <= 0)
+		return;
+
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	memcpy(dst, &s->dataPtr[pos << sample16Bit], length << sample16Bit);
+
+	if (!s->isFixed)
+		return;
+
+	// put back the original samples that fixSample() replaced
+	const int32_t start = MAX(pos, s->fixedPos);
+	const int32_t end = MIN(pos+length, s->fixedPos+MAX_RIGHT_TAPS);
+
+	if (sample16Bit)
+	{
+		int16_t *dst16 = (int16_t *)dst;
+		for (int32_t i = start; i < end; i++)
+			dst16[i-pos] = s->fixedSmp[i-s->fixedPos];
+	}
+	else // 8-bit
+	{
+		for (int32_t i = start; i < end; i++)
+			dst[i-pos] = (int8_t)s->fixedSmp[i-s->fixedPos];
+	}
+}
+
 double getSampleValue(int8_t *smpData, int32_t position, bool sample16Bit)
 {
 	if (smpData == NULL)
@@ -697,7 +894,7 @@ static bool getCopyBuffer(int32_t size, bool sample16Bit)
 	return true;
 }
 
-static int32_t copySampleThread(void *ptr)
+static bool copySampleJob(job_t *job, void *data)
 {
 	pauseAudio();
 
@@ -718,7 +915,6 @@ static int32_t copySampleThread(void *ptr)
 
 	editor.updateCurSmp = true;
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
 	return true;
 
@@ -727,7 +923,8 @@ error:
 	okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void copySmp(void) // copy sample from srcInstr->srcSmp to curInstr->curSmp
@@ -735,15 +932,8 @@ void copySmp(void) // copy sample from srcInstr->srcSmp to curInstr->curSmp
 	if (editor.curInstr == 0 || (editor.curInstr == editor.srcInstr && editor.curSmp == editor.srcSmp))
 		return;
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(copySampleThread, "copy sample thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(copySampleJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
 void xchgSmp(void) // dstSmp <-> srcSmp
@@ -768,28 +958,40 @@ void xchgSmp(void) // dstSmp <-> srcSmp
 	setSongModifiedFlag();
 }
 
-static void writeRange(void)
+static bool getRangeScrSpan(int32_t rx1, int32_t rx2, int32_t *outStart, int32_t *outEnd)
 {
 	// very first sample (rx1=0,rx2=0) is the "no range" special case
-	if (!ui.sampleEditorShown || smpEd_ViewSize == 0 || (smpEd_Rx1 == 0 && smpEd_Rx2 == 0))
-		return;
+	if (smpEd_ViewSize == 0 || (rx1 == 0 && rx2 == 0))
+		return false;
 
 	// test if range is outside of view (passed it by scrolling)
-	int32_t start = smpPos2Scr(smpEd_Rx1);
+	int32_t start = smpPos2Scr(rx1);
 	if (start >= SAMPLE_AREA_WIDTH)
-		return;
+		return false;
 
 	// test if range is outside of view (passed it by scrolling)
-	int32_t end = smpPos2Scr(smpEd_Rx2);
+	int32_t end = smpPos2Scr(rx2);
 	if (end < 0)
-		return;
+		return false;
+
+	*outStart = CLAMP(start, 0, SAMPLE_AREA_WIDTH-1);
+	*outEnd = CLAMP(end, 0, SAMPLE_AREA_WIDTH-1);
 
-	start = CLAMP(start, 0, SAMPLE_AREA_WIDTH-1);
-	end = CLAMP(end, 0, SAMPLE_AREA_WIDTH-1);
+	return true;
+}
+
+static void writeRange(void)
+{
+	int32_t start, end;
+
+	if (!ui.sampleEditorShown || !getRangeScrSpan(smpEd_Rx1, smpEd_Rx2, &start, &end))
+		return;
 
 	int32_t rangeLen = (end + 1) - start;
 	ASSERT(start+rangeLen <= SCREEN_W);
 
+	markRectDirty(start, 174, rangeLen, SAMPLE_AREA_HEIGHT);
+
 	uint32_t *ptr32 = &video.frameBuffer[(174 * SCREEN_W) + start];
 	for (int32_t y = 0; y < SAMPLE_AREA_HEIGHT; y++)
 	{
@@ -851,6 +1053,8 @@ void sampleLine(int32_t x1, int32_t x2, int32_t y1, int32_t y2)
 	const int32_t pitch = sy * SCREEN_W;
 	uint32_t *dst32 = &video.frameBuffer[(y * SCREEN_W) + x];
 
+	markRectDirty(MIN(x1, x2), MIN(y1, y2), ABS(dx) + 1, ABS(dy) + 1);
+
 	// draw line
 	if (ax > ay)
 	{
@@ -912,185 +1116,6 @@ void sampleLine(int32_t x1, int32_t x2, int32_t y1, int32_t y2)
 	}
 }
 
-static void getMinMax16(const void *p, uint32_t scanLen, int16_t *min16, int16_t *max16)
-{
-#if defined _WIN32 || defined __amd64__ || (defined __i386__ && defined __SSE2__)
-	if (cpu.hasSSE2)
-	{
-		/* Taken with permission from the OpenMPT project (and slightly modified).
-		**
-		** SSE2 implementation for min/max finder, packs 8*int16 in a 128-bit XMM register.
-		** scanLen = How many samples to process
-		*/
-		const int16_t *p16;
-		uint32_t scanLen8;
-		const __m128i *v;
-		__m128i minVal, maxVal, minVal2, maxVal2, curVals;
-
-		// Put minimum / maximum in 8 packed int16 values
-		minVal = _mm_set1_epi16(32767);
-		maxVal = _mm_set1_epi16(-32768);
-
-		scanLen8 = scanLen / 8;
-		if (scanLen8 > 0)
-		{
-			v = (__m128i *)p;
-			p = (const __m128i *)p + scanLen8;
-
-			while (scanLen8--)
-			{
-				curVals = _mm_loadu_si128(v++);
-				minVal = _mm_min_epi16(minVal, curVals);
-				maxVal = _mm_max_epi16(maxVal, curVals);
-			}
-
-			/* Now we have 8 minima and maxima each.
-			** Move the upper 4 values to the lower half and compute the minima/maxima of that. */
-			minVal2 = _mm_unpackhi_epi64(minVal, minVal);
-			maxVal2 = _mm_unpackhi_epi64(maxVal, maxVal);
-			minVal = _mm_min_epi16(minVal, minVal2);
-			maxVal = _mm_max_epi16(maxVal, maxVal2);
-
-			/* Now we have 4 minima and maxima each.
-			** Move the upper 2 values to the lower half and compute the minima/maxima of that. */
-			minVal2 = _mm_shuffle_epi32(minVal, _MM_SHUFFLE(1, 1, 1, 1));
-			maxVal2 = _mm_shuffle_epi32(maxVal, _MM_SHUFFLE(1, 1, 1, 1));
-			minVal = _mm_min_epi16(minVal, minVal2);
-			maxVal = _mm_max_epi16(maxVal, maxVal2);
-
-			// Compute the minima/maxima of the both remaining values
-			minVal2 = _mm_shufflelo_epi16(minVal, _MM_SHUFFLE(1, 1, 1, 1));
-			maxVal2 = _mm_shufflelo_epi16(maxVal, _MM_SHUFFLE(1, 1, 1, 1));
-			minVal = _mm_min_epi16(minVal, minVal2);
-			maxVal = _mm_max_epi16(maxVal, maxVal2);
-		}
-
-		p16 = (const int16_t *)p;
-		while (scanLen-- & 7)
-		{
-			curVals = _mm_set1_epi16(*p16++);
-			minVal = _mm_min_epi16(minVal, curVals);
-			maxVal = _mm_max_epi16(maxVal, curVals);
-		}
-
-		*min16 = (int16_t)_mm_cvtsi128_si32(minVal);
-		*max16 = (int16_t)_mm_cvtsi128_si32(maxVal);
-	}
-	else
-#endif
-	{
-		// non-SSE version (really slow for big samples while zoomed out)
-		int16_t minVal =  32767;
-		int16_t maxVal = -32768;
-
-		const int16_t *ptr16 = (const int16_t *)p;
-		for (uint32_t i = 0; i < scanLen; i++)
-		{
-			const int16_t smp16 = ptr16[i];
-			if (smp16 < minVal) minVal = smp16;
-			if (smp16 > maxVal) maxVal = smp16;
-		}
-
-		*min16 = minVal;
-		*max16 = maxVal;
-	}
-}
-
-static void getMinMax8(const void *p, uint32_t scanLen, int8_t *min8, int8_t *max8)
-{
-#if defined _WIN32 || defined __amd64__ || (defined __i386__ && defined __SSE2__)
-	if (cpu.hasSSE2)
-	{
-		/* Taken with permission from the OpenMPT project (and slightly modified).
-		**
-		** SSE2 implementation for min/max finder, packs 16*int8 in a 128-bit XMM register.
-		** scanLen = How many samples to process
-		*/
-		const int8_t *p8;
-		uint32_t scanLen16;
-		const __m128i *v;
-		__m128i xorVal, minVal, maxVal, minVal2, maxVal2, curVals;
-
-		// Put minimum / maximum in 8 packed int16 values (-1 and 0 because unsigned)
-		minVal = _mm_set1_epi8(-1);
-		maxVal = _mm_set1_epi8(0);
-
-		// For signed <-> unsigned conversion (_mm_min_epi8/_mm_max_epi8 is SSE4)
-		xorVal = _mm_set1_epi8(0x80);
-
-		scanLen16 = scanLen / 16;
-		if (scanLen16 > 0)
-		{
-			v = (__m128i *)p;
-			p = (const __m128i *)p + scanLen16;
-
-			while (scanLen16--)
-			{
-				curVals = _mm_loadu_si128(v++);
-				curVals = _mm_xor_si128(curVals, xorVal);
-				minVal = _mm_min_epu8(minVal, curVals);
-				maxVal = _mm_max_epu8(maxVal, curVals);
-			}
-
-			/* Now we have 16 minima and maxima each.
-			** Move the upper 8 values to the lower half and compute the minima/maxima of that. */
-			minVal2 = _mm_unpackhi_epi64(minVal, minVal);
-			maxVal2 = _mm_unpackhi_epi64(maxVal, maxVal);
-			minVal = _mm_min_epu8(minVal, minVal2);
-			maxVal = _mm_max_epu8(maxVal, maxVal2);
-
-			/* Now we have 8 minima and maxima each.
-			** Move the upper 4 values to the lower half and compute the minima/maxima of that. */
-			minVal2 = _mm_shuffle_epi32(minVal, _MM_SHUFFLE(1, 1, 1, 1));
-			maxVal2 = _mm_shuffle_epi32(maxVal, _MM_SHUFFLE(1, 1, 1, 1));
-			minVal = _mm_min_epu8(minVal, minVal2);
-			maxVal = _mm_max_epu8(maxVal, maxVal2);
-
-			/* Now we have 4 minima and maxima each.
-			** Move the upper 2 values to the lower half and compute the minima/maxima of that. */
-			minVal2 = _mm_srai_epi32(minVal, 16);
-			maxVal2 = _mm_srai_epi32(maxVal, 16);
-			minVal = _mm_min_epu8(minVal, minVal2);
-			maxVal = _mm_max_epu8(maxVal, maxVal2);
-
-			// Compute the minima/maxima of the both remaining values
-			minVal2 = _mm_srai_epi16(minVal, 8);
-			maxVal2 = _mm_srai_epi16(maxVal, 8);
-			minVal = _mm_min_epu8(minVal, minVal2);
-			maxVal = _mm_max_epu8(maxVal, maxVal2);
-		}
-
-		p8 = (const int8_t *)p;
-		while (scanLen-- & 15)
-		{
-			curVals = _mm_set1_epi8(*p8++ ^ 0x80);
-			minVal = _mm_min_epu8(minVal, curVals);
-			maxVal = _mm_max_epu8(maxVal, curVals);
-		}
-
-		*min8 = (int8_t)(_mm_cvtsi128_si32(minVal) ^ 0x80);
-		*max8 = (int8_t)(_mm_cvtsi128_si32(maxVal) ^ 0x80);
-	}
-	else
-#endif
-	{
-		// non-SSE version (really slow for big samples while zoomed out)
-		int8_t minVal =  127;
-		int8_t maxVal = -128;
-
-		const int8_t *ptr8 = (const int8_t *)p;
-		for (uint32_t i = 0; i < scanLen; i++)
-		{
-			const int8_t smp8 = ptr8[i];
-			if (smp8 < minVal) minVal = smp8;
-			if (smp8 > maxVal) maxVal = smp8;
-		}
-
-		*min8 = minVal;
-		*max8 = maxVal;
-	}
-}
-
 // for scanning sample data peak where loopEnd+MAX_RIGHT_TAPS is within scan range (fixed interpolation tap samples)
 static void getSpecialMinMax16(sample_t *s, int32_t index, int32_t scanEnd, int16_t *min16, int16_t *max16)
 {
@@ -1181,64 +1206,502 @@ static void getSpecialMinMax8(sample_t *s, int32_t index, int32_t scanEnd, int8_
 	*max8 = maxVal;
 }
 
-static void getSampleDataPeak(sample_t *s, int32_t index, int32_t length, int16_t *outMin, int16_t *outMax)
+// gets min/max of the original (unfixed) sample data. 8-bit samples are returned as 16-bit (<< 8)
+void getRawSamplePeak(sample_t *s, int32_t index, int32_t length, int16_t *outMin, int16_t *outMax)
 {
 	int8_t min8, max8;
 	int16_t min16, max16;
 
+	if (s->isFixed && s->length > s->loopLength+s->loopStart)
+	{
+		const int32_t scanEnd = index + length;
+
+		/* If the scan area is including the fixed samples (for branchless mixer interpolation),
+		** do a special procedure to scan the original non-touched samples when needed.
+		*/
+		const bool insideRange = index >= s->fixedPos && index < s->fixedPos+MAX_RIGHT_TAPS;
+		if (insideRange || (index < s->fixedPos && scanEnd >= s->fixedPos))
+		{
+			if (s->flags & SAMPLE_16BIT)
+			{
+				getSpecialMinMax16(s, index, scanEnd, &min16, &max16);
+				*outMin = min16;
+				*outMax = max16;
+			}
+			else // 8-bit
+			{
+				getSpecialMinMax8(s, index, scanEnd, &min8, &max8);
+				*outMin = min8 << 8;
+				*outMax = max8 << 8;
+			}
+
+			return;
+		}
+	}
+
+	if (s->flags & SAMPLE_16BIT)
+	{
+		const int16_t *smpPtr16 = (int16_t *)s->dataPtr;
+		getMinMax16(&smpPtr16[index], length, &min16, &max16);
+		*outMin = min16;
+		*outMax = max16;
+	}
+	else // 8-bit
+	{
+		getMinMax8(&s->dataPtr[index], length, &min8, &max8);
+		*outMin = min8 << 8;
+		*outMax = max8 << 8;
+	}
+}
+
+/* Min/max peak pyramid for the sample editor's zoomed out view.
+**
+** Level 0 holds the min/max of every PEAK_BLOCK_LEN sample frames, and every
+** level above holds the min/max of PEAK_LEVEL_FACTOR entries of the level below.
+** A column of any size can then be scanned with a few raw frames at the edges
+** and a handful of pyramid entries, instead of reading all of its sample data.
+**
+** It's only made for big samples, and only for the sample shown in the editor.
+** Building is done in time slices from handleSamplerRedrawing(), so it never
+** stalls the GUI (and it's never done while a sample job is working, since
+** the sample data may be reallocated then). Until it's done, the sample data is
+** scanned directly like before. It's keyed by the sample data pointer/length/bit
+** depth, freeing/reallocating the data forgets it, and it's rebuilt when the
+** sample's dataVersion changes (unfixSample()/fixSample() around every edit).
+** Hand-drawing only updates the blocks under the stroke instead
+** (invalidateSamplePeakRange()), and then lets the pyramid follow the new
+** dataVersion (keepSamplePeaks()).
+*/
+#define PEAK_BLOCK_BITS 8
+#define PEAK_BLOCK_LEN (1 << PEAK_BLOCK_BITS)
+#define PEAK_LEVEL_BITS 2
+#define PEAK_LEVEL_FACTOR (1 << PEAK_LEVEL_BITS)
+#define MAX_PEAK_LEVELS 16
+#define PEAK_MIN_SAMPLE_LEN (1024*1024) /* smaller samples are fast enough to scan directly */
+#define PEAK_BUILD_FRAMES_PER_STEP (4*1024*1024)
+#define PEAK_MAX_SYNC_UPDATE_LEN (256*1024) /* bigger edits are rebuilt in time slices */
+
+typedef struct peak_t
+{
+	int16_t min, max;
+} peak_t;
+
+static struct
+{
+	volatile bool ready;
+	bool is16Bit;
+	const int8_t *dataPtr;
+	uint32_t dataVersion;
+	int32_t length, numLevels, levelLength[MAX_PEAK_LEVELS], builtBlocks;
+	peak_t *buffer, *level[MAX_PEAK_LEVELS];
+} smpPeaks;
+
+void freeSamplePeaks(void)
+{
+	smpPeaks.ready = false;
+	smpPeaks.dataPtr = NULL;
+	smpPeaks.length = 0;
+	smpPeaks.builtBlocks = 0;
+
+	if (smpPeaks.buffer != NULL)
+	{
+		free(smpPeaks.buffer);
+		smpPeaks.buffer = NULL;
+	}
+}
+
+// called when sample data is freed or reallocated (can happen in other threads)
+static void forgetSamplePeaks(const int8_t *dataPtr)
+{
+	invalidateSpectrogram(dataPtr);
+
+	if (dataPtr != NULL && dataPtr == smpPeaks.dataPtr)
+	{
+		smpPeaks.ready = false;
+		smpPeaks.dataPtr = NULL;
+	}
+}
+
+static void invalidateSamplePeaks(sample_t *s)
+{
+	invalidateSpectrogram(s->dataPtr);
+
+	if (s->dataPtr != NULL && s->dataPtr == smpPeaks.dataPtr)
+	{
+		smpPeaks.ready = false;
+		smpPeaks.builtBlocks = 0;
+	}
+}
+
+static bool samplePeaksMatch(const sample_t *s)
+{
+	return smpPeaks.dataPtr != NULL && s->dataPtr == smpPeaks.dataPtr && s->length == smpPeaks.length &&
+	       !!(s->flags & SAMPLE_16BIT) == smpPeaks.is16Bit;
+}
+
+static bool samplePeaksCurrent(const sample_t *s)
+{
+	return samplePeaksMatch(s) && s->dataVersion == smpPeaks.dataVersion;
+}
+
+// the caller has updated the edited range itself, so don't rebuild the pyramid for the new dataVersion
+static void keepSamplePeaks(const sample_t *s, uint32_t oldDataVersion)
+{
+	if (samplePeaksMatch(s) && smpPeaks.dataVersion == oldDataVersion)
+		smpPeaks.dataVersion = s->dataVersion;
+}
+
+static bool setupSamplePeaks(sample_t *s)
+{
+	freeSamplePeaks();
+
+	int32_t numEntries = 0;
+	int32_t levelLen = (s->length + (PEAK_BLOCK_LEN-1)) >> PEAK_BLOCK_BITS;
+
+	smpPeaks.numLevels = 0;
+	while (smpPeaks.numLevels < MAX_PEAK_LEVELS)
+	{
+		smpPeaks.levelLength[smpPeaks.numLevels++] = levelLen;
+		numEntries += levelLen;
+
+		if (levelLen <= PEAK_LEVEL_FACTOR)
+			break;
+
+		levelLen = (levelLen + (PEAK_LEVEL_FACTOR-1)) >> PEAK_LEVEL_BITS;
+	}
+
+	smpPeaks.buffer = (peak_t *)malloc(numEntries * sizeof (peak_t));
+	if (smpPeaks.buffer == NULL)
+		return false;
+
+	peak_t *p = smpPeaks.buffer;
+	for (int32_t i = 0; i < smpPeaks.numLevels; i++)
+	{
+		smpPeaks.level[i] = p;
+		p += smpPeaks.levelLength[i];
+	}
+
+	smpPeaks.dataPtr = s->dataPtr;
+	smpPeaks.length = s->length;
+	smpPeaks.is16Bit = !!(s->flags & SAMPLE_16BIT);
+	smpPeaks.dataVersion = s->dataVersion;
+	smpPeaks.builtBlocks = 0;
+
+	return true;
+}
+
+static void buildPeakBlocks(sample_t *s, int32_t firstBlock, int32_t lastBlock) // level 0, lastBlock is inclusive
+{
+	peak_t *p = &smpPeaks.level[0][firstBlock];
+	for (int32_t i = firstBlock; i <= lastBlock; i++, p++)
+	{
+		const int32_t pos = i << PEAK_BLOCK_BITS;
+		getRawSamplePeak(s, pos, MIN(PEAK_BLOCK_LEN, s->length - pos), &p->min, &p->max);
+	}
+}
+
+static void buildPeakParents(int32_t firstBlock, int32_t lastBlock) // updates all levels above level 0
+{
+	for (int32_t l = 1; l < smpPeaks.numLevels; l++)
+	{
+		firstBlock >>= PEAK_LEVEL_BITS;
+		lastBlock >>= PEAK_LEVEL_BITS;
+
+		const peak_t *src = smpPeaks.level[l-1];
+		const int32_t srcLen = smpPeaks.levelLength[l-1];
+
+		for (int32_t i = firstBlock; i <= lastBlock; i++)
+		{
+			int16_t minVal = 32767, maxVal = -32768;
+
+			const int32_t end = MIN((i + 1) << PEAK_LEVEL_BITS, srcLen);
+			for (int32_t j = i << PEAK_LEVEL_BITS; j < end; j++)
+			{
+				if (src[j].min < minVal) minVal = src[j].min;
+				if (src[j].max > maxVal) maxVal = src[j].max;
+			}
+
+			smpPeaks.level[l][i].min = minVal;
+			smpPeaks.level[l][i].max = maxVal;
+		}
+	}
+}
+
+static void invalidateSamplePeakRange(sample_t *s, int32_t pos, int32_t length)
+{
+	invalidateSpectrogram(s->dataPtr);
+
+	if (!samplePeaksMatch(s) || length <= 0)
+		return;
+
+	if (length > PEAK_MAX_SYNC_UPDATE_LEN)
+	{
+		invalidateSamplePeaks(s);
+		return;
+	}
+
+	const int32_t firstBlock = MAX(pos, 0) >> PEAK_BLOCK_BITS;
+	int32_t lastBlock = (MIN(pos + length, s->length) - 1) >> PEAK_BLOCK_BITS;
+
+	// blocks that aren't built yet will be done by the time-sliced building anyway
+	if (lastBlock >= smpPeaks.builtBlocks)
+		lastBlock = smpPeaks.builtBlocks - 1;
+
+	if (firstBlock > lastBlock)
+		return;
+
+	buildPeakBlocks(s, firstBlock, lastBlock);
+	if (smpPeaks.ready)
+		buildPeakParents(firstBlock, lastBlock);
+}
+
+bool samplePeaksPending(void) // true if the peak pyramid for the shown sample is being built
+{
+	if (!ui.sampleEditorShown || editor.busy || instr[editor.curInstr] == NULL)
+		return false;
+
+	const sample_t *s = &instr[editor.curInstr]->smp[editor.curSmp];
+	if (s->dataPtr == NULL || s->length < PEAK_MIN_SAMPLE_LEN)
+		return false;
+
+	return !smpPeaks.ready || !samplePeaksCurrent(s);
+}
+
+static void buildSamplePeaksStep(void)
+{
+	if (!samplePeaksPending())
+		return;
+
+	sample_t *s = &instr[editor.curInstr]->smp[editor.curSmp];
+	if (!samplePeaksMatch(s))
+	{
+		if (!setupSamplePeaks(s))
+		{
+			freeSamplePeaks(); // out of memory, just keep scanning the sample data directly
+			return;
+		}
+	}
+	else if (s->dataVersion != smpPeaks.dataVersion) // the sample data was edited, start over
+	{
+		smpPeaks.ready = false;
+		smpPeaks.dataVersion = s->dataVersion;
+		smpPeaks.builtBlocks = 0;
+	}
+
+	const int32_t numBlocks = smpPeaks.levelLength[0];
+	const int32_t lastBlock = MIN(smpPeaks.builtBlocks + (PEAK_BUILD_FRAMES_PER_STEP / PEAK_BLOCK_LEN), numBlocks) - 1;
+
+	buildPeakBlocks(s, smpPeaks.builtBlocks, lastBlock);
+	smpPeaks.builtBlocks = lastBlock + 1;
+
+	if (smpPeaks.builtBlocks >= numBlocks)
+	{
+		buildPeakParents(0, numBlocks - 1);
+		smpPeaks.ready = true;
+	}
+}
+
+static bool getPeakFromPyramid(sample_t *s, int32_t index, int32_t length, int16_t *outMin, int16_t *outMax)
+{
+	if (!smpPeaks.ready || editor.busy || !samplePeaksCurrent(s))
+		return false;
+
+	const int32_t scanEnd = index + length;
+
+	int32_t b0 = (index + (PEAK_BLOCK_LEN-1)) >> PEAK_BLOCK_BITS;
+	int32_t b1 = scanEnd >> PEAK_BLOCK_BITS;
+	if (b1 <= b0)
+		return false; // not a single full block in range
+
+	int16_t minVal, maxVal, min2, max2;
+
+	// unaligned edges are read from the sample data
+
+	minVal = 32767;
+	maxVal = -32768;
+
+	const int32_t headEnd = b0 << PEAK_BLOCK_BITS;
+	if (index < headEnd)
+	{
+		getRawSamplePeak(s, index, headEnd - index, &min2, &max2);
+		if (min2 < minVal) minVal = min2;
+		if (max2 > maxVal) maxVal = max2;
+	}
+
+	const int32_t tailStart = b1 << PEAK_BLOCK_BITS;
+	if (tailStart < scanEnd)
+	{
+		getRawSamplePeak(s, tailStart, scanEnd - tailStart, &min2, &max2);
+		if (min2 < minVal) minVal = min2;
+		if (max2 > maxVal) maxVal = max2;
+	}
+
+	// full blocks, use the highest level possible for every part of the range
+
+	for (int32_t l = 0; b0 < b1; l++)
+	{
+		const peak_t *p = smpPeaks.level[l];
+
+		if (l == smpPeaks.numLevels-1)
+		{
+			for (; b0 < b1; b0++)
+			{
+				if (p[b0].min < minVal) minVal = p[b0].min;
+				if (p[b0].max > maxVal) maxVal = p[b0].max;
+			}
+
+			break;
+		}
+
+		for (; b0 < b1 && (b0 & (PEAK_LEVEL_FACTOR-1)); b0++)
+		{
+			if (p[b0].min < minVal) minVal = p[b0].min;
+			if (p[b0].max > maxVal) maxVal = p[b0].max;
+		}
+
+		for (; b1 > b0 && (b1 & (PEAK_LEVEL_FACTOR-1)); b1--)
+		{
+			if (p[b1-1].min < minVal) minVal = p[b1-1].min;
+			if (p[b1-1].max > maxVal) maxVal = p[b1-1].max;
+		}
+
+		b0 >>= PEAK_LEVEL_BITS;
+		b1 >>= PEAK_LEVEL_BITS;
+	}
+
+	*outMin = minVal;
+	*outMax = maxVal;
+
+	return true;
+}
+
+static void getSampleDataPeak(sample_t *s, int32_t index, int32_t length, int16_t *outMin, int16_t *outMax)
+{
+	int16_t min16, max16;
+
 	if (length == 0 || s->dataPtr == NULL || s->length <= 0)
 	{
-		*outMin = SAMPLE_AREA_Y_CENTER;
-		*outMax = SAMPLE_AREA_Y_CENTER;
+		*outMin = SAMPLE_AREA_Y_CENTER;
+		*outMax = SAMPLE_AREA_Y_CENTER;
+		return;
+	}
+
+	if (!getPeakFromPyramid(s, index, length, &min16, &max16))
+		getRawSamplePeak(s, index, length, &min16, &max16);
+
+	*outMin = SAMPLE_AREA_Y_CENTER - ((min16 * SAMPLE_AREA_HEIGHT) >> 16);
+	*outMax = SAMPLE_AREA_Y_CENTER - ((max16 * SAMPLE_AREA_HEIGHT) >> 16);
+}
+
+/* Draws the finished spectrogram columns x1..x2-1. Columns drawn after the range
+** and the sample position line get the mark/inverted color bits set directly,
+** so that the XOR done when these are removed again gives the right color.
+*/
+static void drawSpectrogramColumns(int32_t x1, int32_t x2, bool markAndPosLine)
+{
+	int32_t rangeStart = -1, rangeEnd = -1;
+	if (markAndPosLine && !getRangeScrSpan(old_Rx1, old_Rx2, &rangeStart, &rangeEnd))
+		rangeStart = rangeEnd = -1;
+
+	for (int32_t x = x1; x < x2; x++)
+	{
+		const uint8_t *levels = getSpectrogramColumn(x);
+		if (levels == NULL)
+			break;
+
+		uint32_t palBits = 0;
+		if (markAndPosLine)
+		{
+			if (x >= rangeStart && x <= rangeEnd)
+				palBits |= 2;
+
+			if (x == smpEd_OldSmpPosLine)
+				palBits |= 1;
+		}
+
+		uint32_t *ptr32 = &video.frameBuffer[(174 * SCREEN_W) + x];
+		for (int32_t y = 0; y < SAMPLE_AREA_HEIGHT; y++, ptr32 += SCREEN_W)
+			*ptr32 = video.palette[PAL_SPECTRUM + (levels[y] * 4) + palBits];
+	}
+
+	if (x2 > x1)
+		markRectDirty(x1, 174, x2 - x1, SAMPLE_AREA_HEIGHT);
+}
+
+static void writeSpectrogram(void) // the sample data area has been cleared
+{
+	spectroColumnsDrawn = 0;
+	spectroRequestPending = false;
+
+	if (editor.busy) // the sample data could be changing, try again when it's done
+	{
+		spectroRequestPending = true;
 		return;
 	}
 
-	if (s->isFixed && s->length > s->loopLength+s->loopStart)
+	if (instr[editor.curInstr] == NULL || smpEd_ViewSize == 0)
 	{
-		const int32_t scanEnd = index + length;
+		requestSpectrogram(NULL, 0, 0, NULL); // nothing to show
+		return;
+	}
 
-		/* If the scan area is including the fixed samples (for branchless mixer interpolation),
-		** do a special procedure to scan the original non-touched samples when needed.
-		*/
-		const bool insideRange = index >= s->fixedPos && index < s->fixedPos+MAX_RIGHT_TAPS;
-		if (insideRange || (index < s->fixedPos && scanEnd >= s->fixedPos))
-		{
-			if (s->flags & SAMPLE_16BIT)
-			{
-				getSpecialMinMax16(s, index, scanEnd, &min16, &max16);
-				*outMin = SAMPLE_AREA_Y_CENTER - ((min16 * SAMPLE_AREA_HEIGHT) >> 16);
-				*outMax = SAMPLE_AREA_Y_CENTER - ((max16 * SAMPLE_AREA_HEIGHT) >> 16);
-			}
-			else // 8-bit
-			{
-				getSpecialMinMax8(s, index, scanEnd, &min8, &max8);
-				*outMin = SAMPLE_AREA_Y_CENTER - ((min8 * SAMPLE_AREA_HEIGHT) >> 8);
-				*outMax = SAMPLE_AREA_Y_CENTER - ((max8 * SAMPLE_AREA_HEIGHT) >> 8);
-			}
+	sample_t *s = &instr[editor.curInstr]->smp[editor.curSmp];
 
-			return;
-		}
-	}
+	int32_t colPos[SAMPLE_AREA_WIDTH+1];
+	for (int32_t x = 0; x <= SAMPLE_AREA_WIDTH; x++)
+		colPos[x] = scr2SmpPos(x);
 
-	if (s->flags & SAMPLE_16BIT)
+	requestSpectrogram(s, smpEd_ScrPos, smpEd_ViewSize, colPos);
+
+	spectroColumnsDrawn = getSpectrogramColumnsDone();
+	drawSpectrogramColumns(0, spectroColumnsDrawn, false);
+}
+
+static void updateSpectrogram(void) // draws the columns the spectrogram thread has finished since the last frame
+{
+	if (spectroRequestPending)
 	{
-		const int16_t *smpPtr16 = (int16_t *)s->dataPtr;
-		getMinMax16(&smpPtr16[index], length, &min16, &max16);
-		*outMin = SAMPLE_AREA_Y_CENTER - ((min16 * SAMPLE_AREA_HEIGHT) >> 16);
-		*outMax = SAMPLE_AREA_Y_CENTER - ((max16 * SAMPLE_AREA_HEIGHT) >> 16);
+		if (!editor.busy)
+			writeSample(FORCE_SAMPLE_REDRAW);
+
+		return;
 	}
-	else // 8-bit
+
+	const int32_t columnsDone = getSpectrogramColumnsDone();
+	if (columnsDone > spectroColumnsDrawn)
 	{
-		getMinMax8(&s->dataPtr[index], length, &min8, &max8);
-		*outMin = SAMPLE_AREA_Y_CENTER - ((min8 * SAMPLE_AREA_HEIGHT) >> 8);
-		*outMax = SAMPLE_AREA_Y_CENTER - ((max8 * SAMPLE_AREA_HEIGHT) >> 8);
+		drawSpectrogramColumns(spectroColumnsDrawn, columnsDone, true);
+		spectroColumnsDrawn = columnsDone;
 	}
 }
 
+bool sampleSpectrogramPending(void)
+{
+	if (!showSpectrogram || !ui.sampleEditorShown)
+		return false;
+
+	return spectroRequestPending || spectrogramWorkerActive() || spectroColumnsDrawn < getSpectrogramColumnsDone();
+}
+
+void toggleSampleSpectrogram(void)
+{
+	showSpectrogram ^= 1;
+
+	if (ui.sampleEditorShown)
+		writeSample(FORCE_SAMPLE_REDRAW);
+}
+
 static void writeWaveform(void)
 {
 	// clear sample data area
 	memset(&video.frameBuffer[174 * SCREEN_W], 0, SAMPLE_AREA_WIDTH * SAMPLE_AREA_HEIGHT * sizeof (int32_t));
+	markRectDirty(0, 174, SAMPLE_AREA_WIDTH, SAMPLE_AREA_HEIGHT);
+
+	if (showSpectrogram)
+	{
+		writeSpectrogram();
+		return;
+	}
 
 	// draw center line
 	hLine(0, SAMPLE_AREA_Y_CENTER, SAMPLE_AREA_WIDTH, PAL_DESKTOP);
@@ -1873,87 +2336,90 @@ void saveRange(void)
 	free(filenameU);
 }
 
-static bool cutRange(bool cropMode, int32_t r1, int32_t r2)
+// adjusts the loop points for a removal of r1..r2 (newLength = length after removal)
+static void cutLoopPoints(sample_t *s, int32_t r1, int32_t r2, int32_t newLength)
 {
-	sample_t *s = getCurSample();
-	if (s == NULL)
-		return false;
+	int32_t loopEnd = s->loopStart + s->loopLength;
+	if (s->loopStart > r1)
+	{
+		s->loopStart -= r2-r1;
+		if (s->loopStart < r1)
+			s->loopStart = r1;
+	}
 
-	bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	if (loopEnd > r1)
+	{
+		loopEnd -= r2-r1;
+		if (loopEnd < r1)
+			loopEnd = r1;
+	}
+
+	s->loopLength = loopEnd - s->loopStart;
+	if (s->loopLength < 0)
+		s->loopLength = 0;
 
-	if (!cropMode)
+	if (s->loopStart+s->loopLength > newLength)
+		s->loopLength = newLength - s->loopStart;
+
+	if (s->loopLength <= 0)
 	{
-		if (editor.curInstr == 0 || s->dataPtr == NULL || s->length == 0)
-			return false;
+		s->loopStart = 0;
+		DISABLE_LOOP(s->flags);
+	}
+}
 
-		pauseAudio();
-		unfixSample(s);
+/* Range edits (cut/crop/paste) build the new sample data in a new buffer while the
+** old data can still be played, so the audio is only paused while the buffers are
+** swapped (and not while copying the data, which takes a while on long samples).
+*/
+static void swapInNewSmpData(sample_t *s, smpPtr_t *sp, int32_t newLength) // pauses audio, call fixSample()/resumeAudio() after
+{
+	pauseAudio();
 
-		if (config.smpCutToBuffer)
-		{
-			if (!getCopyBuffer(r2-r1, sample16Bit))
-			{
-				fixSample(s);
-				resumeAudio();
+	freeSmpData(s);
+	setSmpDataPtr(s, sp);
+	s->length = newLength;
+}
 
-				okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
-				return false;
-			}
+static bool cutRange(int32_t r1, int32_t r2)
+{
+	smpPtr_t sp;
 
-			memcpy(smpCopyBuff, &s->dataPtr[r1 << sample16Bit], (r2-r1) << sample16Bit);
-			smpCopyBits = sample16Bit ? 16 : 8;
-		}
-	}
+	sample_t *s = getCurSample();
+	if (s == NULL || editor.curInstr == 0 || s->dataPtr == NULL || s->length == 0)
+		return false;
 
-	memmove(&s->dataPtr[r1 << sample16Bit], &s->dataPtr[r2 << sample16Bit], (s->length-r2) << sample16Bit);
+	bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
 
-	int32_t length = s->length - r2+r1;
-	if (length > 0)
+	if (config.smpCutToBuffer)
 	{
-		if (!reallocateSmpData(s, length, sample16Bit))
+		if (!getCopyBuffer(r2-r1, sample16Bit))
 		{
-			freeSample(editor.curInstr, editor.curSmp);
-			editor.updateCurSmp = true;
-
-			if (!cropMode)
-				resumeAudio();
-
 			okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
 			return false;
 		}
 
-		s->length = length;
-
-		int32_t loopEnd = s->loopStart + s->loopLength;
-		if (s->loopStart > r1)
-		{
-			s->loopStart -= r2-r1;
-			if (s->loopStart < r1)
-				s->loopStart = r1;
-		}
+		copyUnfixedSmpData(s, smpCopyBuff, r1, r2-r1);
+		smpCopyBits = sample16Bit ? 16 : 8;
+	}
 
-		if (loopEnd > r1)
+	int32_t length = s->length - r2+r1;
+	if (length > 0)
+	{
+		if (!allocateSmpDataPtr(&sp, length, sample16Bit))
 		{
-			loopEnd -= r2-r1;
-			if (loopEnd < r1)
-				loopEnd = r1;
+			okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
+			return false;
 		}
 
-		s->loopLength = loopEnd - s->loopStart;
-		if (s->loopLength < 0)
-			s->loopLength = 0;
-
-		if (s->loopStart+s->loopLength > length)
-			s->loopLength = length - s->loopStart;
-
-		if (s->loopLength <= 0)
-		{
-			s->loopStart = 0;
-			DISABLE_LOOP(s->flags);
-		}
+		copyUnfixedSmpData(s, sp.ptr, 0, r1);
+		copyUnfixedSmpData(s, &sp.ptr[r1 << sample16Bit], r2, s->length-r2);
 
-		if (!cropMode)
-			fixSample(s);
+		swapInNewSmpData(s, &sp, length);
+		cutLoopPoints(s, r1, r2, length);
+		fixSample(s);
+		setSampleUndoEditRange(r1, length - r1);
+		resumeAudio();
 	}
 	else
 	{
@@ -1961,30 +2427,27 @@ static bool cutRange(bool cropMode, int32_t r1, int32_t r2)
 		editor.updateCurSmp = true;
 	}
 
-	if (!cropMode)
-	{
-		resumeAudio();
-		setSongModifiedFlag();
-
-		setMouseBusy(false);
+	setSongModifiedFlag();
 
-		smpEd_Rx2 = r1;
-		writeSampleFlag = true;
-	}
+	smpEd_Rx2 = r1;
+	writeSampleFlag = true;
 
 	return true;
 }
 
-static int32_t sampCutThread(void *ptr)
+static bool sampCutJob(job_t *job, void *data)
 {
-	if (!cutRange(false, smpEd_Rx1, smpEd_Rx2))
+	fillSampleUndo(REMOVE_SAMPLE_MARK);
+
+	if (!cutRange(smpEd_Rx1, smpEd_Rx2))
 		okBoxThreadSafe(0, "System message", "Not enough memory! (Disable \"cut to buffer\")", NULL);
 	else
 		writeSampleFlag = true;
 
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void sampCut(void)
@@ -1993,18 +2456,11 @@ void sampCut(void)
 	if (s == NULL || s->dataPtr == NULL || s->length <= 0 || smpEd_Rx2 == 0 || smpEd_Rx2 < smpEd_Rx1)
 		return;
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(sampCutThread, "sample cut thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(sampCutJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
-static int32_t sampCopyThread(void *ptr)
+static bool sampCopyJob(job_t *job, void *data)
 {
 	sample_t *s = getCurSample();
 
@@ -2020,7 +2476,6 @@ static int32_t sampCopyThread(void *ptr)
 	memcpy(smpCopyBuff, &s->dataPtr[smpEd_Rx1 << sample16Bit], (smpEd_Rx2-smpEd_Rx1) << sample16Bit);
 	fixSample(s);
 
-	setMouseBusy(false);
 
 	// copy sample information (in case we paste over an empty sample)
 	if (smpEd_Rx1 == 0 && smpEd_Rx2 == s->length)
@@ -2032,7 +2487,8 @@ static int32_t sampCopyThread(void *ptr)
 	smpCopyBits = sample16Bit? 16 : 8;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void sampCopy(void)
@@ -2041,30 +2497,25 @@ void sampCopy(void)
 	if (s == NULL || s->dataPtr == NULL || s->length <= 0 || smpEd_Rx2 == 0 || smpEd_Rx2 < smpEd_Rx1)
 		return;
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(sampCopyThread, "sample copy thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(sampCopyJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
 static void pasteOverwrite(sample_t *s)
 {
+	smpPtr_t sp;
+
 	bool sample16Bit = (smpCopyBits == 16);
 
-	if (!reallocateSmpData(s, smpCopySize, sample16Bit))
+	if (!allocateSmpDataPtr(&sp, smpCopySize, sample16Bit))
 	{
 		okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
 		return;
 	}
 
-	pauseAudio();
+	memcpy(sp.ptr, smpCopyBuff, smpCopySize << sample16Bit);
 
-	memcpy(s->dataPtr, smpCopyBuff, smpCopySize << sample16Bit);
+	swapInNewSmpData(s, &sp, smpCopySize);
 
 	if (smpCopyDidCopyWholeSample)
 	{
@@ -2092,14 +2543,11 @@ static void pasteOverwrite(sample_t *s)
 		s->flags = (smpCopyBits == 16) ? SAMPLE_16BIT : 0;
 	}
 
-	s->isFixed = false;
-
 	fixSample(s);
 	resumeAudio();
 
 	editor.updateCurSmp = true;
 	setSongModifiedFlag();
-	setMouseBusy(false);
 }
 
 static void pasteCopiedData(int8_t *dataPtr, int32_t offset, int32_t length, bool sample16Bit)
@@ -2138,7 +2586,7 @@ static void pasteCopiedData(int8_t *dataPtr, int32_t offset, int32_t length, boo
 	}
 }
 
-static int32_t sampPasteThread(void *ptr)
+static bool sampPasteJob(job_t *job, void *data)
 {
 	smpPtr_t sp;
 
@@ -2148,6 +2596,8 @@ static int32_t sampPasteThread(void *ptr)
 		return true;
 	}
 
+	fillSampleUndo(REMOVE_SAMPLE_MARK);
+
 	sample_t *s = getCurSample();
 	if (smpEd_Rx2 == 0 || s == NULL || s->dataPtr == NULL)
 	{
@@ -2179,22 +2629,17 @@ static int32_t sampPasteThread(void *ptr)
 		return true;
 	}
 
-	pauseAudio();
-	unfixSample(s);
-
 	// paste left part of original sample
-	if (smpEd_Rx1 > 0)
-		memcpy(sp.ptr, s->dataPtr, smpEd_Rx1 << sample16Bit);
+	copyUnfixedSmpData(s, sp.ptr, 0, smpEd_Rx1);
 
 	// paste copied data
 	pasteCopiedData(sp.ptr, smpEd_Rx1, smpCopySize, sample16Bit);
 
 	// paste right part of original sample
 	if (smpEd_Rx2 < s->length)
-		memmove(&sp.ptr[(smpEd_Rx1+smpCopySize) << sample16Bit], &s->dataPtr[smpEd_Rx2 << sample16Bit], (s->length-smpEd_Rx2) << sample16Bit);
+		copyUnfixedSmpData(s, &sp.ptr[(smpEd_Rx1+smpCopySize) << sample16Bit], smpEd_Rx2, s->length-smpEd_Rx2);
 
-	freeSmpData(s);
-	setSmpDataPtr(s, &sp);
+	swapInNewSmpData(s, &sp, newLength);
 
 	// adjust loop points if necessary
 	if (smpEd_Rx2-smpEd_Rx1 != smpCopySize)
@@ -2220,13 +2665,11 @@ static int32_t sampPasteThread(void *ptr)
 			s->loopLength = newLength - s->loopStart;
 	}
 
-	s->length = newLength;
-
 	fixSample(s);
+	setSampleUndoEditRange(smpEd_Rx1, smpCopySize); // (everything after it if the length changed)
 	resumeAudio();
 
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
 	// set new range
 	smpEd_Rx2 = smpEd_Rx1 + smpCopySize;
@@ -2234,7 +2677,8 @@ static int32_t sampPasteThread(void *ptr)
 	writeSampleFlag = true;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void sampPaste(void)
@@ -2252,50 +2696,48 @@ void sampPaste(void)
 		}
 	}
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(sampPasteThread, "sample paste thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(sampPasteJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
-static int32_t sampCropThread(void *ptr)
+static bool sampCropJob(job_t *job, void *data)
 {
-	sample_t *s = getCurSample();
+	smpPtr_t sp;
 
-	int32_t r1 = smpEd_Rx1;
-	int32_t r2 = smpEd_Rx2;
+	fillSampleUndo(REMOVE_SAMPLE_MARK);
 
-	pauseAudio();
-	unfixSample(s);
+	sample_t *s = getCurSample();
+	bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+	const int32_t r1 = smpEd_Rx1;
+	const int32_t r2 = smpEd_Rx2;
+	const int32_t oldLength = s->length;
+	const int32_t newLength = r2 - r1;
 
-	if (!cutRange(true, 0, r1) || !cutRange(true, r2-r1, s->length))
+	if (!allocateSmpDataPtr(&sp, newLength, sample16Bit))
 	{
-		fixSample(s);
-		resumeAudio();
+		okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
 		return true;
 	}
-	
+
+	copyUnfixedSmpData(s, sp.ptr, r1, newLength);
+
+	swapInNewSmpData(s, &sp, newLength);
+	cutLoopPoints(s, 0, r1, oldLength - r1);
+	cutLoopPoints(s, r2 - r1, oldLength - r1, newLength);
 	fixSample(s);
 	resumeAudio();
 
-	r1 = 0;
-	r2 = s->length;
-
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
-	smpEd_Rx1 = r1;
-	smpEd_Rx2 = r2;
+	smpEd_Rx1 = 0;
+	smpEd_Rx2 = newLength;
 
 	writeSampleFlag = true;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void sampCrop(void)
@@ -2307,15 +2749,8 @@ void sampCrop(void)
 	if (smpEd_Rx1 == 0 && smpEd_Rx2 == s->length)
 		return; // nothing to crop (the whole sample is marked)
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(sampCropThread, "sample crop thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(sampCropJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
 void sampXFade(void)
@@ -2638,7 +3073,7 @@ void rbSamplePingpongLoop(void)
 	setSongModifiedFlag();
 }
 
-static int32_t convSmp8Bit(void *ptr)
+static bool convSmp8BitJob(job_t *job, void *data)
 {
 	sample_t *s = getCurSample();
 	ASSERT(s->dataPtr != NULL);
@@ -2658,12 +3093,12 @@ static int32_t convSmp8Bit(void *ptr)
 	resumeAudio();
 
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
 	editor.updateCurSmp = true;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void rbSample8bit(void)
@@ -2674,15 +3109,8 @@ void rbSample8bit(void)
 
 	if (okBox(2, "System request", "Pre-convert sample data?", NULL) == 1)
 	{
-		mouseAnimOn();
-		thread = SDL_CreateThread(convSmp8Bit, "sample convert thread", NULL);
-		if (thread == NULL)
-		{
+		if (!startJob(convSmp8BitJob, NULL, NULL, JOB_FOREGROUND))
 			okBox(0, "System message", "Couldn't create thread!", NULL);
-			return;
-		}
-
-		SDL_DetachThread(thread);
 		return;
 	}
 	else
@@ -2703,7 +3131,7 @@ void rbSample8bit(void)
 	}
 }
 
-static int32_t convSmp16Bit(void *ptr)
+static bool convSmp16BitJob(job_t *job, void *data)
 {
 	sample_t *s = getCurSample();
 
@@ -2712,8 +3140,11 @@ static int32_t convSmp16Bit(void *ptr)
 
 	if (!reallocateSmpData(s, s->length, true))
 	{
+		fixSample(s);
+		resumeAudio();
+
 		okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
-		return true;
+		return false;
 	}
 
 	int16_t *dst16 = (int16_t *)s->dataPtr;
@@ -2726,12 +3157,12 @@ static int32_t convSmp16Bit(void *ptr)
 	resumeAudio();
 
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
 	editor.updateCurSmp = true;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void rbSample16bit(void)
@@ -2742,15 +3173,8 @@ void rbSample16bit(void)
 
 	if (okBox(2, "System request", "Pre-convert sample data?", NULL) == 1)
 	{
-		mouseAnimOn();
-		thread = SDL_CreateThread(convSmp16Bit, "sample convert thread", NULL);
-		if (thread == NULL)
-		{
+		if (!startJob(convSmp16BitJob, NULL, NULL, JOB_FOREGROUND))
 			okBox(0, "System message", "Couldn't create thread!", NULL);
-			return;
-		}
-
-		SDL_DetachThread(thread);
 		return;
 	}
 	else
@@ -3040,6 +3464,8 @@ static void invertSamplePosLine(int32_t x)
 	if (x < 0 || x >= SCREEN_W)
 		return;
 
+	markRectDirty(x, 174, 1, SAMPLE_AREA_HEIGHT);
+
 	uint32_t *ptr32 = &video.frameBuffer[(174 * SCREEN_W) + x];
 	for (int32_t y = 0; y < SAMPLE_AREA_HEIGHT; y++, ptr32 += SCREEN_W)
 		*ptr32 = video.palette[(*ptr32 >> 24) ^ 1]; // ">> 24" to get palette, XOR 1 to switch between normal/inverted mode
@@ -3097,6 +3523,8 @@ void handleSamplerRedrawing(void)
 	if (!ui.sampleEditorShown || editor.samplingAudioFlag)
 		return;
 
+	buildSamplePeaksStep();
+
 	if (writeSampleFlag)
 	{
 		writeSampleFlag = false;
@@ -3107,6 +3535,9 @@ void handleSamplerRedrawing(void)
 		writeSample(DONT_FORCE_SAMPLE_REDRAW);
 	}
 
+	if (showSpectrogram)
+		updateSpectrogram();
+
 	writeSamplePosLine();
 }
 
@@ -3190,7 +3621,9 @@ static void editSampleData(bool mouseButtonHeld)
 	if (!mouseButtonHeld)
 	{
 		pauseAudio();
+		const uint32_t oldDataVersion = s->dataVersion;
 		unfixSample(s);
+		keepSamplePeaks(s, oldDataVersion); // the strokes update their own range below
 		editor.editSampleFlag = true;
 
 		lastDrawX = scr2SmpPos(mx);
@@ -3319,6 +3752,8 @@ static void editSampleData(bool mouseButtonHeld)
 		}
 	}
 
+	invalidateSamplePeakRange(s, p, (lastDrawX + 1) - p);
+
 	lastDrawY = rvl;
 	lastDrawX = r;
 
@@ -3529,7 +3964,7 @@ void toggleSampleEditorExt(void)
 		showSampleEditorExt();
 }
 
-static int32_t sampleBackwardsThread(void *ptr)
+static bool sampleBackwardsJob(job_t *job, void *data)
 {
 	int8_t tmp8, *ptrStart, *ptrEnd;
 	int16_t tmp16, *ptrStart16, *ptrEnd16;
@@ -3592,12 +4027,12 @@ static int32_t sampleBackwardsThread(void *ptr)
 	}
 
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
 	writeSampleFlag = true;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void sampleBackwards(void)
@@ -3606,18 +4041,11 @@ void sampleBackwards(void)
 	if (s == NULL || s->dataPtr == NULL || s->length < 2)
 		return;
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(sampleBackwardsThread, "sample modification thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(sampleBackwardsJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
-static int32_t sampleChangeSignThread(void *ptr)
+static bool sampleChangeSignJob(job_t *job, void *data)
 {
 	sample_t *s = getCurSample();
 
@@ -3641,12 +4069,12 @@ static int32_t sampleChangeSignThread(void *ptr)
 	resumeAudio();
 
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
 	writeSampleFlag = true;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void sampleChangeSign(void)
@@ -3655,18 +4083,11 @@ void sampleChangeSign(void)
 	if (s == NULL || s->dataPtr == NULL || s->length <= 0)
 		return;
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(sampleChangeSignThread, "sample modification thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(sampleChangeSignJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
-static int32_t sampleByteSwapThread(void *ptr)
+static bool sampleByteSwapJob(job_t *job, void *data)
 {
 	sample_t *s = getCurSample();
 
@@ -3689,12 +4110,12 @@ static int32_t sampleByteSwapThread(void *ptr)
 	resumeAudio();
 
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
 	writeSampleFlag = true;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void sampleByteSwap(void)
@@ -3709,47 +4130,18 @@ void sampleByteSwap(void)
 			return;
 	}
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(sampleByteSwapThread, "sample modification thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(sampleByteSwapJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
-static int32_t fixDCThread(void *ptr)
+void removeSampleDataDC(int8_t *ptr, int32_t length, bool sample16Bit)
 {
-	int8_t *ptr8;
-	int16_t *ptr16;
-	int32_t length;
-
-	const bool sampleDataMarked = (smpEd_Rx1 != smpEd_Rx2);
-	sample_t *s = getCurSample();
+	if (length <= 0)
+		return;
 
-	if (s->flags & SAMPLE_16BIT)
+	if (sample16Bit)
 	{
-		if (!sampleDataMarked)
-		{
-			ptr16 = (int16_t *)s->dataPtr;
-			length = s->length;
-		}
-		else
-		{
-			ptr16 = (int16_t *)&s->dataPtr + smpEd_Rx1;
-			length = smpEd_Rx2 - smpEd_Rx1;
-		}
-
-		if (length < 0 || length > s->length)
-		{
-			setMouseBusy(false);
-			return true;
-		}
-
-		pauseAudio();
-		unfixSample(s);
+		int16_t *ptr16 = (int16_t *)ptr;
 
 		int64_t averageDC = 0;
 		for (int32_t i = 0; i < length; i++)
@@ -3762,55 +4154,61 @@ static int32_t fixDCThread(void *ptr)
 			int32_t smp32 = ptr16[i] - smpSub;
 			ptr16[i] = (int16_t)(CLAMP(smp32, INT16_MIN, INT16_MAX));
 		}
-
-		fixSample(s);
-		resumeAudio();
 	}
 	else // 8-bit
 	{
-		if (!sampleDataMarked)
-		{
-			ptr8 = s->dataPtr;
-			length = s->length;
-		}
-		else
-		{
-			ptr8 = &s->dataPtr[smpEd_Rx1];
-			length = smpEd_Rx2 - smpEd_Rx1;
-		}
-
-		if (length < 0 || length > s->length)
-		{
-			setMouseBusy(false);
-			return true;
-		}
-
-		pauseAudio();
-		unfixSample(s);
-
 		int64_t averageDC = 0;
 		for (int32_t i = 0; i < length; i++)
-			averageDC += ptr8[i];
+			averageDC += ptr[i];
 		averageDC = (averageDC + (length>>1)) / length; // rounded
 
 		const int32_t smpSub = (int32_t)averageDC;
 		for (int32_t i = 0; i < length; i++)
 		{
-			int32_t smp32 = ptr8[i] - smpSub;
-			ptr8[i] = (int8_t)(CLAMP(smp32, INT8_MIN, INT8_MAX));
+			int32_t smp32 = ptr[i] - smpSub;
+			ptr[i] = (int8_t)(CLAMP(smp32, INT8_MIN, INT8_MAX));
 		}
+	}
+}
 
-		fixSample(s);
-		resumeAudio();
+static bool fixDCJob(job_t *job, void *data)
+{
+	int32_t start, length;
+
+	const bool sampleDataMarked = (smpEd_Rx1 != smpEd_Rx2);
+	sample_t *s = getCurSample();
+
+	if (!sampleDataMarked)
+	{
+		start = 0;
+		length = s->length;
+	}
+	else
+	{
+		start = smpEd_Rx1;
+		length = smpEd_Rx2 - smpEd_Rx1;
 	}
 
+	if (length < 0 || length > s->length)
+		return true;
+
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+	pauseAudio();
+	unfixSample(s);
+
+	removeSampleDataDC(s->dataPtr + (sample16Bit ? (start << 1) : start), length, sample16Bit);
+
+	fixSample(s);
+	resumeAudio();
+
 	setSongModifiedFlag();
-	setMouseBusy(false);
 
 	writeSampleFlag = true;
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 void fixDC(void)
@@ -3819,15 +4217,8 @@ void fixDC(void)
 	if (s == NULL || s->dataPtr == NULL || s->length <= 0)
 		return;
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(fixDCThread, "sample modification thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(fixDCJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
 void smpEdStop(void)
@@ -25,13 +25,27 @@ bool reallocateSmpDataPtr(smpPtr_t *sp, int32_t length, bool sample16Bit);
 void setSmpDataPtr(sample_t *s, smpPtr_t *sp);
 void freeSmpDataPtr(smpPtr_t *sp);
 void freeSmpData(sample_t *s);
+
+// held sample data is read by another thread (the autosave job), freeing/reallocating it is deferred until it's released
+bool holdSmpData(const sample_t *s);
+bool heldSmpDataChanged(const sample_t *s); // true if the held sample data was edited after it was held
+void releaseHeldSmpData(void); // frees the held sample data that was freed or reallocated meanwhile
+
 bool cloneSample(sample_t *src, sample_t *dst);
 sample_t *getCurSample(void);
 void sanitizeSample(sample_t *s);
 void fixSample(sample_t *s); // modifies samples before index 0, and after loop/end (for branchless mixer interpolation)
 void unfixSample(sample_t *s); // restores samples after loop/end
+void fixDrawnSample(sample_t *s); // fixSample() at the end of hand-drawing
+void copyUnfixedSmpData(const sample_t *s, int8_t *dst, int32_t pos, int32_t length); // doesn't modify the sample
+void getRawSamplePeak(sample_t *s, int32_t index, int32_t length, int16_t *outMin, int16_t *outMax); // unfixed data, 8-bit is returned as << 8
+void removeSampleDataDC(int8_t *ptr, int32_t length, bool sample16Bit); // subtracts the average (rounded)
 void clearSample(void);
 void clearCopyBuffer(void);
+void freeSamplePeaks(void);
+bool samplePeaksPending(void); // true while the waveform peak cache for the shown sample is being built
+bool sampleSpectrogramPending(void); // true while the spectrogram for the shown sample is being calculated/drawn
+void toggleSampleSpectrogram(void);
 int32_t getSampleRangeStart(void);
 int32_t getSampleRangeEnd(void);
 int32_t getSampleRangeLength(void);
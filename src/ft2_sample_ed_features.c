@@ -3,6 +3,7 @@
 ** - Echo
 ** - Mix
 ** - Volume
+** - Batch processing (several instruments at once)
 **/
 
 // for finding memory leaks in debug mode with Visual Studio
@@ -11,6 +12,7 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <math.h>
@@ -25,14 +27,56 @@
 #include "ft2_keyboard.h"
 #include "ft2_tables.h"
 #include "ft2_structs.h"
-
-static volatile bool stopThread;
-static bool echo_AddMemory, exitFlag, outOfMemory;
+#include "ft2_sample_undo.h"
+#include "ft2_fft.h"
+#include "ft2_jobs.h"
+#include "ft2_sample_scan.h"
+#include "mixer/ft2_mix_interpolation.h"
+
+#define RESAMPLE_MAX_JOBS 4
+#define RESAMPLE_MIN_FRAMES_PER_JOB 65536
+#define RESAMPLE_BLOCK_LEN 4096 /* output frames between progress updates/cancel checks */
+#define MIX_BLOCK_LEN 4096
+#define VOLUME_BLOCK_LEN 65536
+#define BATCH_MAX_JOBS 4
+#define BATCH_NUM_RATES 8
+
+typedef struct resampleChunk_t
+{
+	const int8_t *src;
+	int8_t *dst;
+	bool sample16Bit, sinc, reportProgress;
+	int32_t srcLength;
+	uint32_t dstStart, dstEnd;
+	uint64_t delta64;
+} resampleChunk_t;
+
+typedef struct batchItem_t
+{
+	bool done, sample16Bit;
+	uint8_t instrNum, smpNum;
+	int8_t relativeNote, finetune;
+	int32_t length, loopStart, loopLength;
+	smpPtr_t sp; // the processed sample data
+} batchItem_t;
+
+static bool echo_AddMemory, echo_Convolve, exitFlag, outOfMemory, resampleSinc;
 static int8_t smpEd_RelReSmp, mix_Balance = 50;
 static int16_t echo_nEcho = 1, echo_VolChange = 30;
 static int32_t echo_Distance = 0x100;
 static double dVol_StartVol = 100.0, dVol_EndVol = 100.0;
-static SDL_Thread *thread;
+static bool resampleFailed;
+static int32_t resampleJobsLeft, resampleNewLength;
+static double resampleRatio;
+static smpPtr_t resampleNewData, resampleSrcCopy;
+static resampleChunk_t resampleChunks[RESAMPLE_MAX_JOBS];
+static bool batch_Downsample, batch_FixDC, batch_Normalize = true, batch_To8Bit;
+static uint8_t batch_FirstInstr = 1, batch_LastInstr = MAX_INST, batch_RateIndex = 6;
+static volatile bool batchFailed, batchOutOfMemory;
+static int32_t batchNumItems, batchJobsLeft;
+static SDL_atomic_t batchNextItem, batchItemsDone;
+static batchItem_t batchItems[MAX_INST * MAX_SMP_PER_INST];
+static const int32_t batchRates[BATCH_NUM_RATES] = { 8363, 11025, 16726, 22050, 32000, 33452, 44100, 48000 };
 
 static void pbExit(void)
 {
@@ -40,6 +84,14 @@ static void pbExit(void)
 	exitFlag = true;
 }
 
+static void toolJobDone(void *data, int32_t result) // closes the tool window when its job is done
+{
+	ui.sysReqShown = false;
+
+	(void)data;
+	(void)result;
+}
+
 static void windowOpen(void)
 {
 	ui.sysReqShown = true;
@@ -79,106 +131,268 @@ static void pbResampleTonesUp(void)
 		smpEd_RelReSmp++;
 }
 
-static int32_t resampleThread(void *ptr)
+static void cbResampleSinc(void)
 {
-	smpPtr_t sp;
+	resampleSinc ^= 1;
+}
 
-	if (instr[editor.curInstr] == NULL)
-		return true;
+static inline double getResampleSrcFrame(const resampleChunk_t *chunk, int32_t pos) // holds first/last frame outside of the sample
+{
+	pos = CLAMP(pos, 0, chunk->srcLength-1);
 
-	sample_t *s = &instr[editor.curInstr]->smp[editor.curSmp];
-	bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	if (chunk->sample16Bit)
+		return ((const int16_t *)chunk->src)[pos];
+	else
+		return chunk->src[pos];
+}
 
-	const double dRatio = pow(2.0, (int32_t)smpEd_RelReSmp * (1.0 / 12.0));
+/* Windowed-sinc resampling, using the mixer's 16-point Kaiser-windowed sinc kernel (no cutoff).
+**
+** When shrinking the sample, the kernel is stretched by the resampling ratio, which moves
+** its cutoff down to the new Nyquist frequency (anti-aliasing). The taps are then looked
+** up from the polyphase table and normalized per output sample.
+*/
+static bool resampleSincChunk(job_t *job, const resampleChunk_t *chunk)
+{
+	const float *fKernel = fSinc16[0];
+	const bool shrinking = chunk->delta64 > ((uint64_t)1 << 32);
+	const double dScale = chunk->delta64 * (1.0 / (UINT32_MAX+1.0));
+	const double dScaleMul = 1.0 / dScale;
+	const int32_t kernelRadius = (int32_t)ceil((SINC16_TAPS / 2) * dScale);
+
+	uint64_t posFrac64 = chunk->dstStart * chunk->delta64;
+	for (uint32_t i = chunk->dstStart; i < chunk->dstEnd; i++, posFrac64 += chunk->delta64)
+	{
+		if (((i - chunk->dstStart) % RESAMPLE_BLOCK_LEN) == 0)
+		{
+			if (jobCancelled(job))
+				return false;
 
-	double dNewLen = s->length * dRatio;
-	if (dNewLen > (double)MAX_SAMPLE_LEN)
-		dNewLen = (double)MAX_SAMPLE_LEN;
+			if (chunk->reportProgress) // (not when it's a part of a batch job)
+				setJobProgress(job, i - chunk->dstStart, chunk->dstEnd - chunk->dstStart);
+		}
 
-	const uint32_t newLen = (int32_t)floor(dNewLen);
-	if (!allocateSmpDataPtr(&sp, newLen, sample16Bit))
-	{
-		outOfMemory = true;
-		setMouseBusy(false);
-		ui.sysReqShown = false;
-		return true;
-	}
+		const int32_t posInt = (int32_t)(posFrac64 >> 32);
+		double dOut;
 
-	int8_t *dst = sp.ptr;
-	int8_t *src = s->dataPtr;
+		if (!shrinking)
+		{
+			const float *fTaps = &fKernel[((uint32_t)posFrac64 >> (32-INTRP_PHASES_BITS)) * SINC16_TAPS];
 
-	// 32.32 fixed-point logic
-	const uint64_t delta64 = (const uint64_t)round((UINT32_MAX+1.0) / dRatio);
-	uint64_t posFrac64 = 0;
+			dOut = 0.0;
+			for (int32_t j = 0; j < SINC16_TAPS; j++)
+				dOut += getResampleSrcFrame(chunk, posInt + (j - ((SINC16_TAPS/2)-1))) * fTaps[j];
+		}
+		else
+		{
+			const double dPos = posFrac64 * (1.0 / (UINT32_MAX+1.0));
 
-	pauseAudio();
-	unfixSample(s);
+			double dSum = 0.0, dTapSum = 0.0;
+			for (int32_t n = posInt - kernelRadius; n <= posInt + kernelRadius; n++)
+			{
+				// kernel position -> tap/phase (see calcPolyphaseSincLUT())
+				const double t = ((n - dPos) * dScaleMul) + ((SINC16_TAPS/2)-1);
+				const int32_t tap = (int32_t)ceil(t);
+				if (tap < 0 || tap >= SINC16_TAPS)
+					continue;
+
+				int32_t phase = (int32_t)((tap - t) * INTRP_PHASES);
+				if (phase > INTRP_PHASES-1)
+					phase = INTRP_PHASES-1;
+
+				const double dTap = fKernel[(phase * SINC16_TAPS) + tap];
+				dSum += getResampleSrcFrame(chunk, n) * dTap;
+				dTapSum += dTap;
+			}
+
+			dOut = (dTapSum != 0.0) ? (dSum / dTapSum) : 0.0;
+		}
+
+		if (chunk->sample16Bit)
+		{
+			const int32_t out = (int32_t)round(dOut);
+			((int16_t *)chunk->dst)[i] = (int16_t)CLAMP(out, INT16_MIN, INT16_MAX);
+		}
+		else
+		{
+			const int32_t out = (int32_t)round(dOut);
+			chunk->dst[i] = (int8_t)CLAMP(out, INT8_MIN, INT8_MAX);
+		}
+	}
 
-	/* Fast nearest-neighbor resampling.
-	**
-	** Could benefit from windowed-sinc interpolation,
-	** but it seems like some people prefer it the way it is.
-	*/
+	return true;
+}
 
-	if (newLen > 0)
+// fast nearest-neighbor resampling (some people prefer the sound of this)
+static bool resampleNearestChunk(job_t *job, const resampleChunk_t *chunk)
+{
+	uint64_t posFrac64 = chunk->dstStart * chunk->delta64;
+	for (uint32_t i = chunk->dstStart; i < chunk->dstEnd; i += RESAMPLE_BLOCK_LEN)
 	{
-		if (sample16Bit)
+		if (jobCancelled(job))
+			return false;
+
+		if (chunk->reportProgress)
+			setJobProgress(job, i - chunk->dstStart, chunk->dstEnd - chunk->dstStart);
+
+		const uint32_t blockEnd = MIN(i + RESAMPLE_BLOCK_LEN, chunk->dstEnd);
+		if (chunk->sample16Bit)
 		{
-			const int16_t *src16 = (const int16_t *)src;
-			int16_t *dst16 = (int16_t *)dst;
+			const int16_t *src16 = (const int16_t *)chunk->src;
+			int16_t *dst16 = (int16_t *)chunk->dst;
 
-			for (uint32_t i = 0; i < newLen; i++)
+			for (uint32_t j = i; j < blockEnd; j++)
 			{
-				dst16[i] = src16[posFrac64 >> 32];
-				posFrac64 += delta64;
+				dst16[j] = src16[posFrac64 >> 32];
+				posFrac64 += chunk->delta64;
 			}
 		}
 		else // 8-bit
 		{
-			const int8_t *src8 = src;
-			int8_t *dst8 = dst;
-
-			for (uint32_t i = 0; i < newLen; i++)
+			for (uint32_t j = i; j < blockEnd; j++)
 			{
-				dst8[i] = src8[posFrac64 >> 32];
-				posFrac64 += delta64;
+				chunk->dst[j] = chunk->src[posFrac64 >> 32];
+				posFrac64 += chunk->delta64;
 			}
 		}
 	}
 
-	freeSmpData(s);
-	setSmpDataPtr(s, &sp);
+	return true;
+}
 
-	s->relativeNote += smpEd_RelReSmp;
-	s->length = newLen;
-	s->loopStart = (int32_t)(s->loopStart * dRatio);
-	s->loopLength = (int32_t)(s->loopLength * dRatio);
+static bool resampleJob(job_t *job, void *data) // one job per chunk of the output (the source is only read)
+{
+	const resampleChunk_t *chunk = (const resampleChunk_t *)data;
 
-	sanitizeSample(s);
+	if (chunk->sinc)
+		return resampleSincChunk(job, chunk);
+	else
+		return resampleNearestChunk(job, chunk);
+}
 
-	fixSample(s);
-	resumeAudio();
+static void resampleJobDone(void *data, int32_t result)
+{
+	if (result != JOB_DONE)
+		resampleFailed = true;
 
-	setSongModifiedFlag();
-	setMouseBusy(false);
+	if (--resampleJobsLeft > 0)
+		return; // wait for the other jobs
+
+	freeSmpDataPtr(&resampleSrcCopy);
+
+	sample_t *s = NULL;
+	if (instr[editor.curInstr] != NULL)
+		s = &instr[editor.curInstr]->smp[editor.curSmp];
+
+	if (resampleFailed || s == NULL)
+	{
+		freeSmpDataPtr(&resampleNewData); // cancelled, leave the sample as it was
+	}
+	else
+	{
+		// the undo step is only taken now that the new sample data is complete
+		fillSampleUndo(REMOVE_SAMPLE_MARK);
+
+		pauseAudio();
+		freeSmpData(s);
+		setSmpDataPtr(s, &resampleNewData);
+
+		s->relativeNote += smpEd_RelReSmp;
+		s->length = resampleNewLength;
+		s->loopStart = (int32_t)(s->loopStart * resampleRatio);
+		s->loopLength = (int32_t)(s->loopLength * resampleRatio);
+
+		sanitizeSample(s);
+
+		fixSample(s);
+		resumeAudio();
+
+		setSongModifiedFlag();
+	}
 
 	ui.sysReqShown = false;
-	return true;
 
-	(void)ptr;
+	(void)data;
 }
 
 static void pbDoResampling(void)
 {
-	mouseAnimOn();
-	thread = SDL_CreateThread(resampleThread, "resample thread", NULL);
-	if (thread == NULL)
+	if (foregroundJobsRunning() || instr[editor.curInstr] == NULL)
+		return;
+
+	sample_t *s = &instr[editor.curInstr]->smp[editor.curSmp];
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+	resampleRatio = pow(2.0, (int32_t)smpEd_RelReSmp * (1.0 / 12.0));
+
+	double dNewLen = s->length * resampleRatio;
+	if (dNewLen > (double)MAX_SAMPLE_LEN)
+		dNewLen = (double)MAX_SAMPLE_LEN;
+
+	resampleNewLength = (int32_t)floor(dNewLen);
+	if (!allocateSmpDataPtr(&resampleNewData, resampleNewLength, sample16Bit))
 	{
-		okBox(0, "System message", "Couldn't create thread!", NULL);
+		outOfMemory = true;
+		ui.sysReqShown = false;
+		return;
+	}
+
+	// resample from an unfixed copy, so that the audio is only paused while the new data is swapped in
+	if (!allocateSmpDataPtr(&resampleSrcCopy, s->length, sample16Bit))
+	{
+		freeSmpDataPtr(&resampleNewData);
+		outOfMemory = true;
+		ui.sysReqShown = false;
 		return;
 	}
 
-	SDL_DetachThread(thread);
+	copyUnfixedSmpData(s, resampleSrcCopy.ptr, 0, s->length);
+
+	int32_t numJobs = SDL_GetCPUCount();
+	numJobs = CLAMP(numJobs, 1, RESAMPLE_MAX_JOBS);
+
+	if (!resampleSinc || s->length <= 0)
+		numJobs = 1; // nearest-neighbor is fast enough as it is
+
+	while (numJobs > 1 && resampleNewLength / numJobs < RESAMPLE_MIN_FRAMES_PER_JOB)
+		numJobs--;
+
+	// 32.32 fixed-point logic
+	const uint64_t delta64 = (const uint64_t)round((UINT32_MAX+1.0) / resampleRatio);
+
+	resampleFailed = false;
+	resampleJobsLeft = 0;
+
+	// split the output into one chunk per job (if a job can't be started, the resampling fails)
+	for (int32_t i = 0; i < numJobs; i++)
+	{
+		resampleChunk_t *chunk = &resampleChunks[i];
+
+		chunk->src = resampleSrcCopy.ptr;
+		chunk->dst = resampleNewData.ptr;
+		chunk->sample16Bit = sample16Bit;
+		chunk->sinc = resampleSinc && s->length > 0;
+		chunk->reportProgress = true;
+		chunk->srcLength = s->length;
+		chunk->delta64 = delta64;
+		chunk->dstStart = (uint32_t)(((uint64_t)resampleNewLength * i) / numJobs);
+		chunk->dstEnd = (uint32_t)(((uint64_t)resampleNewLength * (i+1)) / numJobs);
+
+		if (s->length <= 0)
+			chunk->dstEnd = chunk->dstStart; // nothing to read from
+
+		if (startJob(resampleJob, resampleJobDone, chunk, JOB_FOREGROUND))
+			resampleJobsLeft++;
+		else
+			resampleFailed = true;
+	}
+
+	if (resampleJobsLeft == 0)
+	{
+		freeSmpDataPtr(&resampleSrcCopy);
+		freeSmpDataPtr(&resampleNewData);
+		okBox(0, "System message", "Couldn't create thread!", NULL);
+	}
 }
 
 static void drawResampleBox(void)
@@ -187,7 +401,7 @@ static void drawResampleBox(void)
 	const int16_t x = 209;
 	const int16_t y = 230;
 	const int16_t w = 214;
-	const int16_t h = 54;
+	const int16_t h = 68;
 
 	// main fill
 	fillRect(x + 1, y + 1, w - 2, h - 2, PAL_BUTTONS);
@@ -215,6 +429,7 @@ static void drawResampleBox(void)
 	textOutShadow(215, 236, PAL_FORGRND, PAL_BUTTON2, "Rel. h.tones");
 	textOutShadow(215, 250, PAL_FORGRND, PAL_BUTTON2, "New sample size");
 	hexOut(361, 250, PAL_FORGRND, (int32_t)dNewLen, 8);
+	textOutShadow(230, 266, PAL_FORGRND, PAL_BUTTON2, "Windowed-sinc interpolation");
 
 	     if (smpEd_RelReSmp == 0) sign = ' ';
 	else if (smpEd_RelReSmp  < 0) sign = '-';
@@ -238,13 +453,25 @@ static void setupResampleBoxWidgets(void)
 {
 	pushButton_t *p;
 	scrollBar_t *s;
+	checkBox_t *c;
+
+	// "Windowed-sinc interpolation" checkbox
+	c = &checkBoxes[0];
+	memset(c, 0, sizeof (checkBox_t));
+	c->x = 214;
+	c->y = 264;
+	c->clickAreaWidth = 196;
+	c->clickAreaHeight = 12;
+	c->callbackFunc = cbResampleSinc;
+	c->checked = resampleSinc ? CHECKBOX_CHECKED : CHECKBOX_UNCHECKED;
+	c->visible = true;
 
 	// "Apply" pushbutton
 	p = &pushButtons[0];
 	memset(p, 0, sizeof (pushButton_t));
 	p->caption = "Apply";
 	p->x = 214;
-	p->y = 264;
+	p->y = 278;
 	p->w = 73;
 	p->h = 16;
 	p->callbackFuncOnUp = pbDoResampling;
@@ -255,7 +482,7 @@ static void setupResampleBoxWidgets(void)
 	memset(p, 0, sizeof (pushButton_t));
 	p->caption = "Exit";
 	p->x = 345;
-	p->y = 264;
+	p->y = 278;
 	p->w = 73;
 	p->h = 16;
 	p->callbackFuncOnUp = pbExit;
@@ -320,6 +547,7 @@ void pbSampleResample(void)
 	while (ui.sysReqShown)
 	{
 		readInput();
+		handleJobs();
 		if (ui.sysReqEnterPressed)
 			pbDoResampling();
 
@@ -335,6 +563,7 @@ void pbSampleResample(void)
 		flipFrame();
 	}
 
+	hideCheckBox(0);
 	for (i = 0; i < 4; i++) hidePushButton(i);
 	hideScrollBar(0);
 
@@ -349,6 +578,11 @@ static void cbEchoAddMemory(void)
 	echo_AddMemory ^= 1;
 }
 
+static void cbEchoConvolve(void)
+{
+	echo_Convolve ^= 1;
+}
+
 static void sbSetEchoNumPos(uint32_t pos)
 {
 	if (echo_nEcho != (int32_t)pos)
@@ -403,20 +637,106 @@ static void pbEchoFadeoutUp(void)
 		echo_VolChange++;
 }
 
-static int32_t createEchoThread(void *ptr)
+#define ECHO_BLOCK_LEN 4096
+#define REVERB_MIN_BLOCK_BITS 12
+#define REVERB_MAX_PARTITIONS 64
+
+// reads frames [pos, pos+length) of the sample as doubles, the frames outside of the sample are zero
+static void readSmpBlock(const sample_t *s, int8_t *tmp, double *dst, int32_t pos, int32_t length)
+{
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+	int32_t start = 0;
+	if (pos < 0)
+		start = MIN(-pos, length);
+
+	int32_t end = length;
+	if (pos+end > s->length)
+		end = MAX(s->length-pos, start);
+
+	for (int32_t i = 0; i < start; i++)
+		dst[i] = 0.0;
+
+	copyUnfixedSmpData(s, tmp, pos+start, end-start);
+	if (sample16Bit)
+	{
+		const int16_t *tmp16 = (const int16_t *)tmp;
+		for (int32_t i = start; i < end; i++)
+			dst[i] = tmp16[i-start];
+	}
+	else
+	{
+		for (int32_t i = start; i < end; i++)
+			dst[i] = tmp[i-start];
+	}
+
+	for (int32_t i = end; i < length; i++)
+		dst[i] = 0.0;
+}
+
+static void writeSmpBlock(int8_t *dst, bool sample16Bit, const double *src, int32_t pos, int32_t length)
+{
+	if (sample16Bit)
+	{
+		int16_t *dst16 = (int16_t *)dst + pos;
+		for (int32_t i = 0; i < length; i++)
+		{
+			const int32_t smp32 = (int32_t)round(src[i]);
+			dst16[i] = (int16_t)CLAMP(smp32, INT16_MIN, INT16_MAX);
+		}
+	}
+	else
+	{
+		int8_t *dst8 = dst + pos;
+		for (int32_t i = 0; i < length; i++)
+		{
+			const int32_t smp32 = (int32_t)round(src[i]);
+			dst8[i] = (int8_t)CLAMP(smp32, INT8_MIN, INT8_MAX);
+		}
+	}
+}
+
+// swaps in the new sample data (truncated if the job was cancelled)
+static void finishEchoSample(sample_t *s, smpPtr_t *sp, int32_t length, int32_t writeLen)
+{
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+	if (length < writeLen) // we stopped before echo was done, realloc length
+	{
+		reallocateSmpDataPtr(sp, length, sample16Bit);
+		editor.updateCurSmp = true;
+	}
+
+	pauseAudio();
+	freeSmpData(s);
+	setSmpDataPtr(s, sp);
+	s->length = length;
+	fixSample(s);
+	resumeAudio();
+
+	setSongModifiedFlag();
+}
+
+/* The echo train y[n] = x[n] + v*x[n-d] + ... + v^(N-1)*x[n-(N-1)*d] is
+** calculated with one feedback delay line instead of summing all the delayed
+** copies for every output sample, as y[n] - v*y[n-d] = x[n] - v^N*x[n-N*d].
+** This makes the cost independent of the number of echoes.
+**
+** Like the original echo tool, the first sample point is never echoed (it's
+** zeroed in the delay line input, and added back to the output).
+*/
+static bool createEchoJob(job_t *job, void *data)
 {
 	smpPtr_t sp;
 
 	if (echo_nEcho < 1)
-	{
-		ui.sysReqShown = false;
 		return true;
-	}
+
+	fillSampleUndo(REMOVE_SAMPLE_MARK);
 
 	sample_t *s = &instr[editor.curInstr]->smp[editor.curSmp];
 
 	int32_t readLen = s->length;
-	int8_t *readPtr = s->dataPtr;
 	bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
 	int32_t distance = echo_Distance * 16;
 	double dVolChange = echo_VolChange / 100.0;
@@ -432,10 +752,7 @@ static int32_t createEchoThread(void *ptr)
 	int32_t nEchoes = k + 1;
 
 	if (nEchoes < 1)
-	{
-		ui.sysReqShown = false;
 		return true;
-	}
 
 	// set write length (either original length or full echo length)
 	int32_t writeLen = readLen;
@@ -450,113 +767,276 @@ static int32_t createEchoThread(void *ptr)
 		writeLen = (uint32_t)tmp64;
 	}
 
-	if (!allocateSmpDataPtr(&sp, writeLen, sample16Bit))
+	double dTailMul = 1.0, dEchoSum = 0.0; // v^N, and 1 + v + ... + v^(N-1) (for zero distance)
+	for (int32_t i = 0; i < nEchoes; i++)
 	{
+		dEchoSum += dTailMul;
+		dTailMul *= dVolChange;
+	}
+
+	double *dBuffer = (double *)malloc(((ECHO_BLOCK_LEN * 2) + distance) * sizeof (double));
+	int8_t *tmpBlock = (int8_t *)malloc(ECHO_BLOCK_LEN * sizeof (int16_t));
+
+	sp.origPtr = sp.ptr = NULL;
+	if (dBuffer == NULL || tmpBlock == NULL || !allocateSmpDataPtr(&sp, writeLen, sample16Bit))
+	{
+		if (dBuffer != NULL) free(dBuffer);
+		if (tmpBlock != NULL) free(tmpBlock);
+		freeSmpDataPtr(&sp);
+
 		outOfMemory = true;
-		setMouseBusy(false);
-		ui.sysReqShown = false;
 		return false;
 	}
 
-	pauseAudio();
-	unfixSample(s);
+	double *dIn = dBuffer;
+	double *dTail = dIn + ECHO_BLOCK_LEN;
+	double *dFeedback = dTail + ECHO_BLOCK_LEN; // the last 'distance' output samples
+	for (int32_t i = 0; i < distance; i++)
+		dFeedback[i] = 0.0;
 
-	int32_t writeIdx = 0;
+	const int32_t tailDelay = (int32_t)MIN((int64_t)distance * nEchoes, MAX_SAMPLE_LEN);
 
-	if (sample16Bit)
+	// (the sample is only read here, so the audio doesn't need to be paused)
+	double dFirstSmp = 0.0;
+	int32_t feedbackPos = 0, pos;
+	for (pos = 0; pos < writeLen && !jobCancelled(job); pos += ECHO_BLOCK_LEN)
 	{
-		const int16_t *readPtr16 = (const int16_t *)readPtr;
-		int16_t *writePtr16 = (int16_t *)sp.ptr;
+		const int32_t blockLen = MIN(writeLen - pos, ECHO_BLOCK_LEN);
+		setJobProgress(job, pos, writeLen);
 
-		while (writeIdx < writeLen)
+		readSmpBlock(s, tmpBlock, dIn, pos, blockLen);
+		if (pos == 0)
 		{
-			double dSmpOut = 0.0;
-			double dSmpMul = 1.0;
+			dFirstSmp = dIn[0];
+			dIn[0] = 0.0;
+		}
 
-			int32_t echoRead = writeIdx;
-			int32_t echoCycle = nEchoes;
+		if (distance == 0)
+		{
+			for (int32_t i = 0; i < blockLen; i++)
+				dIn[i] *= dEchoSum;
+		}
+		else
+		{
+			readSmpBlock(s, tmpBlock, dTail, pos - tailDelay, blockLen);
+			if (tailDelay >= pos && tailDelay < pos+blockLen)
+				dTail[tailDelay-pos] = 0.0; // (the first sample point)
 
-			while (!stopThread)
+			for (int32_t i = 0; i < blockLen; i++)
 			{
-				if (echoRead < readLen)
-					dSmpOut += (int32_t)readPtr16[echoRead] * dSmpMul;
+				const double dOut = (dIn[i] - (dTail[i] * dTailMul)) + (dFeedback[feedbackPos] * dVolChange);
 
-				dSmpMul *= dVolChange;
+				dFeedback[feedbackPos] = dOut;
+				if (++feedbackPos >= distance)
+					feedbackPos = 0;
 
-				echoRead -= distance;
-				if (echoRead <= 0 || --echoCycle <= 0)
-					break;
+				dIn[i] = dOut;
 			}
-
-			int32_t smp32 = (int32_t)round(dSmpOut);
-			writePtr16[writeIdx++] = (int16_t)(CLAMP(smp32, INT16_MIN, INT16_MAX));
 		}
+
+		if (pos == 0)
+			dIn[0] += dFirstSmp;
+
+		writeSmpBlock(sp.ptr, sample16Bit, dIn, pos, blockLen);
 	}
-	else // 8-bit
+
+	free(dBuffer);
+	free(tmpBlock);
+
+	// (a cancelled echo keeps the part that was done)
+	finishEchoSample(s, &sp, MIN(pos, writeLen), writeLen);
+	return true;
+}
+
+/* Convolution reverb: the sample is convolved with the source sample (the
+** same one the "Mix" tool uses) as impulse response, by uniformly partitioned
+** FFT convolution with overlap-add. The impulse response is cut into blocks of
+** B frames, and every block of B input frames is transformed once, multiplied
+** with the spectra of all the impulse response blocks (a frequency-domain delay
+** line) and transformed back. B grows with the impulse response length, so the
+** number of partitions stays low. The wet signal is scaled to the input's peak,
+** and mixed with the dry signal by the "Wet mix" percentage (the fade out field).
+*/
+static bool createReverbJob(job_t *job, void *data)
+{
+	smpPtr_t sp;
+	fft_t fft;
+
+	sample_t *s = &instr[editor.curInstr]->smp[editor.curSmp];
+	sample_t *sIR = (instr[editor.srcInstr] != NULL) ? &instr[editor.srcInstr]->smp[editor.srcSmp] : NULL;
+
+	if (sIR == NULL || sIR->dataPtr == NULL || sIR->length <= 0 || sIR == s)
+		return true;
+
+	fillSampleUndo(REMOVE_SAMPLE_MARK);
+
+	const int32_t readLen = s->length;
+	const int32_t irLen = sIR->length;
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+	int32_t writeLen = readLen;
+	if (echo_AddMemory)
+		writeLen = (int32_t)MIN((int64_t)readLen + irLen - 1, MAX_SAMPLE_LEN);
+
+	int32_t blockBits = REVERB_MIN_BLOCK_BITS;
+	while (((int64_t)REVERB_MAX_PARTITIONS << blockBits) < irLen)
+		blockBits++;
+
+	const int32_t blockLen = 1 << blockBits;
+	const int32_t fftLen = blockLen * 2;
+	const int32_t numParts = (irLen + (blockLen-1)) >> blockBits;
+	const int32_t numBlocks = (int32_t)(((int64_t)writeLen + (blockLen-1)) >> blockBits);
+
+	// impulse response spectra, input spectra (delay line), work buffers, and the wet signal
+	double *irSpec = (double *)malloc((size_t)numParts * fftLen * 2 * sizeof (double));
+	double *inSpec = (double *)malloc((size_t)numParts * fftLen * 2 * sizeof (double));
+	double *dWork = (double *)malloc(fftLen * 2 * sizeof (double));
+	float *fWet = (float *)malloc((size_t)writeLen * sizeof (float));
+	int8_t *tmpBlock = (int8_t *)malloc(blockLen * sizeof (int16_t));
+	bool fftOK = fftInit(&fft, blockBits + 1);
+	bool cancelled = false;
+
+	sp.origPtr = sp.ptr = NULL;
+	if (irSpec == NULL || inSpec == NULL || dWork == NULL || fWet == NULL || tmpBlock == NULL || !fftOK ||
+		!allocateSmpDataPtr(&sp, writeLen, sample16Bit))
+	{
+		outOfMemory = true;
+		goto Done;
+	}
+
+	double *wRe = dWork;
+	double *wIm = dWork + fftLen;
+
+	// transform the impulse response blocks (normalized to -1.0 .. 1.0)
+	const double irMul = (sIR->flags & SAMPLE_16BIT) ? (1.0 / 32768.0) : (1.0 / 128.0);
+	for (int32_t p = 0; p < numParts; p++)
+	{
+		double *pRe = &irSpec[(size_t)p * fftLen * 2];
+		double *pIm = pRe + fftLen;
+
+		readSmpBlock(sIR, tmpBlock, pRe, p * blockLen, blockLen);
+		for (int32_t i = 0; i < blockLen; i++)
+			pRe[i] *= irMul;
+
+		for (int32_t i = blockLen; i < fftLen; i++)
+			pRe[i] = 0.0;
+
+		for (int32_t i = 0; i < fftLen; i++)
+			pIm[i] = 0.0;
+
+		fftTransform(&fft, pRe, pIm, false);
+	}
+
+	for (int32_t i = 0; i < writeLen; i++)
+		fWet[i] = 0.0f;
+
+	double dInPeak = 0.0, dWetPeak = 0.0;
+	const double dOutMul = 1.0 / fftLen;
+
+	int32_t b;
+	for (b = 0; b < numBlocks && !jobCancelled(job); b++)
 	{
-		int8_t *writePtr8 = sp.ptr;
-		while (writeIdx < writeLen)
+		const int32_t pos = b * blockLen;
+		setJobProgress(job, b, numBlocks);
+
+		// transform the next input block into the delay line
+		double *xRe = &inSpec[(size_t)(b % numParts) * fftLen * 2];
+		double *xIm = xRe + fftLen;
+
+		readSmpBlock(s, tmpBlock, xRe, pos, blockLen);
+		for (int32_t i = 0; i < blockLen; i++)
 		{
-			double dSmpOut = 0.0;
-			double dSmpMul = 1.0;
+			const double dAbs = fabs(xRe[i]);
+			if (dAbs > dInPeak)
+				dInPeak = dAbs;
+		}
 
-			int32_t echoRead = writeIdx;
-			int32_t echoCycle = nEchoes;
+		for (int32_t i = blockLen; i < fftLen; i++)
+			xRe[i] = 0.0;
 
-			while (!stopThread)
-			{
-				if (echoRead < readLen)
-					dSmpOut += (int32_t)readPtr[echoRead] * dSmpMul;
+		for (int32_t i = 0; i < fftLen; i++)
+			xIm[i] = 0.0;
+
+		fftTransform(&fft, xRe, xIm, false);
 
-				dSmpMul *= dVolChange;
+		// multiply-accumulate all partitions
+		for (int32_t i = 0; i < fftLen; i++)
+			wRe[i] = wIm[i] = 0.0;
 
-				echoRead -= distance;
-				if (echoRead <= 0 || --echoCycle <= 0)
-					break;
+		const int32_t partsUsed = MIN(numParts, b+1);
+		for (int32_t p = 0; p < partsUsed; p++)
+		{
+			const double *hRe = &irSpec[(size_t)p * fftLen * 2];
+			const double *hIm = hRe + fftLen;
+			const double *dRe = &inSpec[(size_t)((b - p) % numParts) * fftLen * 2];
+			const double *dIm = dRe + fftLen;
+
+			for (int32_t i = 0; i < fftLen; i++)
+			{
+				wRe[i] += (dRe[i] * hRe[i]) - (dIm[i] * hIm[i]);
+				wIm[i] += (dRe[i] * hIm[i]) + (dIm[i] * hRe[i]);
 			}
+		}
 
-			int32_t smp32 = (int32_t)round(dSmpOut);
-			writePtr8[writeIdx++] = (int8_t)(CLAMP(smp32, INT8_MIN, INT8_MAX));
+		fftTransform(&fft, wRe, wIm, true);
+
+		// overlap-add
+		const int32_t addLen = MIN(fftLen, writeLen - pos);
+		for (int32_t i = 0; i < addLen; i++)
+			fWet[pos+i] += (float)(wRe[i] * dOutMul);
+
+		// the first half of this block is complete now
+		const int32_t doneLen = MIN(blockLen, writeLen - pos);
+		for (int32_t i = 0; i < doneLen; i++)
+		{
+			const double dAbs = fabs(fWet[pos+i]);
+			if (dAbs > dWetPeak)
+				dWetPeak = dAbs;
 		}
 	}
 
-	freeSmpData(s);
-	setSmpDataPtr(s, &sp);
-
-	if (stopThread) // we stopped before echo was done, realloc length
+	cancelled = jobCancelled(job);
+	if (!cancelled)
 	{
-		writeLen = writeIdx;
-		reallocateSmpData(s, writeLen, sample16Bit);
-		editor.updateCurSmp = true;
-	}
+		const double dWetMix = echo_VolChange / 100.0;
+		const double dDryMix = 1.0 - dWetMix;
+		const double dWetMul = (dWetPeak > 0.0) ? ((dInPeak / dWetPeak) * dWetMix) : 0.0;
 
-	s->length = writeLen;
+		for (int32_t pos = 0; pos < writeLen; pos += blockLen)
+		{
+			const int32_t len = MIN(blockLen, writeLen - pos);
 
-	fixSample(s);
-	resumeAudio();
+			readSmpBlock(s, tmpBlock, wIm, pos, len); // dry signal
+			for (int32_t i = 0; i < len; i++)
+				wRe[i] = (wIm[i] * dDryMix) + (fWet[pos+i] * dWetMul);
 
-	setSongModifiedFlag();
-	setMouseBusy(false);
+			writeSmpBlock(sp.ptr, sample16Bit, wRe, pos, len);
+		}
 
-	ui.sysReqShown = false;
-	return true;
+		finishEchoSample(s, &sp, writeLen, writeLen);
+	}
+
+Done:
+	if (irSpec != NULL) free(irSpec);
+	if (inSpec != NULL) free(inSpec);
+	if (dWork != NULL) free(dWork);
+	if (fWet != NULL) free(fWet);
+	if (tmpBlock != NULL) free(tmpBlock);
+	fftFree(&fft);
+
+	if (cancelled || outOfMemory)
+	{
+		freeSmpDataPtr(&sp);
+		return false;
+	}
 
-	(void)ptr;
+	return true;
 }
 
 static void pbCreateEcho(void)
 {
-	stopThread = false;
-
-	mouseAnimOn();
-	thread = SDL_CreateThread(createEchoThread, "echo thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(echo_Convolve ? createReverbJob : createEchoJob, toolJobDone, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
 static void drawEchoBox(void)
@@ -564,7 +1044,7 @@ static void drawEchoBox(void)
 	const int16_t x = 171;
 	const int16_t y = 220;
 	const int16_t w = 291;
-	const int16_t h = 66;
+	const int16_t h = 80;
 
 	// main fill
 	fillRect(x + 1, y + 1, w - 2, h - 2, PAL_BUTTONS);
@@ -583,8 +1063,9 @@ static void drawEchoBox(void)
 
 	textOutShadow(177, 226, PAL_FORGRND, PAL_BUTTON2, "Number of echoes");
 	textOutShadow(177, 240, PAL_FORGRND, PAL_BUTTON2, "Echo distance");
-	textOutShadow(177, 254, PAL_FORGRND, PAL_BUTTON2, "Fade out");
+	textOutShadow(177, 254, PAL_FORGRND, PAL_BUTTON2, echo_Convolve ? "Wet mix" : "Fade out");
 	textOutShadow(192, 270, PAL_FORGRND, PAL_BUTTON2, "Add memory to sample");
+	textOutShadow(192, 284, PAL_FORGRND, PAL_BUTTON2, "Convolve with source sample (reverb)");
 
 	ASSERT(echo_nEcho <= 64);
 	charOut(315 + (2 * 7), 226, PAL_FORGRND, '0' + (char)(echo_nEcho / 10));
@@ -616,10 +1097,21 @@ static void setupEchoBoxWidgets(void)
 	c->checked = echo_AddMemory ? CHECKBOX_CHECKED : CHECKBOX_UNCHECKED;
 	c->visible = true;
 
-	// "Apply" pushbutton
-	p = &pushButtons[0];
-	memset(p, 0, sizeof (pushButton_t));
-	p->caption = "Apply";
+	// "Convolve with source sample (reverb)" checkbox
+	c = &checkBoxes[1];
+	memset(c, 0, sizeof (checkBox_t));
+	c->x = 176;
+	c->y = 282;
+	c->clickAreaWidth = 268;
+	c->clickAreaHeight = 12;
+	c->callbackFunc = cbEchoConvolve;
+	c->checked = echo_Convolve ? CHECKBOX_CHECKED : CHECKBOX_UNCHECKED;
+	c->visible = true;
+
+	// "Apply" pushbutton
+	p = &pushButtons[0];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = "Apply";
 	p->x = 345;
 	p->y = 266;
 	p->w = 56;
@@ -749,11 +1241,6 @@ static void setupEchoBoxWidgets(void)
 	setScrollBarEnd(2, 100);
 }
 
-void handleEchoToolPanic(void)
-{
-	stopThread = true;
-}
-
 void pbSampleEcho(void)
 {
 	if (editor.curInstr == 0 ||
@@ -772,6 +1259,7 @@ void pbSampleEcho(void)
 	while (ui.sysReqShown)
 	{
 		readInput();
+		handleJobs();
 		if (ui.sysReqEnterPressed)
 			pbCreateEcho();
 
@@ -783,6 +1271,7 @@ void pbSampleEcho(void)
 		setScrollBarPos(1, echo_Distance,  DONT_TRIGGER_CALLBACK);
 		setScrollBarPos(2, echo_VolChange, DONT_TRIGGER_CALLBACK);
 		drawCheckBox(0);
+		drawCheckBox(1);
 		for (uint16_t i = 0; i < 8; i++) drawPushButton(i);
 		for (uint16_t i = 0; i < 3; i++) drawScrollBar(i);
 
@@ -790,6 +1279,7 @@ void pbSampleEcho(void)
 	}
 
 	hideCheckBox(0);
+	hideCheckBox(1);
 	for (uint16_t i = 0; i < 8; i++) hidePushButton(i);
 	for (uint16_t i = 0; i < 3; i++) hideScrollBar(i);
 
@@ -799,12 +1289,38 @@ void pbSampleEcho(void)
 		okBox(0, "System message", "Not enough memory!", NULL);
 }
 
-static int32_t mixThread(void *ptr)
+// converts a block of sample data from copyUnfixedSmpData() to -1.0 .. 0.999inf
+static void getMixBlock(const sample_t *s, int8_t *tmp, double *dst, int32_t pos, int32_t length, int32_t smpLength)
+{
+	int32_t readLen = 0;
+	if (s != NULL && pos < smpLength)
+		readLen = MIN(length, smpLength - pos);
+
+	if (readLen > 0)
+	{
+		copyUnfixedSmpData(s, tmp, pos, readLen);
+		if (s->flags & SAMPLE_16BIT)
+		{
+			const int16_t *tmp16 = (const int16_t *)tmp;
+			for (int32_t i = 0; i < readLen; i++)
+				dst[i] = tmp16[i] * (1.0 / 32768.0);
+		}
+		else
+		{
+			for (int32_t i = 0; i < readLen; i++)
+				dst[i] = tmp[i] * (1.0 / 128.0);
+		}
+	}
+
+	for (int32_t i = readLen; i < length; i++)
+		dst[i] = 0.0;
+}
+
+static bool mixJob(job_t *job, void *data)
 {
 	smpPtr_t sp;
 
-	int8_t *dstPtr, *mixPtr;
-	uint8_t mixFlags, dstFlags;
+	uint8_t dstFlags;
 	int32_t dstLen, mixLen;
 
 	int16_t dstIns = editor.curInstr;
@@ -812,104 +1328,85 @@ static int32_t mixThread(void *ptr)
 	int16_t mixIns = editor.srcInstr;
 	int16_t mixSmp = editor.srcSmp;
 
-	sample_t *s = &instr[dstIns]->smp[dstSmp];
-	sample_t *sSrc = &instr[mixIns]->smp[mixSmp];
-
 	if (dstIns == mixIns && dstSmp == mixSmp)
-	{
-		setMouseBusy(false);
-		ui.sysReqShown = false;
 		return true;
-	}
 
-	if (instr[mixIns] == NULL)
-	{
-		mixLen = 0;
-		mixPtr = NULL;
-		mixFlags = 0;
-	}
-	else
-	{
-		mixLen = sSrc->length;
-		mixPtr = sSrc->dataPtr;
-		mixFlags = sSrc->flags;
+	sample_t *sSrc = NULL;
+	if (instr[mixIns] != NULL && instr[mixIns]->smp[mixSmp].dataPtr != NULL)
+		sSrc = &instr[mixIns]->smp[mixSmp];
 
-		if (mixPtr == NULL)
-		{
-			mixLen = 0;
-			mixFlags = 0;
-		}
-	}
+	mixLen = (sSrc != NULL) ? sSrc->length : 0;
 
-	if (instr[dstIns] == NULL)
-	{
-		dstLen = 0;
-		dstPtr = NULL;
-		dstFlags = 0;
-	}
-	else
-	{
-		dstLen = s->length;
-		dstPtr = s->dataPtr;
-		dstFlags = s->flags;
+	sample_t *s = NULL;
+	if (instr[dstIns] != NULL && instr[dstIns]->smp[dstSmp].dataPtr != NULL)
+		s = &instr[dstIns]->smp[dstSmp];
 
-		if (dstPtr == NULL)
-		{
-			dstLen = 0;
-			dstFlags = 0;
-		}
-	}
+	dstLen = (s != NULL) ? s->length : 0;
+	dstFlags = (s != NULL) ? s->flags : 0;
 
-	bool src16Bits = !!(mixFlags & SAMPLE_16BIT);
 	bool dst16Bits = !!(dstFlags & SAMPLE_16BIT);
 
 	int32_t maxLen = (dstLen > mixLen) ? dstLen : mixLen;
 	if (maxLen == 0)
-	{
-		setMouseBusy(false);
-		ui.sysReqShown = false;
 		return true;
-	}
 
-	if (!allocateSmpDataPtr(&sp, maxLen, dst16Bits))
+	if (instr[dstIns] == NULL && !allocateInstr(dstIns))
 	{
 		outOfMemory = true;
-		setMouseBusy(false);
-		ui.sysReqShown = false;
-		return true;
+		return false;
 	}
-	memset(sp.ptr, 0, maxLen);
 
-	if (instr[dstIns] == NULL && !allocateInstr(dstIns))
+	double *dBuffer = (double *)malloc(MIX_BLOCK_LEN * 2 * sizeof (double));
+	int8_t *tmpBlock = (int8_t *)malloc(MIX_BLOCK_LEN * sizeof (int16_t));
+
+	sp.origPtr = sp.ptr = NULL;
+	if (dBuffer == NULL || tmpBlock == NULL || !allocateSmpDataPtr(&sp, maxLen, dst16Bits))
 	{
+		if (dBuffer != NULL) free(dBuffer);
+		if (tmpBlock != NULL) free(tmpBlock);
+		freeSmpDataPtr(&sp);
+
 		outOfMemory = true;
-		setMouseBusy(false);
-		ui.sysReqShown = false;
-		return true;
+		return false;
 	}
 
-	pauseAudio();
-	unfixSample(s);
-
-	// unfix source sample
-	if (instr[mixIns] != NULL)
-		unfixSample(sSrc);
+	double *dMix = dBuffer;
+	double *dDst = dBuffer + MIX_BLOCK_LEN;
 
 	const double dAmp1 = mix_Balance / 100.0;
 	const double dAmp2 = 1.0 - dAmp1;
-	const double dSmp1ScaleMul = src16Bits ? (1.0 / 32768.0) : (1.0 / 128.0);
-	const double dSmp2ScaleMul = dst16Bits ? (1.0 / 32768.0) : (1.0 / 128.0);
 	const double dNormalizeMul = dst16Bits ? 32768.0 : 128.0;
 
-	for (int32_t i = 0; i < maxLen; i++)
+	// (the samples are only read here, so the audio doesn't need to be paused)
+	for (int32_t pos = 0; pos < maxLen; pos += MIX_BLOCK_LEN)
 	{
-		double dSmp1 = (i >= mixLen) ? 0.0 : (getSampleValue(mixPtr, i, src16Bits) * dSmp1ScaleMul); // -1.0 .. 0.999inf
-		double dSmp2 = (i >= dstLen) ? 0.0 : (getSampleValue(dstPtr, i, dst16Bits) * dSmp2ScaleMul); // -1.0 .. 0.999inf
+		if (jobCancelled(job))
+		{
+			free(dBuffer);
+			free(tmpBlock);
+			freeSmpDataPtr(&sp);
+			return false;
+		}
 
-		const double dSmp = ((dSmp1 * dAmp1) + (dSmp2 * dAmp2)) * dNormalizeMul;
-		putSampleValue(sp.ptr, i, dSmp, dst16Bits);
+		setJobProgress(job, pos, maxLen);
+
+		const int32_t blockLen = MIN(maxLen - pos, MIX_BLOCK_LEN);
+		getMixBlock(sSrc, tmpBlock, dMix, pos, blockLen, mixLen);
+		getMixBlock(s, tmpBlock, dDst, pos, blockLen, dstLen);
+
+		for (int32_t i = 0; i < blockLen; i++)
+		{
+			const double dSmp = ((dMix[i] * dAmp1) + (dDst[i] * dAmp2)) * dNormalizeMul;
+			putSampleValue(sp.ptr, pos+i, dSmp, dst16Bits);
+		}
 	}
 
+	free(dBuffer);
+	free(tmpBlock);
+
+	s = &instr[dstIns]->smp[dstSmp];
+
+	pauseAudio();
 	freeSmpData(s);
 	setSmpDataPtr(s, &sp);
 
@@ -917,33 +1414,18 @@ static int32_t mixThread(void *ptr)
 	s->flags = dstFlags;
 
 	fixSample(s);
-
-	// re-fix source sample again
-	if (instr[mixIns] != NULL)
-		fixSample(sSrc);
-
 	resumeAudio();
 
 	setSongModifiedFlag();
-	setMouseBusy(false);
-
-	ui.sysReqShown = false;
 	return true;
 
-	(void)ptr;
+	(void)data;
 }
 
 static void pbMix(void)
 {
-	mouseAnimOn();
-	thread = SDL_CreateThread(mixThread, "sample mix thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(mixJob, toolJobDone, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
 static void sbSetMixBalancePos(uint32_t pos)
@@ -1074,6 +1556,7 @@ void pbSampleMix(void)
 	while (ui.sysReqShown)
 	{
 		readInput();
+		handleJobs();
 		if (ui.sysReqEnterPressed)
 			pbMix();
 
@@ -1155,12 +1638,13 @@ static void pbSampEndVolUp(void)
 	dVol_EndVol = floor(dVol_EndVol);
 }
 
-static int32_t applyVolumeThread(void *ptr)
+static bool applyVolumeJob(job_t *job, void *data)
 {
+	smpPtr_t sp;
 	int32_t x1, x2;
 
 	if (instr[editor.curInstr] == NULL)
-		goto applyVolumeExit;
+		return true;
 
 	sample_t *s = &instr[editor.curInstr]->smp[editor.curSmp];
 
@@ -1176,7 +1660,7 @@ static int32_t applyVolumeThread(void *ptr)
 			x1 = 0;
 
 		if (x2 <= x1)
-			goto applyVolumeExit;
+			return true;
 	}
 	else
 	{
@@ -1187,70 +1671,69 @@ static int32_t applyVolumeThread(void *ptr)
 
 	const int32_t len = x2 - x1;
 	if (len <= 0)
-		goto applyVolumeExit;
+		return true;
+
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	if (!allocateSmpDataPtr(&sp, s->length, sample16Bit))
+	{
+		okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
+		return false;
+	}
+
+	// the volume is applied to a copy, so the audio is only paused while it's swapped in
+	copyUnfixedSmpData(s, sp.ptr, 0, s->length);
 
-	const bool mustInterpolate = (dVol_StartVol != dVol_EndVol);
 	const double dVolDelta = ((dVol_EndVol - dVol_StartVol) / 100.0) / len;
 	double dVol = dVol_StartVol / 100.0;
 
-	pauseAudio();
-	unfixSample(s);
-	if (s->flags & SAMPLE_16BIT)
+	for (int32_t pos = 0; pos < len; pos += VOLUME_BLOCK_LEN)
 	{
-		int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-		if (mustInterpolate)
+		if (jobCancelled(job))
 		{
-			for (int32_t i = 0; i < len; i++)
-			{
-				int32_t smp32 = (int32_t)((int32_t)ptr16[i] * dVol);
-				ptr16[i] = (int16_t)(CLAMP(smp32, INT16_MIN, INT16_MAX));
-
-				dVol += dVolDelta;
-			}
+			freeSmpDataPtr(&sp);
+			return false;
 		}
-		else // no interpolation needed
+
+		setJobProgress(job, pos, len);
+
+		const int32_t blockLen = MIN(len - pos, VOLUME_BLOCK_LEN);
+		if (sample16Bit)
 		{
-			for (int32_t i = 0; i < len; i++)
+			int16_t *ptr16 = (int16_t *)sp.ptr + x1 + pos;
+			for (int32_t i = 0; i < blockLen; i++)
 			{
 				int32_t smp32 = (int32_t)((int32_t)ptr16[i] * dVol);
 				ptr16[i] = (int16_t)(CLAMP(smp32, INT16_MIN, INT16_MAX));
-			}
-		}
-	}
-	else // 8-bit sample
-	{
-		int8_t *ptr8 = s->dataPtr + x1;
-		if (mustInterpolate)
-		{
-			for (int32_t i = 0; i < len; i++)
-			{
-				int32_t smp32 = (int32_t)((int32_t)ptr8[i] * dVol);
-				ptr8[i] = (int8_t)(CLAMP(smp32, INT8_MIN, INT8_MAX));
 
 				dVol += dVolDelta;
 			}
 		}
-		else // no interpolation needed
+		else // 8-bit sample
 		{
-			for (int32_t i = 0; i < len; i++)
+			int8_t *ptr8 = sp.ptr + x1 + pos;
+			for (int32_t i = 0; i < blockLen; i++)
 			{
 				int32_t smp32 = (int32_t)((int32_t)ptr8[i] * dVol);
 				ptr8[i] = (int8_t)(CLAMP(smp32, INT8_MIN, INT8_MAX));
+
+				dVol += dVolDelta;
 			}
 		}
 	}
+
+	fillSampleUndo(KEEP_SAMPLE_MARK); // (not until now, in case the job was cancelled)
+
+	pauseAudio();
+	freeSmpData(s);
+	setSmpDataPtr(s, &sp);
 	fixSample(s);
+	setSampleUndoEditRange(x1, len);
 	resumeAudio();
 
 	setSongModifiedFlag();
-
-applyVolumeExit:
-	setMouseBusy(false);
-	ui.sysReqShown = false;
-
 	return true;
 
-	(void)ptr;
+	(void)data;
 }
 
 static void pbApplyVolume(void)
@@ -1261,18 +1744,11 @@ static void pbApplyVolume(void)
 		return; // no volume change to be done
 	}
 
-	mouseAnimOn();
-	thread = SDL_CreateThread(applyVolumeThread, "sample modification thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(applyVolumeJob, toolJobDone, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
-static int32_t getMaxScaleThread(void *ptr)
+static bool getMaxScaleJob(job_t *job, void *data)
 {
 	int32_t x1, x2;
 
@@ -1311,71 +1787,39 @@ static int32_t getMaxScaleThread(void *ptr)
 
 	double dVolChange = 100.0;
 
-	/* If sample is looped and the loopEnd point is inside the marked range,
-	** we need to unfix the fixed interpolation sample before scanning,
-	** and fix it again after we're done.
-	*/
-	bool hasLoop = GET_LOOPTYPE(s->flags) != LOOP_DISABLED;
-	const int32_t loopEnd = s->loopStart + s->loopLength;
-	bool fixedSampleInRange = hasLoop && (x1 <= loopEnd) && (x2 >= loopEnd);
-
-	if (fixedSampleInRange)
-		unfixSample(s);
+	// scans the original data if the range includes the fixed interpolation samples, no need to unfix/fix
+	int16_t min16, max16;
+	getRawSamplePeak(s, x1, len, &min16, &max16);
 
-	int32_t maxAmp = 0;
 	if (s->flags & SAMPLE_16BIT)
 	{
-		const int16_t *ptr16 = (const int16_t *)s->dataPtr + x1;
-		for (uint32_t i = 0; i < len; i++)
-		{
-			const int32_t absSmp = ABS(ptr16[i]);
-			if (absSmp > maxAmp)
-				maxAmp = absSmp;
-		}
-
+		const int32_t maxAmp = MAX(-min16, max16);
 		if (maxAmp > 0)
 			dVolChange = (32767.0 / maxAmp) * 100.0;
 	}
 	else // 8-bit
 	{
-		const int8_t *ptr8 = (const int8_t *)&s->dataPtr[x1];
-		for (uint32_t i = 0; i < len; i++)
-		{
-			const int32_t absSmp = ABS(ptr8[i]);
-			if (absSmp > maxAmp)
-				maxAmp = absSmp;
-		}
-
+		const int32_t maxAmp = MAX(-(min16 >> 8), max16 >> 8);
 		if (maxAmp > 0)
 			dVolChange = (127.0 / maxAmp) * 100.0;
 	}
 
-	if (fixedSampleInRange)
-		fixSample(s);
-
 	if (dVolChange < 100.0) // yes, this can happen...
 		dVolChange = 100.0;
 
 	dVol_StartVol = dVol_EndVol = dVolChange;
 
 getScaleExit:
-	setMouseBusy(false);
 	return true;
 
-	(void)ptr;
+	(void)job;
+	(void)data;
 }
 
 static void pbGetMaxScale(void)
 {
-	mouseAnimOn();
-	thread = SDL_CreateThread(getMaxScaleThread, "sample modification thread", NULL);
-	if (thread == NULL)
-	{
+	if (!startJob(getMaxScaleJob, NULL, NULL, JOB_FOREGROUND))
 		okBox(0, "System message", "Couldn't create thread!", NULL);
-		return;
-	}
-
-	SDL_DetachThread(thread);
 }
 
 static void drawSampleVolumeBox(void)
@@ -1612,6 +2056,7 @@ void pbSampleVolume(void)
 	while (ui.sysReqShown)
 	{
 		readInput();
+		handleJobs();
 		if (ui.sysReqEnterPressed)
 		{
 			pbApplyVolume();
@@ -1621,9 +2066,6 @@ void pbSampleVolume(void)
 		setSyncedReplayerVars();
 		handleRedrawing();
 
-		// this is needed for the "Get maximum scale" button
-		if (ui.setMouseIdle) mouseAnimOff();
-
 		drawSampleVolumeBox();
 
 		const int32_t startVol = (int32_t)dVol_StartVol;
@@ -1642,3 +2084,556 @@ void pbSampleVolume(void)
 
 	windowClose(true);
 }
+
+static bool batchCancel(void) // (called from a job, the other jobs will see it and bail out)
+{
+	cancelForegroundJobs();
+	return false;
+}
+
+// runs the enabled effects on a copy of the sample, the copy is swapped in when the whole batch is done
+static bool batchProcessSample(job_t *job, batchItem_t *item)
+{
+	smpPtr_t sp, sp2;
+
+	sample_t *s = &instr[item->instrNum]->smp[item->smpNum];
+	bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	int32_t length = s->length;
+
+	item->relativeNote = s->relativeNote;
+	item->finetune = s->finetune;
+	item->loopStart = s->loopStart;
+	item->loopLength = s->loopLength;
+
+	if (!allocateSmpDataPtr(&sp, length, sample16Bit))
+	{
+		batchOutOfMemory = true;
+		return batchCancel();
+	}
+
+	copyUnfixedSmpData(s, sp.ptr, 0, length);
+
+	if (batch_Downsample)
+	{
+		// set up the new tuning first, so that the resampling ratio matches its (rounded) rate
+		sample_t newSmp = *s;
+		setSampleC4Hz(&newSmp, batchRates[batch_RateIndex]);
+
+		const int32_t oldC4Hz = getSampleC4Hz(s);
+		const int32_t newC4Hz = getSampleC4Hz(&newSmp);
+		const double dRatio = (oldC4Hz > 0) ? ((double)newC4Hz / oldC4Hz) : 1.0;
+		const uint32_t newLength = (uint32_t)floor(length * dRatio);
+
+		if (newC4Hz > 0 && newC4Hz < oldC4Hz && newLength > 0)
+		{
+			if (!allocateSmpDataPtr(&sp2, newLength, sample16Bit))
+			{
+				freeSmpDataPtr(&sp);
+				batchOutOfMemory = true;
+				return batchCancel();
+			}
+
+			resampleChunk_t chunk;
+			memset(&chunk, 0, sizeof (chunk));
+			chunk.src = sp.ptr;
+			chunk.dst = sp2.ptr;
+			chunk.sample16Bit = sample16Bit;
+			chunk.srcLength = length;
+			chunk.dstStart = 0;
+			chunk.dstEnd = newLength;
+			chunk.delta64 = (uint64_t)round((UINT32_MAX+1.0) / dRatio);
+
+			const bool ok = resampleSincChunk(job, &chunk);
+
+			freeSmpDataPtr(&sp);
+			sp = sp2;
+
+			if (!ok)
+			{
+				freeSmpDataPtr(&sp);
+				return false;
+			}
+
+			length = newLength;
+			item->loopStart = (int32_t)(item->loopStart * dRatio);
+			item->loopLength = (int32_t)(item->loopLength * dRatio);
+			item->relativeNote = newSmp.relativeNote;
+			item->finetune = newSmp.finetune;
+		}
+	}
+
+	if (batch_FixDC)
+		removeSampleDataDC(sp.ptr, length, sample16Bit);
+
+	if (batch_Normalize)
+	{
+		const uint32_t peak = sample16Bit ? getPeak16((const int16_t *)sp.ptr, length) : getPeak8(sp.ptr, length);
+		const uint32_t maxAmp = sample16Bit ? 32767 : 127;
+
+		if (peak > 0 && peak < maxAmp)
+		{
+			const double dGain = (double)maxAmp / peak;
+			if (sample16Bit)
+			{
+				int16_t *ptr16 = (int16_t *)sp.ptr;
+				for (int32_t i = 0; i < length; i++)
+				{
+					int32_t smp32 = (int32_t)(ptr16[i] * dGain);
+					ptr16[i] = (int16_t)(CLAMP(smp32, INT16_MIN, INT16_MAX));
+				}
+			}
+			else
+			{
+				int8_t *ptr8 = sp.ptr;
+				for (int32_t i = 0; i < length; i++)
+				{
+					int32_t smp32 = (int32_t)(ptr8[i] * dGain);
+					ptr8[i] = (int8_t)(CLAMP(smp32, INT8_MIN, INT8_MAX));
+				}
+			}
+		}
+	}
+
+	if (batch_To8Bit && sample16Bit)
+	{
+		if (!allocateSmpDataPtr(&sp2, length, false))
+		{
+			freeSmpDataPtr(&sp);
+			batchOutOfMemory = true;
+			return batchCancel();
+		}
+
+		const int16_t *src16 = (const int16_t *)sp.ptr;
+		for (int32_t i = 0; i < length; i++)
+			sp2.ptr[i] = (int8_t)(src16[i] >> 8);
+
+		freeSmpDataPtr(&sp);
+		sp = sp2;
+		sample16Bit = false;
+	}
+
+	item->sp = sp;
+	item->length = length;
+	item->sample16Bit = sample16Bit;
+	item->done = true;
+
+	return true;
+}
+
+static bool batchJob(job_t *job, void *data)
+{
+	// the samples are shared by all the batch jobs, each job takes the next one until they're all done
+	while (!jobCancelled(job))
+	{
+		const int32_t i = SDL_AtomicAdd(&batchNextItem, 1);
+		if (i >= batchNumItems)
+			return true;
+
+		if (!batchProcessSample(job, &batchItems[i]))
+			return false;
+
+		const int32_t numDone = SDL_AtomicAdd(&batchItemsDone, 1) + 1;
+		setJobProgress(job, numDone, batchNumItems);
+	}
+
+	return false;
+
+	(void)data;
+}
+
+static void batchJobDone(void *data, int32_t result)
+{
+	if (result != JOB_DONE)
+		batchFailed = true;
+
+	if (--batchJobsLeft > 0)
+		return; // wait for the other jobs
+
+	if (batchFailed)
+	{
+		// cancelled (or out of memory), leave all the samples as they were
+		for (int32_t i = 0; i < batchNumItems; i++)
+		{
+			if (batchItems[i].done)
+				freeSmpDataPtr(&batchItems[i].sp);
+		}
+	}
+	else
+	{
+		// one undo step for the whole batch
+		const uint32_t undoGroup = newSampleUndoGroup();
+		for (int32_t i = 0; i < batchNumItems; i++)
+			fillSampleUndoGroup(undoGroup, batchItems[i].instrNum, batchItems[i].smpNum);
+
+		pauseAudio();
+		for (int32_t i = 0; i < batchNumItems; i++)
+		{
+			batchItem_t *item = &batchItems[i];
+			sample_t *s = &instr[item->instrNum]->smp[item->smpNum];
+
+			freeSmpData(s);
+			setSmpDataPtr(s, &item->sp);
+
+			if (item->sample16Bit)
+				s->flags |= SAMPLE_16BIT;
+			else
+				s->flags &= ~SAMPLE_16BIT;
+
+			s->length = item->length;
+			s->loopStart = item->loopStart;
+			s->loopLength = item->loopLength;
+			s->relativeNote = item->relativeNote;
+			s->finetune = item->finetune;
+
+			sanitizeSample(s);
+			fixSample(s);
+		}
+		resumeAudio();
+
+		setSongModifiedFlag();
+	}
+
+	batchNumItems = 0;
+	ui.sysReqShown = false;
+
+	(void)data;
+}
+
+static int32_t batchItemCompare(const void *a, const void *b) // longest sample first
+{
+	const batchItem_t *item1 = (const batchItem_t *)a;
+	const batchItem_t *item2 = (const batchItem_t *)b;
+
+	const int32_t len1 = instr[item1->instrNum]->smp[item1->smpNum].length;
+	const int32_t len2 = instr[item2->instrNum]->smp[item2->smpNum].length;
+
+	return (len1 < len2) - (len1 > len2);
+}
+
+static void pbApplyBatch(void)
+{
+	if (foregroundJobsRunning())
+		return;
+
+	if (!batch_Downsample && !batch_FixDC && !batch_Normalize && !batch_To8Bit)
+	{
+		ui.sysReqShown = false;
+		return; // nothing to be done
+	}
+
+	batchNumItems = 0;
+	for (int32_t i = batch_FirstInstr; i <= batch_LastInstr; i++)
+	{
+		if (instr[i] == NULL)
+			continue;
+
+		for (int32_t j = 0; j < MAX_SMP_PER_INST; j++)
+		{
+			const sample_t *s = &instr[i]->smp[j];
+			if (s->dataPtr == NULL || s->length <= 0)
+				continue;
+
+			batchItem_t *item = &batchItems[batchNumItems++];
+			memset(item, 0, sizeof (batchItem_t));
+			item->instrNum = (uint8_t)i;
+			item->smpNum = (uint8_t)j;
+		}
+	}
+
+	if (batchNumItems == 0)
+	{
+		ui.sysReqShown = false;
+		return;
+	}
+
+	// the longest samples are started first, so that the jobs end at about the same time
+	qsort(batchItems, batchNumItems, sizeof (batchItem_t), batchItemCompare);
+
+	SDL_AtomicSet(&batchNextItem, 0);
+	SDL_AtomicSet(&batchItemsDone, 0);
+	batchFailed = batchOutOfMemory = false;
+
+	int32_t numJobs = SDL_GetCPUCount();
+	numJobs = CLAMP(numJobs, 1, BATCH_MAX_JOBS);
+	if (numJobs > batchNumItems)
+		numJobs = batchNumItems;
+
+	batchJobsLeft = 0;
+	for (int32_t i = 0; i < numJobs; i++)
+	{
+		// (if only some of the jobs could be started, they'll just do more samples each)
+		if (startJob(batchJob, batchJobDone, NULL, JOB_FOREGROUND))
+			batchJobsLeft++;
+	}
+
+	if (batchJobsLeft == 0)
+	{
+		batchNumItems = 0;
+		okBox(0, "System message", "Couldn't create thread!", NULL);
+	}
+}
+
+static void cbBatchDownsample(void)
+{
+	batch_Downsample ^= 1;
+}
+
+static void cbBatchFixDC(void)
+{
+	batch_FixDC ^= 1;
+}
+
+static void cbBatchNormalize(void)
+{
+	batch_Normalize ^= 1;
+}
+
+static void cbBatchTo8Bit(void)
+{
+	batch_To8Bit ^= 1;
+}
+
+static void pbBatchFirstInstrUp(void)
+{
+	if (batch_FirstInstr < MAX_INST)
+		batch_FirstInstr++;
+
+	if (batch_LastInstr < batch_FirstInstr)
+		batch_LastInstr = batch_FirstInstr;
+}
+
+static void pbBatchFirstInstrDown(void)
+{
+	if (batch_FirstInstr > 1)
+		batch_FirstInstr--;
+}
+
+static void pbBatchLastInstrUp(void)
+{
+	if (batch_LastInstr < MAX_INST)
+		batch_LastInstr++;
+}
+
+static void pbBatchLastInstrDown(void)
+{
+	if (batch_LastInstr > 1)
+		batch_LastInstr--;
+
+	if (batch_FirstInstr > batch_LastInstr)
+		batch_FirstInstr = batch_LastInstr;
+}
+
+static void pbBatchRateDown(void)
+{
+	if (batch_RateIndex > 0)
+		batch_RateIndex--;
+}
+
+static void pbBatchRateUp(void)
+{
+	if (batch_RateIndex < BATCH_NUM_RATES-1)
+		batch_RateIndex++;
+}
+
+static void drawBatchBox(void)
+{
+	char text[16];
+	const int16_t x = 166;
+	const int16_t y = 206;
+	const int16_t w = 301;
+	const int16_t h = 100;
+
+	// main fill
+	fillRect(x + 1, y + 1, w - 2, h - 2, PAL_BUTTONS);
+
+	// outer border
+	vLine(x,         y,         h - 1, PAL_BUTTON1);
+	hLine(x + 1,     y,         w - 2, PAL_BUTTON1);
+	vLine(x + w - 1, y,         h,     PAL_BUTTON2);
+	hLine(x,         y + h - 1, w - 1, PAL_BUTTON2);
+
+	// inner border
+	vLine(x + 2,     y + 2,     h - 5, PAL_BUTTON2);
+	hLine(x + 3,     y + 2,     w - 6, PAL_BUTTON2);
+	vLine(x + w - 3, y + 2,     h - 4, PAL_BUTTON1);
+	hLine(x + 2,     y + h - 3, w - 4, PAL_BUTTON1);
+
+	textOutShadow(172, 213, PAL_FORGRND, PAL_BUTTON2, "Instruments");
+	hexOut(256, 213, PAL_FORGRND, batch_FirstInstr, 2);
+	textOutShadow(318, 213, PAL_FORGRND, PAL_BUTTON2, "to");
+	hexOut(336, 213, PAL_FORGRND, batch_LastInstr, 2);
+
+	textOutShadow(187, 229, PAL_FORGRND, PAL_BUTTON2, "Downsample to");
+	sprintf(text, "%dHz", batchRates[batch_RateIndex]);
+	textOut(300, 229, PAL_FORGRND, text);
+	textOutShadow(350, 229, PAL_FORGRND, PAL_BUTTON2, "if higher");
+	textOutShadow(187, 243, PAL_FORGRND, PAL_BUTTON2, "Remove DC offset");
+	textOutShadow(187, 257, PAL_FORGRND, PAL_BUTTON2, "Normalize");
+	textOutShadow(187, 271, PAL_FORGRND, PAL_BUTTON2, "Convert to 8-bit");
+}
+
+static void setupBatchBoxWidgets(void)
+{
+	static const struct
+	{
+		bool *enabled;
+		void (*callbackFunc)(void);
+	} options[4] =
+	{
+		{ &batch_Downsample, cbBatchDownsample },
+		{ &batch_FixDC, cbBatchFixDC },
+		{ &batch_Normalize, cbBatchNormalize },
+		{ &batch_To8Bit, cbBatchTo8Bit }
+	};
+
+	pushButton_t *p;
+	checkBox_t *c;
+
+	for (int32_t i = 0; i < 4; i++)
+	{
+		c = &checkBoxes[i];
+		memset(c, 0, sizeof (checkBox_t));
+		c->x = 171;
+		c->y = 227 + (i * 14);
+		c->clickAreaWidth = (i == 0) ? 125 : 120;
+		c->clickAreaHeight = 12;
+		c->callbackFunc = options[i].callbackFunc;
+		c->checked = *options[i].enabled ? CHECKBOX_CHECKED : CHECKBOX_UNCHECKED;
+		c->visible = true;
+	}
+
+	// "Apply" pushbutton
+	p = &pushButtons[0];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = "Apply";
+	p->x = 171;
+	p->y = 285;
+	p->w = 73;
+	p->h = 16;
+	p->callbackFuncOnUp = pbApplyBatch;
+	p->visible = true;
+
+	// "Exit" pushbutton
+	p = &pushButtons[1];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = "Exit";
+	p->x = 389;
+	p->y = 285;
+	p->w = 73;
+	p->h = 16;
+	p->callbackFuncOnUp = pbExit;
+	p->visible = true;
+
+	// instrument range buttons
+
+	p = &pushButtons[2];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = ARROW_UP_STRING;
+	p->x = 274;
+	p->y = 211;
+	p->w = 18;
+	p->h = 13;
+	p->preDelay = 1;
+	p->delayFrames = 3;
+	p->callbackFuncOnDown = pbBatchFirstInstrUp;
+	p->visible = true;
+
+	p = &pushButtons[3];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = ARROW_DOWN_STRING;
+	p->x = 291;
+	p->y = 211;
+	p->w = 18;
+	p->h = 13;
+	p->preDelay = 1;
+	p->delayFrames = 3;
+	p->callbackFuncOnDown = pbBatchFirstInstrDown;
+	p->visible = true;
+
+	p = &pushButtons[4];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = ARROW_UP_STRING;
+	p->x = 354;
+	p->y = 211;
+	p->w = 18;
+	p->h = 13;
+	p->preDelay = 1;
+	p->delayFrames = 3;
+	p->callbackFuncOnDown = pbBatchLastInstrUp;
+	p->visible = true;
+
+	p = &pushButtons[5];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = ARROW_DOWN_STRING;
+	p->x = 371;
+	p->y = 211;
+	p->w = 18;
+	p->h = 13;
+	p->preDelay = 1;
+	p->delayFrames = 3;
+	p->callbackFuncOnDown = pbBatchLastInstrDown;
+	p->visible = true;
+
+	// downsampling rate buttons
+
+	p = &pushButtons[6];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = ARROW_LEFT_STRING;
+	p->x = 411;
+	p->y = 227;
+	p->w = 23;
+	p->h = 13;
+	p->preDelay = 1;
+	p->delayFrames = 3;
+	p->callbackFuncOnDown = pbBatchRateDown;
+	p->visible = true;
+
+	p = &pushButtons[7];
+	memset(p, 0, sizeof (pushButton_t));
+	p->caption = ARROW_RIGHT_STRING;
+	p->x = 434;
+	p->y = 227;
+	p->w = 23;
+	p->h = 13;
+	p->preDelay = 1;
+	p->delayFrames = 3;
+	p->callbackFuncOnDown = pbBatchRateUp;
+	p->visible = true;
+}
+
+void pbSampleBatch(void)
+{
+	uint16_t i;
+
+	setupBatchBoxWidgets();
+	windowOpen();
+
+	exitFlag = false;
+	while (ui.sysReqShown)
+	{
+		readInput();
+		handleJobs();
+		if (ui.sysReqEnterPressed)
+		{
+			pbApplyBatch();
+			keyb.ignoreCurrKeyUp = true; // don't handle key up event for this key release
+		}
+
+		setSyncedReplayerVars();
+		handleRedrawing();
+
+		drawBatchBox();
+		for (i = 0; i < 4; i++) drawCheckBox(i);
+		for (i = 0; i < 8; i++) drawPushButton(i);
+
+		flipFrame();
+	}
+
+	for (i = 0; i < 4; i++) hideCheckBox(i);
+	for (i = 0; i < 8; i++) hidePushButton(i);
+
+	windowClose(false);
+
+	if (batchOutOfMemory)
+		okBox(0, "System message", "Not enough memory!", NULL);
+}
@@ -6,4 +6,4 @@ void pbSampleResample(void);
 void pbSampleEcho(void);
 void pbSampleMix(void);
 void pbSampleVolume(void);
-void handleEchoToolPanic(void);
+void pbSampleBatch(void);
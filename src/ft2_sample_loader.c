@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <math.h>
 #include "ft2_header.h"
+#include "ft2_memfile.h"
 #include "ft2_gui.h"
 #include "ft2_unicode.h"
 #include "ft2_audio.h"
@@ -15,23 +16,26 @@
 #include "ft2_mouse.h"
 #include "ft2_diskop.h"
 #include "ft2_structs.h"
+#include "ft2_sample_scan.h"
+#include "ft2_jobs.h"
+#include "ft2_sysreqs.h"
 
-bool detectFLAC(FILE *f);
-bool loadFLAC(FILE *f, uint32_t filesize);
+bool detectFLAC(MEMFILE *f);
+bool loadFLAC(MEMFILE *f, uint32_t filesize);
 
-bool detectOGG(FILE *f);
-bool loadOGG(FILE *f, uint32_t filesize);
+bool detectOGG(MEMFILE *f);
+bool loadOGG(MEMFILE *f, uint32_t filesize);
 
-bool detectMP3(FILE *f);
-bool loadMP3(FILE *f, uint32_t filesize);
+bool detectMP3(MEMFILE *f);
+bool loadMP3(MEMFILE *f, uint32_t filesize);
 
-bool detectBRR(FILE *f);
-bool loadBRR(FILE *f, uint32_t filesize);
+bool detectBRR(MEMFILE *f);
+bool loadBRR(MEMFILE *f, uint32_t filesize);
 
-bool loadAIFF(FILE *f, uint32_t filesize);
-bool loadIFF(FILE *f, uint32_t filesize);
-bool loadRAW(FILE *f, uint32_t filesize);
-bool loadWAV(FILE *f, uint32_t filesize);
+bool loadAIFF(MEMFILE *f, uint32_t filesize);
+bool loadIFF(MEMFILE *f, uint32_t filesize);
+bool loadRAW(MEMFILE *f, uint32_t filesize);
+bool loadWAV(MEMFILE *f, uint32_t filesize);
 
 enum
 {
@@ -61,21 +65,23 @@ uint8_t sampleSlot;
 sample_t tmpSmp;
 // --------------------------
 
-static volatile bool sampleIsLoading;
+static volatile bool sampleIsLoading, sampleLoadCancel;
+static volatile int32_t sampleLoadProgress;
+static int32_t lastDrawnProgressW;
 static SDL_Thread *thread;
 
 static void freeTmpSample(sample_t *s);
 
 // Crude sample detection routine. These aren't always accurate detections!
-static int8_t detectSample(FILE *f)
+static int8_t detectSample(MEMFILE *f)
 {
 	uint8_t D[512];
 
-	uint32_t oldPos = ftell(f);
-	rewind(f);
+	uint32_t oldPos = mtell(f);
+	mrewind(f);
 	memset(D, 0, sizeof (D));
-	fread(D, 1, sizeof (D), f);
-	fseek(f, oldPos, SEEK_SET);
+	mread(D, 1, sizeof (D), f);
+	mseek(f, oldPos, SEEK_SET);
 
 	if (detectFLAC(f))
 		return FORMAT_FLAC;
@@ -101,6 +107,31 @@ static int8_t detectSample(FILE *f)
 	return FORMAT_UNKNOWN;
 }
 
+static bool loadSampleFromMemFile(MEMFILE *f) // loads into tmpSmp
+{
+	int8_t format = detectSample(f);
+	uint32_t filesize = (uint32_t)msize(f);
+
+	if (filesize == 0)
+	{
+		loaderMsgBox("Error loading sample: The file is empty!");
+		return false;
+	}
+
+	mrewind(f);
+	switch (format)
+	{
+		case FORMAT_IFF: return loadIFF(f, filesize);
+		case FORMAT_WAV: return loadWAV(f, filesize);
+		case FORMAT_AIFF: return loadAIFF(f, filesize);
+		case FORMAT_FLAC: return loadFLAC(f, filesize);
+		case FORMAT_OGG: return loadOGG(f, filesize);
+		case FORMAT_MP3: return loadMP3(f, filesize);
+		case FORMAT_BRR: return loadBRR(f, filesize);
+		default: return loadRAW(f, filesize);
+	}
+}
+
 static int32_t loadSampleThread(void *ptr)
 {
 	if (editor.tmpFilenameU == NULL)
@@ -109,39 +140,15 @@ static int32_t loadSampleThread(void *ptr)
 		goto loadError;
 	}
 
-	FILE *f = UNICHAR_FOPEN(editor.tmpFilenameU, "rb");
+	MEMFILE *f = mopenFile(editor.tmpFilenameU);
 	if (f == NULL)
 	{
 		loaderMsgBox("General I/O error during loading! Is the file in use?");
 		goto loadError;
 	}
 
-	int8_t format = detectSample(f);
-	fseek(f, 0, SEEK_END);
-	uint32_t filesize = ftell(f);
-
-	if (filesize == 0)
-	{
-		fclose(f);
-		loaderMsgBox("Error loading sample: The file is empty!");
-		goto loadError;
-	}
-
-	bool sampleLoaded = false;
-
-	rewind(f);
-	switch (format)
-	{
-		case FORMAT_IFF: sampleLoaded = loadIFF(f, filesize); break;
-		case FORMAT_WAV: sampleLoaded = loadWAV(f, filesize); break;
-		case FORMAT_AIFF: sampleLoaded = loadAIFF(f, filesize); break;
-		case FORMAT_FLAC: sampleLoaded = loadFLAC(f, filesize); break;
-		case FORMAT_OGG: sampleLoaded = loadOGG(f, filesize); break;
-		case FORMAT_MP3: sampleLoaded = loadMP3(f, filesize); break;
-		case FORMAT_BRR: sampleLoaded = loadBRR(f, filesize); break;
-		default: sampleLoaded = loadRAW(f, filesize); break;
-	}
-	fclose(f);
+	const bool sampleLoaded = loadSampleFromMemFile(f);
+	mclose(&f);
 
 	if (!sampleLoaded)
 		goto loadError;
@@ -230,11 +237,80 @@ static void freeTmpSample(sample_t *s)
 	freeSmpData(s);
 }
 
+bool testLoadSample(const uint8_t *data, uint32_t dataLength)
+{
+	if (sampleIsLoading)
+		return false; // tmpSmp is in use
+
+	MEMFILE *f = mopen(data, dataLength);
+	if (f == NULL)
+		return false;
+
+	loaderMsgBox = silentLoaderMsgBox;
+	loaderSysReq = silentLoaderSysReq;
+
+	memset(&tmpSmp, 0, sizeof (tmpSmp));
+	const bool sampleLoaded = loadSampleFromMemFile(f);
+	mclose(&f);
+
+	freeTmpSample(&tmpSmp);
+	return sampleLoaded;
+}
+
 void removeSampleIsLoadingFlag(void)
 {
 	sampleIsLoading = false;
 }
 
+void setSampleLoadProgress(uint64_t pos, uint64_t total)
+{
+	if (total == 0)
+		return;
+
+	if (pos > total)
+		pos = total;
+
+	const int32_t progress = (int32_t)((pos * JOB_PROGRESS_MAX) / total);
+	if (progress > sampleLoadProgress)
+		sampleLoadProgress = progress;
+}
+
+bool sampleLoadingCancelled(void)
+{
+	return sampleLoadCancel;
+}
+
+void cancelSampleLoading(void)
+{
+	if (sampleIsLoading)
+		sampleLoadCancel = true;
+}
+
+void handleSampleLoadProgress(void)
+{
+	if (!sampleIsLoading)
+	{
+		if (lastDrawnProgressW > 0)
+		{
+			lastDrawnProgressW = 0;
+			if (ui.sampleEditorShown)
+				writeSample(FORCE_SAMPLE_REDRAW); // erase the progress bar
+		}
+
+		return;
+	}
+
+	if (!ui.sampleEditorShown)
+		return;
+
+	const int32_t w = (sampleLoadProgress * SAMPLE_AREA_WIDTH) / JOB_PROGRESS_MAX;
+	if (w <= lastDrawnProgressW)
+		return;
+
+	fillRect(0, 324, (uint16_t)w, 3, PAL_FORGRND);
+	lastDrawnProgressW = w;
+}
+
 bool loadSample(UNICHAR *filenameU, uint8_t smpNr, bool instrFlag)
 {
 	if (sampleIsLoading || filenameU == NULL)
@@ -253,6 +329,9 @@ bool loadSample(UNICHAR *filenameU, uint8_t smpNr, bool instrFlag)
 	sampleSlot = smpNr;
 	loadAsInstrFlag = instrFlag;
 	sampleIsLoading = true;
+	sampleLoadCancel = false;
+	sampleLoadProgress = 0;
+	lastDrawnProgressW = 0;
 	smpFilenameSet = false;
 
 	memset(&tmpSmp, 0, sizeof (tmpSmp));
@@ -273,60 +352,30 @@ bool loadSample(UNICHAR *filenameU, uint8_t smpNr, bool instrFlag)
 
 void normalizeSigned32Bit(int32_t *sampleData, uint32_t sampleLength)
 {
-	uint32_t i;
-
-	uint32_t sampleVolPeak = 0;
-	for (i = 0; i < sampleLength; i++)
-	{
-		const uint32_t sample = ABS(sampleData[i]);
-		if (sampleVolPeak < sample)
-			sampleVolPeak = sample;
-	}
-
+	const uint32_t sampleVolPeak = getPeakSigned32(sampleData, sampleLength);
 	if (sampleVolPeak <= 0)
 		return;
 
 	const double dGain = (double)INT32_MAX / sampleVolPeak;
-	for (i = 0; i < sampleLength; i++)
-		sampleData[i] = (int32_t)(sampleData[i] * dGain);
+	scaleSigned32(sampleData, sampleLength, dGain);
 }
 
 void normalize32BitFloatToSigned16Bit(float *fSampleData, uint32_t sampleLength)
 {
-	uint32_t i;
-
-	float fSampleVolPeak = 0.0f;
-	for (i = 0; i < sampleLength; i++)
-	{
-		const float fSample = fabsf(fSampleData[i]);
-		if (fSampleVolPeak < fSample)
-			fSampleVolPeak = fSample;
-	}
-
+	const float fSampleVolPeak = getPeakFloat32(fSampleData, sampleLength);
 	if (fSampleVolPeak <= 0.0f)
 		return;
 
 	const float fGain = (float)INT16_MAX / fSampleVolPeak;
-	for (i = 0; i < sampleLength; i++)
-		fSampleData[i] *= fGain;
+	scaleFloat32(fSampleData, sampleLength, fGain);
 }
 
 void normalize64BitFloatToSigned16Bit(double *dSampleData, uint32_t sampleLength)
 {
-	uint32_t i;
-
-	double dSampleVolPeak = 0.0;
-	for (i = 0; i < sampleLength; i++)
-	{
-		const double dSample = fabs(dSampleData[i]);
-		if (dSampleVolPeak < dSample)
-			dSampleVolPeak = dSample;
-	}
-
+	const double dSampleVolPeak = getPeakFloat64(dSampleData, sampleLength);
 	if (dSampleVolPeak <= 0.0)
 		return;
 
 	const double dGain = (double)INT16_MAX / dSampleVolPeak;
-	for (i = 0; i < sampleLength; i++)
-		dSampleData[i] *= dGain;
+	scaleFloat64(dSampleData, sampleLength, dGain);
 }
@@ -17,7 +17,18 @@ void normalize32BitFloatToSigned16Bit(float *fSampleData, uint32_t sampleLength)
 void normalize64BitFloatToSigned16Bit(double *dSampleData, uint32_t sampleLength);
 
 bool loadSample(UNICHAR *filenameU, uint8_t sampleSlot, bool loadAsInstrFlag);
+
+/* Runs the sample loaders on a memory buffer without any GUI (the messages are dropped),
+** and frees the loaded sample again. For testing the loaders with malformed files.
+*/
+bool testLoadSample(const uint8_t *data, uint32_t dataLength);
 void removeSampleIsLoadingFlag(void);
+void cancelSampleLoading(void);
+void handleSampleLoadProgress(void); // draws the progress bar of long sample loads
+
+// for the sample loaders, the progress bar and ESC/mouse click cancelling
+void setSampleLoadProgress(uint64_t pos, uint64_t total);
+bool sampleLoadingCancelled(void);
 
 // globals for sample loaders
 extern bool loadAsInstrFlag, smpFilenameSet;
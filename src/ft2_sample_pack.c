@@ -0,0 +1,546 @@
+/* Impulse Tracker 2.14/2.15 sample compression.
+**
+** The unpacker is used by the IT loader and the XM loader (for our own packed XMs).
+** The packer finds the cheapest sequence of bit widths for each block with dynamic
+** programming. Any delta value fits in the widest width (9/17 bits), so a block never
+** packs to more than IT_PACK_MAX_BLOCK_LEN bytes.
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "ft2_header.h"
+#include "ft2_sample_ed.h"
+#include "ft2_sample_pack.h"
+
+#define MAX_WIDTH_8BIT 9
+#define MAX_WIDTH_16BIT 17
+#define COST_INFINITE (UINT32_MAX / 2)
+
+typedef struct bitWriter_t
+{
+	uint8_t *ptr;
+	uint32_t bitBuf;
+	int32_t numBits;
+} bitWriter_t;
+
+static void writeBits(bitWriter_t *b, uint32_t value, int32_t numBits) // numBits is 1..17
+{
+	b->bitBuf |= (value & ((1UL << numBits) - 1)) << b->numBits;
+	b->numBits += numBits;
+
+	while (b->numBits >= 8)
+	{
+		*b->ptr++ = (uint8_t)b->bitBuf;
+		b->bitBuf >>= 8;
+		b->numBits -= 8;
+	}
+}
+
+static void flushBits(bitWriter_t *b)
+{
+	if (b->numBits > 0)
+		*b->ptr++ = (uint8_t)b->bitBuf;
+
+	b->bitBuf = 0;
+	b->numBits = 0;
+}
+
+/* The smallest width that can hold a delta value. Widths 1..6 can't hold their lowest value
+** (it's the width change marker), the wider ones reserve 8 (or 16) values around the edges.
+*/
+static int32_t getMinWidth(int32_t delta, bool sample16Bit)
+{
+	const int32_t absDelta = (delta < 0) ? -delta : delta;
+
+	if (absDelta < 32)
+	{
+		int32_t width = 1;
+		while ((1 << (width-1)) <= absDelta)
+			width++;
+
+		return width;
+	}
+
+	if (!sample16Bit)
+	{
+		if (delta >= -60 && delta <= 59) return 7;
+		if (delta >= -124 && delta <= 123) return 8;
+		return MAX_WIDTH_8BIT;
+	}
+
+	for (int32_t width = 7; width < MAX_WIDTH_16BIT; width++)
+	{
+		if (delta >= -(1 << (width-1)) + 8 && delta <= (1 << (width-1)) - 9)
+			return width;
+	}
+
+	return MAX_WIDTH_16BIT;
+}
+
+static int32_t getWidthChangeBits(int32_t width, bool sample16Bit)
+{
+	if (width <= 6)
+		return width + (sample16Bit ? 4 : 3);
+
+	return width;
+}
+
+static void writeWidthChange(bitWriter_t *b, int32_t width, int32_t newWidth, bool sample16Bit)
+{
+	const int32_t n = (newWidth < width) ? (newWidth - 1) : (newWidth - 2); // the current width is skipped
+
+	if (width <= 6)
+	{
+		writeBits(b, 1 << (width-1), width);
+		writeBits(b, n, sample16Bit ? 4 : 3);
+	}
+	else if (!sample16Bit)
+	{
+		if (width < MAX_WIDTH_8BIT)
+			writeBits(b, n + ((width == 8) ? 0x7C : 0x3C), width);
+		else
+			writeBits(b, 0x100 | (newWidth-1), MAX_WIDTH_8BIT);
+	}
+	else
+	{
+		if (width < MAX_WIDTH_16BIT)
+			writeBits(b, (1 << (width-1)) - 9 + (n+1), width);
+		else
+			writeBits(b, 0x10000 | (newWidth-1), MAX_WIDTH_16BIT);
+	}
+}
+
+static void getBlockDeltas(int32_t *deltas, const int8_t *smpData, int32_t numSamples, bool sample16Bit, bool deltaEncoded)
+{
+	// the deltas wrap around like the sample values (the unpacker adds them up in 8/16 bits)
+	int32_t oldSmp = 0, oldDelta = 0;
+	for (int32_t i = 0; i < numSamples; i++)
+	{
+		int32_t smp, delta;
+		if (sample16Bit)
+		{
+			smp = ((const int16_t *)smpData)[i];
+			delta = (int16_t)(smp - oldSmp);
+		}
+		else
+		{
+			smp = smpData[i];
+			delta = (int8_t)(smp - oldSmp);
+		}
+
+		oldSmp = smp;
+
+		if (deltaEncoded)
+		{
+			const int32_t delta2 = sample16Bit ? (int16_t)(delta - oldDelta) : (int8_t)(delta - oldDelta);
+			oldDelta = delta;
+			delta = delta2;
+		}
+
+		deltas[i] = delta;
+	}
+}
+
+static uint32_t packBlock(uint8_t *dst, const int32_t *deltas, int32_t numSamples, bool sample16Bit, uint8_t *widths, uint8_t *fromWidths)
+{
+	uint32_t cost[MAX_WIDTH_16BIT+1], newCost[MAX_WIDTH_16BIT+1];
+
+	const int32_t maxWidth = sample16Bit ? MAX_WIDTH_16BIT : MAX_WIDTH_8BIT;
+
+	for (int32_t w = 1; w <= maxWidth; w++)
+		cost[w] = COST_INFINITE;
+	cost[maxWidth] = 0; // the unpacker starts at the widest width
+
+	// find the cheapest width for each sample, fromWidths has the width of the previous sample
+	for (int32_t i = 0; i < numSamples; i++)
+	{
+		// the two cheapest widths to change from (you can't change to the same width)
+		uint32_t best1 = COST_INFINITE, best2 = COST_INFINITE;
+		int32_t best1Width = 0, best2Width = 0;
+
+		for (int32_t w = 1; w <= maxWidth; w++)
+		{
+			const uint32_t c = cost[w] + getWidthChangeBits(w, sample16Bit);
+			if (c < best1)
+			{
+				best2 = best1;
+				best2Width = best1Width;
+				best1 = c;
+				best1Width = w;
+			}
+			else if (c < best2)
+			{
+				best2 = c;
+				best2Width = w;
+			}
+		}
+
+		const int32_t minWidth = getMinWidth(deltas[i], sample16Bit);
+		uint8_t *from = &fromWidths[i * maxWidth];
+
+		for (int32_t w = 1; w <= maxWidth; w++)
+		{
+			if (w < minWidth)
+			{
+				newCost[w] = COST_INFINITE;
+				from[w-1] = 0;
+				continue;
+			}
+
+			const uint32_t changeCost = (best1Width != w) ? best1 : best2;
+			const int32_t changeWidth = (best1Width != w) ? best1Width : best2Width;
+
+			if (cost[w] <= changeCost)
+			{
+				newCost[w] = cost[w] + w;
+				from[w-1] = (uint8_t)w;
+			}
+			else
+			{
+				newCost[w] = changeCost + w;
+				from[w-1] = (uint8_t)changeWidth;
+			}
+		}
+
+		memcpy(cost, newCost, sizeof (cost));
+	}
+
+	int32_t width = maxWidth;
+	for (int32_t w = 1; w <= maxWidth; w++)
+	{
+		if (cost[w] < cost[width])
+			width = w;
+	}
+
+	for (int32_t i = numSamples-1; i >= 0; i--)
+	{
+		widths[i] = (uint8_t)width;
+		width = fromWidths[(i * maxWidth) + (width-1)];
+	}
+
+	bitWriter_t b;
+	b.ptr = dst + 2;
+	b.bitBuf = 0;
+	b.numBits = 0;
+
+	width = maxWidth;
+	for (int32_t i = 0; i < numSamples; i++)
+	{
+		if (widths[i] != width)
+		{
+			writeWidthChange(&b, width, widths[i], sample16Bit);
+			width = widths[i];
+		}
+
+		uint32_t value = (uint32_t)deltas[i];
+		if (width == maxWidth)
+			value &= (1UL << (maxWidth-1)) - 1; // the top bit is the width change flag here
+
+		writeBits(&b, value, width);
+	}
+
+	flushBits(&b);
+
+	const uint16_t packedLength = (uint16_t)(b.ptr - (dst + 2));
+	memcpy(dst, &packedLength, 2);
+
+	return 2 + packedLength;
+}
+
+static uint32_t getPackedBits(const int32_t *deltas, int32_t numSamples, bool sample16Bit) // a quick estimate
+{
+	uint32_t bits = 0;
+	for (int32_t i = 0; i < numSamples; i++)
+		bits += getMinWidth(deltas[i], sample16Bit);
+
+	return bits;
+}
+
+uint32_t packITSampleData(const sample_t *s, uint8_t *dst, uint8_t *scratch, bool *deltaEncoded)
+{
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	const int32_t samplesPerBlock = IT_PACK_BLOCK_BYTES >> sample16Bit;
+
+	int8_t *smpData = (int8_t *)scratch;
+	int32_t *deltas = (int32_t *)(scratch + IT_PACK_BLOCK_BYTES);
+	uint8_t *widths = scratch + IT_PACK_BLOCK_BYTES + (IT_PACK_BLOCK_BYTES * sizeof (int32_t));
+	uint8_t *fromWidths = widths + IT_PACK_BLOCK_BYTES; // samplesPerBlock * max. width
+
+	// IT 2.15 (packing the delta values) is better for most samples, but not for noisy ones
+	uint32_t it214Bits = 0, it215Bits = 0;
+	for (int32_t pos = 0; pos < s->length; pos += samplesPerBlock)
+	{
+		const int32_t length = MIN(s->length - pos, samplesPerBlock);
+
+		// the mixer may be playing the sample, so we pack an unfixed copy of it
+		copyUnfixedSmpData(s, smpData, pos, length);
+
+		getBlockDeltas(deltas, smpData, length, sample16Bit, false);
+		it214Bits += getPackedBits(deltas, length, sample16Bit);
+
+		getBlockDeltas(deltas, smpData, length, sample16Bit, true);
+		it215Bits += getPackedBits(deltas, length, sample16Bit);
+	}
+
+	*deltaEncoded = (it215Bits < it214Bits);
+
+	uint8_t *writePtr = dst;
+	for (int32_t pos = 0; pos < s->length; pos += samplesPerBlock)
+	{
+		const int32_t length = MIN(s->length - pos, samplesPerBlock);
+
+		copyUnfixedSmpData(s, smpData, pos, length);
+		getBlockDeltas(deltas, smpData, length, sample16Bit, *deltaEncoded);
+		writePtr += packBlock(writePtr, deltas, length, sample16Bit, widths, fromWidths);
+	}
+
+	return (uint32_t)(writePtr - dst);
+}
+
+static void decompress16BitData(int16_t *dst, const uint8_t *src, uint32_t blockLength)
+{
+	uint8_t byte8, bitDepth, bitDepthInv, bitsRead;
+	uint16_t bytes16, lastVal;
+	uint32_t bytes32;
+
+	lastVal = 0;
+	bitDepth = 17;
+	bitDepthInv = bitsRead = 0;
+
+	blockLength >>= 1;
+	while (blockLength != 0)
+	{
+		bytes32 = (*(uint32_t *)src) >> bitsRead;
+
+		bitsRead += bitDepth;
+		src += bitsRead >> 3;
+		bitsRead &= 7;
+
+		if (bitDepth <= 6)
+		{
+			bytes32 <<= bitDepthInv & 0x1F;
+
+			bytes16 = (uint16_t)bytes32;
+			if (bytes16 != 0x8000)
+			{
+				lastVal += (int16_t)bytes16 >> (bitDepthInv & 0x1F); // arithmetic shift
+				*dst++ = lastVal;
+				blockLength--;
+			}
+			else
+			{
+				byte8 = ((bytes32 >> 16) & 0xF) + 1;
+				if (byte8 >= bitDepth)
+					byte8++;
+				bitDepth = byte8;
+
+				bitDepthInv = 16;
+				if (bitDepthInv < bitDepth)
+					bitDepthInv++;
+				bitDepthInv -= bitDepth;
+
+				bitsRead += 4;
+			}
+
+			continue;
+		}
+
+		bytes16 = (uint16_t)bytes32;
+
+		if (bitDepth <= 16)
+		{
+			uint16_t tmp16 = 0xFFFF >> (bitDepthInv & 0x1F);
+			bytes16 &= tmp16;
+			tmp16 = (tmp16 >> 1) - 8;
+
+			if (bytes16 > tmp16+16 || bytes16 <= tmp16)
+			{
+				bytes16 <<= bitDepthInv & 0x1F;
+				bytes16 = (int16_t)bytes16 >> (bitDepthInv & 0x1F); // arithmetic shift
+				lastVal += bytes16;
+				*dst++ = lastVal;
+				blockLength--;
+				continue;
+			}
+
+			byte8 = (uint8_t)(bytes16 - tmp16);
+			if (byte8 >= bitDepth)
+				byte8++;
+			bitDepth = byte8;
+
+			bitDepthInv = 16;
+			if (bitDepthInv < bitDepth)
+				bitDepthInv++;
+			bitDepthInv -= bitDepth;
+			continue;
+		}
+
+		if (bytes32 & 0x10000)
+		{
+			bitDepth = (uint8_t)(bytes16 + 1);
+			bitDepthInv = 16 - bitDepth;
+		}
+		else
+		{
+			lastVal += bytes16;
+			*dst++ = lastVal;
+			blockLength--;
+		}
+	}
+}
+
+static void decompress8BitData(int8_t *dst, const uint8_t *src, uint32_t blockLength)
+{
+	uint8_t lastVal, byte8, bitDepth, bitDepthInv, bitsRead;
+	uint16_t bytes16;
+
+	lastVal = 0;
+	bitDepth = 9;
+	bitDepthInv = bitsRead = 0;
+
+	while (blockLength != 0)
+	{
+		bytes16 = (*(uint16_t *)src) >> bitsRead;
+
+		bitsRead += bitDepth;
+		src += (bitsRead >> 3);
+		bitsRead &= 7;
+
+		byte8 = bytes16 & 0xFF;
+
+		if (bitDepth <= 6)
+		{
+			bytes16 <<= (bitDepthInv & 0x1F);
+			byte8 = bytes16 & 0xFF;
+
+			if (byte8 != 0x80)
+			{
+				lastVal += (int8_t)byte8 >> (bitDepthInv & 0x1F); // arithmetic shift
+				*dst++ = lastVal;
+				blockLength--;
+				continue;
+			}
+
+			byte8 = (bytes16 >> 8) & 7;
+			bitsRead += 3;
+			src += (bitsRead >> 3);
+			bitsRead &= 7;
+		}
+		else
+		{
+			if (bitDepth == 8)
+			{
+				if (byte8 < 0x7C || byte8 > 0x83)
+				{
+					lastVal += byte8;
+					*dst++ = lastVal;
+					blockLength--;
+					continue;
+				}
+				byte8 -= 0x7C;
+			}
+			else if (bitDepth < 8)
+			{
+				byte8 <<= 1;
+				if (byte8 < 0x78 || byte8 > 0x86)
+				{
+					lastVal += (int8_t)byte8 >> (bitDepthInv & 0x1F); // arithmetic shift
+					*dst++ = lastVal;
+					blockLength--;
+					continue;
+				}
+				byte8 = (byte8 >> 1) - 0x3C;
+			}
+			else
+			{
+				bytes16 &= 0x1FF;
+				if ((bytes16 & 0x100) == 0)
+				{
+					lastVal += byte8;
+					*dst++ = lastVal;
+					blockLength--;
+					continue;
+				}
+			}
+		}
+
+		byte8++;
+		if (byte8 >= bitDepth)
+			byte8++;
+		bitDepth = byte8;
+
+		bitDepthInv = 8;
+		if (bitDepthInv < bitDepth)
+			bitDepthInv++;
+		bitDepthInv -= bitDepth;
+	}
+}
+
+void unpackITSampleData(int8_t *dst, uint32_t numBytes, bool sample16Bit, bool deltaEncoded, const uint8_t *src, uint32_t srcLength, uint8_t *scratch)
+{
+	const uint8_t *srcEnd = src + srcLength;
+
+	while (numBytes > 0)
+	{
+		uint32_t bytesToUnpack = IT_PACK_BLOCK_BYTES;
+		if (bytesToUnpack > numBytes)
+			bytesToUnpack = numBytes;
+
+		// (reads past the end of the file leave stale data in the scratch buffer, like before)
+		uint16_t packedLen = 0;
+		if (srcEnd-src >= 2)
+		{
+			memcpy(&packedLen, src, 2);
+			src += 2;
+		}
+		else
+		{
+			src = srcEnd;
+		}
+
+		const uint32_t bytesToRead = (uint32_t)MIN(packedLen, srcEnd-src);
+		memcpy(scratch, src, bytesToRead);
+		src += bytesToRead;
+
+		if (sample16Bit)
+		{
+			decompress16BitData((int16_t *)dst, scratch, bytesToUnpack);
+
+			if (deltaEncoded) // convert from delta values to PCM
+			{
+				int16_t *ptr16 = (int16_t *)dst;
+				int16_t lastSmp16 = 0; // yes, reset this every block!
+
+				const uint32_t length = bytesToUnpack >> 1;
+				for (uint32_t j = 0; j < length; j++)
+				{
+					lastSmp16 += ptr16[j];
+					ptr16[j] = lastSmp16;
+				}
+			}
+		}
+		else
+		{
+			decompress8BitData(dst, scratch, bytesToUnpack);
+
+			if (deltaEncoded) // convert from delta values to PCM
+			{
+				int8_t lastSmp8 = 0; // yes, reset this every block!
+				for (uint32_t j = 0; j < bytesToUnpack; j++)
+				{
+					lastSmp8 += dst[j];
+					dst[j] = lastSmp8;
+				}
+			}
+		}
+
+		dst += bytesToUnpack;
+		numBytes -= bytesToUnpack;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ft2_replayer.h"
+
+/* Impulse Tracker 2.14/2.15 sample compression (lossless). The data is split into blocks of
+** 32768 unpacked bytes, each stored as a 16-bit packed length and a bit stream of variable width
+** delta values. IT 2.15 packs the delta values of the sample instead of the sample itself.
+*/
+
+#define IT_PACK_BLOCK_BYTES 32768
+#define IT_PACK_MAX_BLOCK_LEN (2 + ((IT_PACK_BLOCK_BYTES * 9) / 8)) /* 9 bits per 8-bit sample, 17 per 16-bit sample at most */
+#define IT_PACK_MAX_LEN(numBytes) ((((numBytes) + (IT_PACK_BLOCK_BYTES-1)) / IT_PACK_BLOCK_BYTES) * IT_PACK_MAX_BLOCK_LEN)
+#define IT_PACK_SCRATCH_LEN (IT_PACK_BLOCK_BYTES * 15)
+
+/* XM extension, written by this program only (when "Compress XMs" is enabled in the config):
+** a sample header with one of these values in its nameLength byte (reserved, FT2 ignores it)
+** has IT 2.14/2.15 compressed data. Its length field is the size of the data in the file: the
+** unpacked length in bytes (32-bit), followed by the packed blocks. Files with packed samples
+** have XM_PACKED_PROG_NAME as tracker name, and the marks are only used in such files.
+** Other XM players don't know about this. They stay in sync with the file, but load the packed
+** samples as (short) noise.
+*/
+#define XM_SMP_IT214_PACKED 0xE4
+#define XM_SMP_IT215_PACKED 0xE5
+#define XM_PACKED_PROG_NAME "FT2 clone (packed)"
+
+// packs an unfixed copy of the sample (thread-safe), returns the number of bytes written to dst
+uint32_t packITSampleData(const sample_t *s, uint8_t *dst, uint8_t *scratch, bool *deltaEncoded); // dst needs IT_PACK_MAX_LEN(bytes)
+void unpackITSampleData(int8_t *dst, uint32_t numBytes, bool sample16Bit, bool deltaEncoded, const uint8_t *src, uint32_t srcLength, uint8_t *scratch); // scratch is 65536 bytes
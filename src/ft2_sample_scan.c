@@ -0,0 +1,693 @@
+/* Sample scanning (min/max/peak) and scaling, used by the sample editor's
+** waveform/peak code, the sampling preview, "Get maximum scale" and the
+** normalization of 32-bit/float samples in the sample loaders.
+**
+** Every routine has an SSE2 (x86/x86_64) or NEON (arm64) path, and a plain C
+** fallback. Long scans (SCAN_MT_MIN_FRAMES frames or more) are split into one
+** chunk per CPU core, each chunk is then run in its own thread.
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#if defined _WIN32 || defined __amd64__ || (defined __i386__ && defined __SSE2__)
+#define SCAN_SSE2
+#include <emmintrin.h>
+#elif defined __aarch64__ || defined _M_ARM64
+#define SCAN_NEON
+#include <arm_neon.h>
+#endif
+#include "ft2_header.h"
+#include "ft2_structs.h"
+#include "ft2_sample_scan.h"
+
+#define SCAN_MAX_THREADS 8
+
+enum
+{
+	SCAN_MINMAX8 = 0,
+	SCAN_MINMAX16 = 1,
+	SCAN_MINMAX32 = 2,
+	SCAN_PEAK_FLOAT32 = 3,
+	SCAN_PEAK_FLOAT64 = 4,
+	SCAN_SCALE_SIGNED32 = 5,
+	SCAN_SCALE_FLOAT32 = 6,
+	SCAN_SCALE_FLOAT64 = 7
+};
+
+static const uint8_t scanFrameSize[8] = { 1, 2, 4, 4, 8, 4, 4, 8 };
+
+typedef struct scanJob_t
+{
+	int32_t type;
+	void *p; // first frame of this job
+	uint32_t length;
+	double dGain; // SCAN_SCALE_*
+	int32_t min, max; // SCAN_MINMAX* results
+	double dPeak; // SCAN_PEAK_* results
+} scanJob_t;
+
+static void minMax16Kernel(const int16_t *p, uint32_t scanLen, int16_t *min16, int16_t *max16)
+{
+#ifdef SCAN_SSE2
+	if (cpu.hasSSE2)
+	{
+		/* Taken with permission from the OpenMPT project (and slightly modified).
+		**
+		** SSE2 implementation for min/max finder, packs 8*int16 in a 128-bit XMM register.
+		** scanLen = How many samples to process
+		*/
+		uint32_t scanLen8;
+		const __m128i *v;
+		__m128i minVal, maxVal, minVal2, maxVal2, curVals;
+
+		// Put minimum / maximum in 8 packed int16 values
+		minVal = _mm_set1_epi16(32767);
+		maxVal = _mm_set1_epi16(-32768);
+
+		scanLen8 = scanLen / 8;
+		if (scanLen8 > 0)
+		{
+			v = (const __m128i *)p;
+			p += scanLen8 * 8;
+
+			while (scanLen8--)
+			{
+				curVals = _mm_loadu_si128(v++);
+				minVal = _mm_min_epi16(minVal, curVals);
+				maxVal = _mm_max_epi16(maxVal, curVals);
+			}
+
+			/* Now we have 8 minima and maxima each.
+			** Move the upper 4 values to the lower half and compute the minima/maxima of that. */
+			minVal2 = _mm_unpackhi_epi64(minVal, minVal);
+			maxVal2 = _mm_unpackhi_epi64(maxVal, maxVal);
+			minVal = _mm_min_epi16(minVal, minVal2);
+			maxVal = _mm_max_epi16(maxVal, maxVal2);
+
+			/* Now we have 4 minima and maxima each.
+			** Move the upper 2 values to the lower half and compute the minima/maxima of that. */
+			minVal2 = _mm_shuffle_epi32(minVal, _MM_SHUFFLE(1, 1, 1, 1));
+			maxVal2 = _mm_shuffle_epi32(maxVal, _MM_SHUFFLE(1, 1, 1, 1));
+			minVal = _mm_min_epi16(minVal, minVal2);
+			maxVal = _mm_max_epi16(maxVal, maxVal2);
+
+			// Compute the minima/maxima of the both remaining values
+			minVal2 = _mm_shufflelo_epi16(minVal, _MM_SHUFFLE(1, 1, 1, 1));
+			maxVal2 = _mm_shufflelo_epi16(maxVal, _MM_SHUFFLE(1, 1, 1, 1));
+			minVal = _mm_min_epi16(minVal, minVal2);
+			maxVal = _mm_max_epi16(maxVal, maxVal2);
+		}
+
+		while (scanLen-- & 7)
+		{
+			curVals = _mm_set1_epi16(*p++);
+			minVal = _mm_min_epi16(minVal, curVals);
+			maxVal = _mm_max_epi16(maxVal, curVals);
+		}
+
+		*min16 = (int16_t)_mm_cvtsi128_si32(minVal);
+		*max16 = (int16_t)_mm_cvtsi128_si32(maxVal);
+		return;
+	}
+#endif
+
+	int16_t minVal =  32767;
+	int16_t maxVal = -32768;
+
+	uint32_t i = 0;
+#ifdef SCAN_NEON
+	if (scanLen >= 8)
+	{
+		int16x8_t minVals = vdupq_n_s16(32767);
+		int16x8_t maxVals = vdupq_n_s16(-32768);
+
+		for (; i+8 <= scanLen; i += 8)
+		{
+			const int16x8_t curVals = vld1q_s16(&p[i]);
+			minVals = vminq_s16(minVals, curVals);
+			maxVals = vmaxq_s16(maxVals, curVals);
+		}
+
+		minVal = vminvq_s16(minVals);
+		maxVal = vmaxvq_s16(maxVals);
+	}
+#endif
+
+	for (; i < scanLen; i++)
+	{
+		const int16_t smp16 = p[i];
+		if (smp16 < minVal) minVal = smp16;
+		if (smp16 > maxVal) maxVal = smp16;
+	}
+
+	*min16 = minVal;
+	*max16 = maxVal;
+}
+
+static void minMax8Kernel(const int8_t *p, uint32_t scanLen, int8_t *min8, int8_t *max8)
+{
+#ifdef SCAN_SSE2
+	if (cpu.hasSSE2)
+	{
+		/* Taken with permission from the OpenMPT project (and slightly modified).
+		**
+		** SSE2 implementation for min/max finder, packs 16*int8 in a 128-bit XMM register.
+		** scanLen = How many samples to process
+		*/
+		uint32_t scanLen16;
+		const __m128i *v;
+		__m128i xorVal, minVal, maxVal, minVal2, maxVal2, curVals;
+
+		// Put minimum / maximum in 8 packed int16 values (-1 and 0 because unsigned)
+		minVal = _mm_set1_epi8(-1);
+		maxVal = _mm_set1_epi8(0);
+
+		// For signed <-> unsigned conversion (_mm_min_epi8/_mm_max_epi8 is SSE4)
+		xorVal = _mm_set1_epi8(0x80);
+
+		scanLen16 = scanLen / 16;
+		if (scanLen16 > 0)
+		{
+			v = (const __m128i *)p;
+			p += scanLen16 * 16;
+
+			while (scanLen16--)
+			{
+				curVals = _mm_loadu_si128(v++);
+				curVals = _mm_xor_si128(curVals, xorVal);
+				minVal = _mm_min_epu8(minVal, curVals);
+				maxVal = _mm_max_epu8(maxVal, curVals);
+			}
+
+			/* Now we have 16 minima and maxima each.
+			** Move the upper 8 values to the lower half and compute the minima/maxima of that. */
+			minVal2 = _mm_unpackhi_epi64(minVal, minVal);
+			maxVal2 = _mm_unpackhi_epi64(maxVal, maxVal);
+			minVal = _mm_min_epu8(minVal, minVal2);
+			maxVal = _mm_max_epu8(maxVal, maxVal2);
+
+			/* Now we have 8 minima and maxima each.
+			** Move the upper 4 values to the lower half and compute the minima/maxima of that. */
+			minVal2 = _mm_shuffle_epi32(minVal, _MM_SHUFFLE(1, 1, 1, 1));
+			maxVal2 = _mm_shuffle_epi32(maxVal, _MM_SHUFFLE(1, 1, 1, 1));
+			minVal = _mm_min_epu8(minVal, minVal2);
+			maxVal = _mm_max_epu8(maxVal, maxVal2);
+
+			/* Now we have 4 minima and maxima each.
+			** Move the upper 2 values to the lower half and compute the minima/maxima of that. */
+			minVal2 = _mm_srai_epi32(minVal, 16);
+			maxVal2 = _mm_srai_epi32(maxVal, 16);
+			minVal = _mm_min_epu8(minVal, minVal2);
+			maxVal = _mm_max_epu8(maxVal, maxVal2);
+
+			// Compute the minima/maxima of the both remaining values
+			minVal2 = _mm_srai_epi16(minVal, 8);
+			maxVal2 = _mm_srai_epi16(maxVal, 8);
+			minVal = _mm_min_epu8(minVal, minVal2);
+			maxVal = _mm_max_epu8(maxVal, maxVal2);
+		}
+
+		while (scanLen-- & 15)
+		{
+			curVals = _mm_set1_epi8(*p++ ^ 0x80);
+			minVal = _mm_min_epu8(minVal, curVals);
+			maxVal = _mm_max_epu8(maxVal, curVals);
+		}
+
+		*min8 = (int8_t)(_mm_cvtsi128_si32(minVal) ^ 0x80);
+		*max8 = (int8_t)(_mm_cvtsi128_si32(maxVal) ^ 0x80);
+		return;
+	}
+#endif
+
+	int8_t minVal =  127;
+	int8_t maxVal = -128;
+
+	uint32_t i = 0;
+#ifdef SCAN_NEON
+	if (scanLen >= 16)
+	{
+		int8x16_t minVals = vdupq_n_s8(127);
+		int8x16_t maxVals = vdupq_n_s8(-128);
+
+		for (; i+16 <= scanLen; i += 16)
+		{
+			const int8x16_t curVals = vld1q_s8(&p[i]);
+			minVals = vminq_s8(minVals, curVals);
+			maxVals = vmaxq_s8(maxVals, curVals);
+		}
+
+		minVal = vminvq_s8(minVals);
+		maxVal = vmaxvq_s8(maxVals);
+	}
+#endif
+
+	for (; i < scanLen; i++)
+	{
+		const int8_t smp8 = p[i];
+		if (smp8 < minVal) minVal = smp8;
+		if (smp8 > maxVal) maxVal = smp8;
+	}
+
+	*min8 = minVal;
+	*max8 = maxVal;
+}
+
+static void minMax32Kernel(const int32_t *p, uint32_t scanLen, int32_t *min32, int32_t *max32)
+{
+	int32_t minVal = INT32_MAX;
+	int32_t maxVal = INT32_MIN;
+
+	uint32_t i = 0;
+#ifdef SCAN_SSE2
+	if (cpu.hasSSE2 && scanLen >= 4)
+	{
+		// there's no _mm_min_epi32/_mm_max_epi32 before SSE4.1, select with compare masks instead
+		__m128i minVals = _mm_set1_epi32(INT32_MAX);
+		__m128i maxVals = _mm_set1_epi32(INT32_MIN);
+
+		for (; i+4 <= scanLen; i += 4)
+		{
+			const __m128i curVals = _mm_loadu_si128((const __m128i *)&p[i]);
+
+			__m128i mask = _mm_cmpgt_epi32(minVals, curVals);
+			minVals = _mm_or_si128(_mm_and_si128(mask, curVals), _mm_andnot_si128(mask, minVals));
+
+			mask = _mm_cmpgt_epi32(curVals, maxVals);
+			maxVals = _mm_or_si128(_mm_and_si128(mask, curVals), _mm_andnot_si128(mask, maxVals));
+		}
+
+		int32_t minArr[4], maxArr[4];
+		_mm_storeu_si128((__m128i *)minArr, minVals);
+		_mm_storeu_si128((__m128i *)maxArr, maxVals);
+
+		for (int32_t j = 0; j < 4; j++)
+		{
+			if (minArr[j] < minVal) minVal = minArr[j];
+			if (maxArr[j] > maxVal) maxVal = maxArr[j];
+		}
+	}
+#elif defined SCAN_NEON
+	if (scanLen >= 4)
+	{
+		int32x4_t minVals = vdupq_n_s32(INT32_MAX);
+		int32x4_t maxVals = vdupq_n_s32(INT32_MIN);
+
+		for (; i+4 <= scanLen; i += 4)
+		{
+			const int32x4_t curVals = vld1q_s32(&p[i]);
+			minVals = vminq_s32(minVals, curVals);
+			maxVals = vmaxq_s32(maxVals, curVals);
+		}
+
+		minVal = vminvq_s32(minVals);
+		maxVal = vmaxvq_s32(maxVals);
+	}
+#endif
+
+	for (; i < scanLen; i++)
+	{
+		const int32_t smp32 = p[i];
+		if (smp32 < minVal) minVal = smp32;
+		if (smp32 > maxVal) maxVal = smp32;
+	}
+
+	*min32 = minVal;
+	*max32 = maxVal;
+}
+
+static float peakFloat32Kernel(const float *p, uint32_t scanLen)
+{
+	float fPeak = 0.0f;
+
+	uint32_t i = 0;
+#ifdef SCAN_SSE2
+	if (cpu.hasSSE2 && scanLen >= 4)
+	{
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		__m128 peakVals = _mm_setzero_ps();
+
+		// MAXPS returns the second operand if either is NaN, so NaNs in the data are skipped
+		for (; i+4 <= scanLen; i += 4)
+			peakVals = _mm_max_ps(_mm_and_ps(_mm_loadu_ps(&p[i]), absMask), peakVals);
+
+		float peakArr[4];
+		_mm_storeu_ps(peakArr, peakVals);
+
+		for (int32_t j = 0; j < 4; j++)
+		{
+			if (fPeak < peakArr[j])
+				fPeak = peakArr[j];
+		}
+	}
+#elif defined SCAN_NEON
+	if (scanLen >= 4)
+	{
+		float32x4_t peakVals = vdupq_n_f32(0.0f);
+
+		// FMAXNM prefers the number over a (quiet) NaN
+		for (; i+4 <= scanLen; i += 4)
+			peakVals = vmaxnmq_f32(peakVals, vabsq_f32(vld1q_f32(&p[i])));
+
+		fPeak = vmaxvq_f32(peakVals);
+	}
+#endif
+
+	for (; i < scanLen; i++)
+	{
+		const float fSample = fabsf(p[i]);
+		if (fPeak < fSample)
+			fPeak = fSample;
+	}
+
+	return fPeak;
+}
+
+static double peakFloat64Kernel(const double *p, uint32_t scanLen)
+{
+	double dPeak = 0.0;
+
+	uint32_t i = 0;
+#ifdef SCAN_SSE2
+	if (cpu.hasSSE2 && scanLen >= 2)
+	{
+		const __m128d absMask = _mm_castsi128_pd(_mm_set_epi32(0x7FFFFFFF, 0xFFFFFFFF, 0x7FFFFFFF, 0xFFFFFFFF));
+		__m128d peakVals = _mm_setzero_pd();
+
+		for (; i+2 <= scanLen; i += 2)
+			peakVals = _mm_max_pd(_mm_and_pd(_mm_loadu_pd(&p[i]), absMask), peakVals);
+
+		double peakArr[2];
+		_mm_storeu_pd(peakArr, peakVals);
+
+		dPeak = MAX(peakArr[0], peakArr[1]);
+	}
+#elif defined SCAN_NEON
+	if (scanLen >= 2)
+	{
+		float64x2_t peakVals = vdupq_n_f64(0.0);
+
+		for (; i+2 <= scanLen; i += 2)
+			peakVals = vmaxnmq_f64(peakVals, vabsq_f64(vld1q_f64(&p[i])));
+
+		dPeak = vmaxvq_f64(peakVals);
+	}
+#endif
+
+	for (; i < scanLen; i++)
+	{
+		const double dSample = fabs(p[i]);
+		if (dPeak < dSample)
+			dPeak = dSample;
+	}
+
+	return dPeak;
+}
+
+static void scaleSigned32Kernel(int32_t *p, uint32_t length, double dGain)
+{
+	uint32_t i = 0;
+#ifdef SCAN_SSE2
+	if (cpu.hasSSE2)
+	{
+		const __m128d gainVals = _mm_set1_pd(dGain);
+		for (; i+4 <= length; i += 4)
+		{
+			const __m128i smpVals = _mm_loadu_si128((const __m128i *)&p[i]);
+
+			__m128d loVals = _mm_cvtepi32_pd(smpVals);
+			__m128d hiVals = _mm_cvtepi32_pd(_mm_shuffle_epi32(smpVals, _MM_SHUFFLE(1, 0, 3, 2)));
+			loVals = _mm_mul_pd(loVals, gainVals);
+			hiVals = _mm_mul_pd(hiVals, gainVals);
+
+			_mm_storeu_si128((__m128i *)&p[i], _mm_unpacklo_epi64(_mm_cvttpd_epi32(loVals), _mm_cvttpd_epi32(hiVals)));
+		}
+	}
+#elif defined SCAN_NEON
+	for (; i+4 <= length; i += 4)
+	{
+		const int32x4_t smpVals = vld1q_s32(&p[i]);
+
+		float64x2_t loVals = vcvtq_f64_s64(vmovl_s32(vget_low_s32(smpVals)));
+		float64x2_t hiVals = vcvtq_f64_s64(vmovl_s32(vget_high_s32(smpVals)));
+		loVals = vmulq_n_f64(loVals, dGain);
+		hiVals = vmulq_n_f64(hiVals, dGain);
+
+		vst1q_s32(&p[i], vcombine_s32(vmovn_s64(vcvtq_s64_f64(loVals)), vmovn_s64(vcvtq_s64_f64(hiVals))));
+	}
+#endif
+
+	for (; i < length; i++)
+		p[i] = (int32_t)(p[i] * dGain);
+}
+
+static void scaleFloat32Kernel(float *p, uint32_t length, float fGain)
+{
+	uint32_t i = 0;
+#ifdef SCAN_SSE2
+	if (cpu.hasSSE2)
+	{
+		const __m128 gainVals = _mm_set1_ps(fGain);
+		for (; i+4 <= length; i += 4)
+			_mm_storeu_ps(&p[i], _mm_mul_ps(_mm_loadu_ps(&p[i]), gainVals));
+	}
+#elif defined SCAN_NEON
+	for (; i+4 <= length; i += 4)
+		vst1q_f32(&p[i], vmulq_n_f32(vld1q_f32(&p[i]), fGain));
+#endif
+
+	for (; i < length; i++)
+		p[i] *= fGain;
+}
+
+static void scaleFloat64Kernel(double *p, uint32_t length, double dGain)
+{
+	uint32_t i = 0;
+#ifdef SCAN_SSE2
+	if (cpu.hasSSE2)
+	{
+		const __m128d gainVals = _mm_set1_pd(dGain);
+		for (; i+2 <= length; i += 2)
+			_mm_storeu_pd(&p[i], _mm_mul_pd(_mm_loadu_pd(&p[i]), gainVals));
+	}
+#elif defined SCAN_NEON
+	for (; i+2 <= length; i += 2)
+		vst1q_f64(&p[i], vmulq_n_f64(vld1q_f64(&p[i]), dGain));
+#endif
+
+	for (; i < length; i++)
+		p[i] *= dGain;
+}
+
+static int32_t scanThread(void *ptr)
+{
+	scanJob_t *job = (scanJob_t *)ptr;
+
+	switch (job->type)
+	{
+		case SCAN_MINMAX8:
+		{
+			int8_t min8, max8;
+			minMax8Kernel((const int8_t *)job->p, job->length, &min8, &max8);
+			job->min = min8;
+			job->max = max8;
+		}
+		break;
+
+		case SCAN_MINMAX16:
+		{
+			int16_t min16, max16;
+			minMax16Kernel((const int16_t *)job->p, job->length, &min16, &max16);
+			job->min = min16;
+			job->max = max16;
+		}
+		break;
+
+		case SCAN_MINMAX32: minMax32Kernel((const int32_t *)job->p, job->length, &job->min, &job->max); break;
+		case SCAN_PEAK_FLOAT32: job->dPeak = peakFloat32Kernel((const float *)job->p, job->length); break;
+		case SCAN_PEAK_FLOAT64: job->dPeak = peakFloat64Kernel((const double *)job->p, job->length); break;
+		case SCAN_SCALE_SIGNED32: scaleSigned32Kernel((int32_t *)job->p, job->length, job->dGain); break;
+		case SCAN_SCALE_FLOAT32: scaleFloat32Kernel((float *)job->p, job->length, (float)job->dGain); break;
+		case SCAN_SCALE_FLOAT64: scaleFloat64Kernel((double *)job->p, job->length, job->dGain); break;
+		default: break;
+	}
+
+	return true;
+}
+
+// runs the job, split across threads if it's long enough. The results are merged into 'job'.
+static void runScanJob(scanJob_t *job)
+{
+	scanJob_t jobs[SCAN_MAX_THREADS];
+	SDL_Thread *threads[SCAN_MAX_THREADS];
+
+	int32_t numThreads = 1;
+	if (job->length >= SCAN_MT_MIN_FRAMES)
+	{
+		numThreads = SDL_GetCPUCount();
+		numThreads = CLAMP(numThreads, 1, SCAN_MAX_THREADS);
+	}
+
+	if (numThreads == 1)
+	{
+		scanThread(job);
+		return;
+	}
+
+	const uint32_t frameSize = scanFrameSize[job->type];
+	for (int32_t i = 0; i < numThreads; i++)
+	{
+		const uint32_t start = (uint32_t)(((uint64_t)job->length * i) / numThreads);
+		const uint32_t end = (uint32_t)(((uint64_t)job->length * (i+1)) / numThreads);
+
+		jobs[i] = *job;
+		jobs[i].p = (int8_t *)job->p + ((uint64_t)start * frameSize);
+		jobs[i].length = end - start;
+
+		threads[i] = NULL;
+		if (i > 0)
+			threads[i] = SDL_CreateThread(scanThread, "sample scan worker thread", &jobs[i]);
+	}
+
+	scanThread(&jobs[0]);
+
+	for (int32_t i = 1; i < numThreads; i++)
+	{
+		if (threads[i] != NULL)
+			SDL_WaitThread(threads[i], NULL);
+		else
+			scanThread(&jobs[i]); // couldn't create thread, do it here instead
+	}
+
+	job->min = jobs[0].min;
+	job->max = jobs[0].max;
+	job->dPeak = jobs[0].dPeak;
+
+	for (int32_t i = 1; i < numThreads; i++)
+	{
+		if (jobs[i].min < job->min) job->min = jobs[i].min;
+		if (jobs[i].max > job->max) job->max = jobs[i].max;
+		if (jobs[i].dPeak > job->dPeak) job->dPeak = jobs[i].dPeak;
+	}
+}
+
+static void initScanJob(scanJob_t *job, int32_t type, const void *p, uint32_t length)
+{
+	job->type = type;
+	job->p = (void *)p;
+	job->length = length;
+	job->dGain = 1.0;
+	job->min = job->max = 0;
+	job->dPeak = 0.0;
+}
+
+void getMinMax8(const int8_t *p, uint32_t length, int8_t *min8, int8_t *max8)
+{
+	scanJob_t job;
+
+	initScanJob(&job, SCAN_MINMAX8, p, length);
+	runScanJob(&job);
+
+	*min8 = (int8_t)job.min;
+	*max8 = (int8_t)job.max;
+}
+
+void getMinMax16(const int16_t *p, uint32_t length, int16_t *min16, int16_t *max16)
+{
+	scanJob_t job;
+
+	initScanJob(&job, SCAN_MINMAX16, p, length);
+	runScanJob(&job);
+
+	*min16 = (int16_t)job.min;
+	*max16 = (int16_t)job.max;
+}
+
+uint32_t getPeak8(const int8_t *p, uint32_t length)
+{
+	int8_t min8, max8;
+
+	if (length == 0)
+		return 0;
+
+	getMinMax8(p, length, &min8, &max8);
+	return MAX(-min8, max8);
+}
+
+uint32_t getPeak16(const int16_t *p, uint32_t length)
+{
+	int16_t min16, max16;
+
+	if (length == 0)
+		return 0;
+
+	getMinMax16(p, length, &min16, &max16);
+	return MAX(-min16, max16);
+}
+
+uint32_t getPeakSigned32(const int32_t *p, uint32_t length)
+{
+	scanJob_t job;
+
+	if (length == 0)
+		return 0;
+
+	initScanJob(&job, SCAN_MINMAX32, p, length);
+	runScanJob(&job);
+
+	// (INT32_MIN has no positive int32 counterpart)
+	return (uint32_t)MAX(-(int64_t)job.min, (int64_t)job.max);
+}
+
+float getPeakFloat32(const float *p, uint32_t length)
+{
+	scanJob_t job;
+
+	initScanJob(&job, SCAN_PEAK_FLOAT32, p, length);
+	runScanJob(&job);
+
+	return (float)job.dPeak;
+}
+
+double getPeakFloat64(const double *p, uint32_t length)
+{
+	scanJob_t job;
+
+	initScanJob(&job, SCAN_PEAK_FLOAT64, p, length);
+	runScanJob(&job);
+
+	return job.dPeak;
+}
+
+void scaleSigned32(int32_t *p, uint32_t length, double dGain)
+{
+	scanJob_t job;
+
+	initScanJob(&job, SCAN_SCALE_SIGNED32, p, length);
+	job.dGain = dGain;
+	runScanJob(&job);
+}
+
+void scaleFloat32(float *p, uint32_t length, float fGain)
+{
+	scanJob_t job;
+
+	initScanJob(&job, SCAN_SCALE_FLOAT32, p, length);
+	job.dGain = fGain;
+	runScanJob(&job);
+}
+
+void scaleFloat64(double *p, uint32_t length, double dGain)
+{
+	scanJob_t job;
+
+	initScanJob(&job, SCAN_SCALE_FLOAT64, p, length);
+	job.dGain = dGain;
+	runScanJob(&job);
+}
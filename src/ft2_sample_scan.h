@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// calls with at least this many sample frames are split across worker threads
+#define SCAN_MT_MIN_FRAMES (1 << 22)
+
+void getMinMax8(const int8_t *p, uint32_t length, int8_t *min8, int8_t *max8);
+void getMinMax16(const int16_t *p, uint32_t length, int16_t *min16, int16_t *max16);
+
+// absolute peaks (the ABS() of the sample farthest from zero)
+uint32_t getPeak8(const int8_t *p, uint32_t length);
+uint32_t getPeak16(const int16_t *p, uint32_t length);
+uint32_t getPeakSigned32(const int32_t *p, uint32_t length);
+float getPeakFloat32(const float *p, uint32_t length); // NaNs are ignored
+double getPeakFloat64(const double *p, uint32_t length); // NaNs are ignored
+
+// in-place gain, the int32 version truncates like a (int32_t) cast
+void scaleSigned32(int32_t *p, uint32_t length, double dGain);
+void scaleFloat32(float *p, uint32_t length, float fGain);
+void scaleFloat64(double *p, uint32_t length, double dGain);
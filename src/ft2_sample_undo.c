@@ -0,0 +1,617 @@
+/* Multi-level sample undo/redo.
+**
+** Every undo step is a snapshot of a sample, stored as 64kB pages. Pages that
+** are unchanged since the previous snapshot of that sample are shared
+** (reference counted) instead of copied. Edits that only change a part of the
+** sample tell which part when they're done (setSampleUndoEditRange()), and
+** if the sample hasn't been changed in any other way since (dataVersion), the
+** next snapshot only reads the pages of that range. Otherwise the whole sample
+** is read, and each page is compared against the previous snapshot.
+**
+** A step is only restored into the sample it was taken of (dataGeneration),
+** the steps of a slot that got a new sample (loaded, copied etc.) are dropped.
+**
+** The total page memory is kept below config.smpUndoMemLimit (MB) by dropping
+** the oldest steps, but the newest undo/redo steps are always kept, so that
+** one level of undo works like before even if it's bigger than the limit.
+**
+** Steps can be grouped (batch processing of several samples). A group is
+** undone/redone as a whole when any of its samples is undone/redone, and it
+** counts as one step in the limits.
+**
+** Steps are taken from the sample editor jobs too, so all of this is done with
+** undoMutex locked.
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ft2_header.h"
+#include "ft2_config.h"
+#include "ft2_audio.h"
+#include "ft2_gui.h"
+#include "ft2_sample_ed.h"
+#include "ft2_inst_ed.h"
+#include "ft2_structs.h"
+#include "ft2_replayer.h"
+#include "ft2_sample_undo.h"
+
+#define UNDO_PAGE_SIZE (64*1024)
+#define MAX_UNDO_STEPS 64 // a group counts as one step
+#define WHOLE_SAMPLE INT32_MAX
+
+typedef struct undoPage_t // page data follows the header
+{
+	int32_t refCount, size;
+} undoPage_t;
+
+typedef struct undoStep_t
+{
+	bool keepSampleMark;
+	uint8_t instrNum, smpNum, flags;
+	int8_t relativeNote, finetune;
+	uint32_t group; // 0 = not grouped
+	uint32_t dataGeneration; // of the sample the snapshot was taken of
+	uint32_t dataVersionAfter; // the sample's dataVersion if it's this snapshot with editPos/editLength changed (0 = unknown)
+	int32_t length, loopStart, loopLength, numPages, editPos, editLength;
+	undoPage_t **pages;
+} undoStep_t;
+
+typedef struct undoStack_t
+{
+	int32_t numSteps, maxSteps;
+	undoStep_t **steps; // oldest first
+} undoStack_t;
+
+static undoStack_t undoStack, redoStack;
+static undoStep_t *lastFilledStep; // for setSampleUndoEditRange()
+static uint32_t lastUndoGroup;
+static uint64_t pageMemUsed;
+static SDL_mutex *undoMutex;
+
+static int8_t *getPageData(undoPage_t *p)
+{
+	return (int8_t *)&p[1];
+}
+
+static void releasePage(undoPage_t *p)
+{
+	if (--p->refCount > 0)
+		return;
+
+	pageMemUsed -= sizeof (undoPage_t) + p->size;
+	free(p);
+}
+
+static void freeStep(undoStep_t *step)
+{
+	if (step == lastFilledStep)
+		lastFilledStep = NULL;
+
+	if (step->pages != NULL)
+	{
+		for (int32_t i = 0; i < step->numPages; i++)
+		{
+			if (step->pages[i] != NULL)
+				releasePage(step->pages[i]);
+		}
+
+		free(step->pages);
+	}
+
+	free(step);
+}
+
+static bool refLeadsToSample(const undoStep_t *ref, const sample_t *s) // true if 's' is 'ref' with only its edit range changed
+{
+	return ref != NULL && ref->dataVersionAfter != 0 && ref->dataVersionAfter == s->dataVersion &&
+	       ref->dataGeneration == s->dataGeneration && (ref->flags & SAMPLE_16BIT) == (s->flags & SAMPLE_16BIT);
+}
+
+static void setStepEditRange(undoStep_t *step, int32_t pos, int32_t length)
+{
+	step->editPos = pos;
+	step->editLength = length;
+}
+
+// makes a snapshot of the sample (unfixed), sharing the pages that are identical in 'ref' (can be NULL)
+static undoStep_t *createStep(sample_t *s, int16_t instrNum, int16_t smpNum, const undoStep_t *ref, bool keepSampleMark, uint32_t group)
+{
+	undoStep_t *step = (undoStep_t *)calloc(1, sizeof (undoStep_t));
+	if (step == NULL)
+		return NULL;
+
+	step->keepSampleMark = keepSampleMark;
+	step->instrNum = (uint8_t)instrNum;
+	step->smpNum = (uint8_t)smpNum;
+	step->group = group;
+	step->relativeNote = s->relativeNote;
+	step->finetune = s->finetune;
+	step->flags = s->flags;
+	step->length = (s->dataPtr != NULL) ? s->length : 0;
+	step->loopStart = s->loopStart;
+	step->loopLength = s->loopLength;
+	step->dataGeneration = s->dataGeneration;
+	setStepEditRange(step, 0, WHOLE_SAMPLE);
+
+	const int32_t bytesPerFrame = (s->flags & SAMPLE_16BIT) ? 2 : 1;
+	const int32_t numBytes = step->length * bytesPerFrame;
+	step->numPages = (int32_t)(((int64_t)numBytes + (UNDO_PAGE_SIZE-1)) / UNDO_PAGE_SIZE);
+
+	// the bytes that may have changed since 'ref', the other pages can be shared without reading them
+	int64_t changedStart = 0, changedEnd = numBytes;
+	if (refLeadsToSample(ref, s))
+	{
+		changedStart = (int64_t)ref->editPos * bytesPerFrame;
+		if (s->length == ref->length) // (if not, everything after the edit has moved)
+			changedEnd = changedStart + ((int64_t)ref->editLength * bytesPerFrame);
+	}
+
+	if (step->numPages == 0)
+		return step;
+
+	step->pages = (undoPage_t **)calloc(step->numPages, sizeof (undoPage_t *));
+	int8_t *pageBuffer = (int8_t *)malloc(UNDO_PAGE_SIZE);
+
+	if (step->pages == NULL || pageBuffer == NULL)
+	{
+		if (pageBuffer != NULL)
+			free(pageBuffer);
+
+		freeStep(step);
+		return NULL;
+	}
+
+	for (int32_t i = 0; i < step->numPages; i++)
+	{
+		const int32_t pageSize = MIN(numBytes - (i * UNDO_PAGE_SIZE), UNDO_PAGE_SIZE);
+		const bool refHasPage = ref != NULL && i < ref->numPages && ref->pages[i]->size == pageSize;
+		const int64_t pageStart = (int64_t)i * UNDO_PAGE_SIZE;
+
+		if (refHasPage && (pageStart + pageSize <= changedStart || pageStart >= changedEnd))
+		{
+			// outside of the edit, share it
+			step->pages[i] = ref->pages[i];
+			step->pages[i]->refCount++;
+			continue;
+		}
+
+		// (the sample is only read here, so the audio doesn't need to be paused)
+		copyUnfixedSmpData(s, pageBuffer, (i * UNDO_PAGE_SIZE) / bytesPerFrame, pageSize / bytesPerFrame);
+
+		if (refHasPage && !memcmp(getPageData(ref->pages[i]), pageBuffer, pageSize))
+		{
+			// unchanged since the last snapshot, share it
+			step->pages[i] = ref->pages[i];
+			step->pages[i]->refCount++;
+			continue;
+		}
+
+		undoPage_t *p = (undoPage_t *)malloc(sizeof (undoPage_t) + pageSize);
+		if (p == NULL)
+		{
+			free(pageBuffer);
+			freeStep(step);
+			return NULL;
+		}
+
+		p->refCount = 1;
+		p->size = pageSize;
+		memcpy(getPageData(p), pageBuffer, pageSize);
+		pageMemUsed += sizeof (undoPage_t) + pageSize;
+
+		step->pages[i] = p;
+	}
+
+	free(pageBuffer);
+	return step;
+}
+
+static bool restoreStep(sample_t *s, const undoStep_t *step)
+{
+	smpPtr_t sp;
+
+	// build the restored sample data before pausing the audio, so that the pause is short
+	sp.origPtr = sp.ptr = NULL;
+	if (step->length > 0)
+	{
+		if (!allocateSmpDataPtr(&sp, step->length, !!(step->flags & SAMPLE_16BIT)))
+			return false;
+
+		int8_t *dst = sp.ptr;
+		for (int32_t i = 0; i < step->numPages; i++, dst += UNDO_PAGE_SIZE)
+			memcpy(dst, getPageData(step->pages[i]), step->pages[i]->size);
+	}
+
+	pauseAudio();
+
+	freeSmpData(s);
+	setSmpDataPtr(s, &sp);
+
+	s->flags = step->flags;
+	s->length = step->length;
+	s->loopStart = step->loopStart;
+	s->loopLength = step->loopLength;
+
+	if (step->group != 0) // batch processing can change the tuning (downsampling)
+	{
+		s->relativeNote = step->relativeNote;
+		s->finetune = step->finetune;
+	}
+
+	fixSample(s);
+	resumeAudio();
+
+	return true;
+}
+
+static int32_t findNewestStep(const undoStack_t *stack, uint8_t instrNum, uint8_t smpNum)
+{
+	for (int32_t i = stack->numSteps-1; i >= 0; i--)
+	{
+		const undoStep_t *step = stack->steps[i];
+		if (step->instrNum == instrNum && step->smpNum == smpNum)
+			return i;
+	}
+
+	return -1;
+}
+
+static undoStep_t *removeStep(undoStack_t *stack, int32_t index) // returns the removed step
+{
+	undoStep_t *step = stack->steps[index];
+
+	stack->numSteps--;
+	memmove(&stack->steps[index], &stack->steps[index+1], (stack->numSteps - index) * sizeof (undoStep_t *));
+
+	return step;
+}
+
+static void removeGroup(undoStack_t *stack, int32_t index) // removes the step, and the rest of its group
+{
+	const uint32_t group = stack->steps[index]->group;
+	if (group == 0)
+	{
+		freeStep(removeStep(stack, index));
+		return;
+	}
+
+	for (int32_t i = stack->numSteps-1; i >= 0; i--)
+	{
+		if (stack->steps[i]->group == group)
+			freeStep(removeStep(stack, i));
+	}
+}
+
+static int32_t countGroups(const undoStack_t *stack) // a step that is not grouped is a group of its own here
+{
+	int32_t numGroups = 0;
+	for (int32_t i = 0; i < stack->numSteps; i++)
+	{
+		const uint32_t group = stack->steps[i]->group;
+		if (group == 0 || i == 0 || stack->steps[i-1]->group != group)
+			numGroups++;
+	}
+
+	return numGroups;
+}
+
+static bool pushStep(undoStack_t *stack, undoStep_t *step)
+{
+	// (steps of a group are always pushed right after each other)
+	const bool newGroup = step->group == 0 || stack->numSteps == 0 || stack->steps[stack->numSteps-1]->group != step->group;
+	if (newGroup && countGroups(stack) >= MAX_UNDO_STEPS)
+		removeGroup(stack, 0);
+
+	if (stack->numSteps >= stack->maxSteps)
+	{
+		const int32_t newMaxSteps = (stack->maxSteps == 0) ? MAX_UNDO_STEPS : stack->maxSteps * 2;
+
+		undoStep_t **newSteps = (undoStep_t **)realloc(stack->steps, newMaxSteps * sizeof (undoStep_t *));
+		if (newSteps == NULL)
+		{
+			freeStep(step);
+			return false;
+		}
+
+		stack->steps = newSteps;
+		stack->maxSteps = newMaxSteps;
+	}
+
+	stack->steps[stack->numSteps++] = step;
+	return true;
+}
+
+static void clearStack(undoStack_t *stack)
+{
+	for (int32_t i = 0; i < stack->numSteps; i++)
+		freeStep(stack->steps[i]);
+
+	if (stack->steps != NULL)
+	{
+		free(stack->steps);
+		stack->steps = NULL;
+	}
+
+	stack->numSteps = stack->maxSteps = 0;
+}
+
+static void trimSampleUndo(void) // drops the oldest steps until we're within the memory limit
+{
+	const uint64_t memLimit = (uint64_t)config.smpUndoMemLimit * (1024*1024);
+
+	while (pageMemUsed > memLimit && countGroups(&undoStack) > 1)
+		removeGroup(&undoStack, 0);
+
+	while (pageMemUsed > memLimit && countGroups(&redoStack) > 1)
+		removeGroup(&redoStack, 0);
+}
+
+static void removeSampleSteps(undoStack_t *stack, uint8_t instrNum, uint8_t smpNum) // (the rest of their groups is kept)
+{
+	for (int32_t i = stack->numSteps-1; i >= 0; i--)
+	{
+		const undoStep_t *step = stack->steps[i];
+		if (step->instrNum == instrNum && step->smpNum == smpNum)
+			freeStep(removeStep(stack, i));
+	}
+}
+
+static bool dropStaleSteps(uint8_t instrNum, uint8_t smpNum, const sample_t *s) // returns true if any were dropped
+{
+	const int32_t i = findNewestStep(&undoStack, instrNum, smpNum);
+	const int32_t j = findNewestStep(&redoStack, instrNum, smpNum);
+
+	// (all the steps of a slot are of the same sample, as they're dropped as soon as a new one is found)
+	if ((i < 0 || undoStack.steps[i]->dataGeneration == s->dataGeneration) &&
+		(j < 0 || redoStack.steps[j]->dataGeneration == s->dataGeneration))
+	{
+		return false;
+	}
+
+	removeSampleSteps(&undoStack, instrNum, smpNum);
+	removeSampleSteps(&redoStack, instrNum, smpNum);
+	return true;
+}
+
+static uint32_t getNewUndoGroup(void) // call with undoMutex locked
+{
+	if (++lastUndoGroup == 0)
+		lastUndoGroup = 1;
+
+	return lastUndoGroup;
+}
+
+bool initSampleUndo(void)
+{
+	undoMutex = SDL_CreateMutex();
+	return undoMutex != NULL;
+}
+
+void clearSampleUndo(void)
+{
+	SDL_LockMutex(undoMutex);
+	clearStack(&undoStack);
+	clearStack(&redoStack);
+	SDL_UnlockMutex(undoMutex);
+}
+
+void freeSampleUndo(void)
+{
+	clearSampleUndo();
+
+	if (undoMutex != NULL)
+	{
+		SDL_DestroyMutex(undoMutex);
+		undoMutex = NULL;
+	}
+}
+
+static void fillUndoStep(int16_t instrNum, int16_t smpNum, bool keepSampleMark, uint32_t group) // call with undoMutex locked
+{
+	lastFilledStep = NULL;
+
+	if (instrNum == 0 || instr[instrNum] == NULL)
+		return;
+
+	sample_t *s = &instr[instrNum]->smp[smpNum];
+	if (s->length <= 0)
+		return;
+
+	dropStaleSteps((uint8_t)instrNum, (uint8_t)smpNum, s);
+
+	// a new edit makes the redo steps of this sample invalid
+	int32_t i;
+	while ((i = findNewestStep(&redoStack, (uint8_t)instrNum, (uint8_t)smpNum)) >= 0)
+		removeGroup(&redoStack, i);
+
+	i = findNewestStep(&undoStack, (uint8_t)instrNum, (uint8_t)smpNum);
+	undoStep_t *ref = (i >= 0) ? undoStack.steps[i] : NULL;
+
+	if (ref != NULL && !refLeadsToSample(ref, s))
+		setStepEditRange(ref, 0, WHOLE_SAMPLE); // the sample was changed in some other way since, so we don't know what changed
+
+	undoStep_t *step = createStep(s, instrNum, smpNum, ref, keepSampleMark, group);
+	if (step == NULL)
+		return; // out of memory, the edit will not be undoable
+
+	if (pushStep(&undoStack, step))
+	{
+		lastFilledStep = step;
+		trimSampleUndo();
+	}
+}
+
+void fillSampleUndo(bool keepSampleMark)
+{
+	SDL_LockMutex(undoMutex);
+	fillUndoStep(editor.curInstr, editor.curSmp, keepSampleMark, 0);
+	SDL_UnlockMutex(undoMutex);
+}
+
+uint32_t newSampleUndoGroup(void)
+{
+	SDL_LockMutex(undoMutex);
+	const uint32_t group = getNewUndoGroup();
+	SDL_UnlockMutex(undoMutex);
+
+	return group;
+}
+
+void fillSampleUndoGroup(uint32_t group, int16_t instrNum, int16_t smpNum)
+{
+	SDL_LockMutex(undoMutex);
+	fillUndoStep(instrNum, smpNum, REMOVE_SAMPLE_MARK, group);
+	SDL_UnlockMutex(undoMutex);
+}
+
+void setSampleUndoEditRange(int32_t pos, int32_t length)
+{
+	SDL_LockMutex(undoMutex);
+
+	undoStep_t *step = lastFilledStep;
+	if (step != NULL && step->instrNum == editor.curInstr && step->smpNum == editor.curSmp && instr[editor.curInstr] != NULL)
+	{
+		setStepEditRange(step, MAX(pos, 0), MAX(length, 0));
+		step->dataVersionAfter = instr[editor.curInstr]->smp[editor.curSmp].dataVersion;
+	}
+
+	lastFilledStep = NULL;
+	SDL_UnlockMutex(undoMutex);
+}
+
+// restores srcStack->steps[index], and puts the sample's current state in 'dstStack' (in group 'dstGroup')
+static bool restoreStepFromStack(undoStack_t *srcStack, int32_t index, undoStack_t *dstStack, uint32_t dstGroup)
+{
+	undoStep_t *step = srcStack->steps[index];
+	const uint8_t instrNum = step->instrNum;
+	const uint8_t smpNum = step->smpNum;
+
+	// the instrument is gone, or it has a new sample now: nothing to restore
+	if (instr[instrNum] == NULL || instr[instrNum]->smp[smpNum].dataGeneration != step->dataGeneration)
+	{
+		freeStep(removeStep(srcStack, index));
+		return true;
+	}
+
+	sample_t *s = &instr[instrNum]->smp[smpNum];
+
+	// the restored step is the best reference, as it's the closest state we know of
+	const bool stepLeadsToSample = refLeadsToSample(step, s);
+	undoStep_t *currStep = createStep(s, instrNum, smpNum, step, step->keepSampleMark, dstGroup);
+
+	if (!restoreStep(s, step))
+	{
+		if (currStep != NULL)
+			freeStep(currStep);
+
+		return false;
+	}
+
+	if (currStep != NULL)
+	{
+		// restoring it again changes the same range back
+		if (stepLeadsToSample)
+			setStepEditRange(currStep, step->editPos, step->editLength);
+
+		currStep->dataVersionAfter = s->dataVersion;
+	}
+
+	freeStep(removeStep(srcStack, index));
+
+	// the sample is now in the state that the next step of it in 'srcStack' leads to
+	const int32_t i = findNewestStep(srcStack, instrNum, smpNum);
+	if (i >= 0)
+		srcStack->steps[i]->dataVersionAfter = s->dataVersion;
+
+	if (currStep != NULL)
+		pushStep(dstStack, currStep);
+
+	return true;
+}
+
+// restores the newest step of the current sample in 'srcStack' (or its whole group), and puts the current state in 'dstStack'
+static void restoreSampleFromStack(undoStack_t *srcStack, undoStack_t *dstStack)
+{
+	sample_t *s = getCurSample();
+	if (s == NULL || s->dataPtr == NULL)
+		return;
+
+	SDL_LockMutex(undoMutex);
+	lastFilledStep = NULL;
+
+	const int32_t i = dropStaleSteps(editor.curInstr, editor.curSmp, s) ? -1 : findNewestStep(srcStack, editor.curInstr, editor.curSmp);
+	if (i < 0)
+	{
+		SDL_UnlockMutex(undoMutex);
+		return;
+	}
+
+	const bool keepSampleMark = srcStack->steps[i]->keepSampleMark;
+	const uint32_t group = srcStack->steps[i]->group;
+	bool outOfMemory = false;
+
+	if (group == 0)
+	{
+		outOfMemory = !restoreStepFromStack(srcStack, i, dstStack, 0);
+	}
+	else
+	{
+		const uint32_t dstGroup = getNewUndoGroup();
+
+		int32_t j = 0;
+		while (j < srcStack->numSteps)
+		{
+			if (srcStack->steps[j]->group != group)
+			{
+				j++;
+			}
+			else if (!restoreStepFromStack(srcStack, j, dstStack, dstGroup))
+			{
+				outOfMemory = true;
+				j++; // leave it, and try the rest of the group
+			}
+		}
+	}
+
+	trimSampleUndo();
+	SDL_UnlockMutex(undoMutex);
+
+	if (outOfMemory)
+	{
+		okBox(0, "System message", "Not enough memory!", NULL);
+		if (group == 0)
+			return;
+	}
+
+	const int32_t oldRx1 = smpEd_Rx1;
+	const int32_t oldRx2 = smpEd_Rx2;
+
+	if (group != 0)
+		updateNewSample(); // the tuning may have changed too
+	else
+		updateSampleEditorSample();
+
+	if (keepSampleMark && oldRx1 < oldRx2)
+	{
+		smpEd_Rx1 = oldRx1;
+		smpEd_Rx2 = oldRx2;
+		writeSample(DONT_FORCE_SAMPLE_REDRAW); // redraw sample mark only
+	}
+}
+
+void undoSample(void)
+{
+	restoreSampleFromStack(&undoStack, &redoStack);
+}
+
+void redoSample(void)
+{
+	restoreSampleFromStack(&redoStack, &undoStack);
+}
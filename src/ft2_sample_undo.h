@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum
+{
+	REMOVE_SAMPLE_MARK = 0,
+	KEEP_SAMPLE_MARK   = 1
+};
+
+bool initSampleUndo(void); // called once on startup
+void fillSampleUndo(bool keepSampleMark); // call before modifying the current sample
+
+/* Call this right after fixSample() at the end of an edit (after fillSampleUndo()) that only changed this range of the
+** current sample, so that the next undo step only reads that part. If the length changed, all the data after 'pos' counts
+** as changed.
+*/
+void setSampleUndoEditRange(int32_t pos, int32_t length);
+
+// for modifying several samples at once, the steps of a group are undone/redone together
+uint32_t newSampleUndoGroup(void);
+void fillSampleUndoGroup(uint32_t group, int16_t instrNum, int16_t smpNum);
+void undoSample(void);
+void redoSample(void);
+void clearSampleUndo(void);
+void freeSampleUndo(void);
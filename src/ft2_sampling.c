@@ -13,6 +13,7 @@
 #include "ft2_sampling.h"
 #include "ft2_structs.h"
 #include "ft2_audioselector.h"
+#include "ft2_sample_scan.h"
 
 #define STEREO_SAMPLE_HEIGHT (SAMPLE_AREA_HEIGHT/2)
 #define SAMPLE_L_CENTER (SAMPLE_AREA_Y_CENTER - (STEREO_SAMPLE_HEIGHT/2))
@@ -166,25 +167,6 @@ void stopSampling(void)
 	editor.updateCurInstr = true;
 }
 
-static void getMinMax16(const int16_t *p, uint32_t position, uint32_t scanLen, int16_t *min16, int16_t *max16)
-{
-	int16_t minVal =  32767;
-	int16_t maxVal = -32768;
-
-	ASSERT(position+scanLen <= PREVIEW_SAMPLES);
-
-	const int16_t *ptr16 = (const int16_t *)p + position;
-	for (uint32_t i = 0; i < scanLen; i++)
-	{
-		const int16_t smp16 = ptr16[i];
-		if (smp16 < minVal) minVal = smp16;
-		if (smp16 > maxVal) maxVal = smp16;
-	}
-
-	*min16 = minVal;
-	*max16 = maxVal;
-}
-
 static int32_t scr2BufPos(int32_t x)
 {
 	const double dXScaleMul = PREVIEW_SAMPLES / (double)SAMPLE_AREA_WIDTH;
@@ -197,6 +179,7 @@ static void drawSamplingPreview(void)
 
 	// clear sample data area
 	memset(&video.frameBuffer[174 * SCREEN_W], 0, SAMPLE_AREA_WIDTH * SAMPLE_AREA_HEIGHT * sizeof (int32_t));
+	markRectDirty(0, 174, SAMPLE_AREA_WIDTH, SAMPLE_AREA_HEIGHT);
 
 	if (sampleInStereo) // stereo sampling
 	{
@@ -222,7 +205,7 @@ static void drawSamplingPreview(void)
 			if (smpNum > 0)
 			{
 				// left channel
-				getMinMax16(smpDataL, smpIdx, smpNum, &min, &max);
+				getMinMax16(&smpDataL[smpIdx], smpNum, &min, &max);
 				min = SAMPLE_L_CENTER - ((min * STEREO_SAMPLE_HEIGHT) >> 16);
 				max = SAMPLE_L_CENTER - ((max * STEREO_SAMPLE_HEIGHT) >> 16);
 
@@ -238,7 +221,7 @@ static void drawSamplingPreview(void)
 				oldMaxL = max;
 
 				// right channel
-				getMinMax16(smpDataR, smpIdx, smpNum, &min, &max);
+				getMinMax16(&smpDataR[smpIdx], smpNum, &min, &max);
 				min = SAMPLE_R_CENTER - ((min * STEREO_SAMPLE_HEIGHT) >> 16);
 				max = SAMPLE_R_CENTER - ((max * STEREO_SAMPLE_HEIGHT) >> 16);
 
@@ -274,7 +257,7 @@ static void drawSamplingPreview(void)
 
 			if (smpNum > 0)
 			{
-				getMinMax16(smpData, smpIdx, smpNum, &min, &max);
+				getMinMax16(&smpData[smpIdx], smpNum, &min, &max);
 				min = SAMPLE_CENTER - ((min * MONO_SAMPLE_HEIGHT) >> 16);
 				max = SAMPLE_CENTER - ((max * MONO_SAMPLE_HEIGHT) >> 16);
 
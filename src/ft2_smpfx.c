@@ -9,31 +9,20 @@
 #include <stdbool.h>
 #include <math.h>
 #include "ft2_header.h"
+#include "ft2_mouse.h"
 #include "ft2_audio.h"
 #include "ft2_pattern_ed.h"
 #include "ft2_gui.h"
 #include "ft2_sample_ed.h"
 #include "ft2_structs.h"
 #include "ft2_replayer.h"
+#include "ft2_keyboard.h"
+#include "ft2_sample_undo.h"
+#include "ft2_jobs.h"
 
 #define RESONANCE_RANGE 99
 #define RESONANCE_MIN 0.01 /* prevent massive blow-up */
 
-enum
-{
-	REMOVE_SAMPLE_MARK = 0,
-	KEEP_SAMPLE_MARK   = 1
-};
-
-static struct
-{
-	bool filled, keepSampleMark;
-	uint8_t flags, undoInstr, undoSmp;
-	uint32_t length, loopStart, loopLength;
-	int8_t *smpData8;
-	int16_t *smpData16;
-} sampleUndo;
-
 typedef struct
 {
 	double a1, a2, a3, b1, b2;
@@ -50,68 +39,6 @@ static bool normalization;
 static uint8_t lastFilterType;
 static int32_t lastLpCutoff = 2000, lastHpCutoff = 200, filterResonance, smpCycles = 1, lastWaveLength = 64, lastAmp = 75;
 
-void clearSampleUndo(void)
-{
-	if (sampleUndo.smpData8 != NULL)
-	{
-		free(sampleUndo.smpData8);
-		sampleUndo.smpData8 = NULL;
-	}
-
-	if (sampleUndo.smpData16 != NULL)
-	{
-		free(sampleUndo.smpData16);
-		sampleUndo.smpData16 = NULL;
-	}
-
-	sampleUndo.filled = false;
-	sampleUndo.keepSampleMark = false;
-}
-
-static void fillSampleUndo(bool keepSampleMark)
-{
-	sampleUndo.filled = false;
-
-	sample_t *s = getCurSample();
-	if (s != NULL && s->length > 0)
-	{
-		pauseAudio();
-		unfixSample(s);
-
-		clearSampleUndo();
-
-		sampleUndo.undoInstr = editor.curInstr;
-		sampleUndo.undoSmp = editor.curSmp;
-		sampleUndo.flags = s->flags;
-		sampleUndo.length = s->length;
-		sampleUndo.loopStart = s->loopStart;
-		sampleUndo.loopLength = s->loopLength;
-		sampleUndo.keepSampleMark = keepSampleMark;
-
-		if (s->flags & SAMPLE_16BIT)
-		{
-			sampleUndo.smpData16 = (int16_t *)malloc(s->length * sizeof (int16_t));
-			if (sampleUndo.smpData16 != NULL)
-			{
-				memcpy(sampleUndo.smpData16, s->dataPtr, s->length * sizeof (int16_t));
-				sampleUndo.filled = true;
-			}
-		}
-		else
-		{
-			sampleUndo.smpData8 = (int8_t *)malloc(s->length * sizeof (int8_t));
-			if (sampleUndo.smpData8 != NULL)
-			{
-				memcpy(sampleUndo.smpData8, s->dataPtr, s->length * sizeof (int8_t));
-				sampleUndo.filled = true;
-			}
-		}
-
-		fixSample(s);
-		resumeAudio();
-	}
-}
-
 static sample_t *setupNewSample(uint32_t length)
 {
 	pauseAudio();
@@ -423,6 +350,7 @@ void pbSfxResoDown(void)
 }
 
 #define CUTOFF_EPSILON (1E-4)
+#define PREVIEW_FADE_LEN 256
 
 static void setupResoLpFilter(sample_t *s, resoFilter_t *f, double cutoff, uint32_t resonance, bool absoluteCutoff)
 {
@@ -488,7 +416,164 @@ static void setupResoHpFilter(sample_t *s, resoFilter_t *f, double cutoff, uint3
 	f->inTmp[0] = f->inTmp[1] = f->outTmp[0] = f->outTmp[1] = 0.0; // clear filter history
 }
 
-static bool applyResoFilter(sample_t *s, resoFilter_t *f)
+/* Filter engine.
+**
+** The filters are processed in blocks. For every block, the feed-forward part
+** of the biquad (a1*x[n] + a2*x[n-1] + a3*x[n-2]) has no dependencies between
+** the output samples, so the compiler can vectorize it. Only the recursive
+** part (- b1*y[n-1] - b2*y[n-2]) is left as a serial loop. The operations are
+** done in the same order as before, so the output is identical.
+**
+** The sample is read with copyUnfixedSmpData() and the result is written to a
+** new sample buffer, so the filtering is done in a job while the audio is
+** still playing. The audio is only paused when the new buffer is swapped in.
+*/
+
+#define FILTER_BLOCK_LEN 4096
+
+enum
+{
+	FILTER_OUTPUT_FILTERED = 0,
+	FILTER_OUTPUT_ADD = 1, // x + (filtered * 0.25)
+	FILTER_OUTPUT_SUB = 2  // x - (filtered * 0.25)
+};
+
+typedef struct filterJob_t
+{
+	resoFilter_t f;
+	uint8_t outputMode;
+	bool normalize;
+	int32_t x1, len;
+	job_t *progressJob; // NULL = no progress reporting/cancelling (preview)
+} filterJob_t;
+
+static filterJob_t filterJob;
+
+// in[] must have two samples of input history before in[0]
+static void filterBlock(const resoFilter_t *f, const double *in, double *out, int32_t length, double *outTmp)
+{
+	for (int32_t i = 0; i < length; i++)
+		out[i] = (f->a1*in[i]) + (f->a2*in[i-1]) + (f->a3*in[i-2]);
+
+	double y1 = outTmp[0];
+	double y2 = outTmp[1];
+
+	for (int32_t i = 0; i < length; i++)
+	{
+		const double y = out[i] - (f->b1*y1) - (f->b2*y2);
+
+		y2 = y1;
+		y1 = y;
+
+		out[i] = y;
+	}
+
+	outTmp[0] = y1;
+	outTmp[1] = y2;
+}
+
+/* Filters the job range of the sample. If dst is NULL, only the peak of the output
+** is measured (returned in *peak), else the output is scaled and written to dst.
+*/
+static bool runFilterPass(const sample_t *s, const filterJob_t *job, int8_t *dst, double scale, double *peak, int32_t passNum, int32_t numPasses)
+{
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+	double *buffer = (double *)malloc(((2 + FILTER_BLOCK_LEN + FILTER_BLOCK_LEN) * sizeof (double)) + (FILTER_BLOCK_LEN * sizeof (int16_t)));
+	if (buffer == NULL)
+		return false;
+
+	double *in = buffer + 2;
+	double *out = in + FILTER_BLOCK_LEN;
+	int16_t *smp16 = (int16_t *)(out + FILTER_BLOCK_LEN);
+	int8_t *smp8 = (int8_t *)smp16;
+
+	in[-1] = in[-2] = 0.0; // clear filter history
+	double outTmp[2] = { 0.0, 0.0 };
+	double maxAbs = 0.0;
+
+	for (int32_t pos = 0; pos < job->len; pos += FILTER_BLOCK_LEN)
+	{
+		const int32_t blockLen = MIN(job->len - pos, FILTER_BLOCK_LEN);
+
+		copyUnfixedSmpData(s, smp8, job->x1 + pos, blockLen);
+		if (sample16Bit)
+		{
+			for (int32_t i = 0; i < blockLen; i++)
+				in[i] = smp16[i];
+		}
+		else
+		{
+			for (int32_t i = 0; i < blockLen; i++)
+				in[i] = smp8[i];
+		}
+
+		filterBlock(&job->f, in, out, blockLen, outTmp);
+
+		if (job->outputMode == FILTER_OUTPUT_ADD)
+		{
+			for (int32_t i = 0; i < blockLen; i++)
+				out[i] = in[i] + (out[i] * 0.25);
+		}
+		else if (job->outputMode == FILTER_OUTPUT_SUB)
+		{
+			for (int32_t i = 0; i < blockLen; i++)
+				out[i] = in[i] - (out[i] * 0.25);
+		}
+
+		// input history for the next block
+		const double lastIn = in[blockLen-1];
+		in[-2] = (blockLen > 1) ? in[blockLen-2] : in[-1];
+		in[-1] = lastIn;
+
+		if (dst == NULL)
+		{
+			for (int32_t i = 0; i < blockLen; i++)
+			{
+				const double outAbs = fabs(out[i]);
+				if (outAbs > maxAbs)
+					maxAbs = outAbs;
+			}
+		}
+		else if (sample16Bit)
+		{
+			int16_t *dst16 = (int16_t *)dst + pos;
+			for (int32_t i = 0; i < blockLen; i++)
+			{
+				const double smp = out[i] * scale;
+				dst16[i] = (int16_t)CLAMP(smp, INT16_MIN, INT16_MAX);
+			}
+		}
+		else
+		{
+			int8_t *dst8 = dst + pos;
+			for (int32_t i = 0; i < blockLen; i++)
+			{
+				const double smp = out[i] * scale;
+				dst8[i] = (int8_t)CLAMP(smp, INT8_MIN, INT8_MAX);
+			}
+		}
+
+		if (job->progressJob != NULL)
+		{
+			setJobProgress(job->progressJob, ((int64_t)passNum * job->len) + pos + blockLen, (int64_t)numPasses * job->len);
+			if (jobCancelled(job->progressJob))
+			{
+				free(buffer);
+				return false;
+			}
+		}
+	}
+
+	free(buffer);
+
+	if (peak != NULL)
+		*peak = maxAbs;
+
+	return true;
+}
+
+static bool getFilterRange(sample_t *s, int32_t *x1Out, int32_t *lenOut) // returns false if the marked range is empty
 {
 	int32_t x1, x2;
 	if (smpEd_Rx1 < smpEd_Rx2)
@@ -503,7 +588,7 @@ static bool applyResoFilter(sample_t *s, resoFilter_t *f)
 			x1 = 0;
 
 		if (x2 <= x1)
-			return true;
+			return false;
 	}
 	else
 	{
@@ -511,117 +596,88 @@ static bool applyResoFilter(sample_t *s, resoFilter_t *f)
 		x1 = 0;
 		x2 = s->length;
 	}
-	
-	const int32_t len = x2 - x1;
-
-	if (!normalization)
-	{
-		pauseAudio();
-		unfixSample(s);
 
-		if (s->flags & SAMPLE_16BIT)
-		{
-			int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = (f->a1*ptr16[i]) + (f->a2*f->inTmp[0]) + (f->a3*f->inTmp[1]) - (f->b1*f->outTmp[0]) - (f->b2*f->outTmp[1]);
+	*x1Out = x1;
+	*lenOut = x2 - x1;
+	return true;
+}
 
-				f->inTmp[1] = f->inTmp[0];
-				f->inTmp[0] = ptr16[i];
+static bool applyFilterJob(job_t *progressJob, void *data)
+{
+	smpPtr_t sp;
+	filterJob_t *job = &filterJob;
 
-				f->outTmp[1] = f->outTmp[0];
-				f->outTmp[0] = out;
+	sp.origPtr = sp.ptr = NULL;
+	job->progressJob = progressJob;
 
-				ptr16[i] = (int16_t)CLAMP(out, INT16_MIN, INT16_MAX);
-			}
-		}
-		else
-		{
-			int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = (f->a1*ptr8[i]) + (f->a2*f->inTmp[0]) + (f->a3*f->inTmp[1]) - (f->b1*f->outTmp[0]) - (f->b2*f->outTmp[1]);
+	sample_t *s = getCurSample();
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+	const int32_t x2 = job->x1 + job->len;
 
-				f->inTmp[1] = f->inTmp[0];
-				f->inTmp[0] = ptr8[i];
+	if (!allocateSmpDataPtr(&sp, s->length, sample16Bit))
+		goto Error;
 
-				f->outTmp[1] = f->outTmp[0];
-				f->outTmp[0] = out;
+	// the data outside of the range is copied as is
+	copyUnfixedSmpData(s, sp.ptr, 0, job->x1);
+	copyUnfixedSmpData(s, &sp.ptr[x2 << sample16Bit], x2, s->length - x2);
 
-				ptr8[i] = (int8_t)CLAMP(out, INT8_MIN, INT8_MAX);
-			}
-		}
+	double scale = 1.0;
+	if (job->normalize) // normalize peak, no clipping
+	{
+		double peak;
+		if (!runFilterPass(s, job, NULL, 1.0, &peak, 0, 2))
+			goto Error;
 
-		fixSample(s);
-		resumeAudio();
+		if (peak > 0.0)
+			scale = (sample16Bit ? INT16_MAX : INT8_MAX) / peak;
 	}
-	else // normalize peak, no clipping
-	{
-		double *dSmp = (double *)malloc(len * sizeof (double));
-		if (dSmp == NULL)
-		{
-			okBox(0, "System message", "Not enough memory!", NULL);
-			return false;
-		}
 
-		pauseAudio();
-		unfixSample(s);
+	if (!runFilterPass(s, job, &sp.ptr[job->x1 << sample16Bit], scale, NULL, job->normalize ? 1 : 0, job->normalize ? 2 : 1))
+		goto Error;
 
-		if (s->flags & SAMPLE_16BIT)
-		{
-			int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-				dSmp[i] = (double)ptr16[i];
-		}
-		else
-		{
-			int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-				dSmp[i] = (double)ptr8[i];
-		}
+	fillSampleUndo(KEEP_SAMPLE_MARK); // (not until now, in case the job was cancelled)
 
-		double peak = 0.0;
-		for (int32_t i = 0; i < len; i++)
-		{
-			const double out = (f->a1*dSmp[i]) + (f->a2*f->inTmp[0]) + (f->a3*f->inTmp[1]) - (f->b1*f->outTmp[0]) - (f->b2*f->outTmp[1]);
+	pauseAudio();
+	freeSmpData(s);
+	setSmpDataPtr(s, &sp);
+	fixSample(s);
+	setSampleUndoEditRange(job->x1, job->len);
+	resumeAudio();
 
-			f->inTmp[1] = f->inTmp[0];
-			f->inTmp[0] = dSmp[i];
+	setSongModifiedFlag();
+	return true;
 
-			f->outTmp[1] = f->outTmp[0];
-			f->outTmp[0] = out;
+Error:
+	freeSmpDataPtr(&sp);
 
-			dSmp[i] = out;
+	if (!jobCancelled(progressJob))
+		okBoxThreadSafe(0, "System message", "Not enough memory!", NULL);
 
-			const double outAbs = fabs(out);
-			if (outAbs > peak)
-				peak = outAbs;
-		}
+	return false;
 
-		if (s->flags & SAMPLE_16BIT)
-		{
-			const double scale = INT16_MAX / peak;
+	(void)data;
+}
 
-			int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-				ptr16[i] = (int16_t)(dSmp[i] * scale);
-		}
-		else
-		{
-			const double scale = INT8_MAX / peak;
+static void applyFilterDone(void *data, int32_t result)
+{
+	writeSample(FORCE_SAMPLE_REDRAW);
 
-			int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-				ptr8[i] = (int8_t)(dSmp[i] * scale);
-		}
+	(void)data;
+	(void)result;
+}
 
-		free(dSmp);
+static void startFilterJob(sample_t *s, const resoFilter_t *f, uint8_t outputMode, bool normalize)
+{
+	filterJob_t *job = &filterJob;
+	if (!getFilterRange(s, &job->x1, &job->len))
+		return;
 
-		fixSample(s);
-		resumeAudio();
-	}
+	job->f = *f;
+	job->outputMode = outputMode;
+	job->normalize = normalize;
 
-	return true;
+	if (!startJob(applyFilterJob, applyFilterDone, NULL, JOB_FOREGROUND))
+		okBox(0, "System message", "Couldn't create thread!", NULL);
 }
 
 void pbSfxLowPass(void)
@@ -651,9 +707,7 @@ void pbSfxLowPass(void)
 	}
 
 	setupResoLpFilter(s, &f, lastLpCutoff, filterResonance, false);
-	fillSampleUndo(KEEP_SAMPLE_MARK);
-	applyResoFilter(s, &f);
-	writeSample(FORCE_SAMPLE_REDRAW);
+	startFilterJob(s, &f, FILTER_OUTPUT_FILTERED, normalization);
 }
 
 void pbSfxHighPass(void)
@@ -683,85 +737,83 @@ void pbSfxHighPass(void)
 	}
 
 	setupResoHpFilter(s, &f, lastHpCutoff, filterResonance, false);
-	fillSampleUndo(KEEP_SAMPLE_MARK);
-	applyResoFilter(s, &f);
-	writeSample(FORCE_SAMPLE_REDRAW);
+	startFilterJob(s, &f, FILTER_OUTPUT_FILTERED, normalization);
 }
 
 void sfxPreviewFilter(uint32_t cutoff)
 {
 	sample_t oldSample;
-	resoFilter_t f;
+	filterJob_t job;
 
 	sample_t *s = getCurSample();
 	if (s == NULL || s->dataPtr == NULL || s->length == 0 || cutoff < 1 || cutoff > 99999)
 		return;
 
-	int32_t x1, x2;
-	if (smpEd_Rx1 < smpEd_Rx2)
-	{
-		x1 = smpEd_Rx1;
-		x2 = smpEd_Rx2;
-
-		if (x2 > s->length)
-			x2 = s->length;
+	if (!getFilterRange(s, &job.x1, &job.len))
+		return;
 
-		if (x1 < 0)
-			x1 = 0;
+	/* The preview is only played for 1.5 seconds, so only filter that much of the
+	** range (plus a bit), and fade out the end of the excerpt to prevent a click.
+	*/
+	const double previewRate = getSampleC4Hz(s) * pow(2.0, (editor.smpEd_NoteNr - 1 - NOTE_C4) / 12.0);
+	const double previewFrames = ceil(previewRate * 1.5) + PREVIEW_FADE_LEN;
+	if (previewFrames < job.len)
+		job.len = (int32_t)previewFrames;
 
-		if (x2 <= x1)
-			return;
-	}
+	if (lastFilterType == FILTER_LOWPASS)
+		setupResoLpFilter(s, &job.f, cutoff, filterResonance, false);
 	else
-	{
-		// no mark, operate on whole sample
-		x1 = 0;
-		x2 = s->length;
-	}
+		setupResoHpFilter(s, &job.f, cutoff, filterResonance, false);
 
-	const int32_t len = x2 - x1;
+	job.outputMode = FILTER_OUTPUT_FILTERED;
+	job.normalize = normalization;
+	job.progressJob = NULL;
 
-	pauseAudio();
-	unfixSample(s);
-	memcpy(&oldSample, s, sizeof (sample_t));
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
 
-	if (lastFilterType == FILTER_LOWPASS)
-		setupResoLpFilter(s, &f, cutoff, filterResonance, false);
-	else
-		setupResoHpFilter(s, &f, cutoff, filterResonance, false);
+	// prepare new sample (the filter only reads the current sample, so this is done while the audio is running)
+	int8_t *sampleData = (int8_t *)malloc((job.len << sample16Bit) + SAMPLE_PAD_LENGTH);
+	if (sampleData == NULL)
+		return;
 
-	// prepare new sample
-	int8_t *sampleData;
-	if (s->flags & SAMPLE_16BIT)
+	int8_t *previewData = sampleData + SMP_DAT_OFFSET;
+
+	double scale = 1.0;
+	if (job.normalize)
 	{
-		sampleData = (int8_t *)malloc((len * sizeof (int16_t)) + SAMPLE_PAD_LENGTH);
-		if (sampleData == NULL)
+		double peak;
+		if (!runFilterPass(s, &job, NULL, 1.0, &peak, 0, 2))
 			goto Error;
 
-		memcpy(sampleData + SMP_DAT_OFFSET, (int16_t *)s->dataPtr + x1, len * sizeof (int16_t));
+		if (peak > 0.0)
+			scale = (sample16Bit ? INT16_MAX : INT8_MAX) / peak;
 	}
-	else
+
+	if (!runFilterPass(s, &job, previewData, scale, NULL, 0, 1))
+		goto Error;
+
+	const int32_t fadeLen = MIN(job.len, PREVIEW_FADE_LEN);
+	for (int32_t i = 0; i < fadeLen; i++)
 	{
-		sampleData = (int8_t *)malloc((len * sizeof (int8_t)) + SAMPLE_PAD_LENGTH);
-		if (sampleData == NULL)
-			goto Error;
+		const int32_t pos = job.len - fadeLen + i;
+		const double amp = (fadeLen - i) / (double)fadeLen;
 
-		memcpy(sampleData + SMP_DAT_OFFSET, (int8_t *)s->dataPtr + x1, len * sizeof (int8_t));
+		if (sample16Bit)
+			((int16_t *)previewData)[pos] = (int16_t)(((int16_t *)previewData)[pos] * amp);
+		else
+			previewData[pos] = (int8_t)(previewData[pos] * amp);
 	}
 
+	// (the current sample data is left fixed, it's not touched while the preview sample is set)
+	pauseAudio();
+	memcpy(&oldSample, s, sizeof (sample_t));
+
 	s->origDataPtr = sampleData;
-	s->length = len;
-	s->dataPtr = s->origDataPtr + SMP_DAT_OFFSET;
+	s->length = job.len;
+	s->dataPtr = previewData;
 	s->loopStart = s->loopLength = 0;
 	fixSample(s);
 
-	const int32_t oldX1 = smpEd_Rx1;
-	const int32_t oldX2 = smpEd_Rx2;
-	smpEd_Rx1 = smpEd_Rx2 = 0;
-	applyResoFilter(s, &f);
-	smpEd_Rx1 = oldX1;
-	smpEd_Rx2 = oldX2;
-
 	// set up preview sample on channel 0
 	channel_t *ch = &channel[0];
 	uint8_t note = editor.smpEd_NoteNr;
@@ -780,15 +832,13 @@ void sfxPreviewFilter(uint32_t cutoff)
 	while (ch->status & CS_TRIGGER_VOICE); // wait for voice to trigger in mixer
 	SDL_Delay(1500); // wait 1.5 seconds
 
-	// we're done, stop voice and free temporary data
+	// we're done, stop voice and set back old sample
 	pauseAudio();
-	free(sampleData);
-
-Error:
-	// set back old sample
 	memcpy(s, &oldSample, sizeof (sample_t));
-	fixSample(s);
 	resumeAudio();
+
+Error:
+	free(sampleData);
 }
 
 void pbSfxSubBass(void)
@@ -800,9 +850,7 @@ void pbSfxSubBass(void)
 		return;
 
 	setupResoHpFilter(s, &f, 0.001, 0, true);
-	fillSampleUndo(KEEP_SAMPLE_MARK);
-	applyResoFilter(s, &f);
-	writeSample(FORCE_SAMPLE_REDRAW);
+	startFilterJob(s, &f, FILTER_OUTPUT_FILTERED, normalization);
 }
 
 void pbSfxAddBass(void)
@@ -813,159 +861,8 @@ void pbSfxAddBass(void)
 	if (s == NULL || s->dataPtr == NULL)
 		return;
 
-	int32_t x1, x2;
-	if (smpEd_Rx1 < smpEd_Rx2)
-	{
-		x1 = smpEd_Rx1;
-		x2 = smpEd_Rx2;
-
-		if (x2 > s->length)
-			x2 = s->length;
-
-		if (x1 < 0)
-			x1 = 0;
-
-		if (x2 <= x1)
-			return;
-	}
-	else
-	{
-		// no mark, operate on whole sample
-		x1 = 0;
-		x2 = s->length;
-	}
-	
-	const int32_t len = x2 - x1;
-
 	setupResoLpFilter(s, &f, 0.015, 0, true);
-
-	double *dSmp = (double *)malloc(len * sizeof (double));
-	if (dSmp == NULL)
-	{
-		okBox(0, "System message", "Not enough memory!", NULL);
-		return;
-	}
-
-	fillSampleUndo(KEEP_SAMPLE_MARK);
-
-	pauseAudio();
-	unfixSample(s);
-
-	if (s->flags & SAMPLE_16BIT)
-	{
-		int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-		for (int32_t i = 0; i < len; i++)
-			dSmp[i] = (double)ptr16[i];
-	}
-	else
-	{
-		int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-		for (int32_t i = 0; i < len; i++)
-			dSmp[i] = (double)ptr8[i];
-	}
-
-	if (!normalization)
-	{
-		for (int32_t i = 0; i < len; i++)
-		{
-			double out = (f.a1*dSmp[i]) + (f.a2*f.inTmp[0]) + (f.a3*f.inTmp[1]) - (f.b1*f.outTmp[0]) - (f.b2*f.outTmp[1]);
-
-			f.inTmp[1] = f.inTmp[0];
-			f.inTmp[0] = dSmp[i];
-
-			f.outTmp[1] = f.outTmp[0];
-			f.outTmp[0] = out;
-
-			dSmp[i] = out;
-		}
-
-		if (s->flags & SAMPLE_16BIT)
-		{
-			int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = ptr16[i] + (dSmp[i] * 0.25);
-				out = CLAMP(out, INT16_MIN, INT16_MAX);
-
-				ptr16[i] = (int16_t)out;
-			}
-		}
-		else
-		{
-			int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = ptr8[i] + (dSmp[i] * 0.25);
-				out = CLAMP(out, INT8_MIN, INT8_MAX);
-
-				ptr8[i] = (int8_t)out;
-			}
-		}
-	}
-	else
-	{
-		if (s->flags & SAMPLE_16BIT)
-		{
-			int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-
-			double peak = 0.0;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = (f.a1*dSmp[i]) + (f.a2*f.inTmp[0]) + (f.a3*f.inTmp[1]) - (f.b1*f.outTmp[0]) - (f.b2*f.outTmp[1]);
-
-				f.inTmp[1] = f.inTmp[0];
-				f.inTmp[0] = dSmp[i];
-
-				f.outTmp[1] = f.outTmp[0];
-				f.outTmp[0] = out;
-
-				dSmp[i] = out;
-				double bass = ptr16[i] + (out * 0.25);
-
-				const double outAbs = fabs(bass);
-				if (outAbs > peak)
-					peak = outAbs;
-			}
-
-			double scale = INT16_MAX / peak;
-			for (int32_t i = 0; i < len; i++)
-				ptr16[i] = (int16_t)((ptr16[i] + (dSmp[i] * 0.25)) * scale);
-		}
-		else
-		{
-			int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-
-			double peak = 0.0;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = (f.a1*dSmp[i]) + (f.a2*f.inTmp[0]) + (f.a3*f.inTmp[1]) - (f.b1*f.outTmp[0]) - (f.b2*f.outTmp[1]);
-
-				f.inTmp[1] = f.inTmp[0];
-				f.inTmp[0] = dSmp[i];
-
-				f.outTmp[1] = f.outTmp[0];
-				f.outTmp[0] = out;
-
-				dSmp[i] = out;
-				double bass = ptr8[i] + (out * 0.25);
-
-				const double outAbs = fabs(bass);
-				if (outAbs > peak)
-					peak = outAbs;
-			}
-
-			double scale = INT8_MAX / peak;
-			for (int32_t i = 0; i < len; i++)
-				ptr8[i] = (int8_t)((ptr8[i] + (dSmp[i] * 0.25)) * scale);
-		}
-	}
-
-	free(dSmp);
-
-	fixSample(s);
-	resumeAudio();
-
-	writeSample(FORCE_SAMPLE_REDRAW);
+	startFilterJob(s, &f, FILTER_OUTPUT_ADD, normalization);
 }
 
 void pbSfxSubTreble(void)
@@ -977,9 +874,7 @@ void pbSfxSubTreble(void)
 		return;
 
 	setupResoLpFilter(s, &f, 0.33, 0, true);
-	fillSampleUndo(KEEP_SAMPLE_MARK);
-	applyResoFilter(s, &f);
-	writeSample(FORCE_SAMPLE_REDRAW);
+	startFilterJob(s, &f, FILTER_OUTPUT_FILTERED, normalization);
 }
 
 void pbSfxAddTreble(void)
@@ -990,159 +885,8 @@ void pbSfxAddTreble(void)
 	if (s == NULL || s->dataPtr == NULL)
 		return;
 
-	int32_t x1, x2;
-	if (smpEd_Rx1 < smpEd_Rx2)
-	{
-		x1 = smpEd_Rx1;
-		x2 = smpEd_Rx2;
-
-		if (x2 > s->length)
-			x2 = s->length;
-
-		if (x1 < 0)
-			x1 = 0;
-
-		if (x2 <= x1)
-			return;
-	}
-	else
-	{
-		// no mark, operate on whole sample
-		x1 = 0;
-		x2 = s->length;
-	}
-	
-	const int32_t len = x2 - x1;
-
 	setupResoHpFilter(s, &f, 0.27, 0, true);
-
-	double *dSmp = (double *)malloc(len * sizeof (double));
-	if (dSmp == NULL)
-	{
-		okBox(0, "System message", "Not enough memory!", NULL);
-		return;
-	}
-
-	fillSampleUndo(KEEP_SAMPLE_MARK);
-
-	pauseAudio();
-	unfixSample(s);
-
-	if (s->flags & SAMPLE_16BIT)
-	{
-		int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-		for (int32_t i = 0; i < len; i++)
-			dSmp[i] = (double)ptr16[i];
-	}
-	else
-	{
-		int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-		for (int32_t i = 0; i < len; i++)
-			dSmp[i] = (double)ptr8[i];
-	}
-
-	if (!normalization)
-	{
-		for (int32_t i = 0; i < len; i++)
-		{
-			double out = (f.a1*dSmp[i]) + (f.a2*f.inTmp[0]) + (f.a3*f.inTmp[1]) - (f.b1*f.outTmp[0]) - (f.b2*f.outTmp[1]);
-
-			f.inTmp[1] = f.inTmp[0];
-			f.inTmp[0] = dSmp[i];
-
-			f.outTmp[1] = f.outTmp[0];
-			f.outTmp[0] = out;
-
-			dSmp[i] = out;
-		}
-
-		if (s->flags & SAMPLE_16BIT)
-		{
-			int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = ptr16[i] - (dSmp[i] * 0.25);
-				out = CLAMP(out, INT16_MIN, INT16_MAX);
-
-				ptr16[i] = (int16_t)out;
-			}
-		}
-		else
-		{
-			int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = ptr8[i] - (dSmp[i] * 0.25);
-				out = CLAMP(out, INT8_MIN, INT8_MAX);
-
-				ptr8[i] = (int8_t)out;
-			}
-		}
-	}
-	else
-	{
-		if (s->flags & SAMPLE_16BIT)
-		{
-			int16_t *ptr16 = (int16_t *)s->dataPtr + x1;
-
-			double peak = 0.0;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = (f.a1*dSmp[i]) + (f.a2*f.inTmp[0]) + (f.a3*f.inTmp[1]) - (f.b1*f.outTmp[0]) - (f.b2*f.outTmp[1]);
-
-				f.inTmp[1] = f.inTmp[0];
-				f.inTmp[0] = dSmp[i];
-
-				f.outTmp[1] = f.outTmp[0];
-				f.outTmp[0] = out;
-
-				dSmp[i] = out;
-				double treble = ptr16[i] - (out * 0.25);
-
-				const double outAbs = fabs(treble);
-				if (outAbs > peak)
-					peak = outAbs;
-			}
-
-			double scale = INT16_MAX / peak;
-			for (int32_t i = 0; i < len; i++)
-				ptr16[i] = (int16_t)((ptr16[i] - (dSmp[i] * 0.25)) * scale);
-		}
-		else
-		{
-			int8_t *ptr8 = (int8_t *)s->dataPtr + x1;
-
-			double peak = 0.0;
-			for (int32_t i = 0; i < len; i++)
-			{
-				double out = (f.a1*dSmp[i]) + (f.a2*f.inTmp[0]) + (f.a3*f.inTmp[1]) - (f.b1*f.outTmp[0]) - (f.b2*f.outTmp[1]);
-
-				f.inTmp[1] = f.inTmp[0];
-				f.inTmp[0] = dSmp[i];
-
-				f.outTmp[1] = f.outTmp[0];
-				f.outTmp[0] = out;
-
-				dSmp[i] = out;
-				double treble = ptr8[i] - (out * 0.25);
-
-				const double outAbs = fabs(treble);
-				if (outAbs > peak)
-					peak = outAbs;
-			}
-
-			double scale = INT8_MAX / peak;
-			for (int32_t i = 0; i < len; i++)
-				ptr8[i] = (int8_t)((ptr8[i] - (dSmp[i] * 0.25)) * scale);
-		}
-	}
-
-	free(dSmp);
-
-	fixSample(s);
-	resumeAudio();
-
-	writeSample(FORCE_SAMPLE_REDRAW);
+	startFilterJob(s, &f, FILTER_OUTPUT_SUB, normalization);
 }
 
 void pbSfxSetAmp(void)
@@ -1216,58 +960,18 @@ void pbSfxSetAmp(void)
 	}
 
 	fixSample(s);
+	setSampleUndoEditRange(x1, len);
 	resumeAudio();
 
 	writeSample(FORCE_SAMPLE_REDRAW);
 }
 
-void pbSfxUndo(void)
+void pbSfxUndo(void) // shift+click = redo
 {
-	if (!sampleUndo.filled || sampleUndo.undoInstr != editor.curInstr || sampleUndo.undoSmp != editor.curSmp)
-		return;
-
-	sample_t *s = getCurSample();
-	if (s == NULL || s->dataPtr == NULL)
-		return;
-
-	pauseAudio();
-
-	freeSmpData(s);
-	s->flags = sampleUndo.flags;
-	s->length = sampleUndo.length;
-	s->loopStart = sampleUndo.loopStart;
-	s->loopLength = sampleUndo.loopLength;
-
-	if (allocateSmpData(s, s->length, !!(s->flags & SAMPLE_16BIT)))
-	{
-		if (s->flags & SAMPLE_16BIT)
-			memcpy(s->dataPtr, sampleUndo.smpData16, s->length * sizeof (int16_t));
-		else
-			memcpy(s->dataPtr, sampleUndo.smpData8, s->length * sizeof (int8_t));
-
-		fixSample(s);
-		resumeAudio();
-	}
+	if (keyb.leftShiftPressed)
+		redoSample();
 	else
-	{
-		resumeAudio();
-		okBox(0, "System message", "Not enough memory!", NULL);
-	}
-
-	int32_t oldRx1 = smpEd_Rx1;
-	int32_t oldRx2 = smpEd_Rx2;
-
-	updateSampleEditorSample();
-
-	if (sampleUndo.keepSampleMark && oldRx1 < oldRx2)
-	{
-		smpEd_Rx1 = oldRx1;
-		smpEd_Rx2 = oldRx2;
-		writeSample(DONT_FORCE_SAMPLE_REDRAW); // redraw sample mark only
-	}
-
-	sampleUndo.keepSampleMark = false;
-	sampleUndo.filled = false;
+		undoSample();
 }
 
 void hideSampleEffectsScreen(void)
@@ -3,7 +3,6 @@
 #include <stdint.h>
 #include "ft2_header.h"
 
-void clearSampleUndo(void);
 void cbSfxNormalization(void);
 void pbSfxCyclesUp(void);
 void pbSfxCyclesDown(void);
@@ -0,0 +1,297 @@
+/* Sample editor spectrogram.
+**
+** The spectrogram of the shown part of the sample is calculated column by
+** column in a worker thread, and the sample editor draws the columns as they
+** get done, so a big sample never stalls the GUI. The results for the last
+** few views (scroll position/zoom level) are cached, so zooming back and forth
+** is instant. Every cache entry is tied to the sample data pointer, and is
+** thrown away when that sample data is modified or freed.
+*/
+
+// for finding memory leaks in debug mode with Visual Studio
+#if defined _DEBUG && defined _MSC_VER
+#include <crtdbg.h>
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ft2_header.h"
+#include "ft2_sample_ed.h"
+#include "ft2_fft.h"
+#include "ft2_spectrogram.h"
+
+#define SPECTRO_FFT_BITS 9
+#define SPECTRO_FFT_LEN (1 << SPECTRO_FFT_BITS)
+#define SPECTRO_NUM_BINS (SPECTRO_FFT_LEN / 2)
+#define SPECTRO_MAX_WINDOWS 4 /* per column, when zoomed out */
+#define SPECTRO_CACHE_SIZE 4
+#define SPECTRO_MIN_DB (-96.0)
+
+typedef struct spectroView_t
+{
+	const int8_t *dataPtr; // NULL = unused entry
+	bool is16Bit;
+	int32_t length, scrPos, viewSize;
+	uint32_t lastUsed;
+	volatile int32_t columnsDone;
+	int32_t colPos[SAMPLE_AREA_WIDTH+1];
+	uint8_t levels[SAMPLE_AREA_WIDTH * SAMPLE_AREA_HEIGHT]; // one column after another
+} spectroView_t;
+
+static volatile bool stopWorker;
+static uint32_t useCounter;
+static spectroView_t *views[SPECTRO_CACHE_SIZE], *shownView, *workView;
+static const sample_t *workSample;
+static SDL_Thread *workThread;
+
+static void stopSpectrogramWorker(void)
+{
+	if (workThread == NULL)
+		return;
+
+	stopWorker = true;
+	SDL_WaitThread(workThread, NULL);
+
+	workThread = NULL;
+	workView = NULL;
+}
+
+// reads SPECTRO_FFT_LEN frames from pos (normalized, zero outside of the sample)
+static void readWindow(const sample_t *s, int8_t *tmp, double *dst, int32_t pos)
+{
+	const bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
+
+	const int32_t start = CLAMP(-pos, 0, SPECTRO_FFT_LEN);
+	const int32_t end = CLAMP(s->length - pos, start, SPECTRO_FFT_LEN);
+
+	for (int32_t i = 0; i < start; i++)
+		dst[i] = 0.0;
+
+	copyUnfixedSmpData(s, tmp, pos + start, end - start);
+	if (sample16Bit)
+	{
+		const int16_t *tmp16 = (const int16_t *)tmp;
+		for (int32_t i = start; i < end; i++)
+			dst[i] = tmp16[i-start] * (1.0 / 32768.0);
+	}
+	else
+	{
+		for (int32_t i = start; i < end; i++)
+			dst[i] = tmp[i-start] * (1.0 / 128.0);
+	}
+
+	for (int32_t i = end; i < SPECTRO_FFT_LEN; i++)
+		dst[i] = 0.0;
+}
+
+static int32_t SDLCALL spectrogramThread(void *ptr)
+{
+	fft_t fft;
+	double window[SPECTRO_FFT_LEN], re[SPECTRO_FFT_LEN], im[SPECTRO_FFT_LEN], power[SPECTRO_NUM_BINS];
+	int16_t tmp[SPECTRO_FFT_LEN];
+
+	spectroView_t *v = workView;
+	const sample_t *s = workSample;
+
+	if (!fftInit(&fft, SPECTRO_FFT_BITS))
+		return false;
+
+	for (int32_t i = 0; i < SPECTRO_FFT_LEN; i++) // Hann window
+		window[i] = 0.5 - (0.5 * cos((2.0 * PI * i) / SPECTRO_FFT_LEN));
+
+	// a full scale sine gives a bin magnitude of N/4 with the Hann window
+	const double dRefPower = (SPECTRO_FFT_LEN / 4.0) * (SPECTRO_FFT_LEN / 4.0);
+
+	for (int32_t x = v->columnsDone; x < SAMPLE_AREA_WIDTH && !stopWorker; x++)
+	{
+		const int32_t colStart = v->colPos[x];
+		const int32_t colLen = MAX(v->colPos[x+1] - colStart, 0);
+		const int32_t numWindows = CLAMP(colLen / SPECTRO_FFT_LEN, 1, SPECTRO_MAX_WINDOWS);
+
+		for (int32_t i = 0; i < SPECTRO_NUM_BINS; i++)
+			power[i] = 0.0;
+
+		for (int32_t w = 0; w < numWindows; w++)
+		{
+			const int32_t center = colStart + (int32_t)(((int64_t)colLen * ((w * 2) + 1)) / (numWindows * 2));
+
+			readWindow(s, (int8_t *)tmp, re, center - (SPECTRO_FFT_LEN / 2));
+			for (int32_t i = 0; i < SPECTRO_FFT_LEN; i++)
+			{
+				re[i] *= window[i];
+				im[i] = 0.0;
+			}
+
+			fftTransform(&fft, re, im, false);
+
+			for (int32_t i = 0; i < SPECTRO_NUM_BINS; i++)
+				power[i] += (re[i] * re[i]) + (im[i] * im[i]);
+		}
+
+		// one row can cover more than one bin, use the strongest one
+		uint8_t *dst = &v->levels[x * SAMPLE_AREA_HEIGHT];
+		for (int32_t y = 0; y < SAMPLE_AREA_HEIGHT; y++)
+		{
+			const int32_t row = (SAMPLE_AREA_HEIGHT-1) - y; // low frequencies at the bottom
+			const int32_t bin1 = (row * SPECTRO_NUM_BINS) / SAMPLE_AREA_HEIGHT;
+			const int32_t bin2 = MAX(((row+1) * SPECTRO_NUM_BINS) / SAMPLE_AREA_HEIGHT, bin1+1);
+
+			double dMax = 0.0;
+			for (int32_t i = bin1; i < bin2; i++)
+			{
+				if (power[i] > dMax)
+					dMax = power[i];
+			}
+
+			const double dPower = dMax / (numWindows * dRefPower);
+			const double dB = (dPower > 0.0) ? (10.0 * log10(dPower)) : SPECTRO_MIN_DB;
+
+			int32_t level = (int32_t)(((dB - SPECTRO_MIN_DB) * SPECTROGRAM_LEVELS) / -SPECTRO_MIN_DB);
+			dst[y] = (uint8_t)CLAMP(level, 0, SPECTROGRAM_LEVELS-1);
+		}
+
+		v->columnsDone = x+1;
+	}
+
+	fftFree(&fft);
+	return true;
+
+	(void)ptr;
+}
+
+static bool viewMatches(const spectroView_t *v, const sample_t *s, int32_t scrPos, int32_t viewSize)
+{
+	return v != NULL && v->dataPtr != NULL && v->dataPtr == s->dataPtr && v->length == s->length &&
+	       v->is16Bit == !!(s->flags & SAMPLE_16BIT) && v->scrPos == scrPos && v->viewSize == viewSize;
+}
+
+void requestSpectrogram(const sample_t *s, int32_t scrPos, int32_t viewSize, const int32_t *colPos)
+{
+	if (s == NULL || s->dataPtr == NULL || s->length <= 0)
+	{
+		shownView = NULL;
+		return;
+	}
+
+	spectroView_t *v = NULL;
+	for (int32_t i = 0; i < SPECTRO_CACHE_SIZE; i++)
+	{
+		if (viewMatches(views[i], s, scrPos, viewSize))
+		{
+			v = views[i];
+			break;
+		}
+	}
+
+	if (v == NULL) // not cached, use an empty or the least recently used entry
+	{
+		int32_t entry = 0;
+		for (int32_t i = 0; i < SPECTRO_CACHE_SIZE; i++)
+		{
+			if (views[i] == NULL || views[i]->dataPtr == NULL)
+			{
+				entry = i;
+				break;
+			}
+
+			if (views[i]->lastUsed < views[entry]->lastUsed)
+				entry = i;
+		}
+
+		if (views[entry] == NULL)
+		{
+			views[entry] = (spectroView_t *)malloc(sizeof (spectroView_t));
+			if (views[entry] == NULL)
+			{
+				shownView = NULL;
+				return;
+			}
+		}
+
+		v = views[entry];
+		if (v == workView)
+			stopSpectrogramWorker();
+
+		v->dataPtr = s->dataPtr;
+		v->is16Bit = !!(s->flags & SAMPLE_16BIT);
+		v->length = s->length;
+		v->scrPos = scrPos;
+		v->viewSize = viewSize;
+		v->columnsDone = 0;
+		memcpy(v->colPos, colPos, sizeof (v->colPos));
+	}
+
+	v->lastUsed = ++useCounter;
+	shownView = v;
+
+	if (v->columnsDone >= SAMPLE_AREA_WIDTH || (workThread != NULL && workView == v))
+		return; // done, or being worked on
+
+	stopSpectrogramWorker();
+
+	stopWorker = false;
+	workView = v;
+	workSample = s;
+
+	workThread = SDL_CreateThread(spectrogramThread, "spectrogram thread", NULL);
+	if (workThread == NULL)
+		workView = NULL;
+}
+
+int32_t getSpectrogramColumnsDone(void)
+{
+	if (shownView == NULL)
+		return 0;
+
+	return shownView->columnsDone;
+}
+
+const uint8_t *getSpectrogramColumn(int32_t x)
+{
+	if (shownView == NULL || x < 0 || x >= shownView->columnsDone)
+		return NULL;
+
+	return &shownView->levels[x * SAMPLE_AREA_HEIGHT];
+}
+
+bool spectrogramWorkerActive(void)
+{
+	return workThread != NULL && workView != NULL && workView->columnsDone < SAMPLE_AREA_WIDTH;
+}
+
+void invalidateSpectrogram(const int8_t *dataPtr)
+{
+	if (dataPtr == NULL)
+		return;
+
+	if (workView != NULL && workView->dataPtr == dataPtr)
+		stopSpectrogramWorker();
+
+	for (int32_t i = 0; i < SPECTRO_CACHE_SIZE; i++)
+	{
+		spectroView_t *v = views[i];
+		if (v != NULL && v->dataPtr == dataPtr)
+		{
+			v->dataPtr = NULL;
+			v->columnsDone = 0;
+		}
+	}
+}
+
+void freeSpectrogram(void)
+{
+	stopSpectrogramWorker();
+	shownView = NULL;
+
+	for (int32_t i = 0; i < SPECTRO_CACHE_SIZE; i++)
+	{
+		if (views[i] != NULL)
+		{
+			free(views[i]);
+			views[i] = NULL;
+		}
+	}
+}
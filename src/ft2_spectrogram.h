@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ft2_replayer.h"
+#include "ft2_palette.h"
+
+#define SPECTROGRAM_LEVELS PAL_SPECTRUM_LEVELS
+
+// colPos[] = SAMPLE_AREA_WIDTH+1 sample positions (the column edges of the view)
+void requestSpectrogram(const sample_t *s, int32_t scrPos, int32_t viewSize, const int32_t *colPos);
+int32_t getSpectrogramColumnsDone(void); // for the last requested view
+const uint8_t *getSpectrogramColumn(int32_t x); // SAMPLE_AREA_HEIGHT levels, top row first
+bool spectrogramWorkerActive(void);
+
+void invalidateSpectrogram(const int8_t *dataPtr); // call before the sample data is modified or freed
+void freeSpectrogram(void);
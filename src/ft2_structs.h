@@ -19,7 +19,7 @@ typedef struct editor_t
 
 	volatile bool mainLoopOngoing;
 	volatile bool busy, scopeThreadBusy, programRunning, wavIsRendering, wavReachedEndFlag, stopWavRender;
-	volatile bool updateCurSmp, updateCurInstr, diskOpReadDir, diskOpReadDone, updateWindowTitle;
+	volatile bool updateCurSmp, updateCurInstr, diskOpReadDir, diskOpReadDone, updateWindowTitle, autosaveDirty;
 	volatile uint8_t loadMusicEvent;
 	volatile FILE *wavRendererFileHandle;
 
@@ -105,6 +105,22 @@ void myLoaderMsgBox(const char *fmt, ...)
 	okBox(0, "System message", fmt, NULL);
 }
 
+// for loading without any GUI (the messages are dropped)
+void silentLoaderMsgBox(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+int16_t silentLoaderSysReq(int16_t type, const char *headline, const char *text, void (*checkBoxCallback)(void))
+{
+	(void)type;
+	(void)headline;
+	(void)text;
+	(void)checkBoxCallback;
+
+	return 3; // the third button (for the stereo sample question, "Mix to mono")
+}
+
 static void drawWindow(uint16_t w)
 {
 	const uint16_t h = SYSTEM_REQUEST_H;
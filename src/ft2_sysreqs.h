@@ -29,6 +29,8 @@ bool askUnsavedChanges(uint8_t type);
 
 void myLoaderMsgBoxThreadSafe(const char *fmt, ...);
 void myLoaderMsgBox(const char *fmt, ...);
+void silentLoaderMsgBox(const char *fmt, ...);
+int16_t silentLoaderSysReq(int16_t type, const char *headline, const char *text, void (*checkBoxCallback)(void));
 
  // ft2_sysreqs.c
 extern okBoxData_t okBoxData;
@@ -53,6 +53,7 @@ textBox_t textBoxes[NUM_TEXTBOXES] =
 	// ------ DISK OP. TEXTBOXES ------
 	// x,   y,   w,   h,  tx,ty, maxc,       rmb,   cmc
 	{   31, 158, 134,  12, 2, 1, PATH_MAX,   false, true },
+	{   31, 144, 134,  12, 2, 1, DISKOP_SEARCH_LEN, false, true },
 
 	// ------ CONFIG TEXTBOXES ------
 	// x,   y,   w,   h,  tx,ty, maxc,       rmb,   cmc
@@ -78,6 +79,10 @@ static void setSongModifiedFlagIfNeeded(void) // called during keystrokes in tex
 	{
 		setSongModifiedFlag();
 	}
+	else if (mouse.lastEditBox == TB_DISKOP_SEARCH)
+	{
+		diskOp_SearchTextChanged(); // filter the list while typing
+	}
 }
 
 bool textIsMarked(void)
@@ -348,6 +353,9 @@ void exitTextEditing(void)
 		updateWindowTitle(true);
 	}
 
+	if (mouse.lastEditBox == TB_DISKOP_SEARCH)
+		diskOp_SearchEditDone();
+
 	keyb.ignoreCurrKeyUp = true; // prevent a note being played (on enter key)
 	editor.editTextFlag = false;
 
@@ -26,6 +26,7 @@ enum // TEXTBOXES
 	TB_SONG_NAME,
 
 	TB_DISKOP_FILENAME,
+	TB_DISKOP_SEARCH,
 
 	TB_CONF_DEF_MODS_DIR,
 	TB_CONF_DEF_INSTRS_DIR,
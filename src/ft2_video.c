@@ -50,7 +50,7 @@ static char wndTitle[256];
 static sprite_t sprites[SPRITE_NUM];
 
 // for FPS counter
-#define FPS_LINES 15
+#define FPS_LINES 19
 #define FPS_SCAN_FRAMES 60
 #define FPS_RENDER_W 285
 #define FPS_RENDER_H (((FONT1_CHAR_H + 1) * FPS_LINES) + 1)
@@ -64,6 +64,25 @@ static uint64_t frameStartTime, runningFrameDuration;
 static double dFrameDurationDiv, dAvgFPS;
 // ------------------
 
+// for dirty rectangle tracking (one dirty span per scanline, x2 is exclusive)
+static bool screenIsDirty, lastFramePresented, lastMouseOverTextBox, lastTextCursorFocus;
+static int16_t dirtyRowX1[SCREEN_H], dirtyRowX2[SCREEN_H];
+// ------------------
+
+// for idle mode
+#define IDLE_WAIT_TIMEOUT_MS 100
+static SDL_atomic_t wakeUpPending; // a wake-up event is queued, cleared by the main loop every frame
+// ------------------
+
+// for frame timing (present time statistics and display latency estimation)
+#define FRAME_LATENCY_SMOOTHING 0.05 /* lowpass coefficient */
+#define MAX_DISPLAY_LATENCY_MS 100.0
+static uint32_t lateFrames, frameStatsCounter;
+static uint64_t syncTime, lastPresentTime, displayLatency;
+static double dPresentTimeSum, dFrameIntervalSum, dFrameIntervalMax, dDisplayLatency;
+static double dAvgPresentTimeMs, dAvgFrameIntervalMs, dMaxFrameIntervalMs;
+// ------------------
+
 static void drawReplayerData(void);
 
 void resetFPSCounter(void)
@@ -72,6 +91,88 @@ void resetFPSCounter(void)
 	fpsTextBuf[0] = '\0';
 	runningFrameDuration = 0;
 	avgFramesReady = false;
+
+	lateFrames = 0;
+	frameStatsCounter = 0;
+	lastPresentTime = 0;
+	dPresentTimeSum = dFrameIntervalSum = dFrameIntervalMax = 0.0;
+	dAvgPresentTimeMs = dAvgFrameIntervalMs = dMaxFrameIntervalMs = 0.0;
+}
+
+/* Returns the current time for the audio/video sync queues, shifted by the
+** estimated display latency, so that we pick the replayer state that will
+** be audible when this frame actually shows up on the screen.
+*/
+uint64_t getVisualsSyncTime(void)
+{
+	syncTime = SDL_GetPerformanceCounter();
+	return syncTime + displayLatency;
+}
+
+static double getRefreshPeriod(void) // in HPC ticks
+{
+	double dRefreshRate = video.dMonitorRefreshRate;
+	if (dRefreshRate < 30.0 || dRefreshRate > 1000.0)
+		dRefreshRate = VBLANK_HZ; // unknown or bogus, assume 60Hz
+
+	return (double)hpcFreq.freq64 / dRefreshRate;
+}
+
+static void updateFrameTiming(uint64_t presentStart, uint64_t presentEnd)
+{
+	const double dRefreshPeriod = getRefreshPeriod();
+
+	// frame statistics (shown in the FPS counter)
+
+	dPresentTimeSum += (double)(presentEnd - presentStart);
+	if (lastPresentTime != 0)
+	{
+		const double dInterval = (double)(presentEnd - lastPresentTime);
+
+		dFrameIntervalSum += dInterval;
+		if (dInterval > dFrameIntervalMax)
+			dFrameIntervalMax = dInterval;
+
+		if (dInterval > dRefreshPeriod*1.5 && songPlaying) // a missed vblank (only counted while things move)
+			lateFrames++;
+	}
+	lastPresentTime = presentEnd;
+
+	if (++frameStatsCounter >= FPS_SCAN_FRAMES)
+	{
+		dAvgPresentTimeMs = (dPresentTimeSum / FPS_SCAN_FRAMES) * hpcFreq.dFreqMulMs;
+		dAvgFrameIntervalMs = (dFrameIntervalSum / FPS_SCAN_FRAMES) * hpcFreq.dFreqMulMs;
+		dMaxFrameIntervalMs = dFrameIntervalMax * hpcFreq.dFreqMulMs;
+
+		dPresentTimeSum = dFrameIntervalSum = dFrameIntervalMax = 0.0;
+		frameStatsCounter = 0;
+	}
+
+	/* Display latency estimation: time from sampling the sync queues to the
+	** end of SDL_RenderPresent(), plus the time until the frame is visible.
+	** With VSync, the buffer swap happens at vblank and the image is scanned
+	** out during the next refresh period (half a period on average). Without
+	** VSync, we additionally wait for the next vblank (half a period on average).
+	*/
+	if (syncTime != 0 && presentEnd > syncTime)
+	{
+		double dLatency = (double)(presentEnd - syncTime) + (dRefreshPeriod * 0.5);
+		if (!video.vsync60HzPresent)
+			dLatency += dRefreshPeriod * 0.5;
+
+		const double dMaxLatency = MAX_DISPLAY_LATENCY_MS / hpcFreq.dFreqMulMs;
+		if (dLatency > dMaxLatency)
+			dLatency = dMaxLatency;
+
+		if (dDisplayLatency == 0.0)
+			dDisplayLatency = dLatency;
+		else
+			dDisplayLatency += (dLatency - dDisplayLatency) * FRAME_LATENCY_SMOOTHING;
+
+		displayLatency = (uint64_t)dDisplayLatency;
+	}
+
+	syncTime = 0;
 }
 
 void beginFPSCounter(void)
@@ -131,6 +232,10 @@ static void drawFPSCounter(void)
 	             "Mouse pixel-space muls: x=%.4f, y=%.4f\n" \
 	             "Relative mouse coords: %d,%d\n" \
 	             "Absolute mouse coords: %d,%d\n" \
+	             "Present time: %.3fms (%u late frames)\n" \
+	             "Frame interval: %.3fms (max %.3fms)\n" \
+	             "Est. display latency: %.2fms\n" \
+	             "Audio/video sync correction: %+.3fms\n" \
 	             "Press CTRL+SHIFT+F to close this box.\n",
 	             SDLVer.major, SDLVer.minor, SDLVer.patch,
 	             dAvgFPS,
@@ -145,7 +250,11 @@ static void drawFPSCounter(void)
 	             video.dDpiZoomFactorX, video.dDpiZoomFactorY,
 	             video.dMouseXMul, video.dMouseYMul,
 	             mouse.x, mouse.y,
-	             mouse.absX, mouse.absY);
+	             mouse.absX, mouse.absY,
+	             dAvgPresentTimeMs, lateFrames,
+	             dAvgFrameIntervalMs, dMaxFrameIntervalMs,
+	             dDisplayLatency * hpcFreq.dFreqMulMs,
+	             audio.syncCorrection * hpcFreq.dFreqMulMs);
 
 	// draw text
 
@@ -185,6 +294,129 @@ void endFPSCounter(void)
 		runningFrameDuration += SDL_GetPerformanceCounter() - frameStartTime;
 }
 
+void markRectDirty(int32_t x, int32_t y, int32_t w, int32_t h)
+{
+	// clip to screen (sprites can be partially or fully outside of it)
+	if (x < 0)
+	{
+		w += x; // subtraction
+		x = 0;
+	}
+
+	if (y < 0)
+	{
+		h += y; // subtraction
+		y = 0;
+	}
+
+	if (x+w > SCREEN_W) w = SCREEN_W - x;
+	if (y+h > SCREEN_H) h = SCREEN_H - y;
+
+	if (w <= 0 || h <= 0)
+		return;
+
+	const int16_t x1 = (int16_t)x;
+	const int16_t x2 = (int16_t)(x + w);
+
+	int16_t *rowX1 = &dirtyRowX1[y];
+	int16_t *rowX2 = &dirtyRowX2[y];
+	for (int32_t i = 0; i < h; i++)
+	{
+		if (x1 < rowX1[i]) rowX1[i] = x1;
+		if (x2 > rowX2[i]) rowX2[i] = x2;
+	}
+
+	screenIsDirty = true;
+}
+
+void markScreenDirty(void)
+{
+	for (int32_t i = 0; i < SCREEN_H; i++)
+	{
+		dirtyRowX1[i] = 0;
+		dirtyRowX2[i] = SCREEN_W;
+	}
+
+	screenIsDirty = true;
+}
+
+static void uploadDirtyRegions(void)
+{
+	/* Merge runs of consecutive dirty scanlines into bands, and only upload those
+	** to the GPU texture. The playback timer, scopes and a few changed buttons
+	** usually end up as a handful of small rectangles instead of a full frame.
+	*/
+	int32_t y = 0;
+	while (y < SCREEN_H)
+	{
+		if (dirtyRowX1[y] >= dirtyRowX2[y])
+		{
+			y++;
+			continue;
+		}
+
+		const int32_t y1 = y;
+		int32_t x1 = dirtyRowX1[y];
+		int32_t x2 = dirtyRowX2[y];
+
+		for (; y < SCREEN_H && dirtyRowX1[y] < dirtyRowX2[y]; y++)
+		{
+			if (dirtyRowX1[y] < x1) x1 = dirtyRowX1[y];
+			if (dirtyRowX2[y] > x2) x2 = dirtyRowX2[y];
+
+			dirtyRowX1[y] = SCREEN_W;
+			dirtyRowX2[y] = 0;
+		}
+
+		SDL_Rect dstRect;
+		dstRect.x = x1;
+		dstRect.y = y1;
+		dstRect.w = x2 - x1;
+		dstRect.h = y - y1;
+
+		SDL_UpdateTexture(video.texture, &dstRect, &video.frameBuffer[(y1 * SCREEN_W) + x1], SCREEN_W * sizeof (int32_t));
+	}
+
+	screenIsDirty = false;
+}
+
+static bool programIsIdle(void)
+{
+	/* Nothing can change on screen without user input (or another thread setting
+	** a flag, which is handled after IDLE_WAIT_TIMEOUT_MS at the latest).
+	*/
+	if (songPlaying || editor.busy || editor.samplingAudioFlag || editor.editTextFlag || video.showFPSCounter)
+		return false;
+
+	if (ui.aboutScreenShown || (ui.nibblesShown && editor.NI_Play))
+		return false;
+
+	if (mouse.leftButtonPressed || mouse.rightButtonPressed) // GUI objects are repeated while held down
+		return false;
+
+	if (anyScopeIsActive()) // also covers jamming notes and sample previews
+		return false;
+
+	if (samplePeaksPending()) // built in time slices from the main loop
+		return false;
+
+	if (sampleSpectrogramPending()) // columns are drawn as the spectrogram thread finishes them
+		return false;
+
+	return true;
+}
+
+void wakeUpFromIdle(void) // thread-safe
+{
+	if (!SDL_AtomicCAS(&wakeUpPending, 0, 1))
+		return; // one event in the queue is enough
+
+	SDL_Event event;
+	memset(&event, 0, sizeof (event));
+	event.type = SDL_USEREVENT;
+	SDL_PushEvent(&event);
+}
+
 void flipFrame(void)
 {
 	const uint32_t windowFlags = SDL_GetWindowFlags(video.window);
@@ -195,26 +427,57 @@ void flipFrame(void)
 	if (video.showFPSCounter)
 		drawFPSCounter();
 
-	SDL_UpdateTexture(video.texture, NULL, video.frameBuffer, SCREEN_W * sizeof (int32_t));
+	// if nothing changed since the last frame, the GPU texture and the presented frame are still valid
+	const bool presentFrame = screenIsDirty;
+	if (presentFrame)
+	{
+		uploadDirtyRegions();
 
-	// SDL 2.0.14 bug on Windows (?): This function consumes ever-increasing memory if the program is minimized
-	if (!minimized)
-		SDL_RenderClear(video.renderer);
+		// SDL 2.0.14 bug on Windows (?): This function consumes ever-increasing memory if the program is minimized
+		if (!minimized)
+			SDL_RenderClear(video.renderer);
 
-	if (video.useCustomRenderRect)
-		SDL_RenderCopy(video.renderer, video.texture, NULL, &video.renderRect);
-	else
-		SDL_RenderCopy(video.renderer, video.texture, NULL, NULL);
+		if (video.useCustomRenderRect)
+			SDL_RenderCopy(video.renderer, video.texture, NULL, &video.renderRect);
+		else
+			SDL_RenderCopy(video.renderer, video.texture, NULL, NULL);
 
-	SDL_RenderPresent(video.renderer);
+		const uint64_t presentStart = SDL_GetPerformanceCounter();
+		SDL_RenderPresent(video.renderer);
+		updateFrameTiming(presentStart, SDL_GetPerformanceCounter());
+	}
+	else
+	{
+		syncTime = 0; // this frame's sync time was never shown, don't measure a later present from it
+	}
 
 	eraseSprites();
 
-	if (!video.vsync60HzPresent)
+	/* Wake-up events pushed from now on end the idle wait below. Any earlier
+	** one is either still in the event queue, or its input was already handled.
+	*/
+	SDL_AtomicSet(&wakeUpPending, 0);
+
+	if (!presentFrame && programIsIdle())
+	{
+		// block until we get input (or time out), instead of running the main loop at ~60Hz
+		SDL_WaitEventTimeout(NULL, IDLE_WAIT_TIMEOUT_MS);
+
+		hpc_ResetCounters(&video.vblankHpc);
+	}
+	else if (!video.vsync60HzPresent)
 	{
 		// we have no VSync, do crude thread sleeping to sync to ~60Hz
 		hpc_Wait(&video.vblankHpc);
 	}
+	else if (!presentFrame)
+	{
+		// we skipped SDL_RenderPresent(), so VSync can't block us this frame
+		if (lastFramePresented)
+			hpc_ResetCounters(&video.vblankHpc);
+
+		hpc_Wait(&video.vblankHpc);
+	}
 	else
 	{
 		/* We have VSync, but it can unexpectedly get inactive in certain scenarios.
@@ -238,14 +501,8 @@ void flipFrame(void)
 #endif
 	}
 
+	lastFramePresented = presentFrame;
 	editor.framesPassed++;
-
-	/* Reset audio/video sync timestamp every half an hour to prevent
-	** possible sync drifting after hours of playing a song without
-	** a single song stop (resets timestamp) in-between.
-	*/
-	if (editor.framesPassed >= VBLANK_HZ*60*30)
-		audio.resetSyncTickTimeFlag = true;
 }
 
 void showErrorMsgBox(const char *fmt, ...)
@@ -336,6 +593,8 @@ static void updateRenderSizeVars(void)
 	// "hardware mouse" calculations
 	video.mouseCursorUpscaleFactor = MIN(video.renderW / SCREEN_W, video.renderH / SCREEN_H);
 	createMouseCursors();
+
+	markScreenDirty();
 }
 
 void enterFullscreen(void)
@@ -425,6 +684,8 @@ bool setupSprites(void)
 
 void changeSpriteData(int32_t sprite, const uint8_t *data)
 {
+	markRectDirty(sprites[sprite].x, sprites[sprite].y, sprites[sprite].w, sprites[sprite].h);
+
 	sprites[sprite].data = data;
 	memset(sprites[sprite].refreshBuffer, 0, sprites[sprite].w * sprites[sprite].h * sizeof (int32_t));
 }
@@ -468,6 +729,19 @@ void hideSprite(int32_t sprite)
 	sprites[sprite].newX = SCREEN_W;
 }
 
+static void updateSpritePos(sprite_t *s)
+{
+	if (s->x == s->newX && s->y == s->newY)
+		return;
+
+	// the old position was restored by eraseSprites(), so both areas need to be uploaded
+	markRectDirty(s->x, s->y, s->w, s->h);
+	markRectDirty(s->newX, s->newY, s->w, s->h);
+
+	s->x = s->newX;
+	s->y = s->newY;
+}
+
 void eraseSprites(void)
 {
 	sprite_t *s = &sprites[SPRITE_NUM-1];
@@ -531,13 +805,27 @@ void renderSprites(void)
 		{
 			ASSERT(video.window != NULL);
 			const uint32_t windowFlags = SDL_GetWindowFlags(video.window);
-			if (!(windowFlags & SDL_WINDOW_INPUT_FOCUS))
+			const bool hasFocus = !!(windowFlags & SDL_WINDOW_INPUT_FOCUS);
+
+			if (hasFocus != lastTextCursorFocus)
+			{
+				lastTextCursorFocus = hasFocus;
+				markRectDirty(s->x, s->y, s->w, s->h);
+			}
+
+			if (!hasFocus)
 				continue;
 		}
 
+		// the text edit mouse pointer changes color depending on the content under it
+		if (i == SPRITE_MOUSE_POINTER && mouse.mouseOverTextBox != lastMouseOverTextBox)
+		{
+			lastMouseOverTextBox = mouse.mouseOverTextBox;
+			markRectDirty(s->x, s->y, s->w, s->h);
+		}
+
 		// set new sprite position
-		s->x = s->newX;
-		s->y = s->newY;
+		updateSpritePos(s);
 
 		if (s->x >= SCREEN_W || s->y >= SCREEN_H) // sprite is hidden, don't draw nor fill clear buffer
 			continue;
@@ -644,8 +932,7 @@ void renderLoopPins(void)
 	ASSERT(s->data != NULL && s->refreshBuffer != NULL);
 
 	// set new sprite position
-	s->x = s->newX;
-	s->y = s->newY;
+	updateSpritePos(s);
 
 	if (s->x < SCREEN_W) // loop pin shown?
 	{
@@ -700,14 +987,10 @@ void renderLoopPins(void)
 	ASSERT(s->data != NULL && s->refreshBuffer != NULL);
 
 	// set new sprite position
-	s->x = s->newX;
-	s->y = s->newY;
+	updateSpritePos(s);
 
 	if (s->x < SCREEN_W) // loop pin shown?
 	{
-		s->x = s->newX;
-		s->y = s->newY;
-
 		sw = s->w;
 		sh = s->h;
 		sx = s->x;
@@ -897,6 +1180,8 @@ bool recreateTexture(void)
 
 	// disable alpha blending as we store the palette number in the MSB (0xXX000000)
 	SDL_SetTextureBlendMode(video.texture, SDL_BLENDMODE_NONE);
+
+	markScreenDirty(); // new texture has undefined contents
 	return true;
 }
 
@@ -50,6 +50,10 @@ void resetFPSCounter(void);
 void beginFPSCounter(void);
 void endFPSCounter(void);
 void flipFrame(void);
+uint64_t getVisualsSyncTime(void);
+void markRectDirty(int32_t x, int32_t y, int32_t w, int32_t h);
+void markScreenDirty(void);
+void wakeUpFromIdle(void);
 void showErrorMsgBox(const char *fmt, ...);
 void updateWindowTitle(bool forceUpdate);
 void handleScopesFromChQueue(chSyncData_t *chSyncData, uint8_t *scopeUpdateStatus);
@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_module_loader.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_sysreqs.h"
@@ -83,68 +84,108 @@ static const uint8_t xmEfxTab[] = { 10, 16, 17, 25 }; // A, G, H, P
 static uint16_t trackList[256*32];
 static note_t *decodedTrack[MAX_TRACKS];
 
-static char *readString(FILE *f)
+static void freeDecodedTracks(void)
 {
-	uint16_t length;
-	fread(&length, 2, 1, f);
+	for (int32_t i = 0; i < MAX_TRACKS; i++)
+	{
+		if (decodedTrack[i] != NULL)
+		{
+			free(decodedTrack[i]);
+			decodedTrack[i] = NULL;
+		}
+	}
+}
+
+static char *readString(MEMFILE *f)
+{
+	uint16_t length = 0;
+	mread(&length, 2, 1, f);
 
 	char *out = (char *)malloc(length+1);
 	if (out == NULL)
 		return NULL;
 
-	fread(out, 1, length, f);
+	mread(out, 1, length, f);
 	out[length] = '\0';
 
 	return out;
 }
 
-bool detectBEM(FILE *f)
+bool detectBEM(MEMFILE *f)
 {
 	if (f == NULL) return false;
 
-	uint32_t oldPos = (uint32_t)ftell(f);
+	uint32_t oldPos = (uint32_t)mtell(f);
 
-	fseek(f, 0, SEEK_SET);
+	mseek(f, 0, SEEK_SET);
 	char ID[64];
 	memset(ID, 0, sizeof (ID));
-	fread(ID, 1, 4, f);
+	mread(ID, 1, 4, f);
 	if (memcmp(ID, "UN05", 4) != 0)
 		goto error;
 
-	fseek(f, 0x131, SEEK_SET);
-	if (feof(f))
+	mseek(f, 0x131, SEEK_SET);
+	if (meof(f))
 		goto error;
 
-	uint8_t flags = (uint8_t)fgetc(f);
+	uint8_t flags = (uint8_t)mgetc(f);
 	if ((flags & FLAG_XMPERIODS) == 0)
 		goto error;
 
-	fseek(f, 0x132, SEEK_SET);
-	if (feof(f))
+	mseek(f, 0x132, SEEK_SET);
+	if (meof(f))
 		goto error;
 
 	uint16_t strLength = 0;
-	fread(&strLength, 2, 1, f);
+	mread(&strLength, 2, 1, f);
 	if (strLength == 0 || strLength > 512)
 		goto error;
 
-	fseek(f, strLength+2, SEEK_CUR);
-	if (feof(f))
+	mseek(f, strLength+2, SEEK_CUR);
+	if (meof(f))
 		goto error;
 
-	fread(ID, 1, 64, f);
+	mread(ID, 1, 64, f);
 	if (memcmp(ID, "FastTracker v2.00", 17) != 0)
 		goto error;
 
-	fseek(f, oldPos, SEEK_SET);
+	mseek(f, oldPos, SEEK_SET);
 	return true;
 
 error:
-	fseek(f, oldPos, SEEK_SET);
+	mseek(f, oldPos, SEEK_SET);
 	return false;
 }
 
-bool loadBEM(FILE *f, uint32_t filesize)
+bool getBEMInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info) // only the song name, the instrument names are stored further in
+{
+	bemHdr_t header;
+
+	if (filesize < sizeof (header) || mread(&header, 1, sizeof (header), f) != sizeof (header))
+		return false;
+
+	if (header.numchn > 32)
+		return false;
+
+	char *songName = readString(f);
+	if (songName == NULL)
+		return false;
+
+	strcpy(info->format, "BEM");
+	setModuleInfoTitle(info, songName, (int32_t)strlen(songName));
+	info->numChannels = header.numchn;
+	info->numInstrs = header.numins;
+	info->songLength = header.numpos;
+	info->numPatterns = header.numpat;
+
+	if (header.numpos > 256 || header.numpat > 256 || header.numtrk > MAX_TRACKS || header.numins > MAX_INST)
+		info->warnings |= MODINFO_WARN_CORRUPT;
+
+	free(songName);
+	return true;
+}
+
+bool loadBEM(MEMFILE *f, uint32_t filesize)
 {
 	bemHdr_t header;
 
@@ -154,21 +195,22 @@ bool loadBEM(FILE *f, uint32_t filesize)
 		return false;
 	}
 
-	fread(&header, 1, sizeof (header), f);
+	mread(&header, 1, sizeof (header), f);
 
 	char *songName = readString(f);
 	if (songName == NULL)
 		return false;
 
-	strcpy(songTmp.name, songName);
+	strncpy(songTmp.name, songName, 20);
 	free(songName);
 	uint16_t strLength;
-	fread(&strLength, 2, 1, f);
-	fseek(f, strLength, SEEK_CUR);
-	fread(&strLength, 2, 1, f);
-	fseek(f, strLength, SEEK_CUR);
+	mread(&strLength, 2, 1, f);
+	mseek(f, strLength, SEEK_CUR);
+	mread(&strLength, 2, 1, f);
+	mseek(f, strLength, SEEK_CUR);
 
-	if (header.numpos > 256 || header.numpat > 256 || header.numchn > 32 || header.numtrk > MAX_TRACKS)
+	if (header.numpos > 256 || header.numpat > 256 || header.numchn > 32 || header.numtrk > MAX_TRACKS ||
+		header.numins > MAX_INST)
 	{
 		loaderMsgBox("Error loading BEM: The module is corrupt!");
 		return false;
@@ -194,28 +236,34 @@ bool loadBEM(FILE *f, uint32_t filesize)
 		}
 		instr_t *ins = instrTmp[1 + i];
 
-		ins->numSamples = (uint8_t)fgetc(f);
-		fread(ins->note2SampleLUT, 1, 96, f);
-
-		ins->volEnvFlags = (uint8_t)fgetc(f);
-		ins->volEnvLength = (uint8_t)fgetc(f);
-		ins->volEnvSustain = (uint8_t)fgetc(f);
-		ins->volEnvLoopStart = (uint8_t)fgetc(f);
-		ins->volEnvLoopEnd = (uint8_t)fgetc(f);
-		fread(ins->volEnvPoints, 2, 12*2, f);
-
-		ins->panEnvFlags = (uint8_t)fgetc(f);
-		ins->panEnvLength = (uint8_t)fgetc(f);
-		ins->panEnvSustain = (uint8_t)fgetc(f);
-		ins->panEnvLoopStart = (uint8_t)fgetc(f);
-		ins->panEnvLoopEnd = (uint8_t)fgetc(f);
-		fread(ins->panEnvPoints, 2, 12*2, f);
-
-		ins->autoVibType = (uint8_t)fgetc(f);
-		ins->autoVibSweep = (uint8_t)fgetc(f);
-		ins->autoVibDepth = (uint8_t)fgetc(f);
-		ins->autoVibRate = (uint8_t)fgetc(f);
-		fread(&ins->fadeout, 2, 1, f);
+		ins->numSamples = (uint8_t)mgetc(f);
+		if (ins->numSamples > MAX_SMP_PER_INST)
+		{
+			loaderMsgBox("Error loading BEM: The module is corrupt!");
+			return false;
+		}
+
+		mread(ins->note2SampleLUT, 1, 96, f);
+
+		ins->volEnvFlags = (uint8_t)mgetc(f);
+		ins->volEnvLength = (uint8_t)mgetc(f);
+		ins->volEnvSustain = (uint8_t)mgetc(f);
+		ins->volEnvLoopStart = (uint8_t)mgetc(f);
+		ins->volEnvLoopEnd = (uint8_t)mgetc(f);
+		mread(ins->volEnvPoints, 2, 12*2, f);
+
+		ins->panEnvFlags = (uint8_t)mgetc(f);
+		ins->panEnvLength = (uint8_t)mgetc(f);
+		ins->panEnvSustain = (uint8_t)mgetc(f);
+		ins->panEnvLoopStart = (uint8_t)mgetc(f);
+		ins->panEnvLoopEnd = (uint8_t)mgetc(f);
+		mread(ins->panEnvPoints, 2, 12*2, f);
+
+		ins->autoVibType = (uint8_t)mgetc(f);
+		ins->autoVibSweep = (uint8_t)mgetc(f);
+		ins->autoVibDepth = (uint8_t)mgetc(f);
+		ins->autoVibRate = (uint8_t)mgetc(f);
+		mread(&ins->fadeout, 2, 1, f);
 
 		char *insName = readString(f);
 		if (insName == NULL)
@@ -231,19 +279,25 @@ bool loadBEM(FILE *f, uint32_t filesize)
 		sample_t *s = ins->smp;
 		for (int32_t j = 0; j < ins->numSamples; j++, s++)
 		{
-			s->finetune = (int8_t)fgetc(f) ^ 0x80;
-			fseek(f, 1, SEEK_CUR);
-			s->relativeNote = (int8_t)fgetc(f);
-			s->volume = (uint8_t)fgetc(f);
-			s->panning = (uint8_t)fgetc(f);
-			fread(&s->length, 4, 1, f);
-			fread(&s->loopStart, 4, 1, f);
+			s->finetune = (int8_t)mgetc(f) ^ 0x80;
+			mseek(f, 1, SEEK_CUR);
+			s->relativeNote = (int8_t)mgetc(f);
+			s->volume = (uint8_t)mgetc(f);
+			s->panning = (uint8_t)mgetc(f);
+			mread(&s->length, 4, 1, f);
+			if (s->length < 0 || s->length > MAX_SAMPLE_LEN)
+			{
+				loaderMsgBox("Error loading BEM: The module is corrupt!");
+				return false;
+			}
+
+			mread(&s->loopStart, 4, 1, f);
 			uint32_t loopEnd;
-			fread(&loopEnd, 4, 1, f);
+			mread(&loopEnd, 4, 1, f);
 			s->loopLength = loopEnd - s->loopStart;
 
 			uint16_t flags;
-			fread(&flags, 2, 1, f);
+			mread(&flags, 2, 1, f);
 			if (flags &  1) s->flags |= SAMPLE_16BIT;
 			if (flags & 16) s->flags |= LOOP_FORWARD;
 			if (flags & 32) s->flags |= LOOP_PINGPONG;
@@ -265,24 +319,21 @@ bool loadBEM(FILE *f, uint32_t filesize)
 
 	uint16_t rowsInPattern[256];
 	
-	fread(rowsInPattern, 2, header.numpat, f);
-	fread(trackList, 2, header.numpat * header.numchn, f);
+	mread(rowsInPattern, 2, header.numpat, f);
+	mread(trackList, 2, header.numpat * header.numchn, f);
 	
 	for (int32_t i = 0; i < header.numtrk; i++)
 	{
 		uint16_t trackBytesInFile;
-		fread(&trackBytesInFile, 2, 1, f);
+		mread(&trackBytesInFile, 2, 1, f);
 		if (trackBytesInFile == 0)
 		{
 			loaderMsgBox("Error loading BEM: This module is corrupt!");
-trackError:
-			for (int32_t j = 0; j < i; j++)
-				free(decodedTrack[j]);
-
-			return false;
+			goto trackError;
 		}
 
-		decodedTrack[i] = (note_t *)calloc(rowsInPattern[i], sizeof (note_t));
+		// (the track length is only known when decoding, so make room for the longest possible pattern)
+		decodedTrack[i] = (note_t *)calloc(MAX_PATT_LEN, sizeof (note_t));
 		if (decodedTrack[i] == NULL)
 		{
 			loaderMsgBox("Not enough memory!");
@@ -290,49 +341,50 @@ trackError:
 		}
 
 		note_t *out = decodedTrack[i];
+		note_t *outEnd = &decodedTrack[i][MAX_PATT_LEN];
 
 		// decode track
 
-		uint32_t trackPosInFile = (uint32_t)ftell(f);
-		while ((uint32_t)ftell(f) < trackPosInFile+trackBytesInFile)
+		uint32_t trackPosInFile = (uint32_t)mtell(f);
+		while ((uint32_t)mtell(f) < trackPosInFile+trackBytesInFile)
 		{
-			uint8_t byte = (uint8_t)fgetc(f);
+			uint8_t byte = (uint8_t)mgetc(f);
 			if (byte == 0)
 				break; // end of track
 
 			uint8_t repeat = byte >> 5;
 			uint8_t opcodeBytes = (byte & 0x1F) - 1;
 
-			uint32_t opcodeStart = (uint32_t)ftell(f);
+			uint32_t opcodeStart = (uint32_t)mtell(f);
 			uint32_t opcodeEnd = opcodeStart + opcodeBytes;
 
-			for (int32_t j = 0; j <= repeat; j++, out++)
+			for (int32_t j = 0; j <= repeat && out < outEnd; j++, out++)
 			{
-				fseek(f, opcodeStart, SEEK_SET);
-				while ((uint32_t)ftell(f) < opcodeEnd)
+				mseek(f, opcodeStart, SEEK_SET);
+				while ((uint32_t)mtell(f) < opcodeEnd)
 				{
-					uint8_t opcode = (uint8_t)fgetc(f);
+					uint8_t opcode = (uint8_t)mgetc(f);
 
 					if (opcode == 0)
 						break;
 
 					if (opcode == UNI_NOTE)
 					{
-						out->note = 1 + (uint8_t)fgetc(f);
+						out->note = 1 + (uint8_t)mgetc(f);
 					}
 					else if (opcode == UNI_INSTRUMENT)
 					{
-						out->instr = 1 + (uint8_t)fgetc(f);
+						out->instr = 1 + (uint8_t)mgetc(f);
 					}
 					else if (opcode >= UNI_PTEFFECT0 && opcode <= UNI_PTEFFECTF) // PT effects
 					{
 						out->efx = opcode - UNI_PTEFFECT0;
-						out->efxData = (uint8_t)fgetc(f);
+						out->efxData = (uint8_t)mgetc(f);
 					}
 					else if (opcode >= UNI_XMEFFECTA && opcode <= UNI_XMEFFECTP) // XM effects
 					{
 						out->efx = xmEfxTab[opcode-UNI_XMEFFECTA];
-						out->efxData = (uint8_t)fgetc(f);
+						out->efxData = (uint8_t)mgetc(f);
 					}
 					else
 					{
@@ -344,7 +396,7 @@ trackError:
 
 						// unsupported opcode, skip it
 						if (opcode > 0)
-							fseek(f, 1, SEEK_CUR);
+							mseek(f, 1, SEEK_CUR);
 					}
 				}
 			}
@@ -361,13 +413,17 @@ trackError:
 		if (!allocateTmpPatt(i, numRows))
 		{
 			loaderMsgBox("Not enough memory!");
-			return false;
+			goto trackError;
 		}
 
 		note_t *dst = patternTmp[i];
 		for (int32_t ch = 0; ch < header.numchn; ch++)
 		{
-			note_t *src = (note_t *)decodedTrack[trackList[(i * header.numchn) + ch]];
+			const uint16_t trackNum = trackList[(i * header.numchn) + ch];
+			if (trackNum >= header.numtrk)
+				continue;
+
+			note_t *src = decodedTrack[trackNum];
 			if (src != NULL)
 			{
 				for (int32_t row = 0; row < numRows; row++)
@@ -376,6 +432,8 @@ trackError:
 		}
 	}
 
+	freeDecodedTracks();
+
 	// samples
 
 	for (int32_t i = 0; i < header.numins; i++)
@@ -395,13 +453,17 @@ trackError:
 			}
 
 			if (sampleIs16Bit)
-				fread(s->dataPtr, 2, s->length, f);
+				mread(s->dataPtr, 2, s->length, f);
 			else
-				fread(s->dataPtr, 1, s->length, f);
+				mread(s->dataPtr, 1, s->length, f);
 
 			delta2Samp(s->dataPtr, s->length, s->flags);
 		}
 	}
 
 	return true;
+
+trackError:
+	freeDecodedTracks();
+	return false;
 }
@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_module_loader.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_tables.h"
@@ -64,7 +65,44 @@ static void convertPatternEffect(note_t *p)
 	}
 }
 
-bool loadDIGI(FILE *f, uint32_t filesize)
+bool getDIGIInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info)
+{
+	digiHdr_t header;
+
+	if (filesize < sizeof (header) || mread(&header, 1, sizeof (header), f) != sizeof (header))
+		return false;
+
+	if (header.numChannels < 1 || header.numChannels > 8)
+		return false;
+
+	strcpy(info->format, "DIGI");
+	setModuleInfoTitle(info, header.name, 32);
+	info->numChannels = header.numChannels;
+	info->numInstrs = 31;
+	info->songLength = (uint8_t)(header.numOrders + 1); // (like in the loader, 255 wraps to 0)
+	info->numPatterns = (uint8_t)(header.numPatterns + 1);
+
+	if (info->songLength < 1 || info->songLength > 128)
+		info->warnings |= MODINFO_WARN_CORRUPT;
+
+	for (int32_t i = 0; i < 31; i++)
+	{
+		addModuleInfoName(info, header.smpName[i], 30);
+		const uint32_t length = MIN(SWAP32(header.smpLength[i]), MAX_SAMPLE_LEN);
+		info->sampleDataBytes = (uint32_t)MIN((uint64_t)info->sampleDataBytes + length, UINT32_MAX);
+	}
+
+	// (the size of packed patterns is only known when reading them)
+	const uint64_t minSize = sizeof (header) + (uint64_t)info->sampleDataBytes +
+		(header.packedPatternsFlag ? 0 : (info->numPatterns * 64 * 4 * header.numChannels));
+
+	if (minSize > filesize)
+		info->warnings |= MODINFO_WARN_TRUNCATED;
+
+	return true;
+}
+
+bool loadDIGI(MEMFILE *f, uint32_t filesize)
 {
 	sample_t *s;
 	digiHdr_t header;
@@ -78,7 +116,7 @@ bool loadDIGI(FILE *f, uint32_t filesize)
 	}
 
 	memset(&header, 0, sizeof (header));
-	if (fread(&header, 1, sizeof (header), f) != sizeof (header))
+	if (mread(&header, 1, sizeof (header), f) != sizeof (header))
 	{
 		loaderMsgBox("Error: This file is either not a module, or is not supported.");
 		return false;
@@ -121,14 +159,14 @@ bool loadDIGI(FILE *f, uint32_t filesize)
 			// compressed pattern
 
 			uint16_t pattSize;
-			fread(&pattSize, 2, 1, f); pattSize = SWAP16(pattSize);
+			mread(&pattSize, 2, 1, f); pattSize = SWAP16(pattSize);
 
 			if (pattSize >= 64)
 			{
 				uint8_t bitMasks[64];
-				fread(bitMasks, 1, 64, f);
+				mread(bitMasks, 1, 64, f);
 
-				fread(tmpBuffer, 1, pattSize-64, f);
+				mread(tmpBuffer, 1, pattSize-64, f);
 				uint8_t *pattPtr = tmpBuffer;
 
 				for (int32_t row = 0; row < 64; row++)
@@ -165,7 +203,7 @@ bool loadDIGI(FILE *f, uint32_t filesize)
 		{
 			// uncompressed pattern
 
-			fread(tmpBuffer, 1, 64 * songTmp.numChannels * 4, f);
+			mread(tmpBuffer, 1, 64 * songTmp.numChannels * 4, f);
 			uint8_t *pattPtr = tmpBuffer;
 
 			for (int32_t ch = 0; ch < songTmp.numChannels; ch++)
@@ -212,7 +250,7 @@ bool loadDIGI(FILE *f, uint32_t filesize)
 
 		memcpy(s->name, header.smpName[i], 22);
 
-		s->length = SWAP32(header.smpLength[i]);
+		s->length = MIN(SWAP32(header.smpLength[i]), MAX_SAMPLE_LEN);
 		s->finetune = FINETUNE_MOD2XM(header.smpFinetune[i]);
 		s->volume = header.smpVolume[i];
 		s->loopStart = SWAP32(header.smpLoopStart[i]);
@@ -251,7 +289,7 @@ bool loadDIGI(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		int32_t bytesRead = (int32_t)fread(s->dataPtr, 1, s->length, f);
+		int32_t bytesRead = (int32_t)mread(s->dataPtr, 1, s->length, f);
 		if (bytesRead < s->length)
 		{
 			int32_t bytesToClear = s->length - bytesRead;
@@ -10,11 +10,14 @@
 */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_module_loader.h"
 #include "../ft2_sample_ed.h"
+#include "../ft2_sample_pack.h"
 #include "../ft2_sysreqs.h"
 
 #ifdef _MSC_VER
@@ -116,12 +119,118 @@ static uint8_t volPortaConv[9] = { 1, 4, 8, 16, 32, 64, 96, 128, 255 };
 static uint32_t insOffs[256], smpOffs[256], patOffs[256];
 static itSmpHdr_t *srcSmp, smpHdrs[256];
 
-static bool loadCompressed16BitSample(FILE *f, sample_t *s, bool deltaEncoded);
-static bool loadCompressed8BitSample(FILE *f, sample_t *s, bool deltaEncoded);
+static void decodeCompressedSample(sampleDecode_t *d, uint8_t *scratch);
 static void setAutoVibrato(instr_t *ins, itSmpHdr_t *is);
-static bool loadSample(FILE *f, sample_t *s, itSmpHdr_t *is);
+static bool loadSample(MEMFILE *f, sample_t *s, itSmpHdr_t *is);
 
-bool loadIT(FILE *f, uint32_t filesize)
+bool getITInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info)
+{
+	char name[26];
+	uint32_t offsets[256];
+	itHdr_t header;
+
+	if (filesize < sizeof (header) || mread(&header, 1, sizeof (header), f) != sizeof (header))
+		return false;
+
+	if (header.ordNum > 257 || header.insNum > 256 || header.smpNum > 256 || header.patNum > 256)
+		return false;
+
+	const bool songUsesInstruments = !!(header.flags & 4);
+
+	strcpy(info->format, "IT");
+	setModuleInfoTitle(info, header.songName, 26);
+	info->numInstrs = songUsesInstruments ? header.insNum : header.smpNum;
+	info->numPatterns = header.patNum;
+
+	if (info->numInstrs > MAX_INST)
+	{
+		info->numInstrs = MAX_INST;
+		info->warnings |= MODINFO_WARN_INSTRS;
+	}
+
+	// enabled channels (the loader uses the highest channel found in the pattern data instead)
+	for (int32_t i = 0; i < 64; i++)
+	{
+		if (header.initialPans[i] < 128)
+			info->numChannels++;
+	}
+
+	if (info->numChannels > MAX_CHANNELS)
+		info->warnings |= MODINFO_WARN_CHANNELS;
+
+	// order list (like in the loader, the separators are skipped)
+	for (int32_t i = 0; i < header.ordNum; i++)
+	{
+		const int32_t patt = mgetc(f);
+		if (patt == EOF)
+		{
+			info->warnings |= MODINFO_WARN_TRUNCATED;
+			return true;
+		}
+
+		if (patt == 255)
+			break;
+
+		if (patt != 254 && info->songLength < MAX_ORDERS-1)
+			info->songLength++;
+	}
+
+	// sample data sizes
+	mseek(f, sizeof (header) + header.ordNum + (header.insNum * 4), SEEK_SET);
+	if (mread(offsets, 4, header.smpNum, f) != header.smpNum)
+	{
+		info->warnings |= MODINFO_WARN_TRUNCATED;
+		return true;
+	}
+
+	for (int32_t i = 0; i < header.smpNum; i++)
+	{
+		itSmpHdr_t smpHdr;
+
+		mseek(f, offsets[i], SEEK_SET);
+		if (mread(&smpHdr, 1, sizeof (smpHdr), f) != sizeof (smpHdr))
+		{
+			info->warnings |= MODINFO_WARN_TRUNCATED;
+			continue;
+		}
+
+		if ((int32_t)smpHdr.length <= 0 || smpHdr.offsetInFile == 0)
+			continue; // empty sample
+
+		const uint32_t bytesPerSample = (smpHdr.flags & 2) ? 2 : 1;
+		const uint64_t length = MIN(smpHdr.length, MAX_SAMPLE_LEN) * bytesPerSample;
+
+		// (the size of compressed sample data is only known when unpacking)
+		if (smpHdr.offsetInFile >= filesize || (!(smpHdr.flags & 8) && smpHdr.offsetInFile+length > filesize))
+			info->warnings |= MODINFO_WARN_TRUNCATED;
+
+		info->sampleDataBytes = (uint32_t)MIN(info->sampleDataBytes + length, UINT32_MAX);
+	}
+
+	// the instrument pointers are followed by the sample pointers
+	uint32_t offsetsPos = sizeof (header) + header.ordNum;
+	if (!songUsesInstruments)
+		offsetsPos += header.insNum * 4;
+
+	mseek(f, offsetsPos, SEEK_SET);
+	if (mread(offsets, 4, info->numInstrs, f) != info->numInstrs)
+		return true; // the song info is still OK
+
+	// the name is at the same offset in all instrument header versions, and in the sample header
+	const uint32_t nameOffset = songUsesInstruments ? offsetof(itInsHdr_t, instrumentName) : offsetof(itSmpHdr_t, sampleName);
+	for (int32_t i = 0; i < info->numInstrs; i++)
+	{
+		mseek(f, offsets[i] + nameOffset, SEEK_SET);
+		if (mread(name, 1, sizeof (name), f) != sizeof (name))
+			break;
+
+		addModuleInfoName(info, name, 26);
+	}
+
+	return true;
+}
+
+bool loadIT(MEMFILE *f, uint32_t filesize)
 {
 	itHdr_t header;
 
@@ -131,7 +240,7 @@ bool loadIT(FILE *f, uint32_t filesize)
 		goto error;
 	}
 
-	fread(&header, sizeof (header), 1, f);
+	mread(&header, sizeof (header), 1, f);
 
 	if (header.ordNum > 257 || header.insNum > 256 || header.smpNum > 256 || header.patNum > 256)
 	{
@@ -156,7 +265,7 @@ bool loadIT(FILE *f, uint32_t filesize)
 	// read order list
 	for (int32_t i = 0; i < MAX_ORDERS; i++)
 	{
-		const uint8_t patt = (uint8_t)fgetc(f);
+		const uint8_t patt = (uint8_t)mgetc(f);
 		if (patt == 254) // separator ("+++"), skip it
 			continue;
 
@@ -171,15 +280,15 @@ bool loadIT(FILE *f, uint32_t filesize)
 	}
 
 	// read file pointers
-	fseek(f, sizeof (header) + header.ordNum, SEEK_SET);
-	fread(insOffs, 4, header.insNum, f);
-	fread(smpOffs, 4, header.smpNum, f);
-	fread(patOffs, 4, header.patNum, f);
+	mseek(f, sizeof (header) + header.ordNum, SEEK_SET);
+	mread(insOffs, 4, header.insNum, f);
+	mread(smpOffs, 4, header.smpNum, f);
+	mread(patOffs, 4, header.patNum, f);
 
 	for (int32_t i = 0; i < header.smpNum; i++)
 	{
-		fseek(f, smpOffs[i], SEEK_SET);
-		fread(&smpHdrs[i], sizeof (itSmpHdr_t), 1, f);
+		mseek(f, smpOffs[i], SEEK_SET);
+		mread(&smpHdrs[i], sizeof (itSmpHdr_t), 1, f);
 	}
 
 	if (!songUsesInstruments) // read samples (as instruments)
@@ -221,8 +330,8 @@ bool loadIT(FILE *f, uint32_t filesize)
 		int32_t numIns = MIN(header.insNum, MAX_INST);
 		for (int16_t i = 0; i < numIns; i++)
 		{
-			fseek(f, insOffs[i], SEEK_SET);
-			fread(&itIns, sizeof (itIns), 1, f);
+			mseek(f, insOffs[i], SEEK_SET);
+			mread(&itIns, sizeof (itIns), 1, f);
 
 			if (!allocateTmpInstr(1 + i))
 			{
@@ -362,8 +471,8 @@ bool loadIT(FILE *f, uint32_t filesize)
 		int32_t numIns = MIN(header.insNum, MAX_INST);
 		for (int16_t i = 0; i < numIns; i++)
 		{
-			fseek(f, insOffs[i], SEEK_SET);
-			fread(&itIns, sizeof (itIns), 1, f);
+			mseek(f, insOffs[i], SEEK_SET);
+			mread(&itIns, sizeof (itIns), 1, f);
 
 			if (!allocateTmpInstr(1 + i))
 			{
@@ -540,12 +649,12 @@ bool loadIT(FILE *f, uint32_t filesize)
 		if (patOffs[i] == 0)
 			continue;
 	
-		fseek(f, patOffs[i], SEEK_SET);
+		mseek(f, patOffs[i], SEEK_SET);
 
 		uint16_t length, numRows;
-		fread(&length, 2, 1, f);
-		fread(&numRows, 2, 1, f);
-		fseek(f, 4, SEEK_CUR);
+		mread(&length, 2, 1, f);
+		mread(&numRows, 2, 1, f);
+		mseek(f, 4, SEEK_CUR);
 
 		numRows = MIN(numRows, MAX_PATT_LEN);
 		if (numRows == 0)
@@ -564,7 +673,7 @@ bool loadIT(FILE *f, uint32_t filesize)
 		note_t lastNote[64];
 		memset(lastNote, 0, sizeof (lastNote));
 
-		fread(tmpBuffer, 1, length, f);
+		mread(tmpBuffer, 1, length, f);
 		uint8_t *pattPtr = tmpBuffer;
 
 		int32_t bytesRead = 0;
@@ -1207,254 +1316,10 @@ error:
 	return false;
 }
 
-static void decompress16BitData(int16_t *dst, const uint8_t *src, uint32_t blockLength)
-{
-	uint8_t byte8, bitDepth, bitDepthInv, bitsRead;
-	uint16_t bytes16, lastVal;
-	uint32_t bytes32;
-
-	lastVal = 0;
-	bitDepth = 17;
-	bitDepthInv = bitsRead = 0;
-
-	blockLength >>= 1;
-	while (blockLength != 0)
-	{
-		bytes32 = (*(uint32_t *)src) >> bitsRead;
-
-		bitsRead += bitDepth;
-		src += bitsRead >> 3;
-		bitsRead &= 7;
-
-		if (bitDepth <= 6)
-		{
-			bytes32 <<= bitDepthInv & 0x1F;
-
-			bytes16 = (uint16_t)bytes32;
-			if (bytes16 != 0x8000)
-			{
-				lastVal += (int16_t)bytes16 >> (bitDepthInv & 0x1F); // arithmetic shift
-				*dst++ = lastVal;
-				blockLength--;
-			}
-			else
-			{
-				byte8 = ((bytes32 >> 16) & 0xF) + 1;
-				if (byte8 >= bitDepth)
-					byte8++;
-				bitDepth = byte8;
-
-				bitDepthInv = 16;
-				if (bitDepthInv < bitDepth)
-					bitDepthInv++;
-				bitDepthInv -= bitDepth;
-
-				bitsRead += 4;
-			}
-
-			continue;
-		}
-
-		bytes16 = (uint16_t)bytes32;
-
-		if (bitDepth <= 16)
-		{
-			uint16_t tmp16 = 0xFFFF >> (bitDepthInv & 0x1F);
-			bytes16 &= tmp16;
-			tmp16 = (tmp16 >> 1) - 8;
-
-			if (bytes16 > tmp16+16 || bytes16 <= tmp16)
-			{
-				bytes16 <<= bitDepthInv & 0x1F;
-				bytes16 = (int16_t)bytes16 >> (bitDepthInv & 0x1F); // arithmetic shift
-				lastVal += bytes16;
-				*dst++ = lastVal;
-				blockLength--;
-				continue;
-			}
-
-			byte8 = (uint8_t)(bytes16 - tmp16);
-			if (byte8 >= bitDepth)
-				byte8++;
-			bitDepth = byte8;
-
-			bitDepthInv = 16;
-			if (bitDepthInv < bitDepth)
-				bitDepthInv++;
-			bitDepthInv -= bitDepth;
-			continue;
-		}
-
-		if (bytes32 & 0x10000)
-		{
-			bitDepth = (uint8_t)(bytes16 + 1);
-			bitDepthInv = 16 - bitDepth;
-		}
-		else
-		{
-			lastVal += bytes16;
-			*dst++ = lastVal;
-			blockLength--;
-		}
-	}
-}
-
-static void decompress8BitData(int8_t *dst, const uint8_t *src, uint32_t blockLength)
-{
-	uint8_t lastVal, byte8, bitDepth, bitDepthInv, bitsRead;
-	uint16_t bytes16;
-
-	lastVal = 0;
-	bitDepth = 9;
-	bitDepthInv = bitsRead = 0;
-
-	while (blockLength != 0)
-	{
-		bytes16 = (*(uint16_t *)src) >> bitsRead;
-
-		bitsRead += bitDepth;
-		src += (bitsRead >> 3);
-		bitsRead &= 7;
-
-		byte8 = bytes16 & 0xFF;
-
-		if (bitDepth <= 6)
-		{
-			bytes16 <<= (bitDepthInv & 0x1F);
-			byte8 = bytes16 & 0xFF;
-
-			if (byte8 != 0x80)
-			{
-				lastVal += (int8_t)byte8 >> (bitDepthInv & 0x1F); // arithmetic shift
-				*dst++ = lastVal;
-				blockLength--;
-				continue;
-			}
-
-			byte8 = (bytes16 >> 8) & 7;
-			bitsRead += 3;
-			src += (bitsRead >> 3);
-			bitsRead &= 7;
-		}
-		else
-		{
-			if (bitDepth == 8)
-			{
-				if (byte8 < 0x7C || byte8 > 0x83)
-				{
-					lastVal += byte8;
-					*dst++ = lastVal;
-					blockLength--;
-					continue;
-				}
-				byte8 -= 0x7C;
-			}
-			else if (bitDepth < 8)
-			{
-				byte8 <<= 1;
-				if (byte8 < 0x78 || byte8 > 0x86)
-				{
-					lastVal += (int8_t)byte8 >> (bitDepthInv & 0x1F); // arithmetic shift
-					*dst++ = lastVal;
-					blockLength--;
-					continue;
-				}
-				byte8 = (byte8 >> 1) - 0x3C;
-			}
-			else
-			{
-				bytes16 &= 0x1FF;
-				if ((bytes16 & 0x100) == 0)
-				{
-					lastVal += byte8;
-					*dst++ = lastVal;
-					blockLength--;
-					continue;
-				}
-			}
-		}
-
-		byte8++;
-		if (byte8 >= bitDepth)
-			byte8++;
-		bitDepth = byte8;
-
-		bitDepthInv = 8;
-		if (bitDepthInv < bitDepth)
-			bitDepthInv++;
-		bitDepthInv -= bitDepth;
-	}
-}
-
-static bool loadCompressed16BitSample(FILE *f, sample_t *s, bool deltaEncoded)
-{
-	int8_t *dstPtr = (int8_t *)s->dataPtr;
-
-	uint32_t i = s->length * 2;
-	while (i > 0)
-	{
-		uint32_t bytesToUnpack = 32768;
-		if (bytesToUnpack > i)
-			bytesToUnpack = i;
-
-		uint16_t packedLen;
-		fread(&packedLen, sizeof (uint16_t), 1, f);
-		fread(tmpBuffer, 1, packedLen, f);
-
-		decompress16BitData((int16_t *)dstPtr, tmpBuffer, bytesToUnpack);
-
-		if (deltaEncoded) // convert from delta values to PCM
-		{
-			int16_t *ptr16 = (int16_t *)dstPtr;
-			int16_t lastSmp16 = 0; // yes, reset this every block!
-
-			const uint32_t length = bytesToUnpack >> 1;
-			for (uint32_t j = 0; j < length; j++)
-			{
-				lastSmp16 += ptr16[j];
-				ptr16[j] = lastSmp16;
-			}
-		}
-
-		dstPtr += bytesToUnpack;
-		i -= bytesToUnpack;
-	}
-
-	return true;
-}
-
-static bool loadCompressed8BitSample(FILE *f, sample_t *s, bool deltaEncoded)
+static void decodeCompressedSample(sampleDecode_t *d, uint8_t *scratch) // IT214/IT215
 {
-	int8_t *dstPtr = (int8_t *)s->dataPtr;
-
-	uint32_t i = s->length;
-	while (i > 0)
-	{
-		uint32_t bytesToUnpack = 32768;
-		if (bytesToUnpack > i)
-			bytesToUnpack = i;
-
-		uint16_t packedLen;
-		fread(&packedLen, sizeof (uint16_t), 1, f);
-		fread(tmpBuffer, 1, packedLen, f);
-
-		decompress8BitData(dstPtr, tmpBuffer, bytesToUnpack);
-
-		if (deltaEncoded) // convert from delta values to PCM
-		{
-			int8_t lastSmp8 = 0; // yes, reset this every block!
-			for (uint32_t j = 0; j < bytesToUnpack; j++)
-			{
-				lastSmp8 += dstPtr[j];
-				dstPtr[j] = lastSmp8;
-			}
-		}
-
-		dstPtr += bytesToUnpack;
-		i -= bytesToUnpack;
-	}
-
-	return true;
+	sample_t *s = d->s;
+	unpackITSampleData(s->dataPtr, SAMPLE_LENGTH_BYTES(s), !!(s->flags & SAMPLE_16BIT), !!(d->param & 1), d->src, d->srcLength, scratch);
 }
 
 static void setAutoVibrato(instr_t *ins, itSmpHdr_t *is)
@@ -1481,7 +1346,7 @@ static void setAutoVibrato(instr_t *ins, itSmpHdr_t *is)
 		ins->autoVibDepth = 15;
 }
 
-static bool loadSample(FILE *f, sample_t *s, itSmpHdr_t *is)
+static bool loadSample(MEMFILE *f, sample_t *s, itSmpHdr_t *is)
 {
 	bool sampleIs16Bit = !!(is->flags & 2);
 	bool compressed = !!(is->flags & 8);
@@ -1516,29 +1381,40 @@ static bool loadSample(FILE *f, sample_t *s, itSmpHdr_t *is)
 
 	setSampleC4Hz(s, is->c5Speed);
 
-	if (s->length <= 0 || is->offsetInFile == 0)
+	if (s->length <= 0 || is->offsetInFile == 0 || is->offsetInFile >= msize(f))
 		return true; // empty sample, skip data loading
 
+	if (s->length > MAX_SAMPLE_LEN)
+		s->length = MAX_SAMPLE_LEN;
+
+	if (!compressed) // don't allocate more than the file can hold (broken or malicious headers)
+	{
+		const uint32_t maxLength = (uint32_t)(msize(f) - is->offsetInFile) >> sampleIs16Bit;
+		if ((uint32_t)s->length > maxLength)
+			s->length = maxLength;
+
+		if (s->length == 0)
+			return true;
+	}
+
 	if (!allocateSmpData(s, s->length, sampleIs16Bit))
 		return false;
 
 	// begin sample loading
 
-	fseek(f, is->offsetInFile, SEEK_SET);
+	mseek(f, is->offsetInFile, SEEK_SET);
 
 	if (compressed)
 	{
-		if (sampleIs16Bit)
-			loadCompressed16BitSample(f, s, deltaEncoded);
-		else
-			loadCompressed8BitSample(f, s, deltaEncoded);
+		// (unpacked in parallel after loading, the packed size is only known when unpacking)
+		queueSampleDecode(f, decodeCompressedSample, s, UINT32_MAX, deltaEncoded);
 	}
 	else
 	{
 		if (sampleIs16Bit)
-			fread(s->dataPtr, 2, s->length, f);
+			mread(s->dataPtr, 2, s->length, f);
 		else
-			fread(s->dataPtr, 1, s->length, f);
+			mread(s->dataPtr, 1, s->length, f);
 
 		if (!signedSamples)
 		{
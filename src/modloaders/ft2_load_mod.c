@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_module_loader.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_tables.h"
@@ -93,7 +94,7 @@ static void convertPatternEffect(note_t *p, uint8_t modFormat)
 	}
 }
 
-bool loadMOD(FILE *f, uint32_t filesize)
+bool loadMOD(MEMFILE *f, uint32_t filesize)
 {
 	uint8_t numChannels;
 	sample_t *s;
@@ -109,7 +110,7 @@ bool loadMOD(FILE *f, uint32_t filesize)
 	}
 
 	memset(&header, 0, sizeof (header));
-	if (fread(&header, 1, sizeof (header), f) != sizeof (header))
+	if (mread(&header, 1, sizeof (header), f) != sizeof (header))
 	{
 		loaderMsgBox("Error: This file is either not a module, or is not supported.");
 		return false;
@@ -177,7 +178,7 @@ bool loadMOD(FILE *f, uint32_t filesize)
 				return false;
 			}
 
-			fread(tmpBuffer, 1, 64 * numChannels * 4, f);
+			mread(tmpBuffer, 1, 64 * numChannels * 4, f);
 			uint8_t *pattPtr = tmpBuffer;
 
 			for (int32_t row = 0; row < 64; row++)
@@ -226,7 +227,7 @@ bool loadMOD(FILE *f, uint32_t filesize)
 			int32_t pattNum = i >> 1;
 			int32_t chnOffset = (i & 1) * 4;
 
-			fread(tmpBuffer, 1, 64 * 4 * 4, f);
+			mread(tmpBuffer, 1, 64 * 4 * 4, f);
 			uint8_t *pattPtr = tmpBuffer;
 
 			for (int32_t row = 0; row < 64; row++)
@@ -314,7 +315,7 @@ bool loadMOD(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		int32_t bytesRead = (int32_t)fread(s->dataPtr, 1, s->length, f);
+		int32_t bytesRead = (int32_t)mread(s->dataPtr, 1, s->length, f);
 		if (bytesRead < s->length)
 		{
 			int32_t bytesToClear = s->length - bytesRead;
@@ -334,6 +335,49 @@ bool loadMOD(FILE *f, uint32_t filesize)
 	return true;
 }
 
+bool getMODInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info)
+{
+	uint8_t numChannels;
+	modHdr_t header;
+
+	if (filesize < sizeof (header) || mread(&header, 1, sizeof (header), f) != sizeof (header))
+		return false;
+
+	const uint8_t modType = getModType(&numChannels, header.ID);
+	if (modType == FORMAT_UNKNOWN || numChannels == 0)
+		return false;
+
+	strcpy(info->format, "MOD");
+	setModuleInfoTitle(info, header.name, 20);
+	info->numChannels = numChannels;
+	info->numInstrs = 31;
+	info->songLength = (modType == FORMAT_MK && header.numOrders == 129) ? 127 : header.numOrders; // see loadMOD()
+
+	if (info->songLength < 1 || info->songLength > 128)
+		info->warnings |= MODINFO_WARN_CORRUPT;
+
+	if (numChannels > MAX_CHANNELS)
+		info->warnings |= MODINFO_WARN_CHANNELS;
+
+	for (int32_t i = 0; i < 128; i++)
+	{
+		const uint8_t pattNum = (modType == FORMAT_FLT8) ? (header.orders[i] >> 1) : header.orders[i];
+		if (pattNum+1 > info->numPatterns)
+			info->numPatterns = pattNum+1;
+	}
+
+	for (int32_t i = 0; i < 31; i++)
+	{
+		addModuleInfoName(info, header.smp[i].name, 22);
+		info->sampleDataBytes += 2 * SWAP16(header.smp[i].length);
+	}
+
+	if (sizeof (header) + (info->numPatterns * 64 * 4 * numChannels) + info->sampleDataBytes > filesize)
+		info->warnings |= MODINFO_WARN_TRUNCATED;
+
+	return true;
+}
+
 static uint8_t getModType(uint8_t *numChannels, const char *id)
 {
 #define IS_ID(s, b) !strncmp(s, b, 4)
@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_module_loader.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_tables.h"
@@ -51,7 +52,107 @@ s3mHdr_t;
 #pragma pack(pop)
 #endif
 
-bool loadS3M(FILE *f, uint32_t filesize)
+bool getS3MInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info)
+{
+	uint8_t orders[MAX_ORDERS];
+	uint16_t sampleOffsets[256], patternOffsets[256];
+	s3mHdr_t header;
+	s3mSmpHdr_t smpHdr;
+
+	if (filesize < sizeof (header) || mread(&header, 1, sizeof (header), f) != sizeof (header))
+		return false;
+
+	if (header.numSamples < 0 || header.numSamples > 256 || header.numOrders < 0 || header.type != 16)
+		return false;
+
+	strcpy(info->format, "S3M");
+	setModuleInfoTitle(info, header.name, 28);
+	info->numInstrs = header.numSamples;
+	info->numPatterns = (uint16_t)MAX(header.numPatterns, 0);
+
+	if (header.numSamples > MAX_INST || header.numOrders == 0 || header.numOrders > MAX_ORDERS || header.numPatterns < 0 ||
+		header.numPatterns > MAX_PATTERNS || header.ffi < 1 || header.ffi > 2)
+	{
+		info->warnings |= MODINFO_WARN_CORRUPT;
+	}
+
+	// enabled channels (the loader uses the highest channel found in the pattern data instead)
+	for (int32_t i = 0; i < 32; i++)
+	{
+		if (header.chnSettings[i] < 16)
+			info->numChannels++;
+	}
+
+	const int32_t numOrders = MIN(header.numOrders, MAX_ORDERS);
+	const int32_t numPatterns = CLAMP(header.numPatterns, 0, MAX_PATTERNS);
+
+	// (the loader rejects the module if the order list or the offsets are cut off)
+	bool offsetsOK = mread(orders, 1, numOrders, f) == (size_t)numOrders;
+	mseek(f, sizeof (header) + header.numOrders, SEEK_SET);
+	offsetsOK &= mread(sampleOffsets, 2, header.numSamples, f) == (size_t)header.numSamples;
+	offsetsOK &= mread(patternOffsets, 2, numPatterns, f) == (size_t)numPatterns;
+
+	if (!offsetsOK)
+	{
+		info->warnings |= MODINFO_WARN_CORRUPT | MODINFO_WARN_TRUNCATED;
+		return true; // the song info is still OK
+	}
+
+	// song length, like in the loader (the separators are skipped, and the song ends at the first 255 after the first order)
+	for (int32_t i = 0; i < numOrders; i++)
+	{
+		if (orders[i] == 255 && info->songLength > 0)
+			break;
+
+		if (orders[i] != 254)
+			info->songLength++;
+	}
+
+	for (int32_t i = 0; i < numPatterns; i++)
+	{
+		if (patternOffsets[i] != 0 && (patternOffsets[i] << 4) + 2 > filesize)
+			info->warnings |= MODINFO_WARN_CORRUPT | MODINFO_WARN_TRUNCATED;
+	}
+
+	for (int32_t i = 0; i < header.numSamples; i++)
+	{
+		if (sampleOffsets[i] == 0)
+			continue;
+
+		mseek(f, sampleOffsets[i] << 4, SEEK_SET);
+		if (mread(&smpHdr, 1, sizeof (smpHdr), f) != sizeof (smpHdr))
+		{
+			info->warnings |= MODINFO_WARN_CORRUPT | MODINFO_WARN_TRUNCATED;
+			break;
+		}
+
+		addModuleInfoName(info, smpHdr.name, 28);
+
+		const uint32_t offsetInFile = ((smpHdr.offsetInFileH << 16) | smpHdr.offsetInFile) << 4;
+		if (smpHdr.type != 1 || offsetInFile == 0 || offsetInFile >= filesize || smpHdr.length <= 0)
+			continue; // not loaded
+
+		if ((smpHdr.flags & (255-1-2-4)) != 0 || smpHdr.packFlag != 0)
+			info->warnings |= MODINFO_WARN_CORRUPT; // the loader doesn't support this
+
+		// (the loader cuts the sample off at the end of the file, stereo samples are mixed to mono)
+		uint32_t length = (uint32_t)smpHdr.length;
+		if (offsetInFile+length > filesize)
+		{
+			length = filesize - offsetInFile;
+			info->warnings |= MODINFO_WARN_TRUNCATED;
+		}
+
+		if (smpHdr.flags & 4)
+			length *= 2;
+
+		info->sampleDataBytes = (uint32_t)MIN((uint64_t)info->sampleDataBytes + length, UINT32_MAX);
+	}
+
+	return true;
+}
+
+bool loadS3M(MEMFILE *f, uint32_t filesize)
 {
 	uint8_t alastnfo[32], alastefx[32], alastvibnfo[32], alastGxxInstr[32];
 	uint16_t tmpU16;
@@ -68,21 +169,21 @@ bool loadS3M(FILE *f, uint32_t filesize)
 	}
 
 	memset(&header, 0, sizeof (header));
-	if (fread(&header, 1, sizeof (header), f) != sizeof (header))
+	if (mread(&header, 1, sizeof (header), f) != sizeof (header))
 	{
 		loaderMsgBox("Error: This file is either not a module, or is not supported.");
 		return false;
 	}
 
-	if (header.numSamples > MAX_INST || header.numOrders > MAX_ORDERS || header.numPatterns > MAX_PATTERNS ||
-		header.type != 16 || header.ffi < 1 || header.ffi > 2)
+	if (header.numSamples < 0 || header.numSamples > MAX_INST || header.numOrders < 0 || header.numOrders > MAX_ORDERS ||
+		header.numPatterns < 0 || header.numPatterns > MAX_PATTERNS || header.type != 16 || header.ffi < 1 || header.ffi > 2)
 	{
 		loaderMsgBox("Error loading .s3m: Incompatible module!");
 		return false;
 	}
 
 	memset(songTmp.orders, 255, 256); // pad by 255
-	if (fread(songTmp.orders, header.numOrders, 1, f) != 1)
+	if (mread(songTmp.orders, header.numOrders, 1, f) != 1)
 	{
 		loaderMsgBox("General I/O error during loading! Is the file in use?");
 		return false;
@@ -127,7 +228,7 @@ bool loadS3M(FILE *f, uint32_t filesize)
 	// load sample offsets
 	for (int32_t i = 0; i < header.numSamples; i++)
 	{
-		if (fread(&tmpU16, 2, 1, f) != 1)
+		if (mread(&tmpU16, 2, 1, f) != 1)
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -139,7 +240,7 @@ bool loadS3M(FILE *f, uint32_t filesize)
 	// load pattern offsets
 	for (int32_t i = 0; i < header.numPatterns; i++)
 	{
-		if (fread(&tmpU16, 2, 1, f) != 1)
+		if (mread(&tmpU16, 2, 1, f) != 1)
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -161,12 +262,12 @@ bool loadS3M(FILE *f, uint32_t filesize)
 		memset(alastvibnfo, 0, sizeof (alastvibnfo));
 		memset(alastGxxInstr, 0, sizeof (alastGxxInstr));
 
-		fseek(f, patternOffsets[i], SEEK_SET);
-		if (feof(f))
+		mseek(f, patternOffsets[i], SEEK_SET);
+		if (meof(f))
 			continue;
 
 		uint16_t packedPattLen;
-		if (fread(&packedPattLen, 2, 1, f) != 1)
+		if (mread(&packedPattLen, 2, 1, f) != 1)
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -181,7 +282,7 @@ bool loadS3M(FILE *f, uint32_t filesize)
 			}
 			note_t *p = patternTmp[i];
 
-			fread(tmpBuffer, 1, packedPattLen, f);
+			mread(tmpBuffer, 1, packedPattLen, f);
 
 			uint16_t index = 0, chn = 0, row = 0;
 			while (index < packedPattLen)
@@ -509,9 +610,9 @@ bool loadS3M(FILE *f, uint32_t filesize)
 		if (sampleOffsets[i] == 0)
 			continue;
 
-		fseek(f, sampleOffsets[i], SEEK_SET);
+		mseek(f, sampleOffsets[i], SEEK_SET);
 
-		if (fread(&smpHdr, 1, sizeof (smpHdr), f) != sizeof (smpHdr))
+		if (mread(&smpHdr, 1, sizeof (smpHdr), f) != sizeof (smpHdr))
 		{
 			loaderMsgBox("Not enough memory!");
 			return false;
@@ -586,12 +687,12 @@ bool loadS3M(FILE *f, uint32_t filesize)
 				if (hasLoop)
 					s->flags |= LOOP_FORWARD;
 
-				fseek(f, offsetInFile, SEEK_SET);
+				mseek(f, offsetInFile, SEEK_SET);
 
 				if (sample16Bit)
-					fread(s->dataPtr, 2, s->length, f);
+					mread(s->dataPtr, 2, s->length, f);
 				else
-					fread(s->dataPtr, 1, s->length, f);
+					mread(s->dataPtr, 1, s->length, f);
 
 				if (header.ffi == 2) // unsigned samples, convert to signed
 				{
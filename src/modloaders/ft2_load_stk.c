@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_module_loader.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_tables.h"
@@ -31,7 +32,41 @@ stkHdr_t;
 #pragma pack(pop)
 #endif
 
-bool loadSTK(FILE *f, uint32_t filesize)
+bool getSTKInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info)
+{
+	stkHdr_t header;
+
+	if (filesize < sizeof (header) || mread(&header, 1, sizeof (header), f) != sizeof (header))
+		return false;
+
+	if (header.numOrders < 1 || header.numOrders > 128 || header.CIAVal > 220)
+		return false;
+
+	strcpy(info->format, "STK");
+	setModuleInfoTitle(info, header.name, 20);
+	info->numChannels = 4;
+	info->numInstrs = 15;
+	info->songLength = header.numOrders;
+
+	for (int32_t i = 0; i < 128; i++)
+	{
+		if (header.orders[i]+1 > info->numPatterns)
+			info->numPatterns = header.orders[i]+1;
+	}
+
+	for (int32_t i = 0; i < 15; i++)
+	{
+		addModuleInfoName(info, header.smp[i].name, 22);
+		info->sampleDataBytes += 2 * SWAP16(header.smp[i].length);
+	}
+
+	if (sizeof (header) + (info->numPatterns * 64 * 4 * 4) + info->sampleDataBytes > filesize)
+		info->warnings |= MODINFO_WARN_TRUNCATED;
+
+	return true;
+}
+
+bool loadSTK(MEMFILE *f, uint32_t filesize)
 {
 	sample_t *s;
 	modSmpHdr_t *srcSmp;
@@ -49,7 +84,7 @@ bool loadSTK(FILE *f, uint32_t filesize)
 	}
 
 	memset(&header, 0, sizeof (stkHdr_t));
-	if (fread(&header, 1, sizeof (header), f) != sizeof (header))
+	if (mread(&header, 1, sizeof (header), f) != sizeof (header))
 	{
 		loaderMsgBox("Error: This file is either not a module, or is not supported.");
 		return false;
@@ -122,7 +157,7 @@ bool loadSTK(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		fread(tmpBuffer, 1, 64 * 4 * 4, f);
+		mread(tmpBuffer, 1, 64 * 4 * 4, f);
 		uint8_t *pattPtr = tmpBuffer;
 
 		for (int32_t row = 0; row < 64; row++)
@@ -323,7 +358,7 @@ bool loadSTK(FILE *f, uint32_t filesize)
 		if (s->loopStart > 0 && s->loopLength < s->length)
 		{
 			s->length -= s->loopStart;
-			fseek(f, s->loopStart, SEEK_CUR);
+			mseek(f, s->loopStart, SEEK_CUR);
 			s->loopStart = 0;
 		}
 
@@ -333,7 +368,7 @@ bool loadSTK(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		int32_t bytesRead = (int32_t)fread(s->dataPtr, 1, s->length, f);
+		int32_t bytesRead = (int32_t)mread(s->dataPtr, 1, s->length, f);
 		if (bytesRead < s->length)
 		{
 			int32_t bytesToClear = s->length - bytesRead;
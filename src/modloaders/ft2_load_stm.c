@@ -8,6 +8,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_module_loader.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_tables.h"
@@ -52,7 +53,45 @@ static const uint8_t stmEfx[16] = { 0, 0, 11, 0, 10, 2, 1, 3, 4, 7, 0, 5, 6, 0,
 
 static uint16_t stmTempoToBPM(uint8_t tempo);
 
-bool loadSTM(FILE *f, uint32_t filesize)
+bool getSTMInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info)
+{
+	stmHdr_t header;
+
+	if (filesize < sizeof (header) || mread(&header, 1, sizeof (header), f) != sizeof (header))
+		return false;
+
+	if (header.type != 2)
+		return false;
+
+	strcpy(info->format, "STM");
+	setModuleInfoTitle(info, header.name, 20);
+	info->numChannels = 4;
+	info->numInstrs = 31;
+	info->numPatterns = header.numPatterns;
+
+	uint8_t orders[128];
+	const uint8_t maxOrders = (header.verMinor == 0) ? 64 : 128;
+	if (mread(orders, 1, maxOrders, f) != maxOrders)
+		info->warnings |= MODINFO_WARN_TRUNCATED;
+	else
+	{
+		for (int32_t i = 0; i < maxOrders && orders[i] < 99; i++)
+			info->songLength++;
+	}
+
+	for (int32_t i = 0; i < 31; i++)
+	{
+		addModuleInfoName(info, header.smp[i].name, 12);
+		info->sampleDataBytes += header.smp[i].length;
+	}
+
+	if (sizeof (header) + maxOrders + (header.numPatterns * 64 * 4 * 4) + info->sampleDataBytes > filesize)
+		info->warnings |= MODINFO_WARN_TRUNCATED; // (the loader cuts the samples off at the end of the file)
+
+	return true;
+}
+
+bool loadSTM(MEMFILE *f, uint32_t filesize)
 {
 	stmHdr_t header;
 
@@ -64,7 +103,7 @@ bool loadSTM(FILE *f, uint32_t filesize)
 		return false;
 	}
 
-	if (fread(&header, 1, sizeof (header), f) != sizeof (header))
+	if (mread(&header, 1, sizeof (header), f) != sizeof (header))
 	{
 		loaderMsgBox("Error: This file is either not a module, or is not supported.");
 		return false;
@@ -79,7 +118,7 @@ bool loadSTM(FILE *f, uint32_t filesize)
 	songTmp.numChannels = 4;
 
 	uint8_t maxOrders = (header.verMinor == 0) ? 64 : 128;
-	fread(songTmp.orders, 1, maxOrders, f);
+	mread(songTmp.orders, 1, maxOrders, f);
 
 	// count number of orders (song length)
 	songTmp.songLength = 0;
@@ -119,7 +158,7 @@ bool loadSTM(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		fread(tmpBuffer, 1, 64 * 4 * 4, f);
+		mread(tmpBuffer, 1, 64 * 4 * 4, f);
 		uint8_t *pattPtr = tmpBuffer;
 
 		for (int32_t row = 0; row < 64; row++)
@@ -208,7 +247,7 @@ bool loadSTM(FILE *f, uint32_t filesize)
 			memcpy(s->name, srcSmp->name, 12);
 
 			// non-FT2: fixes "acidlamb.stm" and other broken STMs
-			const uint32_t offsetInFile = (uint32_t)ftell(f);
+			const uint32_t offsetInFile = (uint32_t)mtell(f);
 			if (offsetInFile+srcSmp->length > filesize)
 				srcSmp->length = (uint16_t)(filesize - offsetInFile);
 
@@ -238,7 +277,7 @@ bool loadSTM(FILE *f, uint32_t filesize)
 
 			if (offsetInFile < filesize)
 			{
-				if (fread(s->dataPtr, s->length, 1, f) != 1)
+				if (mread(s->dataPtr, s->length, 1, f) != 1)
 				{
 					loaderMsgBox("General I/O error during loading! Possibly corrupt module?");
 					return false;
@@ -5,27 +5,38 @@
 */
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_module_loader.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_tables.h"
 #include "../ft2_sysreqs.h"
+#include "../ft2_sample_pack.h"
 
 /* ModPlug Tracker & OpenMPT supports up to 32 samples per instrument for XMs -  we don't.
 ** For such modules, we use a temporary array here to store the extra sample data lengths
 ** we need to skip to be able to load the file (we lose the extra samples, though...).
 */
 static uint32_t extraSampleLengths[32-MAX_SMP_PER_INST];
+static bool xmSamplesPacked;
 
-static bool loadInstrHeader(FILE *f, int32_t insNum);
-static bool loadInstrSample(FILE *f, int32_t insNum);
-static bool loadPatterns(FILE *f, int32_t numPatterns, uint16_t xmVersion);
+static bool loadInstrHeader(MEMFILE *f, int32_t insNum);
+static bool loadInstrSample(MEMFILE *f, int32_t insNum);
+static bool loadPatterns(MEMFILE *f, int32_t numPatterns, uint16_t xmVersion);
 static void unpackPattern(note_t *p, uint8_t *src, int32_t numRows, int32_t numChannels);
-static void loadADPCMSample(FILE *f, sample_t *s); // ModPlug Tracker
+static void decodeDeltaSample(sampleDecode_t *d, uint8_t *scratch);
+static void decodeADPCMSample(sampleDecode_t *d, uint8_t *scratch); // ModPlug Tracker
+static void decodePackedSample(sampleDecode_t *d, uint8_t *scratch); // our extension
 
-bool loadXM(FILE *f, uint32_t filesize)
+static bool hasPackedSamples(const xmHdr_t *h) // our extension, only files with our tag can have them
+{
+	return h->version == 0x0104 && !memcmp(h->progName, XM_PACKED_PROG_NAME, sizeof (XM_PACKED_PROG_NAME) - 1);
+}
+
+bool loadXM(MEMFILE *f, uint32_t filesize)
 {
 	xmHdr_t header;
 
@@ -35,7 +46,7 @@ bool loadXM(FILE *f, uint32_t filesize)
 		return false;
 	}
 
-	if (fread(&header, 1, sizeof (header), f) != sizeof (header))
+	if (mread(&header, 1, sizeof (header), f) != sizeof (header))
 	{
 		loaderMsgBox("Error: This file is either not a module, or is not supported.");
 		return false;
@@ -67,8 +78,8 @@ bool loadXM(FILE *f, uint32_t filesize)
 		return false;
 	}
 
-	fseek(f, 60 + header.headerSize, SEEK_SET);
-	if (filesize != 336 && feof(f)) // 336 in length at this point = empty XM
+	mseek(f, 60 + header.headerSize, SEEK_SET);
+	if (filesize != 336 && meof(f)) // 336 in length at this point = empty XM
 	{
 		loaderMsgBox("Error loading XM: The module is empty!");
 		return false;
@@ -83,6 +94,7 @@ bool loadXM(FILE *f, uint32_t filesize)
 	songTmp.BPM = header.BPM;
 	songTmp.speed = header.speed;
 	tmpLinearPeriodsFlag = !!(header.flags & 1);
+	xmSamplesPacked = hasPackedSamples(&header);
 
 	if (songTmp.songLength == 0)
 		songTmp.songLength = 1; // (songTmp.orders is already zeroed, this is safe)
@@ -185,7 +197,153 @@ bool loadXM(FILE *f, uint32_t filesize)
 	return true;
 }
 
-static bool loadInstrHeader(FILE *f, int32_t insNum)
+bool getXMInfo(MEMFILE *f, uint32_t filesize, moduleInfo_t *info) // skips the pattern and sample data
+{
+	xmHdr_t header;
+	xmPatHdr_t ph;
+	xmInsHdr_t ih;
+	xmSmpHdr_t sh;
+
+	if (filesize < sizeof (header) || mread(&header, 1, sizeof (header), f) != sizeof (header))
+		return false;
+
+	if (header.version < 0x0102 || header.version > 0x0104 || header.numChannels == 0 || header.numInstr > 256)
+		return false;
+
+	strcpy(info->format, "XM");
+	setModuleInfoTitle(info, header.name, 20);
+	info->numChannels = (uint8_t)MIN(header.numChannels, 255);
+	info->numInstrs = MIN(header.numInstr, MAX_INST);
+	info->songLength = header.numOrders;
+	info->numPatterns = header.numPatterns;
+
+	if (header.numOrders > MAX_ORDERS || header.numPatterns > MAX_PATTERNS)
+		info->warnings |= MODINFO_WARN_CORRUPT;
+
+	if (header.numChannels > MAX_CHANNELS)
+		info->warnings |= MODINFO_WARN_CHANNELS;
+
+	if (header.numInstr > MAX_INST)
+		info->warnings |= MODINFO_WARN_INSTRS;
+
+	uint64_t offset = 60 + header.headerSize;
+	if (header.version == 0x0104) // the patterns come before the instruments
+	{
+		for (int32_t i = 0; i < header.numPatterns; i++)
+		{
+			mseek(f, offset, SEEK_SET);
+			if (mread(&ph, 1, sizeof (ph), f) != sizeof (ph) || ph.headerSize < 0)
+			{
+				info->warnings |= MODINFO_WARN_TRUNCATED;
+				return true; // the song info is still OK
+			}
+
+			offset += ph.headerSize + ph.dataSize;
+		}
+	}
+
+	// (in XM v1.02/v1.03, the patterns and then the data of all samples follow the instruments)
+	uint64_t storedSampleBytes = 0;
+	const bool samplesPacked = hasPackedSamples(&header);
+
+	const int32_t headerBytes = offsetof(xmInsHdr_t, note2SampleLUT);
+	for (int32_t i = 0; i < header.numInstr; i++)
+	{
+		mseek(f, offset, SEEK_SET);
+		if (mread(&ih, 1, headerBytes, f) != (size_t)headerBytes)
+		{
+			info->warnings |= MODINFO_WARN_TRUNCATED;
+			return true;
+		}
+
+		if (ih.numSamples < 0 || ih.numSamples > 32)
+		{
+			info->warnings |= MODINFO_WARN_CORRUPT;
+			return true;
+		}
+
+		if (ih.numSamples > MAX_SMP_PER_INST)
+			info->warnings |= MODINFO_WARN_SAMPLES;
+
+		if (i < MAX_INST)
+			addModuleInfoName(info, ih.name, 22);
+
+		offset += (ih.instrSize == 0) ? INSTR_HEADER_SIZE : ih.instrSize;
+		if (ih.numSamples == 0)
+			continue;
+
+		uint64_t sampleDataLength = 0;
+		for (int32_t j = 0; j < ih.numSamples; j++)
+		{
+			mseek(f, offset + (j * sizeof (xmSmpHdr_t)), SEEK_SET);
+			if (mread(&sh, 1, sizeof (sh), f) != sizeof (sh))
+			{
+				info->warnings |= MODINFO_WARN_TRUNCATED;
+				return true;
+			}
+
+			uint32_t length = sh.length;
+			if (samplesPacked && (sh.nameLength == XM_SMP_IT214_PACKED || sh.nameLength == XM_SMP_IT215_PACKED) &&
+			    !(sh.flags & SAMPLE_STEREO))
+			{
+				// the unpacked length comes first in the sample data
+				mseek(f, offset + (ih.numSamples * sizeof (xmSmpHdr_t)) + sampleDataLength, SEEK_SET);
+				if (sh.length < 4 || mread(&length, 4, 1, f) != 1)
+					length = 0;
+			}
+
+			length = MIN(length, (sh.flags & SAMPLE_16BIT) ? MAX_SAMPLE_LEN*2 : MAX_SAMPLE_LEN);
+			if (sh.flags & SAMPLE_STEREO)
+				length >>= 1; // mixed to mono
+
+			if (i < MAX_INST && j < MAX_SMP_PER_INST)
+				info->sampleDataBytes = (uint32_t)MIN((uint64_t)info->sampleDataBytes + length, UINT32_MAX);
+
+			if (sh.nameLength == 0xAD && !(sh.flags & (SAMPLE_16BIT | SAMPLE_STEREO))) // ModPlug ADPCM
+			{
+				sampleDataLength += 16 + ((sh.length + 1) / 2);
+			}
+			else
+				sampleDataLength += sh.length;
+		}
+
+		offset += ih.numSamples * sizeof (xmSmpHdr_t);
+
+		// in XM v1.04, the sample data follows the sample headers of each instrument
+		if (header.version == 0x0104)
+			offset += sampleDataLength;
+		else
+			storedSampleBytes += sampleDataLength;
+
+		if (offset > filesize)
+		{
+			info->warnings |= MODINFO_WARN_TRUNCATED;
+			return true;
+		}
+	}
+
+	if (header.version < 0x0104)
+	{
+		for (int32_t i = 0; i < header.numPatterns; i++)
+		{
+			mseek(f, offset, SEEK_SET);
+			if (mread(&ph, 1, sizeof (ph), f) != sizeof (ph) || ph.headerSize < 0)
+			{
+				info->warnings |= MODINFO_WARN_TRUNCATED;
+				return true;
+			}
+
+			offset += ph.headerSize + ph.dataSize;
+		}
+
+		if (offset + storedSampleBytes > filesize)
+			info->warnings |= MODINFO_WARN_TRUNCATED;
+	}
+
+	return true;
+}
+
+static bool loadInstrHeader(MEMFILE *f, int32_t insNum)
 {
 	uint32_t readSize;
 	xmInsHdr_t ih;
@@ -193,8 +351,8 @@ static bool loadInstrHeader(FILE *f, int32_t insNum)
 	memset(extraSampleLengths, 0, sizeof (extraSampleLengths));
 	memset(&ih, 0, sizeof (ih));
 
-	fread(&readSize, 4, 1, f);
-	fseek(f, -4, SEEK_CUR);
+	mread(&readSize, 4, 1, f);
+	mseek(f, -4, SEEK_CUR);
 
 	// yes, some XMs can have a header size of 0, and it usually means 263 bytes (INSTR_HEADER_SIZE)
 	if (readSize == 0 || readSize > INSTR_HEADER_SIZE)
@@ -206,11 +364,11 @@ static bool loadInstrHeader(FILE *f, int32_t insNum)
 		return false;
 	}
 
-	fread(&ih, readSize, 1, f); // read instrument header
+	mread(&ih, readSize, 1, f); // read instrument header
 
 	// FT2 bugfix: skip instrument header data if instrSize is above INSTR_HEADER_SIZE
 	if (ih.instrSize > INSTR_HEADER_SIZE)
-		fseek(f, ih.instrSize-INSTR_HEADER_SIZE, SEEK_CUR);
+		mseek(f, ih.instrSize-INSTR_HEADER_SIZE, SEEK_CUR);
 
 	if (ih.numSamples < 0 || ih.numSamples > 32)
 	{
@@ -261,7 +419,7 @@ static bool loadInstrHeader(FILE *f, int32_t insNum)
 		if (sampleHeadersToRead > MAX_SMP_PER_INST)
 			sampleHeadersToRead = MAX_SMP_PER_INST;
 
-		if (fread(ih.smp, sampleHeadersToRead * sizeof (xmSmpHdr_t), 1, f) != 1)
+		if (mread(ih.smp, sampleHeadersToRead * sizeof (xmSmpHdr_t), 1, f) != 1)
 		{
 			loaderMsgBox("General I/O error during loading!");
 			return false;
@@ -273,8 +431,8 @@ static bool loadInstrHeader(FILE *f, int32_t insNum)
 			const int32_t samplesToSkip = ih.numSamples - MAX_SMP_PER_INST;
 			for (int32_t j = 0; j < samplesToSkip; j++)
 			{
-				fread(&extraSampleLengths[j], 4, 1, f); // used for skipping data in loadInstrSample()
-				fseek(f, sizeof (xmSmpHdr_t) - 4, SEEK_CUR);
+				mread(&extraSampleLengths[j], 4, 1, f); // used for skipping data in loadInstrSample()
+				mseek(f, sizeof (xmSmpHdr_t) - 4, SEEK_CUR);
 			}
 		}
 
@@ -289,7 +447,7 @@ static bool loadInstrHeader(FILE *f, int32_t insNum)
 			s->loopLength = srcSmp->loopLength;
 			s->volume = srcSmp->volume;
 			s->finetune = srcSmp->finetune;
-			s->flags = srcSmp->flags;
+			s->flags = srcSmp->flags & ~(SAMPLE_ADPCM | SAMPLE_IT214_PACKED | SAMPLE_IT215_PACKED); // (used by the loader)
 			s->panning = srcSmp->panning;
 			s->relativeNote = srcSmp->relativeNote;
 
@@ -299,6 +457,15 @@ static bool loadInstrHeader(FILE *f, int32_t insNum)
 			if (srcSmp->nameLength == 0xAD && !(srcSmp->flags & (SAMPLE_16BIT | SAMPLE_STEREO)))
 				s->flags |= SAMPLE_ADPCM;
 
+			// IT 2.14/2.15 compressed sample data, an extension of ours (see ft2_sample_pack.h)
+			if (xmSamplesPacked && !(srcSmp->flags & SAMPLE_STEREO))
+			{
+				if (srcSmp->nameLength == XM_SMP_IT214_PACKED)
+					s->flags |= SAMPLE_IT214_PACKED;
+				else if (srcSmp->nameLength == XM_SMP_IT215_PACKED)
+					s->flags |= SAMPLE_IT215_PACKED;
+			}
+
 			memcpy(s->name, srcSmp->name, 22);
 
 			// s->dataPtr is set up later
@@ -308,7 +475,7 @@ static bool loadInstrHeader(FILE *f, int32_t insNum)
 	return true;
 }
 
-static bool loadInstrSample(FILE *f, int32_t insNum)
+static bool loadInstrSample(MEMFILE *f, int32_t insNum)
 {
 	instr_t *ins = instrTmp[1+insNum];
 	if (ins == NULL)
@@ -324,13 +491,27 @@ static bool loadInstrSample(FILE *f, int32_t insNum)
 		for (int32_t i = 0; i < numSamples; i++, s++)
 		{
 			if (s->length > 0)
-				fseek(f, s->length, SEEK_CUR);
+				mseek(f, s->length, SEEK_CUR);
 		}
 	}
 	else
 	{
 		for (int32_t i = 0; i < numSamples; i++, s++)
 		{
+			int32_t lengthInFile = s->length;
+
+			if ((s->flags & (SAMPLE_IT214_PACKED | SAMPLE_IT215_PACKED)) && lengthInFile > 0)
+			{
+				// our extension: the unpacked length in bytes, then the packed data
+				uint32_t unpackedLength = 0;
+				if (lengthInFile >= 4 && mread(&unpackedLength, 4, 1, f) == 1)
+					lengthInFile -= 4;
+
+				s->length = (int32_t)MIN(unpackedLength, (uint32_t)MAX_SAMPLE_LEN*2);
+				if (s->length <= 0)
+					mseek(f, lengthInFile, SEEK_CUR);
+			}
+
 			if (s->length <= 0)
 			{
 				s->length = 0;
@@ -340,11 +521,10 @@ static bool loadInstrSample(FILE *f, int32_t insNum)
 			}
 			else
 			{
-				const int32_t lengthInFile = s->length;
-
 				bool sample16Bit = !!(s->flags & SAMPLE_16BIT);
 				bool stereoSample = !!(s->flags & SAMPLE_STEREO);
 				bool adpcmSample = !!(s->flags & SAMPLE_ADPCM); // ModPlug Tracker
+				bool packedSample = !!(s->flags & (SAMPLE_IT214_PACKED | SAMPLE_IT215_PACKED)); // our extension
 
 				if (sample16Bit) // we use units of samples (not bytes like in FT2)
 				{
@@ -364,18 +544,28 @@ static bool loadInstrSample(FILE *f, int32_t insNum)
 
 				if (adpcmSample)
 				{
-					loadADPCMSample(f, s);
+					queueSampleDecode(f, decodeADPCMSample, s, 16 + ((s->length + 1) / 2), 0);
+				}
+				else if (packedSample)
+				{
+					const bool deltaEncoded = !!(s->flags & SAMPLE_IT215_PACKED);
+					queueSampleDecode(f, decodePackedSample, s, lengthInFile, deltaEncoded);
+				}
+				else if (!stereoSample)
+				{
+					// (the delta decoding is done in parallel after loading)
+					queueSampleDecode(f, decodeDeltaSample, s, lengthInFile, 0);
 				}
 				else
 				{
 					if (sample16Bit)
-						fread(s->dataPtr, 2, s->length, f);
+						mread(s->dataPtr, 2, s->length, f);
 					else
-						fread(s->dataPtr, 1, s->length, f);
+						mread(s->dataPtr, 1, s->length, f);
 
 					const int32_t sampleLengthInBytes = SAMPLE_LENGTH_BYTES(s);
 					if (sampleLengthInBytes < lengthInFile)
-						fseek(f, lengthInFile-sampleLengthInBytes, SEEK_CUR);
+						mseek(f, lengthInFile-sampleLengthInBytes, SEEK_CUR);
 
 					delta2Samp(s->dataPtr, s->length, s->flags);
 
@@ -393,6 +583,9 @@ static bool loadInstrSample(FILE *f, int32_t insNum)
 			// remove stereo flag if present (already handled)
 			if (s->flags & SAMPLE_STEREO)
 				s->flags &= ~SAMPLE_STEREO;
+
+			// remove the loader's own flags, so that they don't end up in saved modules
+			s->flags &= ~(SAMPLE_ADPCM | SAMPLE_IT214_PACKED | SAMPLE_IT215_PACKED);
 		}
 	}
 
@@ -403,54 +596,54 @@ static bool loadInstrSample(FILE *f, int32_t insNum)
 		for (int32_t i = 0; i < samplesToSkip; i++)
 		{
 			if (extraSampleLengths[i] > 0)
-				fseek(f, extraSampleLengths[i], SEEK_CUR);
+				mseek(f, extraSampleLengths[i], SEEK_CUR);
 		}
 	}
 
 	return true;
 }
 
-static bool loadPatterns(FILE *f, int32_t numPatterns, uint16_t xmVersion)
+static bool loadPatterns(MEMFILE *f, int32_t numPatterns, uint16_t xmVersion)
 {
 	xmPatHdr_t ph;
 
 	bool pattLenWarn = false;
 	for (int32_t i = 0; i < numPatterns; i++)
 	{
-		if (fread(&ph.headerSize, 4, 1, f) != 1)
+		if (mread(&ph.headerSize, 4, 1, f) != 1)
 			goto pattCorrupt;
 
-		if (fread(&ph.type, 1, 1, f) != 1)
+		if (mread(&ph.type, 1, 1, f) != 1)
 			goto pattCorrupt;
 
 		ph.numRows = 0;
 		if (xmVersion == 0x0102)
 		{
 			uint8_t tmpLen;
-			if (fread(&tmpLen, 1, 1, f) != 1)
+			if (mread(&tmpLen, 1, 1, f) != 1)
 				goto pattCorrupt;
 
-			if (fread(&ph.dataSize, 2, 1, f) != 1)
+			if (mread(&ph.dataSize, 2, 1, f) != 1)
 				goto pattCorrupt;
 
 			ph.numRows = tmpLen + 1; // +1 in v1.02
 
 			if (ph.headerSize > 8)
-				fseek(f, ph.headerSize - 8, SEEK_CUR);
+				mseek(f, ph.headerSize - 8, SEEK_CUR);
 		}
 		else
 		{
-			if (fread(&ph.numRows, 2, 1, f) != 1)
+			if (mread(&ph.numRows, 2, 1, f) != 1)
 				goto pattCorrupt;
 
-			if (fread(&ph.dataSize, 2, 1, f) != 1)
+			if (mread(&ph.dataSize, 2, 1, f) != 1)
 				goto pattCorrupt;
 
 			if (ph.headerSize > 9)
-				fseek(f, ph.headerSize - 9, SEEK_CUR);
+				mseek(f, ph.headerSize - 9, SEEK_CUR);
 		}
 
-		if (feof(f))
+		if (meof(f))
 			goto pattCorrupt;
 
 		patternNumRowsTmp[i] = ph.numRows;
@@ -468,7 +661,7 @@ static bool loadPatterns(FILE *f, int32_t numPatterns, uint16_t xmVersion)
 				return false;
 			}
 
-			if (fread(tmpBuffer, 1, ph.dataSize, f) != ph.dataSize)
+			if (mread(tmpBuffer, 1, ph.dataSize, f) != ph.dataSize)
 				goto pattCorrupt;
 
 			unpackPattern(patternTmp[i], tmpBuffer, patternNumRowsTmp[i], songTmp.numChannels);
@@ -567,18 +760,43 @@ static void unpackPattern(note_t *p, uint8_t *src, int32_t numRows, int32_t numC
 	}
 }
 
-static void loadADPCMSample(FILE *f, sample_t *s) // ModPlug Tracker
+static void decodeDeltaSample(sampleDecode_t *d, uint8_t *scratch)
 {
+	sample_t *s = d->s;
+
+	const uint32_t sampleLengthInBytes = SAMPLE_LENGTH_BYTES(s);
+	const uint32_t bytesToCopy = (d->srcLength < sampleLengthInBytes) ? d->srcLength : sampleLengthInBytes;
+
+	memcpy(s->dataPtr, d->src, bytesToCopy);
+	delta2Samp(s->dataPtr, s->length, s->flags);
+
+	(void)scratch;
+}
+
+static void decodeADPCMSample(sampleDecode_t *d, uint8_t *scratch) // ModPlug Tracker
+{
+	const uint8_t *src = d->src;
+	const uint8_t *srcEnd = d->src + d->srcLength;
+
 	int8_t deltaLUT[16];
-	fread(deltaLUT, 1, 16, f);
+	memset(deltaLUT, 0, sizeof (deltaLUT));
+	if (d->srcLength >= 16)
+	{
+		memcpy(deltaLUT, src, 16);
+		src += 16;
+	}
+	else
+	{
+		src = srcEnd;
+	}
 
-	int8_t *dataPtr = s->dataPtr;
-	const int32_t dataLength = (s->length + 1) / 2;
+	int8_t *dataPtr = d->s->dataPtr;
+	const int32_t dataLength = (d->s->length + 1) / 2;
 
 	int8_t currSample = 0;
 	for (int32_t i = 0; i < dataLength; i++)
 	{
-		const uint8_t nibbles = (uint8_t)fgetc(f);
+		const uint8_t nibbles = (src < srcEnd) ? *src++ : 0xFF; // (0xFF = EOF, like before)
 
 		currSample += deltaLUT[nibbles & 0x0F];
 		*dataPtr++ = currSample;
@@ -586,4 +804,12 @@ static void loadADPCMSample(FILE *f, sample_t *s) // ModPlug Tracker
 		currSample += deltaLUT[nibbles >> 4];
 		*dataPtr++ = currSample;
 	}
+
+	(void)scratch;
+}
+
+static void decodePackedSample(sampleDecode_t *d, uint8_t *scratch) // our extension
+{
+	sample_t *s = d->s;
+	unpackITSampleData(s->dataPtr, SAMPLE_LENGTH_BYTES(s), !!(s->flags & SAMPLE_16BIT), !!(d->param & 1), d->src, d->srcLength, scratch);
 }
@@ -48,6 +48,18 @@ int32_t getSamplePositionFromScopes(uint8_t ch)
 	return -1; // not active or overflown
 }
 
+bool anyScopeIsActive(void)
+{
+	volatile scope_t *sc = scope;
+	for (int32_t i = 0; i < song.numChannels; i++, sc++)
+	{
+		if (sc->active)
+			return true;
+	}
+
+	return false;
+}
+
 void stopAllScopes(void)
 {
 	// wait for scopes to finish updating
@@ -28,6 +28,7 @@
 #define SCOPE_INTRP_PHASES_BITS 6 /* log2(SCOPE_INTRP_PHASES) */
 
 int32_t getSamplePositionFromScopes(uint8_t ch);
+bool anyScopeIsActive(void);
 void stopAllScopes(void);
 void refreshScopes(void);
 bool testScopesMouseDown(void);
@@ -10,6 +10,7 @@
 #include <stdbool.h>
 #include <math.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_mouse.h"
 #include "../ft2_audio.h"
 #include "../ft2_sample_ed.h"
@@ -17,9 +18,9 @@
 #include "../ft2_sample_loader.h"
 
 static double getAIFFSampleRate(uint8_t *in);
-static bool aiffIsStereo(FILE *f); // only ran on files that are confirmed to be AIFFs
+static bool aiffIsStereo(MEMFILE *f); // only ran on files that are confirmed to be AIFFs
 
-bool loadAIFF(FILE *f, uint32_t filesize)
+bool loadAIFF(MEMFILE *f, uint32_t filesize)
 {
 	char compType[4];
 	int8_t *audioDataS8;
@@ -31,9 +32,9 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 	uint32_t offset;
 	sample_t *s = &tmpSmp;
 
-	fseek(f, 8, SEEK_SET);
-	fread(compType, 1, 4, f);
-	rewind(f);
+	mseek(f, 8, SEEK_SET);
+	mread(compType, 1, 4, f);
+	mrewind(f);
 
 	if (filesize < 12)
 	{
@@ -44,11 +45,11 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 	uint32_t commPtr = 0, commLen = 0;
 	uint32_t ssndPtr = 0, ssndLen = 0;
 
-	fseek(f, 12, SEEK_SET);
-	while (!feof(f) && (uint32_t)ftell(f) < filesize-12)
+	mseek(f, 12, SEEK_SET);
+	while (!meof(f) && (uint32_t)mtell(f) < filesize-12)
 	{
-		fread(&blockName, 4, 1, f); if (feof(f)) break;
-		fread(&blockSize, 4, 1, f); if (feof(f)) break;
+		mread(&blockName, 4, 1, f); if (meof(f)) break;
+		mread(&blockSize, 4, 1, f); if (meof(f)) break;
 
 		blockName = SWAP32(blockName);
 		blockSize = SWAP32(blockSize);
@@ -57,14 +58,14 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 		{
 			case 0x434F4D4D: // "COMM"
 			{
-				commPtr = ftell(f);
+				commPtr = mtell(f);
 				commLen = blockSize;
 			}
 			break;
 
 			case 0x53534E44: // "SSND"
 			{
-				ssndPtr = ftell(f);
+				ssndPtr = mtell(f);
 				ssndLen = blockSize;
 			}
 			break;
@@ -72,7 +73,7 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 			default: break;
 		}
 
-		fseek(f, blockSize + (blockSize & 1), SEEK_CUR);
+		mseek(f, blockSize + (blockSize & 1), SEEK_CUR);
 	}
 
 	if (commPtr == 0 || commLen < 18 || ssndPtr == 0)
@@ -88,11 +89,11 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 	if (ssndPtr+ssndLen > (uint32_t)filesize)
 		ssndLen = filesize - ssndPtr;
 
-	fseek(f, commPtr, SEEK_SET);
-	fread(&numChannels, 2, 1, f); numChannels = SWAP16(numChannels);
-	fseek(f, 4, SEEK_CUR);
-	fread(&bitDepth, 2, 1, f); bitDepth = SWAP16(bitDepth);
-	fread(sampleRateBytes, 1, 10, f);
+	mseek(f, commPtr, SEEK_SET);
+	mread(&numChannels, 2, 1, f); numChannels = SWAP16(numChannels);
+	mseek(f, 4, SEEK_CUR);
+	mread(&bitDepth, 2, 1, f); bitDepth = SWAP16(bitDepth);
+	mread(sampleRateBytes, 1, 10, f);
 
 	if (numChannels != 1 && numChannels != 2)
 	{
@@ -105,7 +106,7 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 	bool floatSample = false;
 	if (commLen > 18)
 	{
-		fread(&compType, 1, 4, f);
+		mread(&compType, 1, 4, f);
 
 		if (!memcmp(compType, "raw ", 4))
 		{
@@ -133,16 +134,16 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 
 	// sample data chunk
 
-	fseek(f, ssndPtr, SEEK_SET);
+	mseek(f, ssndPtr, SEEK_SET);
 
-	fread(&offset, 4, 1, f);
+	mread(&offset, 4, 1, f);
 	if (offset > 0)
 	{
 		loaderMsgBox("Error loading sample: The sample is not supported or is invalid!");
 		return false;
 	}
 
-	fseek(f, 4, SEEK_CUR);
+	mseek(f, 4, SEEK_CUR);
 
 	ssndLen -= 8; // don't include offset and blockSize datas
 
@@ -165,7 +166,7 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		if (fread(s->dataPtr, sampleLength, 1, f) != 1)
+		if (mread(s->dataPtr, sampleLength, 1, f) != 1)
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -225,7 +226,7 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		if (fread(s->dataPtr, sampleLength, sizeof (int16_t), f) != sizeof (int16_t))
+		if (mread(s->dataPtr, sampleLength, sizeof (int16_t), f) != sizeof (int16_t))
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -285,7 +286,7 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		if (fread(&s->dataPtr[sampleLength], sampleLength, 3, f) != 3)
+		if (mread(&s->dataPtr[sampleLength], sampleLength, 3, f) != 3)
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -359,7 +360,7 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		if (fread(s->dataPtr, sampleLength, sizeof (int32_t), f) != sizeof (int32_t))
+		if (mread(s->dataPtr, sampleLength, sizeof (int32_t), f) != sizeof (int32_t))
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -428,7 +429,7 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		if (fread(s->dataPtr, sampleLength, sizeof (float), f) != sizeof (float))
+		if (mread(s->dataPtr, sampleLength, sizeof (float), f) != sizeof (float))
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -498,7 +499,7 @@ bool loadAIFF(FILE *f, uint32_t filesize)
 			return false;
 		}
 
-		if (fread(s->dataPtr, sampleLength, sizeof (double), f) != sizeof (double))
+		if (mread(s->dataPtr, sampleLength, sizeof (double), f) != sizeof (double))
 		{
 			loaderMsgBox("General I/O error during loading! Is the file in use?");
 			return false;
@@ -593,39 +594,39 @@ static double getAIFFSampleRate(uint8_t *in)
 	return (1.0 + dMantissa) * exp2(dExp);
 }
 
-static bool aiffIsStereo(FILE *f) // only ran on files that are confirmed to be AIFFs
+static bool aiffIsStereo(MEMFILE *f) // only ran on files that are confirmed to be AIFFs
 {
 	uint16_t numChannels;
 	uint32_t chunkID, chunkSize;
 
-	uint32_t oldPos = ftell(f);
+	uint32_t oldPos = mtell(f);
 
-	fseek(f, 0, SEEK_END);
-	int32_t filesize = ftell(f);
+	mseek(f, 0, SEEK_END);
+	int32_t filesize = mtell(f);
 
 	if (filesize < 12)
 	{
-		fseek(f, oldPos, SEEK_SET);
+		mseek(f, oldPos, SEEK_SET);
 		return false;
 	}
 
-	fseek(f, 12, SEEK_SET);
+	mseek(f, 12, SEEK_SET);
 
 	uint32_t commPtr = 0;
 	uint32_t commLen = 0;
 
 	int32_t bytesRead = 0;
-	while (!feof(f) && bytesRead < filesize-12)
+	while (!meof(f) && bytesRead < filesize-12)
 	{
-		fread(&chunkID, 4, 1, f); chunkID = SWAP32(chunkID); if (feof(f)) break;
-		fread(&chunkSize, 4, 1, f); chunkSize = SWAP32(chunkSize); if (feof(f)) break;
+		mread(&chunkID, 4, 1, f); chunkID = SWAP32(chunkID); if (meof(f)) break;
+		mread(&chunkSize, 4, 1, f); chunkSize = SWAP32(chunkSize); if (meof(f)) break;
 
-		int32_t endOfChunk = (ftell(f) + chunkSize) + (chunkSize & 1);
+		int32_t endOfChunk = (mtell(f) + chunkSize) + (chunkSize & 1);
 		switch (chunkID)
 		{
 			case 0x434F4D4D: // "COMM"
 			{
-				commPtr = ftell(f);
+				commPtr = mtell(f);
 				commLen = chunkSize;
 			}
 			break;
@@ -634,18 +635,18 @@ static bool aiffIsStereo(FILE *f) // only ran on files that are confirmed to be
 		}
 
 		bytesRead += (chunkSize + (chunkSize & 1));
-		fseek(f, endOfChunk, SEEK_SET);
+		mseek(f, endOfChunk, SEEK_SET);
 	}
 
 	if (commPtr == 0 || commLen < 2)
 	{
-		fseek(f, oldPos, SEEK_SET);
+		mseek(f, oldPos, SEEK_SET);
 		return false;
 	}
 
-	fseek(f, commPtr, SEEK_SET);
-	fread(&numChannels, 2, 1, f); numChannels = SWAP16(numChannels);
-	fseek(f, oldPos, SEEK_SET);
+	mseek(f, commPtr, SEEK_SET);
+	mread(&numChannels, 2, 1, f); numChannels = SWAP16(numChannels);
+	mseek(f, oldPos, SEEK_SET);
 
 	return (numChannels == 2);
 }
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_sysreqs.h"
 #include "../ft2_sample_loader.h"
@@ -17,33 +18,33 @@
 
 static int16_t s1, s2;
 
-bool detectBRR(FILE *f)
+bool detectBRR(MEMFILE *f)
 {
 	if (f == NULL)
 		return false;
 
-	uint32_t oldPos = (uint32_t)ftell(f);
-	fseek(f, 0, SEEK_END);
-	uint32_t filesize = (uint32_t)ftell(f);
+	uint32_t oldPos = (uint32_t)mtell(f);
+	mseek(f, 0, SEEK_END);
+	uint32_t filesize = (uint32_t)mtell(f);
 
 	const uint32_t filesizeMod9 = filesize % 9;
 
 	if (filesize < 11 || filesize > 65536 || (filesizeMod9 != 0 && filesizeMod9 != 2))
 		goto error; // definitely not a BRR file
 
-	rewind(f);
+	mrewind(f);
 
 	uint32_t blockBytes = filesize;
 	if (filesizeMod9 == 2) // skip loop block word
 	{
-		fseek(f, 2, SEEK_CUR);
+		mseek(f, 2, SEEK_CUR);
 		blockBytes -= 2;
 	}
 
 	uint32_t numBlocks = blockBytes / 9;
 
 	// if the first block is the last, this is very unlikely to be a real BRR sample
-	uint8_t header = (uint8_t)fgetc(f);
+	uint8_t header = (uint8_t)mgetc(f);
 	if (header & 1)
 		goto error;
 
@@ -62,15 +63,15 @@ bool detectBRR(FILE *f)
 		if (shift > 13)
 			goto error;
 
-		fseek(f, 8, SEEK_CUR);
-		header = (uint8_t)fgetc(f);
+		mseek(f, 8, SEEK_CUR);
+		header = (uint8_t)mgetc(f);
 	}
 
-	fseek(f, oldPos, SEEK_SET);
+	mseek(f, oldPos, SEEK_SET);
 	return true;
 
 error:
-	fseek(f, oldPos, SEEK_SET);
+	mseek(f, oldPos, SEEK_SET);
 	return false;
 }
 
@@ -115,7 +116,7 @@ static int16_t decodeSample(int8_t nybble, int32_t shift, int32_t filter)
 	return (int16_t)(smp << 1); // multiply by two to get 16-bit scale
 }
 
-bool loadBRR(FILE *f, uint32_t filesize)
+bool loadBRR(MEMFILE *f, uint32_t filesize)
 {
 	sample_t *s = &tmpSmp;
 
@@ -123,7 +124,7 @@ bool loadBRR(FILE *f, uint32_t filesize)
 	if ((filesize % 9) == 2) // loop header present
 	{
 		uint16_t loopStartBlock;
-		fread(&loopStartBlock, 2, 1, f);
+		mread(&loopStartBlock, 2, 1, f);
 		loopStart = BRR_RATIO(loopStartBlock);
 		blockBytes -= 2;
 	}
@@ -144,7 +145,7 @@ bool loadBRR(FILE *f, uint32_t filesize)
 	for (uint32_t i = 0; i < blockBytes; i++)
 	{
 		const uint32_t blockOffset = i % 9;
-		const uint8_t byte = (uint8_t)fgetc(f);
+		const uint8_t byte = (uint8_t)mgetc(f);
 
 		if (blockOffset == 0) // this byte is the BRR header
 		{
@@ -31,6 +31,7 @@
 #endif
 
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_mouse.h"
 #include "../ft2_audio.h"
 #include "../ft2_sample_ed.h"
@@ -38,40 +39,94 @@
 #include "../ft2_sample_loader.h"
 
 #define MAX_FLAC_BLOCK_SIZE 65535
+#define FLAC_READ_BUFFER_SIZE (256*1024)
 
 #define INC_BUFFER \
 	bytesLeft -= bytesHandled; \
 	bufferPtr += bytesHandled;
 
+// calls a miniflac function (on bufferPtr/bytesLeft) until it has been fed enough of the file
+#define FEED_DECODER(call) \
+	do \
+	{ \
+		result = call; \
+		INC_BUFFER \
+	} \
+	while (result == MINIFLAC_CONTINUE && fillReadBuffer());
+
 static uint8_t numChannels, bitDepth;
+static uint8_t *readBuffer, *bufferPtr;
+static uint32_t bytesLeft, fileBytesLeft, flacFilesize;
 static int16_t stereoAction = STEREO_SAMPLE_MIX_TO_MONO;
+static MEMFILE *flacFile;
 static sample_t *s;
 
 static bool writeSamples(int64_t sampleIndex, int32_t **samples, int32_t numSamples);
 
-bool detectFLAC(FILE *f)
+bool detectFLAC(MEMFILE *f)
 {
 	uint8_t h[4];
 	memset(h, 0, sizeof (h));
-	fread(h, 1, 4, f);
+	mread(h, 1, 4, f);
 
 	bool result = (memcmp(h, "fLaC", 4) == 0);
 
-	rewind(f);
+	mrewind(f);
 	return result;
 }
 
-bool loadFLAC(FILE *f, uint32_t filesize)
+// keeps the unhandled bytes and reads more of the file after them, false if there's nothing more to read
+static bool fillReadBuffer(void)
+{
+	if (fileBytesLeft == 0 || bytesLeft >= FLAC_READ_BUFFER_SIZE || sampleLoadingCancelled())
+		return false;
+
+	if (bytesLeft > 0)
+		memmove(readBuffer, bufferPtr, bytesLeft);
+	bufferPtr = readBuffer;
+
+	uint32_t bytesToRead = FLAC_READ_BUFFER_SIZE - bytesLeft;
+	if (bytesToRead > fileBytesLeft)
+		bytesToRead = fileBytesLeft;
+
+	const uint32_t bytesRead = (uint32_t)mread(&readBuffer[bytesLeft], 1, bytesToRead, flacFile);
+	if (bytesRead == 0)
+	{
+		fileBytesLeft = 0;
+		return false;
+	}
+
+	bytesLeft += bytesRead;
+	fileBytesLeft -= bytesRead;
+
+	setSampleLoadProgress(flacFilesize - fileBytesLeft, flacFilesize);
+	return true;
+}
+
+static bool haveBytes(uint32_t numBytes)
+{
+	while (bytesLeft < numBytes)
+	{
+		if (!fillReadBuffer())
+			return false;
+	}
+
+	return true;
+}
+
+bool loadFLAC(MEMFILE *f, uint32_t filesize)
 {
 	int32_t *samples[2] = { NULL };
 	uint32_t sampleRate = 44100;
 	uint64_t totalSamples = 0;
 	miniflac_t decoder;
+	MINIFLAC_RESULT result;
 
 	s = &tmpSmp;
 
-	uint8_t *fileBuffer = (uint8_t *)malloc(filesize);
-	if (fileBuffer == NULL)
+	// the file is decoded while reading it in blocks, straight into the sample data
+	readBuffer = (uint8_t *)malloc(FLAC_READ_BUFFER_SIZE);
+	if (readBuffer == NULL)
 		goto oomError;
 
 	samples[0] = (int32_t *)malloc(sizeof (int32_t) * MAX_FLAC_BLOCK_SIZE);
@@ -79,18 +134,24 @@ bool loadFLAC(FILE *f, uint32_t filesize)
 	if (samples[0] == NULL || samples[1] == NULL)
 		goto oomError;
 
-	if (fread(fileBuffer, 1, filesize, f) != filesize)
+	flacFile = f;
+	flacFilesize = fileBytesLeft = filesize;
+	bufferPtr = readBuffer;
+	bytesLeft = 0;
+
+	uint32_t bytesHandled;
+
+	if (!fillReadBuffer())
 	{
-		loaderMsgBox("General I/O error during loading! Is the file in use?");
+		if (!sampleLoadingCancelled())
+			loaderMsgBox("General I/O error during loading! Is the file in use?");
+
 		goto errorCleanup;
 	}
 
-	uint8_t *bufferPtr = fileBuffer;
-	uint32_t bytesHandled, bytesLeft = filesize;
-
 	miniflac_init(&decoder, MINIFLAC_CONTAINER_NATIVE);
-	if (miniflac_sync(&decoder, bufferPtr, bytesLeft, &bytesHandled) != MINIFLAC_OK) goto decodeError;
-	INC_BUFFER
+	FEED_DECODER(miniflac_sync(&decoder, bufferPtr, bytesLeft, &bytesHandled))
+	if (result != MINIFLAC_OK) goto decodeError;
 
 	s->volume = 64;
 	s->panning = 128;
@@ -99,67 +160,72 @@ bool loadFLAC(FILE *f, uint32_t filesize)
 	{
 		if (decoder.metadata.header.type == MINIFLAC_METADATA_STREAMINFO)
 		{
-			if (miniflac_streaminfo_sample_rate(&decoder, bufferPtr, bytesLeft, &bytesHandled, &sampleRate) != MINIFLAC_OK) goto decodeError;
-			INC_BUFFER
-			if (miniflac_streaminfo_channels(&decoder, bufferPtr, bytesLeft, &bytesHandled, &numChannels) != MINIFLAC_OK) goto decodeError;
-			INC_BUFFER
-			if (miniflac_streaminfo_bps(&decoder, bufferPtr, bytesLeft, &bytesHandled, &bitDepth) != MINIFLAC_OK) goto decodeError;
-			INC_BUFFER
-			if (miniflac_streaminfo_total_samples(&decoder, bufferPtr, bytesLeft, &bytesHandled, &totalSamples) != MINIFLAC_OK) goto decodeError;
-			INC_BUFFER
+			FEED_DECODER(miniflac_streaminfo_sample_rate(&decoder, bufferPtr, bytesLeft, &bytesHandled, &sampleRate))
+			if (result != MINIFLAC_OK) goto decodeError;
+			FEED_DECODER(miniflac_streaminfo_channels(&decoder, bufferPtr, bytesLeft, &bytesHandled, &numChannels))
+			if (result != MINIFLAC_OK) goto decodeError;
+			FEED_DECODER(miniflac_streaminfo_bps(&decoder, bufferPtr, bytesLeft, &bytesHandled, &bitDepth))
+			if (result != MINIFLAC_OK) goto decodeError;
+			FEED_DECODER(miniflac_streaminfo_total_samples(&decoder, bufferPtr, bytesLeft, &bytesHandled, &totalSamples))
+			if (result != MINIFLAC_OK) goto decodeError;
 		}
-		else if (decoder.metadata.header.type == MINIFLAC_METADATA_APPLICATION && !memcmp(bufferPtr, "riff", 4))
+		else if (decoder.metadata.header.type == MINIFLAC_METADATA_APPLICATION)
 		{
-			const uint8_t *data = bufferPtr + 4;
+			haveBytes(64); // the chunk data we parse below (reads past the end only reach old buffer data)
 
-			uint32_t chunkID  = *(uint32_t *)data; data += 4;
-			uint32_t chunkLen = *(uint32_t *)data; data += 4;
-
-			if (chunkID == 0x61727478 && chunkLen >= 8) // "xtra"
+			if (!memcmp(bufferPtr, "riff", 4))
 			{
-				uint32_t xtraFlags = *(uint32_t *)data; data += 4;
+				const uint8_t *data = bufferPtr + 4;
+
+				uint32_t chunkID  = *(uint32_t *)data; data += 4;
+				uint32_t chunkLen = *(uint32_t *)data; data += 4;
 
-				// panning (0..256)
-				if (xtraFlags & 0x20) // set panning flag
+				if (chunkID == 0x61727478 && chunkLen >= 8) // "xtra"
 				{
-					uint16_t tmpPan = *(uint16_t *)data;
-					if (tmpPan > 255)
-						tmpPan = 255;
+					uint32_t xtraFlags = *(uint32_t *)data; data += 4;
 
-					s->panning = (uint8_t)tmpPan;
-				}
-				data += 2;
+					// panning (0..256)
+					if (xtraFlags & 0x20) // set panning flag
+					{
+						uint16_t tmpPan = *(uint16_t *)data;
+						if (tmpPan > 255)
+							tmpPan = 255;
 
-				// volume (0..256)
-				uint16_t tmpVol = *(uint16_t *)data;
-				if (tmpVol > 256)
-					tmpVol = 256;
+						s->panning = (uint8_t)tmpPan;
+					}
+					data += 2;
 
-				s->volume = (uint8_t)((tmpVol + 2) / 4); // 0..256 -> 0..64 (rounded)
-			}
+					// volume (0..256)
+					uint16_t tmpVol = *(uint16_t *)data;
+					if (tmpVol > 256)
+						tmpVol = 256;
 
-			if (chunkID == 0x6C706D73 && chunkLen > 52) // "smpl"
-			{
-				data += 28; // seek to first wanted byte
+					s->volume = (uint8_t)((tmpVol + 2) / 4); // 0..256 -> 0..64 (rounded)
+				}
 
-				uint32_t numLoops = *(uint32_t *)data; data += 4;
-				if (numLoops == 1)
+				if (chunkID == 0x6C706D73 && chunkLen > 52) // "smpl"
 				{
-					data += 4+4; // skip "samplerData" and "identifier"
+					data += 28; // seek to first wanted byte
+
+					uint32_t numLoops = *(uint32_t *)data; data += 4;
+					if (numLoops == 1)
+					{
+						data += 4+4; // skip "samplerData" and "identifier"
 
-					uint32_t loopType  = *(uint32_t *)data; data += 4;
-					uint32_t loopStart = *(uint32_t *)data; data += 4;
-					uint32_t loopEnd   = *(uint32_t *)data; data += 4;
+						uint32_t loopType  = *(uint32_t *)data; data += 4;
+						uint32_t loopStart = *(uint32_t *)data; data += 4;
+						uint32_t loopEnd   = *(uint32_t *)data; data += 4;
 
-					s->loopStart = loopStart;
-					s->loopLength = (loopEnd+1) - loopStart;
-					s->flags |= (loopType == 0) ? LOOP_FORWARD : LOOP_PINGPONG;
+						s->loopStart = loopStart;
+						s->loopLength = (loopEnd+1) - loopStart;
+						s->flags |= (loopType == 0) ? LOOP_FORWARD : LOOP_PINGPONG;
+					}
 				}
 			}
 		}
 
-		if (miniflac_sync_native(&decoder, bufferPtr, bytesLeft, &bytesHandled) != MINIFLAC_OK) break;
-		INC_BUFFER
+		FEED_DECODER(miniflac_sync_native(&decoder, bufferPtr, bytesLeft, &bytesHandled))
+		if (result != MINIFLAC_OK) break;
 	}
 
 	if (numChannels > 2)
@@ -197,24 +263,26 @@ bool loadFLAC(FILE *f, uint32_t filesize)
 	int64_t sampleIndex = 0;
 	while (true)
 	{
-		if (miniflac_decode(&decoder, bufferPtr, bytesLeft, &bytesHandled, samples) != MINIFLAC_OK) break;
-		INC_BUFFER
+		FEED_DECODER(miniflac_decode(&decoder, bufferPtr, bytesLeft, &bytesHandled, samples))
+		if (result != MINIFLAC_OK) break;
 
 		const int32_t numSamples = decoder.frame.header.block_size;
 		if (!writeSamples(sampleIndex, samples, numSamples)) break;
 		sampleIndex += numSamples;
 
-		if (miniflac_sync_native(&decoder, bufferPtr, bytesLeft, &bytesHandled) != MINIFLAC_OK) break;
-		INC_BUFFER
+		FEED_DECODER(miniflac_sync_native(&decoder, bufferPtr, bytesLeft, &bytesHandled))
+		if (result != MINIFLAC_OK) break;
 	}
 
-	if (fileBuffer != NULL) free(fileBuffer);
-	if (samples[0] != NULL) free(samples[0]);
-	if (samples[1] != NULL) free(samples[1]);
+	if (sampleLoadingCancelled())
+		goto errorCleanup; // (no message)
 
-	return true;
+	free(readBuffer);
+	free(samples[0]);
+	free(samples[1]);
+	readBuffer = bufferPtr = NULL;
 
-	(void)filesize;
+	return true;
 
 oomError:
 	loaderMsgBox("Not enough memory!");
@@ -223,9 +291,10 @@ oomError:
 decodeError:
 	loaderMsgBox("Error loading sample: The sample is empty or corrupt!");
 errorCleanup:
-	if (fileBuffer != NULL) free(fileBuffer);
+	if (readBuffer != NULL) free(readBuffer);
 	if (samples[0] != NULL) free(samples[0]);
 	if (samples[1] != NULL) free(samples[1]);
+	readBuffer = bufferPtr = NULL;
 
 	return false;
 }
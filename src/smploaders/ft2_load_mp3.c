@@ -33,19 +33,27 @@
 #endif
 
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_mouse.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_sysreqs.h"
 #include "../ft2_sample_loader.h"
 
+typedef struct mp3Stream_t
+{
+	MEMFILE *f;
+	uint32_t filesize;
+	bool decoding;
+} mp3Stream_t;
+
 static bool mp3IsStereo = true;
 
-bool detectMP3(FILE *f)
+bool detectMP3(MEMFILE *f)
 {
 	uint8_t h[10];
 
 	memset(h, 0, sizeof (h));
-	fread(h, 1, 10, f);
+	mread(h, 1, 10, f);
 
 	// skip IDv3 tag, if found
 	if (!memcmp(h, "ID3", 3) && !((h[5] & 15) || (h[6] & 0x80) || (h[7] & 0x80) || (h[8] & 0x80) || (h[9] & 0x80)))
@@ -54,10 +62,10 @@ bool detectMP3(FILE *f)
 		if (h[5] & 16)
 			bytesToSkip += 10; // footer present
 
-		fseek(f, 10+bytesToSkip, SEEK_SET);
+		mseek(f, 10+bytesToSkip, SEEK_SET);
 
 		h[0] = h[1] = h[2] = h[3] = 0;
-		fread(h, 1, 4, f);
+		mread(h, 1, 4, f);
 	}
 
 	mp3IsStereo = (((h[3]) & 0xC0) != 0xC0);
@@ -70,22 +78,36 @@ bool detectMP3(FILE *f)
 	    (HDR_GET_BITRATE(h) != 15) &&
 	    (HDR_GET_SAMPLE_RATE(h) != 3);
 	
-	rewind(f);
+	mrewind(f);
 	return result;
 }
 
-bool loadMP3(FILE *f, uint32_t filesize)
+static size_t mp3ReadCallback(void *buf, size_t size, void *userData)
 {
-	mp3dec_t mp3d;
-	mp3dec_file_info_t info;
-	sample_t *s = &tmpSmp;
+	mp3Stream_t *stream = (mp3Stream_t *)userData;
+	if (sampleLoadingCancelled())
+		return 0; // makes the decoder stop (EOF)
 
-	uint8_t *buf = (uint8_t *)malloc(filesize);
-	if (buf == NULL)
-	{
-		loaderMsgBox("Out of memory!");
-		return false;
-	}
+	const size_t bytesRead = mread(buf, 1, size, stream->f);
+
+	// the file is read twice, first to find the length and then to decode it
+	const uint64_t pos = (uint64_t)mtell(stream->f);
+	setSampleLoadProgress((stream->decoding ? stream->filesize : 0) + pos, (uint64_t)stream->filesize * 2);
+
+	return bytesRead;
+}
+
+static int mp3SeekCallback(uint64_t position, void *userData)
+{
+	mp3Stream_t *stream = (mp3Stream_t *)userData;
+	return mseek(stream->f, (int64_t)position, SEEK_SET);
+}
+
+bool loadMP3(MEMFILE *f, uint32_t filesize)
+{
+	mp3Stream_t stream;
+	mp3dec_io_t io;
+	sample_t *s = &tmpSmp;
 
 	int16_t stereoAction = -1;
 	if (mp3IsStereo)
@@ -94,15 +116,29 @@ bool loadMP3(FILE *f, uint32_t filesize)
 		setMouseBusy(true);
 	}
 
-	if (fread(buf, 1, filesize, f) != filesize)
+	stream.f = f;
+	stream.filesize = filesize;
+	stream.decoding = false;
+
+	io.read = mp3ReadCallback;
+	io.read_data = &stream;
+	io.seek = mp3SeekCallback;
+	io.seek_data = &stream;
+
+	// decoded in small blocks, straight into the sample data (the whole file is never in memory)
+	mp3dec_ex_t *dec = (mp3dec_ex_t *)calloc(1, sizeof (mp3dec_ex_t));
+	if (dec == NULL)
 	{
-		free(buf);
-		loaderMsgBox("General I/O error during loading! Is the file in use?");
+		loaderMsgBox("Out of memory!");
 		return false;
 	}
 
-	int32_t result = mp3dec_load_buf(&mp3d, buf, filesize, &info, NULL, NULL);
-	free(buf);
+	int32_t result = mp3dec_ex_open_cb(dec, &io, MP3D_SEEK_TO_BYTE);
+	if (result == 0 && sampleLoadingCancelled())
+		goto error; // (no message)
+
+	if (result == 0 && (dec->samples == 0 || dec->info.channels < 1 || dec->info.channels > 2))
+		result = MP3D_E_DECODE;
 
 	if (result != 0)
 	{
@@ -121,53 +157,86 @@ bool loadMP3(FILE *f, uint32_t filesize)
 				break;
 		}
 
-		return false;
+		goto error;
 	}
 
-	uint32_t sampleLength = (uint32_t)info.samples;
-	if (mp3IsStereo)
-		sampleLength >>= 1;
+	const int32_t numChannels = dec->info.channels;
+	if (numChannels == 2 && stereoAction == -1)
+		stereoAction = STEREO_SAMPLE_MIX_TO_MONO; // (the first frame header said mono)
+
+	uint64_t maxLength = dec->samples / numChannels;
+	if (maxLength > MAX_SAMPLE_LEN)
+		maxLength = MAX_SAMPLE_LEN;
 
-	if (!allocateSmpData(s, sampleLength, true))
+	if (!allocateSmpData(s, (int32_t)maxLength, true))
 	{
 		loaderMsgBox("Not enough memory!");
-		return false;
+		goto error;
 	}
 
+	stream.decoding = true;
+
 	int16_t *dst16 = (int16_t *)s->dataPtr;
-	if (mp3IsStereo)
+	uint32_t sampleLength = 0;
+	while (sampleLength < maxLength)
 	{
-		if (stereoAction == STEREO_SAMPLE_MIX_TO_MONO)
+		mp3d_sample_t *src16;
+		mp3dec_frame_info_t frameInfo;
+
+		size_t numSamples = mp3dec_ex_read_frame(dec, &src16, &frameInfo, MINIMP3_MAX_SAMPLES_PER_FRAME);
+		if (numSamples == 0)
+			break;
+
+		numSamples /= numChannels;
+		if (numSamples > maxLength-sampleLength)
+			numSamples = (size_t)(maxLength-sampleLength);
+
+		if (numChannels == 2)
 		{
-			int16_t *src16 = (int16_t *)info.buffer;
-			for (uint32_t i = 0; i < sampleLength; i++, src16 += 2)
-				dst16[i] = (src16[0] + src16[1]) >> 1;
+			if (stereoAction == STEREO_SAMPLE_MIX_TO_MONO)
+			{
+				for (size_t i = 0; i < numSamples; i++, src16 += 2)
+					*dst16++ = (src16[0] + src16[1]) >> 1;
+			}
+			else
+			{
+				if (stereoAction == STEREO_SAMPLE_READ_RIGHT_CHANNEL)
+					src16++;
+
+				for (size_t i = 0; i < numSamples; i++, src16 += 2)
+					*dst16++ = *src16;
+			}
 		}
 		else
 		{
-			int16_t *src16;
-			if (stereoAction == STEREO_SAMPLE_READ_LEFT_CHANNEL)
-				src16 = (int16_t *)info.buffer + 0;
-			else
-				src16 = (int16_t *)info.buffer + 1;
-
-			for (uint32_t i = 1; i < sampleLength; i++, src16 += 2)
-				dst16[i] = *src16;
+			// mono
+			memcpy(dst16, src16, numSamples * sizeof (int16_t));
+			dst16 += numSamples;
 		}
+
+		sampleLength += (uint32_t)numSamples;
 	}
-	else
-	{
-		// mono
-		memcpy(dst16, info.buffer, sampleLength * sizeof (uint16_t));
-	}
 
-	free(info.buffer);
+	if (sampleLoadingCancelled())
+		goto error;
+
+	if (sampleLength < maxLength) // the length found when scanning is not always exact
+		reallocateSmpData(s, sampleLength, true);
 
 	s->volume = 64;
 	s->panning = 128;
 	s->flags = SAMPLE_16BIT;
 	s->length = sampleLength;
-	setSampleC4Hz(s, info.hz);
+	setSampleC4Hz(s, dec->info.hz);
+
+	mp3dec_ex_close(dec);
+	free(dec);
 
 	return true;
+
+error:
+	mp3dec_ex_close(dec);
+	free(dec);
+
+	return false;
 }
@@ -39,6 +39,7 @@
 #endif
 
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_mouse.h"
 #include "../ft2_audio.h"
 #include "../ft2_sample_ed.h"
@@ -47,24 +48,41 @@
 
 #define SAMPLE_BUFFER_SIZE 524208
 
-bool detectOGG(FILE *f)
+bool detectOGG(MEMFILE *f)
 {
 	uint8_t h[4];
 	memset(h, 0, sizeof (h));
-	fread(h, 1, 4, f);
+	mread(h, 1, 4, f);
 
 	bool result = (memcmp(h, "OggS", 4) == 0);
 
-	rewind(f);
+	mrewind(f);
 	return result;
 }
 
-bool loadOGG(FILE *f, uint32_t filesize)
+static size_t oggRead(void *ptr, size_t size, size_t count, void *datasource)
+{
+	return mread(ptr, size, count, (MEMFILE *)datasource);
+}
+
+static int oggSeek(void *datasource, ogg_int64_t offset, int whence)
+{
+	return mseek((MEMFILE *)datasource, offset, whence);
+}
+
+static long oggTell(void *datasource)
+{
+	return (long)mtell((MEMFILE *)datasource);
+}
+
+static ov_callbacks oggCallbacks = { oggRead, oggSeek, NULL, oggTell }; // (no close, the file is closed by the caller)
+
+bool loadOGG(MEMFILE *f, uint32_t filesize)
 {
 	OggVorbis_File vorbis;
 	sample_t *s = &tmpSmp;
 
-	if (ov_open_callbacks(f, &vorbis, NULL, 0, OV_CALLBACKS_DEFAULT) != 0)
+	if (ov_open_callbacks(f, &vorbis, NULL, 0, oggCallbacks) != 0)
 	{
 		loaderMsgBox("Error loading sample: The sample is empty or corrupt!");
 		return false;
@@ -7,11 +7,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "../ft2_header.h"
+#include "../ft2_memfile.h"
 #include "../ft2_sample_ed.h"
 #include "../ft2_sysreqs.h"
 #include "../ft2_sample_loader.h"
 
-bool loadRAW(FILE *f, uint32_t filesize)
+bool loadRAW(MEMFILE *f, uint32_t filesize)
 {
 	sample_t *s = &tmpSmp;
 
@@ -21,7 +22,7 @@ bool loadRAW(FILE *f, uint32_t filesize)
 		return false;
 	}
 
-	if (fread(s->dataPtr, filesize, 1, f) != 1)
+	if (mread(s->dataPtr, filesize, 1, f) != 1)
 	{
 		okBoxThreadSafe(0, "System message", "General I/O error during loading! Is the file in use?", NULL);
 		return false;